@@ -0,0 +1,654 @@
+/*
+  File: exprbtch.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Evaluate an expression over columns of values
+
+  This file is part of ExprEval.
+*/
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+#include <errno.h>
+
+/* Block size */
+#define EXPR_BS EXPR_BATCHSIZE
+
+/* Batch evaluation state */
+typedef struct _exprBatch
+{
+  exprObj *obj; /* Expression being evaluated */
+  exprProgram *prog; /* Its compiled program */
+  exprBinding *bindings; /* Variable bindings */
+  int bindcount; /* Number of bindings */
+  int *bind; /* Binding of each slot, -1 if none */
+  char *stored; /* Slot was assigned in the current block */
+  EXPRTYPE *stack; /* One column per stack item */
+  EXPRTYPE *cols; /* One column per slot, for assigned slots */
+} exprBatch;
+
+/* Internal functions */
+static int exprBatchVector(exprBatch *batch);
+static int exprBatchBlock(exprBatch *batch, int row, int rows, EXPRTYPE *out);
+static int exprBatchScalar(exprBatch *batch, int row, int rows, EXPRTYPE *out);
+static void exprBatchFinish(exprBatch *batch, int row, int rows);
+
+/* Column loop replacing the top column with a math routine */
+#define EXPR_BATCH_MATH1(op, func)              \
+  case op:                                      \
+    EXPR_BATCH_RESET_ERR();                     \
+    for(pos = 0; pos < rows; pos++)             \
+      sp[pos] = func(sp[pos]);                  \
+    EXPR_BATCH_CHECK_ERR();                     \
+    break;
+
+/* Column loop replacing the top two columns with a math routine */
+#define EXPR_BATCH_MATH2(op, func)              \
+  case op:                                      \
+    sp -= EXPR_BS;                              \
+    EXPR_BATCH_RESET_ERR();                     \
+    for(pos = 0; pos < rows; pos++)             \
+      sp[pos] = func(sp[pos], sp[pos + EXPR_BS]); \
+    EXPR_BATCH_CHECK_ERR();                     \
+    break;
+
+/* Column loop for a simple binary expression of a and b */
+#define EXPR_BATCH_BINARY(op, expr)             \
+  case op:                                      \
+    sp -= EXPR_BS;                              \
+    for(pos = 0; pos < rows; pos++)             \
+      {                                         \
+        EXPRTYPE a = sp[pos];                   \
+        EXPRTYPE b = sp[pos + EXPR_BS];         \
+        sp[pos] = (expr);                       \
+      }                                         \
+    break;
+
+/* Column kernel replacing the top column */
+#define EXPR_BATCH_KERNEL1(op, kernel)          \
+  case op:                                      \
+    EXPR_BATCH_KERNEL(kernel(sp, sp, rows, NULL)); \
+    break;
+
+/* Same, for kernels that can't fail */
+#define EXPR_BATCH_EXACT1(op, kernel)           \
+  case op:                                      \
+    kernel(sp, sp, rows);                       \
+    break;
+
+/* Same, for expressions calling math routines */
+#define EXPR_BATCH_BINARYERR(op, expr)          \
+  case op:                                      \
+    sp -= EXPR_BS;                              \
+    EXPR_BATCH_RESET_ERR();                     \
+    for(pos = 0; pos < rows; pos++)             \
+      {                                         \
+        EXPRTYPE a = sp[pos];                   \
+        EXPRTYPE b = sp[pos + EXPR_BS];         \
+        sp[pos] = (expr);                       \
+      }                                         \
+    EXPR_BATCH_CHECK_ERR();                     \
+    break;
+
+/* Any math error (errno or a kernel error) in a block means the block is evaluated
+   again one row at a time to find the row and error */
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+#define EXPR_BATCH_RESET_ERR() errno = 0
+#define EXPR_BATCH_CHECK_ERR() if(errno) return EXPR_ERROR_OUTOFRANGE
+#define EXPR_BATCH_KERNEL(call) if((call) != EXPR_ERROR_NOERROR) return EXPR_ERROR_OUTOFRANGE
+#else
+#define EXPR_BATCH_RESET_ERR()
+#define EXPR_BATCH_CHECK_ERR()
+#define EXPR_BATCH_KERNEL(call) (call)
+#endif
+
+
+/* Evaluate an expression count times.  Each binding supplies the
+   value of a variable for each row, and the result of each row is
+   stored in out, which may be NULL.  After the call, variables hold
+   the values from the last row, just as if exprEval had been called
+   once per row. */
+int exprEvalBatch(exprObj *obj, int count, exprBinding *bindings, int bindcount, EXPRTYPE *out)
+{
+  exprBatch batch;
+  exprProgram *prog;
+  EXPRTYPE dummy[EXPR_BS];
+  int vector;
+  int row, rows;
+  int pos, slot;
+  int err;
+  size_t size;
+  char *mem;
+
+  if(obj == NULL || (bindings == NULL && bindcount > 0))
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(obj->parsedbad || !obj->parsedgood || obj->headnode == NULL)
+    return EXPR_ERROR_BADEXPR;
+
+  if(count <= 0)
+    return EXPR_ERROR_NOERROR;
+
+  /* Batches always run the compiled program */
+  if(obj->program == NULL)
+    {
+      err = exprCompile(obj);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+    }
+
+  prog = obj->program;
+
+  /* Allocate the state */
+  size = prog->varcount * sizeof(int) +
+    prog->depth * EXPR_BS * sizeof(EXPRTYPE) +
+    prog->varcount * EXPR_BS * sizeof(EXPRTYPE) +
+    prog->varcount;
+
+  /* Columns are only read for slots marked as stored */
+  mem = exprAllocRawMem(size);
+  if(mem == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  batch.obj = obj;
+  batch.prog = prog;
+  batch.bindings = bindings;
+  batch.bindcount = bindcount;
+  batch.stack = (EXPRTYPE*)mem;
+  batch.cols = batch.stack + prog->depth * EXPR_BS;
+  batch.bind = (int*)(batch.cols + prog->varcount * EXPR_BS);
+  batch.stored = (char*)(batch.bind + prog->varcount);
+
+  /* Find the binding of each slot */
+  for(slot = 0; slot < prog->varcount; slot++)
+    {
+      batch.bind[slot] = -1;
+
+      for(pos = 0; pos < bindcount; pos++)
+        {
+          if(bindings[pos].addr == prog->vars[slot])
+            batch.bind[slot] = pos;
+        }
+    }
+
+  vector = exprBatchVector(&batch);
+
+  /* Evaluate each block */
+  err = EXPR_ERROR_NOERROR;
+
+  for(row = 0; row < count; row += rows)
+    {
+      rows = count - row;
+      if(rows > EXPR_BS)
+        rows = EXPR_BS;
+
+      /* The breaker is checked once per block */
+      err = exprCheckBreak(obj, prog->count * rows);
+      if(err != EXPR_ERROR_NOERROR)
+        break;
+
+      err = EXPR_ERROR_UNKNOWN;
+
+      if(vector)
+        err = exprBatchBlock(&batch, row, rows, out ? out + row : dummy);
+
+      if(err == EXPR_ERROR_NOERROR)
+        {
+          exprBatchFinish(&batch, row, rows);
+        }
+      else
+        {
+          /* Not vectorizable or an error occured, go row by row */
+          err = exprBatchScalar(&batch, row, rows, out ? out + row : dummy);
+          if(err != EXPR_ERROR_NOERROR)
+            break;
+        }
+    }
+
+  exprFreeMem(mem);
+
+  /* Each row is an evaluation, and the cost of each block was given
+     to exprCheckBreak */
+  EXPR_STAT_EVAL(count, obj->loopnodes, err);
+  obj->loopnodes = 0;
+
+  return err;
+}
+
+/* Determine if the program can be evaluated a column at a time.
+   It must be straight line code without function solvers, and
+   must not read a variable it assigns before assigning it unless
+   the variable is bound, since that value would come from the
+   previous row. */
+static int exprBatchVector(exprBatch *batch)
+{
+  exprProgram *prog;
+  exprInstr *ip;
+  int slot;
+
+  prog = batch->prog;
+
+  for(ip = prog->code; ip->op != EXPR_OP_END; ip++)
+    {
+      switch(ip->op)
+        {
+          case EXPR_OP_JUMP:
+          case EXPR_OP_JUMPZ:
+          case EXPR_OP_SELECT:
+          case EXPR_OP_CALL:
+          case EXPR_OP_RAND:
+          case EXPR_OP_RANDOM:
+          case EXPR_OP_RANDOMIZE:
+            return 0;
+
+          case EXPR_OP_CALLVAL:
+            {
+              exprNode *node = ip->data.node;
+
+              /* A block that fails is evaluated again a row at a
+                 time, which must not change anything twice */
+              if(node->data.function.eager->bptr == NULL || node->data.function.refcount != 0 ||
+                !(node->data.function.flags & EXPR_FUNC_PURE) || ip->arg > EXPR_EAGER_ARGS)
+                {
+                  return 0;
+                }
+
+              break;
+            }
+
+          case EXPR_OP_LOAD:
+            {
+              exprInstr *next;
+
+              slot = ip->arg;
+              if(batch->bind[slot] != -1)
+                break;
+
+              /* Is it assigned later? */
+              for(next = ip + 1; next->op != EXPR_OP_END; next++)
+                {
+                  if(next->op == EXPR_OP_STORE && next->arg == slot)
+                    break;
+                }
+
+              if(next->op == EXPR_OP_END)
+                break;
+
+              /* Is it assigned earlier? */
+              for(next = prog->code; next != ip; next++)
+                {
+                  if(next->op == EXPR_OP_STORE && next->arg == slot)
+                    break;
+                }
+
+              if(next == ip)
+                return 0;
+
+              break;
+            }
+        }
+    }
+
+  return 1;
+}
+
+/* Evaluate a block of rows a column at a time */
+static int exprBatchBlock(exprBatch *batch, int row, int rows, EXPRTYPE *out)
+{
+  exprProgram *prog;
+  exprInstr *ip;
+  exprBinding *b;
+  EXPRTYPE *sp;
+  EXPRTYPE *col;
+  EXPRTYPE d1;
+  int pos, arg, slot;
+
+  prog = batch->prog;
+  sp = batch->stack - EXPR_BS;
+  memset(batch->stored, 0, prog->varcount);
+
+  for(ip = prog->code; ; ip++)
+    {
+      switch(ip->op)
+        {
+          case EXPR_OP_END:
+            memcpy(out, sp, rows * sizeof(EXPRTYPE));
+            return EXPR_ERROR_NOERROR;
+
+          case EXPR_OP_VALUE:
+            sp += EXPR_BS;
+            d1 = ip->data.value;
+
+            for(pos = 0; pos < rows; pos++)
+              sp[pos] = d1;
+
+            break;
+
+          case EXPR_OP_LOAD:
+            sp += EXPR_BS;
+            slot = ip->arg;
+
+            if(batch->stored[slot])
+              {
+                /* Assigned earlier in this block */
+                memcpy(sp, batch->cols + slot * EXPR_BS, rows * sizeof(EXPRTYPE));
+              }
+            else if(batch->bind[slot] != -1)
+              {
+                /* Read from the binding */
+                b = &(batch->bindings[batch->bind[slot]]);
+                col = (EXPRTYPE*)b->data + (size_t)row * b->stride;
+
+                for(pos = 0; pos < rows; pos++)
+                  sp[pos] = col[(size_t)pos * b->stride];
+              }
+            else
+              {
+                /* Same for every row */
+                d1 = *(prog->vars[slot]);
+
+                for(pos = 0; pos < rows; pos++)
+                  sp[pos] = d1;
+              }
+
+            break;
+
+          case EXPR_OP_STORE:
+            memcpy(batch->cols + ip->arg * EXPR_BS, sp, rows * sizeof(EXPRTYPE));
+            batch->stored[ip->arg] = 1;
+            break;
+
+          case EXPR_OP_POP:
+            sp -= EXPR_BS;
+            break;
+
+          EXPR_BATCH_BINARY(EXPR_OP_ADD, a + b)
+          EXPR_BATCH_BINARY(EXPR_OP_SUBTRACT, a - b)
+          EXPR_BATCH_BINARY(EXPR_OP_MULTIPLY, a * b)
+
+          case EXPR_OP_DIVIDE:
+            sp -= EXPR_BS;
+
+            for(pos = 0; pos < rows; pos++)
+              {
+                if(sp[pos + EXPR_BS] != 0.0)
+                  sp[pos] = sp[pos] / sp[pos + EXPR_BS];
+                else
+                  {
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+                    return EXPR_ERROR_DIVBYZERO;
+#else
+                    sp[pos] = 0.0;
+#endif
+                  }
+              }
+
+            break;
+
+          case EXPR_OP_EXPONENT:
+          case EXPR_OP_POW:
+            sp -= EXPR_BS;
+            EXPR_BATCH_KERNEL(exprKernelPow(sp, sp, sp + EXPR_BS, rows, NULL));
+            break;
+
+          case EXPR_OP_NEGATE:
+            for(pos = 0; pos < rows; pos++)
+              sp[pos] = -sp[pos];
+
+            break;
+
+          EXPR_BATCH_EXACT1(EXPR_OP_ABS, exprKernelAbs)
+
+          EXPR_BATCH_MATH2(EXPR_OP_MOD, fmod)
+
+          case EXPR_OP_IPART:
+            EXPR_BATCH_RESET_ERR();
+            for(pos = 0; pos < rows; pos++)
+              {
+                modf(sp[pos], &d1);
+                sp[pos] = d1;
+              }
+            EXPR_BATCH_CHECK_ERR();
+            break;
+
+          case EXPR_OP_FPART:
+            EXPR_BATCH_RESET_ERR();
+            for(pos = 0; pos < rows; pos++)
+              sp[pos] = modf(sp[pos], &d1);
+            EXPR_BATCH_CHECK_ERR();
+            break;
+
+          case EXPR_OP_MIN:
+            sp -= (ip->arg - 1) * EXPR_BS;
+
+            for(arg = 1; arg < ip->arg; arg++)
+              exprKernelMin(sp, sp, sp + arg * EXPR_BS, rows);
+
+            break;
+
+          case EXPR_OP_MAX:
+            sp -= (ip->arg - 1) * EXPR_BS;
+
+            for(arg = 1; arg < ip->arg; arg++)
+              exprKernelMax(sp, sp, sp + arg * EXPR_BS, rows);
+
+            break;
+
+          case EXPR_OP_AVG:
+            sp -= (ip->arg - 1) * EXPR_BS;
+
+            /* The sum starts at 0 as in exprEval, so -0 becomes 0 */
+            for(pos = 0; pos < rows; pos++)
+              sp[pos] += 0.0;
+
+            for(arg = 1; arg < ip->arg; arg++)
+              {
+                col = sp + arg * EXPR_BS;
+
+                for(pos = 0; pos < rows; pos++)
+                  sp[pos] += col[pos];
+              }
+
+            d1 = (EXPRTYPE)(ip->arg);
+
+            for(pos = 0; pos < rows; pos++)
+              sp[pos] = sp[pos] / d1;
+
+            break;
+
+          EXPR_BATCH_KERNEL1(EXPR_OP_SQRT, exprKernelSqrt)
+          EXPR_BATCH_KERNEL1(EXPR_OP_SIN, exprKernelSin)
+          EXPR_BATCH_MATH1(EXPR_OP_SINH, sinh)
+          EXPR_BATCH_MATH1(EXPR_OP_ASIN, asin)
+          EXPR_BATCH_KERNEL1(EXPR_OP_COS, exprKernelCos)
+          EXPR_BATCH_MATH1(EXPR_OP_COSH, cosh)
+          EXPR_BATCH_MATH1(EXPR_OP_ACOS, acos)
+          EXPR_BATCH_MATH1(EXPR_OP_TAN, tan)
+          EXPR_BATCH_MATH1(EXPR_OP_TANH, tanh)
+          EXPR_BATCH_MATH1(EXPR_OP_ATAN, atan)
+          EXPR_BATCH_MATH2(EXPR_OP_ATAN2, atan2)
+          EXPR_BATCH_MATH1(EXPR_OP_LOG, log10)
+
+          case EXPR_OP_POW10:
+            EXPR_BATCH_RESET_ERR();
+            for(pos = 0; pos < rows; pos++)
+              sp[pos] = pow(10.0, sp[pos]);
+            EXPR_BATCH_CHECK_ERR();
+            break;
+
+          EXPR_BATCH_KERNEL1(EXPR_OP_LN, exprKernelLn)
+          EXPR_BATCH_KERNEL1(EXPR_OP_EXP, exprKernelExp)
+
+          case EXPR_OP_LOGN:
+            sp -= EXPR_BS;
+
+            EXPR_BATCH_RESET_ERR();
+            for(pos = 0; pos < rows; pos++)
+              {
+                d1 = log(sp[pos + EXPR_BS]);
+
+                if(d1 == 0.0)
+                  {
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+                    return EXPR_ERROR_OUTOFRANGE;
+#else
+                    sp[pos] = 0.0;
+                    continue;
+#endif
+                  }
+
+                sp[pos] = log(sp[pos]) / d1;
+              }
+            EXPR_BATCH_CHECK_ERR();
+            break;
+
+          EXPR_BATCH_EXACT1(EXPR_OP_CEIL, exprKernelCeil)
+          EXPR_BATCH_EXACT1(EXPR_OP_FLOOR, exprKernelFloor)
+          EXPR_BATCH_BINARYERR(EXPR_OP_RECTTOPOLR, sqrt((a * a) + (b * b)))
+          EXPR_BATCH_BINARYERR(EXPR_OP_POLTORECTX, a * cos(b))
+          EXPR_BATCH_BINARYERR(EXPR_OP_POLTORECTY, a * sin(b))
+
+          case EXPR_OP_DEG:
+            for(pos = 0; pos < rows; pos++)
+              sp[pos] = (180.0 * sp[pos]) / M_PI;
+
+            break;
+
+          case EXPR_OP_RAD:
+            for(pos = 0; pos < rows; pos++)
+              sp[pos] = (M_PI * sp[pos]) / 180.0;
+
+            break;
+
+          case EXPR_OP_RECTTOPOLA:
+            sp -= EXPR_BS;
+
+            EXPR_BATCH_RESET_ERR();
+            for(pos = 0; pos < rows; pos++)
+              {
+                d1 = atan2(sp[pos + EXPR_BS], sp[pos]);
+                sp[pos] = (d1 < 0.0) ? d1 + (2.0 * M_PI) : d1;
+              }
+            EXPR_BATCH_CHECK_ERR();
+            break;
+
+          EXPR_BATCH_BINARY(EXPR_OP_EQUAL, (a == b) ? 1.0 : 0.0)
+          EXPR_BATCH_BINARY(EXPR_OP_ABOVE, (a > b) ? 1.0 : 0.0)
+          EXPR_BATCH_BINARY(EXPR_OP_BELOW, (a < b) ? 1.0 : 0.0)
+          EXPR_BATCH_BINARY(EXPR_OP_AND, (a == 0.0 || b == 0.0) ? 0.0 : 1.0)
+          EXPR_BATCH_BINARY(EXPR_OP_OR, (a != 0.0 || b != 0.0) ? 1.0 : 0.0)
+
+          case EXPR_OP_NOT:
+            for(pos = 0; pos < rows; pos++)
+              sp[pos] = (sp[pos] != 0.0) ? 0.0 : 1.0;
+
+            break;
+
+          case EXPR_OP_CLIP:
+            sp -= 2 * EXPR_BS;
+            exprKernelClip(sp, sp, sp + EXPR_BS, sp + 2 * EXPR_BS, rows);
+            break;
+
+          case EXPR_OP_CLAMP:
+            sp -= 2 * EXPR_BS;
+            EXPR_BATCH_KERNEL(exprKernelClamp(sp, sp, sp + EXPR_BS, sp + 2 * EXPR_BS, rows, NULL));
+            break;
+
+          case EXPR_OP_PNTCHANGE:
+            sp -= 4 * EXPR_BS;
+
+            for(pos = 0; pos < rows; pos++)
+              {
+                d1 = sp[pos + EXPR_BS] - sp[pos];
+
+                if(d1 != 0.0)
+                  {
+                    sp[pos] = sp[pos + 2 * EXPR_BS] +
+                      (((sp[pos + 4 * EXPR_BS] - sp[pos]) / d1) *
+                       (sp[pos + 3 * EXPR_BS] - sp[pos + 2 * EXPR_BS]));
+                  }
+              }
+
+            break;
+
+          case EXPR_OP_POLY:
+            sp -= (ip->arg - 1) * EXPR_BS;
+            EXPR_BATCH_KERNEL(exprKernelPoly(sp, sp, sp + EXPR_BS, ip->arg - 1, EXPR_BS, rows, NULL));
+            break;
+
+          case EXPR_OP_CALLVAL:
+            {
+              const EXPRTYPE *args[EXPR_EAGER_ARGS];
+              exprEager *eager = ip->data.node->data.function.eager;
+              int err;
+
+              /* The result replaces the first argument's column */
+              sp -= (ip->arg - 1) * EXPR_BS;
+
+              for(arg = 0; arg < ip->arg; arg++)
+                args[arg] = sp + arg * EXPR_BS;
+
+              err = (*(eager->bptr))(batch->obj, args, ip->arg, rows, sp);
+              if(err != EXPR_ERROR_NOERROR)
+                return err;
+
+              break;
+            }
+
+          default:
+            return EXPR_ERROR_UNKNOWN;
+        }
+    }
+}
+
+/* Evaluate a block of rows one at a time */
+static int exprBatchScalar(exprBatch *batch, int row, int rows, EXPRTYPE *out)
+{
+  exprProgram *prog;
+  exprBinding *b;
+  int pos, end;
+  int err;
+
+  prog = batch->prog;
+
+  for(end = row + rows; row < end; row++, out++)
+    {
+      for(pos = 0; pos < batch->bindcount; pos++)
+        {
+          b = &(batch->bindings[pos]);
+          *(b->addr) = b->data[(size_t)row * b->stride];
+        }
+
+      err = exprRunProgram(batch->obj, prog, prog->vars, prog->stack, out);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+    }
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Leave variables as they would be after the last row of a block */
+static void exprBatchFinish(exprBatch *batch, int row, int rows)
+{
+  exprProgram *prog;
+  exprBinding *b;
+  int pos;
+
+  prog = batch->prog;
+
+  for(pos = 0; pos < batch->bindcount; pos++)
+    {
+      b = &(batch->bindings[pos]);
+      *(b->addr) = b->data[(size_t)(row + rows - 1) * b->stride];
+    }
+
+  for(pos = 0; pos < prog->varcount; pos++)
+    {
+      if(batch->stored[pos])
+        *(prog->vars[pos]) = batch->cols[pos * EXPR_BS + rows - 1];
+    }
+}
@@ -0,0 +1,536 @@
+/*
+  File: exprcache.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Cache of parsed expressions keyed by their text
+
+  This file is part of ExprEval.
+*/
+
+/* Threads are not part of strict C */
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+#if(EXPR_THREADS) && defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__))
+#define EXPR_CACHE_THREADS
+#include <pthread.h>
+#endif
+
+
+/* Cache of parsed expressions */
+struct _exprCache
+{
+  struct _exprCacheEntry **table; /* Chained hash table */
+  int tablesize; /* Size of the table, a power of 2 */
+  int count; /* Number of entries */
+  struct _exprCacheEntry *newest; /* Most recently used */
+  struct _exprCacheEntry *oldest; /* Least recently used */
+  size_t budget; /* Bytes to stay within */
+  size_t bytes; /* Bytes used */
+  unsigned long hits, misses, evictions; /* Counters */
+
+#ifdef EXPR_CACHE_THREADS
+  pthread_mutex_t lock; /* Guards the members above and the entries */
+#endif
+};
+
+/* Only one thread at a time works on a cache */
+#ifdef EXPR_CACHE_THREADS
+#define EXPR_CACHE_LOCK(cache) pthread_mutex_lock(&((cache)->lock))
+#define EXPR_CACHE_UNLOCK(cache) pthread_mutex_unlock(&((cache)->lock))
+#else
+#define EXPR_CACHE_LOCK(cache) ((void)0)
+#define EXPR_CACHE_UNLOCK(cache) ((void)0)
+#endif
+
+
+/* Internal functions */
+static size_t exprCacheNormalize(char *expr, char *key, size_t size);
+static int exprCacheWordChar(int c);
+static exprCacheEntry *exprCacheFind(exprCache *cache, char *key, size_t len, unsigned int hash,
+    exprFuncList *flist, exprValList *vlist, exprValList *clist);
+static int exprCacheInsert(exprCache *cache, exprCacheEntry *entry);
+static void exprCacheUnlink(exprCache *cache, exprCacheEntry *entry);
+static void exprCacheTrim(exprCache *cache);
+static size_t exprCacheObjSize(exprObj *obj);
+
+
+/* Create a cache keeping parsed expressions of up to budget bytes.
+   Expressions still in use are kept even when over the budget.
+   Threads may share a cache when the library is built with
+   EXPR_THREADS, otherwise one thread at a time may use it. */
+int exprCacheCreate(exprCache **cache, unsigned long budget)
+{
+  exprCache *tmp;
+
+  if(cache == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *cache = NULL;
+
+  tmp = exprAllocMem(sizeof(exprCache));
+  if(tmp == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  tmp->budget = (size_t)budget;
+
+#ifdef EXPR_CACHE_THREADS
+  pthread_mutex_init(&(tmp->lock), NULL);
+#endif
+
+  *cache = tmp;
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Free a cache and all its expressions.  Expressions from the cache
+   must not be used afterward, even if not released. */
+int exprCacheFree(exprCache *cache)
+{
+  exprCacheEntry *cur, *next;
+
+  if(cache == NULL)
+    return EXPR_ERROR_NOERROR;
+
+  for(cur = cache->newest; cur; cur = next)
+    {
+      next = cur->older;
+
+      exprFree(cur->obj);
+      exprFreeMem(cur);
+    }
+
+#ifdef EXPR_CACHE_THREADS
+  pthread_mutex_destroy(&(cache->lock));
+#endif
+
+  exprFreeMem(cache->table);
+  exprFreeMem(cache);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Free the expressions that are not in use */
+int exprCacheClear(exprCache *cache)
+{
+  exprCacheEntry *cur, *next;
+
+  if(cache == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  EXPR_CACHE_LOCK(cache);
+
+  for(cur = cache->newest; cur; cur = next)
+    {
+      next = cur->older;
+
+      if(cur->refs == 0)
+        {
+          exprCacheUnlink(cache, cur);
+          exprFree(cur->obj);
+          exprFreeMem(cur);
+        }
+    }
+
+  EXPR_CACHE_UNLOCK(cache);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Get a parsed and compiled expression for the text.  Texts that
+   only differ in spaces and comments, with the same lists, give the
+   same expression.  The expression is shared: evaluate it through
+   an evaluation context, and do not parse, clear, optimize or free
+   it.  Release it with exprCacheRelease when done.  Errors from
+   parsing are returned and nothing is cached for the text.  A text
+   not in the cache is parsed with the cache locked, so threads
+   sharing a cache may share its lists as well. */
+int exprCacheGet(exprCache *cache, exprObj **obj, exprFuncList *flist, exprValList *vlist,
+    exprValList *clist, char *expr)
+{
+  exprCacheEntry *entry;
+  exprObj *tmp;
+  char buf[EXPR_CACHE_KEYSIZE];
+  char *key;
+  unsigned int hash;
+  size_t len;
+  int err;
+
+  if(obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *obj = NULL;
+
+  if(cache == NULL || expr == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  /* Short texts are made normal without allocating */
+  key = buf;
+  len = exprCacheNormalize(expr, key, sizeof(buf));
+
+  if(len >= sizeof(buf))
+    {
+      key = exprAllocRawMem(len + 1);
+      if(key == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      exprCacheNormalize(expr, key, len + 1);
+    }
+
+  hash = exprHashName(key, (int)len);
+
+  EXPR_CACHE_LOCK(cache);
+
+  entry = exprCacheFind(cache, key, len, hash, flist, vlist, clist);
+  if(entry != NULL)
+    {
+      cache->hits++;
+
+      /* Move to the newest end */
+      if(entry != cache->newest)
+        {
+          entry->newer->older = entry->older;
+
+          if(entry->older)
+            entry->older->newer = entry->newer;
+          else
+            cache->oldest = entry->newer;
+
+          entry->newer = NULL;
+          entry->older = cache->newest;
+          cache->newest->newer = entry;
+          cache->newest = entry;
+        }
+
+      entry->refs++;
+      *obj = entry->obj;
+      err = EXPR_ERROR_NOERROR;
+      goto cleanup;
+    }
+
+  cache->misses++;
+
+  /* Parse and compile a new expression */
+  err = exprCreate(&tmp, flist, vlist, clist, NULL, NULL);
+  if(err != EXPR_ERROR_NOERROR)
+    goto cleanup;
+
+  err = exprParse(tmp, expr);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCompile(tmp);
+
+  if(err != EXPR_ERROR_NOERROR)
+    {
+      exprFree(tmp);
+      goto cleanup;
+    }
+
+  /* It is never parsed again */
+  exprFreeFrom(&(tmp->alloc), tmp->tokens);
+  tmp->tokens = NULL;
+  tmp->tokensize = 0;
+
+  /* The key follows the entry */
+  entry = exprAllocMem(sizeof(exprCacheEntry) + len + 1);
+  if(entry == NULL)
+    {
+      exprFree(tmp);
+      err = EXPR_ERROR_MEMORY;
+      goto cleanup;
+    }
+
+  entry->key = (char*)(entry + 1);
+  memcpy(entry->key, key, len + 1);
+  entry->len = len;
+  entry->hash = hash;
+  entry->flist = flist;
+  entry->vlist = vlist;
+  entry->clist = clist;
+  entry->obj = tmp;
+  entry->refs = 1;
+  entry->size = sizeof(exprCacheEntry) + len + 1 + exprCacheObjSize(tmp);
+
+  err = exprCacheInsert(cache, entry);
+  if(err != EXPR_ERROR_NOERROR)
+    {
+      exprFree(tmp);
+      exprFreeMem(entry);
+      goto cleanup;
+    }
+
+  tmp->cacheentry = entry;
+
+  exprCacheTrim(cache);
+
+  *obj = tmp;
+
+cleanup:
+  EXPR_CACHE_UNLOCK(cache);
+
+  if(key != buf)
+    exprFreeMem(key);
+
+  return err;
+}
+
+/* Release an expression from exprCacheGet.  It may be freed once
+   nothing uses it. */
+int exprCacheRelease(exprCache *cache, exprObj *obj)
+{
+  exprCacheEntry *entry;
+
+  if(cache == NULL || obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  EXPR_CACHE_LOCK(cache);
+
+  entry = obj->cacheentry;
+  if(entry == NULL || entry->obj != obj || entry->refs == 0)
+    {
+      EXPR_CACHE_UNLOCK(cache);
+      return EXPR_ERROR_NOTFOUND;
+    }
+
+  entry->refs--;
+
+  if(entry->refs == 0)
+    exprCacheTrim(cache);
+
+  EXPR_CACHE_UNLOCK(cache);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Get the counters of a cache */
+int exprCacheGetStats(exprCache *cache, exprCacheStats *stats)
+{
+  if(cache == NULL || stats == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  EXPR_CACHE_LOCK(cache);
+
+  stats->hits = cache->hits;
+  stats->misses = cache->misses;
+  stats->evictions = cache->evictions;
+  stats->entries = cache->count;
+  stats->bytes = (unsigned long)cache->bytes;
+  stats->budget = (unsigned long)cache->budget;
+
+  EXPR_CACHE_UNLOCK(cache);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+
+/* Write the normal form of the text to key, keeping at most size
+   bytes with the ending 0, and return its full length.  Spaces,
+   tabs, line ends and comments are dropped, except one space where
+   they separate two names or numbers.  Other characters are kept, so
+   text the parser would refuse never matches text it accepts. */
+static size_t exprCacheNormalize(char *expr, char *key, size_t size)
+{
+  size_t len = 0;
+  int last = 0;
+  int skipped = 0;
+
+  for(; *expr != '\0'; expr++)
+    {
+      if(*expr == '#')
+        {
+          while(expr[1] != '\0' && expr[1] != '\r' && expr[1] != '\n')
+            expr++;
+
+          skipped = 1;
+          continue;
+        }
+
+      if(*expr == ' ' || *expr == '\t' || *expr == '\r' || *expr == '\n')
+        {
+          skipped = 1;
+          continue;
+        }
+
+      if(skipped && exprCacheWordChar(last) && exprCacheWordChar((unsigned char)*expr))
+        {
+          if(len < size)
+            key[len] = ' ';
+
+          len++;
+        }
+
+      if(len < size)
+        key[len] = *expr;
+
+      len++;
+      last = (unsigned char)*expr;
+      skipped = 0;
+    }
+
+  if(len < size)
+    key[len] = '\0';
+
+  return len;
+}
+
+/* Is a character part of a name or number? */
+static int exprCacheWordChar(int c)
+{
+  return (c == '_' || c == '.' || isalnum(c));
+}
+
+/* Find an entry by the normal form of the text and the lists */
+static exprCacheEntry *exprCacheFind(exprCache *cache, char *key, size_t len, unsigned int hash,
+    exprFuncList *flist, exprValList *vlist, exprValList *clist)
+{
+  exprCacheEntry *cur;
+
+  if(cache->table == NULL)
+    return NULL;
+
+  for(cur = cache->table[hash & (cache->tablesize - 1)]; cur; cur = cur->next)
+    {
+      if(cur->hash == hash && cur->len == len && cur->flist == flist &&
+        cur->vlist == vlist && cur->clist == clist && memcmp(cur->key, key, len) == 0)
+        {
+          return cur;
+        }
+    }
+
+  return NULL;
+}
+
+/* Add an entry to the table and the newest end of the list.  Items
+   are removed from the table, so it uses chains rather than the
+   open addressing of the lists. */
+static int exprCacheInsert(exprCache *cache, exprCacheEntry *entry)
+{
+  exprCacheEntry **table;
+  exprCacheEntry *cur, *next;
+  int size, pos, mask;
+
+  /* Grow the table when three quarters full */
+  if((cache->count + 1) * 4 > cache->tablesize * 3)
+    {
+      size = cache->tablesize ? cache->tablesize * 2 : EXPR_HASH_INITSIZE;
+
+      table = exprAllocMem(size * sizeof(exprCacheEntry*));
+      if(table == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      mask = size - 1;
+
+      for(pos = 0; pos < cache->tablesize; pos++)
+        {
+          for(cur = cache->table[pos]; cur; cur = next)
+            {
+              next = cur->next;
+
+              cur->next = table[cur->hash & mask];
+              table[cur->hash & mask] = cur;
+            }
+        }
+
+      exprFreeMem(cache->table);
+      cache->table = table;
+      cache->tablesize = size;
+    }
+
+  pos = (int)(entry->hash & (cache->tablesize - 1));
+  entry->next = cache->table[pos];
+  cache->table[pos] = entry;
+  cache->count++;
+
+  entry->newer = NULL;
+  entry->older = cache->newest;
+
+  if(cache->newest)
+    cache->newest->newer = entry;
+  else
+    cache->oldest = entry;
+
+  cache->newest = entry;
+  cache->bytes += entry->size;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Remove an entry from the table and the list */
+static void exprCacheUnlink(exprCache *cache, exprCacheEntry *entry)
+{
+  exprCacheEntry **link;
+
+  link = &(cache->table[entry->hash & (cache->tablesize - 1)]);
+  while(*link != entry)
+    link = &((*link)->next);
+
+  *link = entry->next;
+  cache->count--;
+
+  if(entry->newer)
+    entry->newer->older = entry->older;
+  else
+    cache->newest = entry->older;
+
+  if(entry->older)
+    entry->older->newer = entry->newer;
+  else
+    cache->oldest = entry->newer;
+
+  cache->bytes -= entry->size;
+}
+
+/* Free the least recently used expressions not in use until the
+   cache fits in its budget */
+static void exprCacheTrim(exprCache *cache)
+{
+  exprCacheEntry *cur, *next;
+
+  for(cur = cache->oldest; cur && cache->bytes > cache->budget; cur = next)
+    {
+      next = cur->newer;
+
+      if(cur->refs == 0)
+        {
+          exprCacheUnlink(cache, cur);
+          exprFree(cur->obj);
+          exprFreeMem(cur);
+
+          cache->evictions++;
+        }
+    }
+}
+
+/* Bytes used by a parsed and compiled expression */
+static size_t exprCacheObjSize(exprObj *obj)
+{
+  exprChunk *chunk;
+  exprProgram *prog;
+  size_t size;
+
+  size = sizeof(exprObj);
+
+  if(obj->ownarena && obj->arena)
+    {
+      size += sizeof(exprArena);
+
+      for(chunk = obj->arena->chunks; chunk; chunk = chunk->next)
+        size += sizeof(exprChunk) + chunk->size;
+    }
+
+  prog = obj->program;
+  if(prog)
+    {
+      size += sizeof(exprProgram) +
+        prog->count * sizeof(exprInstr) +
+        prog->depth * sizeof(EXPRTYPE) +
+        prog->varcount * sizeof(EXPRTYPE*);
+    }
+
+  return size;
+}
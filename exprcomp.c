@@ -0,0 +1,600 @@
+/*
+  File: exprcomp.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Compile a parsed expression into a linear program
+
+  This file is part of ExprEval.
+*/
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+/* Compiler state.  The compiler runs twice over the tree.  The
+   first pass has code set to NULL and only counts instructions,
+   variable references and stack depth.  The second pass fills in
+   the program allocated from those counts. */
+typedef struct _exprCompiler
+{
+  exprInstr *code; /* Instructions, NULL while sizing */
+  int count; /* Current instruction count */
+  EXPRTYPE **vars; /* Variable slots */
+  int varcount; /* Number of variable slots used */
+  int *slotmap; /* Hash of variable addresses to slots, -1 if empty */
+  int slotmask; /* Size of slotmap minus one */
+  int depth; /* Current stack depth */
+  int maxdepth; /* Maximum stack depth */
+} exprCompiler;
+
+/* Internal functions */
+static int exprCompileNode(exprCompiler *comp, exprNode *node);
+static int exprCompileFunction(exprCompiler *comp, exprNode *node);
+static int exprCompileArgs(exprCompiler *comp, exprNode *nodes, int first, int last);
+static int exprCompileEmit(exprCompiler *comp, int op, int arg);
+static void exprCompilePatch(exprCompiler *comp, int pos, int target);
+static void exprCompileStack(exprCompiler *comp, int change);
+static int exprCompileSlot(exprCompiler *comp, EXPRTYPE *addr);
+static int exprCompileFuncOp(int type);
+
+
+/* Compile a parsed expression into its program */
+int exprCompile(exprObj *obj)
+{
+  exprProgram *prog;
+  int err;
+
+  if(obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  /* Must have parsed successfully */
+  if(obj->parsedbad || !obj->parsedgood || obj->headnode == NULL)
+    return EXPR_ERROR_BADEXPR;
+
+  err = exprCompileProgram(&(obj->alloc), obj->headnode, &prog);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  /* Replace any older program and its machine code */
+  exprFreeJit(&(obj->alloc), obj->jit);
+  obj->jit = NULL;
+
+  exprFreeProgram(&(obj->alloc), obj->program);
+  obj->program = prog;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Compile a node tree into a newly allocated program */
+int exprCompileProgram(exprAllocator *alloc, exprNode *node, exprProgram **prog)
+{
+  exprCompiler comp;
+  exprProgram *tmp;
+  size_t size;
+  int refs, pos;
+  int err;
+  char *mem;
+
+  *prog = NULL;
+
+  /* Sizing pass */
+  memset(&comp, 0, sizeof(exprCompiler));
+
+  err = exprCompileNode(&comp, node);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  exprCompileEmit(&comp, EXPR_OP_END, 0);
+
+  /* In the sizing pass varcount counts every reference, which
+     is an upper bound for the number of slots */
+  refs = comp.varcount;
+  if(comp.maxdepth < 1)
+    comp.maxdepth = 1;
+
+  /* Code, stack and variable table follow the header */
+  size = sizeof(exprProgram) +
+    comp.count * sizeof(exprInstr) +
+    comp.maxdepth * sizeof(EXPRTYPE) +
+    refs * sizeof(EXPRTYPE*);
+
+  /* Every part of it is set below */
+  mem = exprAllocRawFrom(alloc, size);
+  if(mem == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  tmp = (exprProgram*)mem;
+  mem += sizeof(exprProgram);
+  tmp->code = (exprInstr*)mem;
+  mem += comp.count * sizeof(exprInstr);
+  tmp->stack = (EXPRTYPE*)mem;
+  mem += comp.maxdepth * sizeof(EXPRTYPE);
+  tmp->vars = (EXPRTYPE**)mem;
+  tmp->depth = comp.maxdepth;
+
+  /* Hash used to give each variable address a single slot */
+  comp.slotmask = 15;
+  while(comp.slotmask < refs * 2)
+    comp.slotmask = (comp.slotmask << 1) | 1;
+
+  comp.slotmap = exprAllocRawMem((comp.slotmask + 1) * sizeof(int));
+  if(comp.slotmap == NULL)
+    {
+      exprFreeFrom(alloc, tmp);
+      return EXPR_ERROR_MEMORY;
+    }
+
+  for(pos = 0; pos <= comp.slotmask; pos++)
+    comp.slotmap[pos] = -1;
+
+  /* Emit pass */
+  comp.code = tmp->code;
+  comp.vars = tmp->vars;
+  comp.count = 0;
+  comp.varcount = 0;
+  comp.depth = 0;
+  comp.maxdepth = 0;
+
+  err = exprCompileNode(&comp, node);
+  exprCompileEmit(&comp, EXPR_OP_END, 0);
+
+  exprFreeMem(comp.slotmap);
+
+  if(err != EXPR_ERROR_NOERROR)
+    {
+      exprFreeFrom(alloc, tmp);
+      return err;
+    }
+
+  tmp->count = comp.count;
+  tmp->varcount = comp.varcount;
+
+  *prog = tmp;
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Free a compiled program */
+void exprFreeProgram(exprAllocator *alloc, exprProgram *prog)
+{
+  /* Everything is in one allocation */
+  exprFreeFrom(alloc, prog);
+}
+
+/* Compile a node, leaving its value on the stack */
+static int exprCompileNode(exprCompiler *comp, exprNode *node)
+{
+  int err;
+  int pos;
+  int op;
+
+  switch(node->type)
+    {
+      case EXPR_NODETYPE_MULTI:
+        {
+          /* Each subexpression but the last is discarded */
+          if(node->data.oper.nodecount == 0)
+            {
+              pos = exprCompileEmit(comp, EXPR_OP_VALUE, 0);
+              if(comp->code)
+                comp->code[pos].data.value = 0.0;
+
+              exprCompileStack(comp, 1);
+              break;
+            }
+
+          return exprCompileArgs(comp, node->data.oper.nodes, 0, node->data.oper.nodecount - 1);
+        }
+
+      case EXPR_NODETYPE_ADD:
+      case EXPR_NODETYPE_SUBTRACT:
+      case EXPR_NODETYPE_MULTIPLY:
+      case EXPR_NODETYPE_DIVIDE:
+      case EXPR_NODETYPE_EXPONENT:
+        {
+          err = exprCompileNode(comp, &(node->data.oper.nodes[0]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          err = exprCompileNode(comp, &(node->data.oper.nodes[1]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          switch(node->type)
+            {
+              case EXPR_NODETYPE_ADD: op = EXPR_OP_ADD; break;
+              case EXPR_NODETYPE_SUBTRACT: op = EXPR_OP_SUBTRACT; break;
+              case EXPR_NODETYPE_MULTIPLY: op = EXPR_OP_MULTIPLY; break;
+              case EXPR_NODETYPE_DIVIDE: op = EXPR_OP_DIVIDE; break;
+              default: op = EXPR_OP_EXPONENT; break;
+            }
+
+          exprCompileEmit(comp, op, 0);
+          exprCompileStack(comp, -1);
+          break;
+        }
+
+      case EXPR_NODETYPE_NEGATE:
+        {
+          err = exprCompileNode(comp, node->data.oper.nodes);
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          exprCompileEmit(comp, EXPR_OP_NEGATE, 0);
+          break;
+        }
+
+      case EXPR_NODETYPE_VALUE:
+        {
+          pos = exprCompileEmit(comp, EXPR_OP_VALUE, 0);
+          if(comp->code)
+            comp->code[pos].data.value = node->data.value.value;
+
+          exprCompileStack(comp, 1);
+          break;
+        }
+
+      case EXPR_NODETYPE_VARIABLE:
+        {
+          exprCompileEmit(comp, EXPR_OP_LOAD, exprCompileSlot(comp, node->data.variable.vaddr));
+          exprCompileStack(comp, 1);
+          break;
+        }
+
+      case EXPR_NODETYPE_ASSIGN:
+        {
+          err = exprCompileNode(comp, node->data.assign.node);
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          exprCompileEmit(comp, EXPR_OP_STORE, exprCompileSlot(comp, node->data.assign.vaddr));
+          break;
+        }
+
+      case EXPR_NODETYPE_FUNCTION:
+        return exprCompileFunction(comp, node);
+
+      default:
+        return EXPR_ERROR_UNKNOWN;
+    }
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Compile a function node */
+static int exprCompileFunction(exprCompiler *comp, exprNode *node)
+{
+  exprNode *nodes;
+  int count;
+  int err;
+  int op;
+  int pos, jump, end;
+  int depth;
+
+  nodes = node->data.function.nodes;
+  count = node->data.function.nodecount;
+
+  /* Function solvers are called with the node tree */
+  if(node->data.function.fptr != NULL)
+    {
+      pos = exprCompileEmit(comp, EXPR_OP_CALL, 0);
+      if(comp->code)
+        comp->code[pos].data.node = node;
+
+      exprCompileStack(comp, 1);
+      return EXPR_ERROR_NOERROR;
+    }
+
+  switch(node->data.function.type)
+    {
+      case EXPR_NODEFUNC_IF:
+        {
+          err = exprCompileNode(comp, &(nodes[0]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          jump = exprCompileEmit(comp, EXPR_OP_JUMPZ, 0);
+          exprCompileStack(comp, -1);
+          depth = comp->depth;
+
+          err = exprCompileNode(comp, &(nodes[1]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          end = exprCompileEmit(comp, EXPR_OP_JUMP, 0);
+          exprCompilePatch(comp, jump, comp->count);
+
+          /* Only one of the branches leaves a value */
+          comp->depth = depth;
+
+          err = exprCompileNode(comp, &(nodes[2]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          exprCompilePatch(comp, end, comp->count);
+          return EXPR_ERROR_NOERROR;
+        }
+
+      case EXPR_NODEFUNC_SELECT:
+        {
+          err = exprCompileNode(comp, &(nodes[0]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          jump = exprCompileEmit(comp, EXPR_OP_SELECT, 0);
+          exprCompileStack(comp, -1);
+          depth = comp->depth;
+
+          /* Negative */
+          err = exprCompileNode(comp, &(nodes[1]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          end = exprCompileEmit(comp, EXPR_OP_JUMP, 0);
+
+          /* Zero, and positive if there is no fourth argument */
+          if(comp->code)
+            {
+              comp->code[jump].data.jump[0] = comp->count;
+              comp->code[jump].data.jump[1] = comp->count;
+            }
+
+          comp->depth = depth;
+          err = exprCompileNode(comp, &(nodes[2]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          if(count == 4)
+            {
+              pos = exprCompileEmit(comp, EXPR_OP_JUMP, 0);
+              if(comp->code)
+                comp->code[jump].data.jump[1] = comp->count;
+
+              comp->depth = depth;
+              err = exprCompileNode(comp, &(nodes[3]));
+              if(err != EXPR_ERROR_NOERROR)
+                return err;
+
+              exprCompilePatch(comp, pos, comp->count);
+            }
+
+          exprCompilePatch(comp, end, comp->count);
+          return EXPR_ERROR_NOERROR;
+        }
+
+      case EXPR_NODEFUNC_FOR:
+        {
+          /* Initializer */
+          err = exprCompileNode(comp, &(nodes[0]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          exprCompileEmit(comp, EXPR_OP_POP, 0);
+          exprCompileStack(comp, -1);
+
+          /* Result if the loop body never runs */
+          pos = exprCompileEmit(comp, EXPR_OP_VALUE, 0);
+          if(comp->code)
+            comp->code[pos].data.value = 0.0;
+
+          exprCompileStack(comp, 1);
+
+          /* Test */
+          pos = comp->count;
+          err = exprCompileNode(comp, &(nodes[1]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          end = exprCompileEmit(comp, EXPR_OP_JUMPZ, 0);
+          exprCompileStack(comp, -1);
+
+          /* Body replaces the previous result */
+          exprCompileEmit(comp, EXPR_OP_POP, 0);
+          exprCompileStack(comp, -1);
+
+          err = exprCompileArgs(comp, nodes, 3, count - 1);
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          /* Increment */
+          err = exprCompileNode(comp, &(nodes[2]));
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          exprCompileEmit(comp, EXPR_OP_POP, 0);
+          exprCompileStack(comp, -1);
+
+          exprCompileEmit(comp, EXPR_OP_JUMP, pos);
+          exprCompilePatch(comp, end, comp->count);
+          return EXPR_ERROR_NOERROR;
+        }
+
+      case EXPR_NODEFUNC_MANY:
+        return exprCompileArgs(comp, nodes, 0, count - 1);
+
+      case EXPR_NODEFUNC_EAGER:
+        {
+          /* The values are passed from the stack */
+          for(pos = 0; pos < count; pos++)
+            {
+              err = exprCompileNode(comp, &(nodes[pos]));
+              if(err != EXPR_ERROR_NOERROR)
+                return err;
+            }
+
+          pos = exprCompileEmit(comp, EXPR_OP_CALLVAL, count);
+          if(comp->code)
+            comp->code[pos].data.node = node;
+
+          exprCompileStack(comp, 1 - count);
+          return EXPR_ERROR_NOERROR;
+        }
+
+      case EXPR_NODEFUNC_RAND:
+      case EXPR_NODEFUNC_RANDOM:
+      case EXPR_NODEFUNC_RANDOMIZE:
+        {
+          /* The seed is passed by reference */
+          for(pos = 0; pos < count; pos++)
+            {
+              err = exprCompileNode(comp, &(nodes[pos]));
+              if(err != EXPR_ERROR_NOERROR)
+                return err;
+            }
+
+          op = exprCompileFuncOp(node->data.function.type);
+          exprCompileEmit(comp, op, exprCompileSlot(comp, node->data.function.refs[0]));
+          exprCompileStack(comp, 1 - count);
+          return EXPR_ERROR_NOERROR;
+        }
+
+      default:
+        {
+          op = exprCompileFuncOp(node->data.function.type);
+          if(op == EXPR_OP_END)
+            return EXPR_ERROR_UNKNOWN;
+
+          /* All arguments are evaluated in order before the call */
+          for(pos = 0; pos < count; pos++)
+            {
+              err = exprCompileNode(comp, &(nodes[pos]));
+              if(err != EXPR_ERROR_NOERROR)
+                return err;
+            }
+
+          exprCompileEmit(comp, op, count);
+          exprCompileStack(comp, 1 - count);
+          return EXPR_ERROR_NOERROR;
+        }
+    }
+}
+
+/* Compile a sequence of nodes, keeping only the last value */
+static int exprCompileArgs(exprCompiler *comp, exprNode *nodes, int first, int last)
+{
+  int pos;
+  int err;
+
+  for(pos = first; pos <= last; pos++)
+    {
+      err = exprCompileNode(comp, &(nodes[pos]));
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+
+      if(pos != last)
+        {
+          exprCompileEmit(comp, EXPR_OP_POP, 0);
+          exprCompileStack(comp, -1);
+        }
+    }
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Emit an instruction, returns its position */
+static int exprCompileEmit(exprCompiler *comp, int op, int arg)
+{
+  if(comp->code)
+    {
+      comp->code[comp->count].op = op;
+      comp->code[comp->count].arg = arg;
+    }
+
+  return comp->count++;
+}
+
+/* Set the target of a jump */
+static void exprCompilePatch(exprCompiler *comp, int pos, int target)
+{
+  if(comp->code)
+    comp->code[pos].arg = target;
+}
+
+/* Track the stack depth */
+static void exprCompileStack(exprCompiler *comp, int change)
+{
+  comp->depth += change;
+
+  if(comp->depth > comp->maxdepth)
+    comp->maxdepth = comp->depth;
+}
+
+/* Get the slot of a variable address */
+static int exprCompileSlot(exprCompiler *comp, EXPRTYPE *addr)
+{
+  size_t hash;
+
+  /* Sizing pass only counts references */
+  if(comp->code == NULL)
+    return comp->varcount++;
+
+  hash = ((size_t)addr / sizeof(EXPRTYPE)) & comp->slotmask;
+
+  while(comp->slotmap[hash] != -1)
+    {
+      if(comp->vars[comp->slotmap[hash]] == addr)
+        return comp->slotmap[hash];
+
+      hash = (hash + 1) & comp->slotmask;
+    }
+
+  comp->vars[comp->varcount] = addr;
+  comp->slotmap[hash] = comp->varcount;
+
+  return comp->varcount++;
+}
+
+/* Get the opcode for an internal function, EXPR_OP_END if none */
+static int exprCompileFuncOp(int type)
+{
+  switch(type)
+    {
+      case EXPR_NODEFUNC_ABS: return EXPR_OP_ABS;
+      case EXPR_NODEFUNC_MOD: return EXPR_OP_MOD;
+      case EXPR_NODEFUNC_IPART: return EXPR_OP_IPART;
+      case EXPR_NODEFUNC_FPART: return EXPR_OP_FPART;
+      case EXPR_NODEFUNC_MIN: return EXPR_OP_MIN;
+      case EXPR_NODEFUNC_MAX: return EXPR_OP_MAX;
+      case EXPR_NODEFUNC_POW: return EXPR_OP_POW;
+      case EXPR_NODEFUNC_SQRT: return EXPR_OP_SQRT;
+      case EXPR_NODEFUNC_SIN: return EXPR_OP_SIN;
+      case EXPR_NODEFUNC_SINH: return EXPR_OP_SINH;
+      case EXPR_NODEFUNC_ASIN: return EXPR_OP_ASIN;
+      case EXPR_NODEFUNC_COS: return EXPR_OP_COS;
+      case EXPR_NODEFUNC_COSH: return EXPR_OP_COSH;
+      case EXPR_NODEFUNC_ACOS: return EXPR_OP_ACOS;
+      case EXPR_NODEFUNC_TAN: return EXPR_OP_TAN;
+      case EXPR_NODEFUNC_TANH: return EXPR_OP_TANH;
+      case EXPR_NODEFUNC_ATAN: return EXPR_OP_ATAN;
+      case EXPR_NODEFUNC_ATAN2: return EXPR_OP_ATAN2;
+      case EXPR_NODEFUNC_LOG: return EXPR_OP_LOG;
+      case EXPR_NODEFUNC_POW10: return EXPR_OP_POW10;
+      case EXPR_NODEFUNC_LN: return EXPR_OP_LN;
+      case EXPR_NODEFUNC_EXP: return EXPR_OP_EXP;
+      case EXPR_NODEFUNC_LOGN: return EXPR_OP_LOGN;
+      case EXPR_NODEFUNC_CEIL: return EXPR_OP_CEIL;
+      case EXPR_NODEFUNC_FLOOR: return EXPR_OP_FLOOR;
+      case EXPR_NODEFUNC_RAND: return EXPR_OP_RAND;
+      case EXPR_NODEFUNC_RANDOM: return EXPR_OP_RANDOM;
+      case EXPR_NODEFUNC_RANDOMIZE: return EXPR_OP_RANDOMIZE;
+      case EXPR_NODEFUNC_DEG: return EXPR_OP_DEG;
+      case EXPR_NODEFUNC_RAD: return EXPR_OP_RAD;
+      case EXPR_NODEFUNC_RECTTOPOLR: return EXPR_OP_RECTTOPOLR;
+      case EXPR_NODEFUNC_RECTTOPOLA: return EXPR_OP_RECTTOPOLA;
+      case EXPR_NODEFUNC_POLTORECTX: return EXPR_OP_POLTORECTX;
+      case EXPR_NODEFUNC_POLTORECTY: return EXPR_OP_POLTORECTY;
+      case EXPR_NODEFUNC_EQUAL: return EXPR_OP_EQUAL;
+      case EXPR_NODEFUNC_ABOVE: return EXPR_OP_ABOVE;
+      case EXPR_NODEFUNC_BELOW: return EXPR_OP_BELOW;
+      case EXPR_NODEFUNC_AVG: return EXPR_OP_AVG;
+      case EXPR_NODEFUNC_CLIP: return EXPR_OP_CLIP;
+      case EXPR_NODEFUNC_CLAMP: return EXPR_OP_CLAMP;
+      case EXPR_NODEFUNC_PNTCHANGE: return EXPR_OP_PNTCHANGE;
+      case EXPR_NODEFUNC_POLY: return EXPR_OP_POLY;
+      case EXPR_NODEFUNC_AND: return EXPR_OP_AND;
+      case EXPR_NODEFUNC_OR: return EXPR_OP_OR;
+      case EXPR_NODEFUNC_NOT: return EXPR_OP_NOT;
+      default: return EXPR_OP_END;
+    }
+}
@@ -26,4 +26,94 @@
 #define EXPR_ERROR_LEVEL EXPR_ERROR_LEVEL_CHECK
 #endif
 
+/*
+  Dispatch method for compiled programs
+
+  0: Use a switch statement.
+
+  1: Use computed goto (threaded dispatch).  Only available
+  with GCC compatible compilers, others always use the switch.
+*/
+#ifndef EXPR_THREADED_DISPATCH
+#define EXPR_THREADED_DISPATCH 1
+#endif
+
+/*
+  Number of rows exprEvalBatch evaluates at a time.  Each
+  instruction is dispatched once per block of this many rows.
+*/
+#ifndef EXPR_BATCHSIZE
+#define EXPR_BATCHSIZE 128
+#endif
+
+/*
+  Vector kernels
+
+  0: Use the portable kernels only.
+
+  1: Also build SSE2, AVX and AVX-512 kernels and pick one when
+  first used based on the processor.  Only available with GCC
+  compatible compilers on x86 and x86-64.
+*/
+#ifndef EXPR_KERNEL_SIMD
+#define EXPR_KERNEL_SIMD 1
+#endif
+
+/*
+  Native code
+
+  0: Compiled programs only run in the virtual machine.
+
+  1: exprJitCompile translates compiled programs to machine code.
+  Only available on x86-64 Linux, elsewhere it returns
+  EXPR_ERROR_NONATIVE.
+*/
+#ifndef EXPR_JIT
+#define EXPR_JIT 1
+#endif
+
+/*
+  Compiled C source
+
+  0: exprNativeCreate always returns EXPR_ERROR_NONATIVE.
+
+  1: exprNativeCreate compiles generated source with the command
+  in EXPR_NATIVE_CC and loads it with dlopen.  Only available on
+  Unix like systems.  The command gets the library and source
+  paths for its two %s.
+*/
+#ifndef EXPR_NATIVE
+#define EXPR_NATIVE 1
+#endif
+
+#ifndef EXPR_NATIVE_CC
+#define EXPR_NATIVE_CC "cc -O2 -fno-builtin -fPIC -shared -o '%s' '%s' -lm"
+#endif
+
+/*
+  Threads of pools
+
+  0: Pools run everything on the calling thread.
+
+  1: Pools run tasks on their own threads with pthreads.  Only
+  available with GCC compatible compilers on Unix like systems,
+  elsewhere pools act as with 0.
+*/
+#ifndef EXPR_THREADS
+#define EXPR_THREADS 1
+#endif
+
+/*
+  Profiling
+
+  0: exprSetProfile returns EXPR_ERROR_NOPROFILE.
+
+  1: exprSetProfile makes exprEval count and time each node.  Each
+  node evaluated tests whether its expression is being profiled, so
+  this slows evaluation down a little even when nothing is.
+*/
+#ifndef EXPR_PROFILE
+#define EXPR_PROFILE 0
+#endif
+
 #endif /* __BAVII_EXPRCONF_H */
@@ -0,0 +1,409 @@
+/*
+  File: exprctx.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Evaluation contexts sharing a compiled expression
+
+  This file is part of ExprEval.
+*/
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+#include <limits.h>
+
+/* Indexes each task of exprEvalRange evaluates */
+#define EXPR_RANGE_CHUNK 4096
+
+/* Range evaluation state */
+typedef struct _exprRange
+{
+  exprContext **ctxs; /* Context of each thread */
+  EXPRTYPE *initial; /* Values of the slots when called */
+  int *slots; /* Slots the program assigns */
+  int slotcount; /* Number of them */
+  int indexslot; /* Slot of the index variable, -1 if not used */
+  long begin, end; /* Indexes to evaluate */
+  long chunk; /* Indexes of each task */
+  EXPRTYPE *out; /* Result of each index */
+  int *errs; /* First error of each task */
+} exprRange;
+
+
+/* Internal functions */
+static int exprContextFindSlot(exprContext *ctx, char *name);
+static int exprContextRangeTask(void *data, int task, int worker);
+
+
+/* Create a context to evaluate the compiled program of an
+   expression with its own variables.  The expression is compiled
+   first if needed.  The values of the variables and constants are
+   copied when the context is created.  Contexts do not change the
+   expression or its program, so each thread can evaluate its own
+   context at the same time.  The expression must not be cleared,
+   parsed, optimized, compiled or freed while it has contexts. */
+int exprContextCreate(exprContext **ctx, exprObj *obj)
+{
+  exprContext *tmp;
+  exprProgram *prog;
+  size_t size;
+  int pos, err;
+  char *mem;
+
+  if(ctx == NULL || obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *ctx = NULL;
+
+  /* Must have parsed successfully */
+  if(obj->parsedbad || !obj->parsedgood || obj->headnode == NULL)
+    return EXPR_ERROR_BADEXPR;
+
+  if(obj->program == NULL)
+    {
+      err = exprCompile(obj);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+    }
+
+  prog = obj->program;
+
+  /* Custom functions evaluate the nodes, which use the
+     expression's own variables, and so do the references of
+     eager ones */
+  for(pos = 0; pos < prog->count; pos++)
+    {
+      if(prog->code[pos].op == EXPR_OP_CALL)
+        return EXPR_ERROR_NOTSHAREABLE;
+
+      if(prog->code[pos].op == EXPR_OP_CALLVAL && prog->code[pos].data.node->data.function.refcount != 0)
+        return EXPR_ERROR_NOTSHAREABLE;
+    }
+
+  /* Variable table, values and stack follow the header */
+  size = sizeof(exprContext) +
+    prog->varcount * sizeof(EXPRTYPE) +
+    prog->depth * sizeof(EXPRTYPE) +
+    prog->varcount * sizeof(EXPRTYPE*);
+
+  /* From the expression's allocator, every part is set below */
+  mem = exprAllocRawFrom(&(obj->alloc), size);
+  if(mem == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  tmp = (exprContext*)mem;
+  mem += sizeof(exprContext);
+  tmp->values = (EXPRTYPE*)mem;
+  mem += prog->varcount * sizeof(EXPRTYPE);
+  tmp->stack = (EXPRTYPE*)mem;
+  mem += prog->depth * sizeof(EXPRTYPE);
+  tmp->vars = (EXPRTYPE**)mem;
+  tmp->prog = prog;
+
+  /* The copy of the expression is only used for the breaker */
+  tmp->obj = *obj;
+  tmp->obj.arena = NULL;
+  tmp->obj.ownarena = 0;
+  tmp->obj.tokens = NULL;
+  tmp->obj.tokensize = 0;
+  tmp->obj.breakcur = obj->breakcount;
+  tmp->obj.loopnodes = 0;
+  tmp->obj.profile = NULL;
+
+  for(pos = 0; pos < prog->varcount; pos++)
+    {
+      tmp->values[pos] = *(prog->vars[pos]);
+      tmp->vars[pos] = &(tmp->values[pos]);
+    }
+
+  *ctx = tmp;
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Free a context */
+int exprContextFree(exprContext *ctx)
+{
+  exprAllocator alloc;
+
+  if(ctx == NULL)
+    return EXPR_ERROR_NOERROR;
+
+  /* Everything is in one allocation */
+  alloc = ctx->obj.alloc;
+  exprFreeFrom(&alloc, ctx);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Evaluate the program with the context's variables */
+int exprContextEval(exprContext *ctx, EXPRTYPE *val)
+{
+  EXPRTYPE dummy;
+  int err;
+
+  if(ctx == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(val == NULL)
+    val = &dummy;
+
+  err = exprRunProgram(&(ctx->obj), ctx->prog, ctx->vars, ctx->stack, val);
+
+  EXPR_STAT_EVAL(1, ctx->prog->count + ctx->obj.loopnodes, err);
+  ctx->obj.loopnodes = 0;
+
+  return err;
+}
+
+/* Get the address of a variable or constant in the context.  Names
+   the expression does not use are not found. */
+int exprContextGetAddress(exprContext *ctx, char *name, EXPRTYPE **addr)
+{
+  int slot;
+
+  if(ctx == NULL || addr == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  slot = exprContextFindSlot(ctx, name);
+
+  *addr = (slot >= 0) ? ctx->vars[slot] : NULL;
+
+  return (slot >= 0) ? EXPR_ERROR_NOERROR : EXPR_ERROR_NOTFOUND;
+}
+
+/* Use memory of the caller for a variable of the context.  The
+   memory must stay valid as long as the context is used. */
+int exprContextSetAddress(exprContext *ctx, char *name, EXPRTYPE *addr)
+{
+  int slot;
+
+  if(ctx == NULL || addr == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  slot = exprContextFindSlot(ctx, name);
+  if(slot < 0)
+    return EXPR_ERROR_NOTFOUND;
+
+  ctx->vars[slot] = addr;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Evaluate an expression once for each index from begin up to, but
+   not including, end, with the variable at var set to the index.
+   The result for each index is stored in out[index - begin].  Each
+   index is evaluated from the values the variables had when called,
+   whatever the expression assigns for the other indexes, so the
+   results do not depend on the threads.  The indexes are split
+   among the threads of pool, each with a context of its own, or
+   evaluated on the calling thread if pool is NULL.  The variables
+   of the expression are not changed.  The error of the lowest
+   failing index is returned. */
+int exprEvalRange(exprObj *obj, EXPRTYPE *var, long begin, long end, EXPRTYPE *out, exprPool *pool)
+{
+  exprRange range;
+  exprProgram *prog;
+  char *assigned;
+  long chunks;
+  int threads, pos, slot;
+  int err;
+
+  if(obj == NULL || var == NULL || out == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(end <= begin)
+    return EXPR_ERROR_NOERROR;
+
+  threads = 1;
+  if(pool)
+    exprPoolGetThreads(pool, &threads);
+
+  memset(&range, 0, sizeof(exprRange));
+
+  range.ctxs = exprAllocMem(threads * sizeof(exprContext*));
+  if(range.ctxs == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  /* Creating the first context compiles the expression */
+  for(pos = 0; pos < threads; pos++)
+    {
+      err = exprContextCreate(&(range.ctxs[pos]), obj);
+      if(err != EXPR_ERROR_NOERROR)
+        goto cleanup;
+    }
+
+  prog = obj->program;
+
+  /* Tasks are counted in an int */
+  range.chunk = EXPR_RANGE_CHUNK;
+  while((end - begin) / range.chunk >= INT_MAX)
+    range.chunk *= 2;
+
+  chunks = (end - begin + range.chunk - 1) / range.chunk;
+
+  range.initial = exprAllocRawMem(prog->varcount * sizeof(EXPRTYPE) + 1);
+  range.slots = exprAllocRawMem(prog->varcount * sizeof(int) + 1);
+  range.errs = exprAllocMem(chunks * sizeof(int));
+  assigned = exprAllocMem(prog->varcount + 1);
+
+  if(range.initial == NULL || range.slots == NULL || range.errs == NULL || assigned == NULL)
+    {
+      exprFreeMem(assigned);
+      err = EXPR_ERROR_MEMORY;
+      goto cleanup;
+    }
+
+  for(slot = 0; slot < prog->varcount; slot++)
+    range.initial[slot] = range.ctxs[0]->values[slot];
+
+  /* Slots put back before each index */
+  for(pos = 0; pos < prog->count; pos++)
+    {
+      switch(prog->code[pos].op)
+        {
+          case EXPR_OP_STORE:
+          case EXPR_OP_RAND:
+          case EXPR_OP_RANDOM:
+          case EXPR_OP_RANDOMIZE:
+            if(!assigned[prog->code[pos].arg])
+              {
+                assigned[prog->code[pos].arg] = 1;
+                range.slots[range.slotcount++] = prog->code[pos].arg;
+              }
+
+            break;
+
+          default:
+            break;
+        }
+    }
+
+  exprFreeMem(assigned);
+
+  range.indexslot = -1;
+
+  for(slot = 0; slot < prog->varcount; slot++)
+    {
+      if(prog->vars[slot] == var)
+        range.indexslot = slot;
+    }
+
+  range.begin = begin;
+  range.end = end;
+  range.out = out;
+
+  if(pool)
+    {
+      err = exprPoolRun(pool, (int)chunks, NULL, NULL, NULL, exprContextRangeTask, &range);
+      if(err != EXPR_ERROR_NOERROR)
+        goto cleanup;
+    }
+  else
+    {
+      for(pos = 0; pos < (int)chunks; pos++)
+        exprContextRangeTask(&range, pos, 0);
+    }
+
+  /* The lowest index failing */
+  err = EXPR_ERROR_NOERROR;
+
+  for(pos = 0; pos < (int)chunks && err == EXPR_ERROR_NOERROR; pos++)
+    err = range.errs[pos];
+
+cleanup:
+  for(pos = 0; pos < threads; pos++)
+    exprContextFree(range.ctxs[pos]);
+
+  exprFreeMem(range.ctxs);
+  exprFreeMem(range.initial);
+  exprFreeMem(range.slots);
+  exprFreeMem(range.errs);
+
+  return err;
+}
+
+/* Find the program slot of a variable or constant, -1 if not used */
+static int exprContextFindSlot(exprContext *ctx, char *name)
+{
+  EXPRTYPE *addr;
+  int pos;
+
+  if(name == NULL || name[0] == '\0')
+    return -1;
+
+  /* Slots are known by the address in the expression's lists,
+     constants first like the parser */
+  addr = NULL;
+
+  if(ctx->obj.clist)
+    exprValListGetAddress(ctx->obj.clist, name, &addr);
+
+  if(addr == NULL && ctx->obj.vlist)
+    exprValListGetAddress(ctx->obj.vlist, name, &addr);
+
+  if(addr == NULL)
+    return -1;
+
+  for(pos = 0; pos < ctx->prog->varcount; pos++)
+    {
+      if(ctx->prog->vars[pos] == addr)
+        return pos;
+    }
+
+  return -1;
+}
+
+/* Pool task evaluating a chunk of the indexes of exprEvalRange */
+static int exprContextRangeTask(void *data, int task, int worker)
+{
+  exprRange *range;
+  exprContext *ctx;
+  exprStatBlock *stat;
+  long index, last;
+  int pos, err;
+
+  range = (exprRange*)data;
+  ctx = range->ctxs[worker];
+
+  index = range->begin + task * range->chunk;
+  last = (range->end - index > range->chunk) ? index + range->chunk : range->end;
+
+  /* Counted on the thread running the chunk */
+  stat = EXPR_STAT_BLOCK();
+  EXPR_STAT_ADD(stat, evals, last - index);
+
+  /* Check for a break once per chunk */
+  if(exprCheckBreak(&(ctx->obj), (int)(last - index) * ctx->prog->count) != EXPR_ERROR_NOERROR)
+    {
+      range->errs[task] = EXPR_ERROR_BREAK;
+      return EXPR_ERROR_NOERROR;
+    }
+
+  for(; index < last; index++)
+    {
+      for(pos = 0; pos < range->slotcount; pos++)
+        ctx->values[range->slots[pos]] = range->initial[range->slots[pos]];
+
+      if(range->indexslot >= 0)
+        ctx->values[range->indexslot] = (EXPRTYPE)index;
+
+      err = exprRunProgram(&(ctx->obj), ctx->prog, ctx->vars, ctx->stack, &(range->out[index - range->begin]));
+
+      if(err != EXPR_ERROR_NOERROR)
+        {
+          EXPR_STAT_ADD(stat, evalerrors[EXPR_STAT_CODE(err)], 1);
+
+          if(range->errs[task] == EXPR_ERROR_NOERROR)
+            range->errs[task] = err;
+        }
+    }
+
+  /* The cost of the chunk and of the loops in it */
+  EXPR_STAT_ADD(stat, nodes, ctx->obj.loopnodes);
+  ctx->obj.loopnodes = 0;
+
+  return EXPR_ERROR_NOERROR;
+}
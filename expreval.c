@@ -11,6 +11,7 @@
 #include "exprincl.h"
 
 #include "exprpriv.h"
+#include "exprmem.h"
 
 /* Defines for error checking */
 #include <errno.h>
@@ -23,11 +24,53 @@
 #define EXPR_CHECK_ERR()
 #endif
 
+/* Dispatch for compiled programs */
+#if(EXPR_THREADED_DISPATCH) && defined(__GNUC__)
+#define EXPR_VM_THREADED
+#endif
+
+#ifdef EXPR_VM_THREADED
+#define EXPR_VM_LABEL(op) [op] = &&L_##op
+#define EXPR_VM_BEGIN() goto *labels[ip->op];
+#define EXPR_VM_CASE(op) L_##op:
+#define EXPR_VM_NEXT() ip++; goto *labels[ip->op]
+#define EXPR_VM_JUMP(target) ip = code + (target); goto *labels[ip->op]
+#define EXPR_VM_FINISH()
+#else
+#define EXPR_VM_BEGIN() for(;;) { switch(ip->op) {
+#define EXPR_VM_CASE(op) case op:
+#define EXPR_VM_NEXT() ip++; continue
+#define EXPR_VM_JUMP(target) ip = code + (target); continue
+#define EXPR_VM_FINISH() default: return EXPR_ERROR_UNKNOWN; } }
+#endif
+
+/* Instruction replacing the top of the stack with a math routine */
+#define EXPR_VM_MATH1(op, func)                 \
+  EXPR_VM_CASE(op)                              \
+  {                                             \
+    EXPR_RESET_ERR();                           \
+    *sp = func(*sp);                            \
+    EXPR_CHECK_ERR();                           \
+    EXPR_VM_NEXT();                             \
+  }
+
+/* Instruction replacing the top two items with a math routine */
+#define EXPR_VM_MATH2(op, func)                 \
+  EXPR_VM_CASE(op)                              \
+  {                                             \
+    sp--;                                       \
+    EXPR_RESET_ERR();                           \
+    *sp = func(sp[0], sp[1]);                   \
+    EXPR_CHECK_ERR();                           \
+    EXPR_VM_NEXT();                             \
+  }
+
 
 /* This routine will evaluate an expression */
 int exprEval(exprObj *obj, EXPRTYPE *val)
 {
   EXPRTYPE dummy;
+  int err;
 
   if(val ==  NULL)
     val = &dummy;
@@ -37,10 +80,614 @@ int exprEval(exprObj *obj, EXPRTYPE *val)
     {
       /* Do NOT reset the break count.  Let is accumulate
          between calls until breaker function is called */
-      return exprEvalNode(obj, obj->headnode, 0, val);
+      err = exprEvalNode(obj, obj->headnode, 0, val);
+    }
+  else
+    err = EXPR_ERROR_BADEXPR;
+
+  EXPR_STAT_EVAL(1, obj->nodecount + obj->loopnodes, err);
+  obj->loopnodes = 0;
+
+  return err;
+}
+
+/* This routine will evaluate the compiled program of an expression */
+int exprEvalCompiled(exprObj *obj, EXPRTYPE *val)
+{
+  EXPRTYPE dummy;
+  int err;
+
+  if(obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(val == NULL)
+    val = &dummy;
+
+  if(obj->parsedbad || !obj->parsedgood || obj->headnode == NULL)
+    err = EXPR_ERROR_BADEXPR;
+  else if(obj->program == NULL || obj->profile)
+    {
+      /* Not compiled or being profiled, use the node tree */
+      err = exprEvalNode(obj, obj->headnode, 0, val);
+    }
+  else if(obj->jit)
+    {
+      /* Machine code for the program */
+      err = (*(obj->jit->func))(obj, val);
     }
   else
-    return EXPR_ERROR_BADEXPR;
+    err = exprRunProgram(obj, obj->program, obj->program->vars, obj->program->stack, val);
+
+  EXPR_STAT_EVAL(1, obj->nodecount + obj->loopnodes, err);
+  obj->loopnodes = 0;
+
+  return err;
+}
+
+/* Run a compiled program.  vars holds the address of each
+   variable slot and stack must hold prog->depth items. */
+int exprRunProgram(exprObj *obj, exprProgram *prog, EXPRTYPE **vars, EXPRTYPE *stack, EXPRTYPE *val)
+{
+  exprInstr *code;
+  exprInstr *ip;
+  EXPRTYPE *sp;
+  EXPRTYPE d1, d2;
+  exprNode *node;
+  int err;
+  int pos;
+
+#ifdef EXPR_VM_THREADED
+  static const void *labels[EXPR_OP_COUNT] =
+    {
+      EXPR_VM_LABEL(EXPR_OP_END),
+      EXPR_VM_LABEL(EXPR_OP_VALUE),
+      EXPR_VM_LABEL(EXPR_OP_LOAD),
+      EXPR_VM_LABEL(EXPR_OP_STORE),
+      EXPR_VM_LABEL(EXPR_OP_POP),
+      EXPR_VM_LABEL(EXPR_OP_ADD),
+      EXPR_VM_LABEL(EXPR_OP_SUBTRACT),
+      EXPR_VM_LABEL(EXPR_OP_MULTIPLY),
+      EXPR_VM_LABEL(EXPR_OP_DIVIDE),
+      EXPR_VM_LABEL(EXPR_OP_EXPONENT),
+      EXPR_VM_LABEL(EXPR_OP_NEGATE),
+      EXPR_VM_LABEL(EXPR_OP_JUMP),
+      EXPR_VM_LABEL(EXPR_OP_JUMPZ),
+      EXPR_VM_LABEL(EXPR_OP_SELECT),
+      EXPR_VM_LABEL(EXPR_OP_CALL),
+      EXPR_VM_LABEL(EXPR_OP_CALLVAL),
+      EXPR_VM_LABEL(EXPR_OP_ABS),
+      EXPR_VM_LABEL(EXPR_OP_MOD),
+      EXPR_VM_LABEL(EXPR_OP_IPART),
+      EXPR_VM_LABEL(EXPR_OP_FPART),
+      EXPR_VM_LABEL(EXPR_OP_MIN),
+      EXPR_VM_LABEL(EXPR_OP_MAX),
+      EXPR_VM_LABEL(EXPR_OP_POW),
+      EXPR_VM_LABEL(EXPR_OP_SQRT),
+      EXPR_VM_LABEL(EXPR_OP_SIN),
+      EXPR_VM_LABEL(EXPR_OP_SINH),
+      EXPR_VM_LABEL(EXPR_OP_ASIN),
+      EXPR_VM_LABEL(EXPR_OP_COS),
+      EXPR_VM_LABEL(EXPR_OP_COSH),
+      EXPR_VM_LABEL(EXPR_OP_ACOS),
+      EXPR_VM_LABEL(EXPR_OP_TAN),
+      EXPR_VM_LABEL(EXPR_OP_TANH),
+      EXPR_VM_LABEL(EXPR_OP_ATAN),
+      EXPR_VM_LABEL(EXPR_OP_ATAN2),
+      EXPR_VM_LABEL(EXPR_OP_LOG),
+      EXPR_VM_LABEL(EXPR_OP_POW10),
+      EXPR_VM_LABEL(EXPR_OP_LN),
+      EXPR_VM_LABEL(EXPR_OP_EXP),
+      EXPR_VM_LABEL(EXPR_OP_LOGN),
+      EXPR_VM_LABEL(EXPR_OP_CEIL),
+      EXPR_VM_LABEL(EXPR_OP_FLOOR),
+      EXPR_VM_LABEL(EXPR_OP_RAND),
+      EXPR_VM_LABEL(EXPR_OP_RANDOM),
+      EXPR_VM_LABEL(EXPR_OP_RANDOMIZE),
+      EXPR_VM_LABEL(EXPR_OP_DEG),
+      EXPR_VM_LABEL(EXPR_OP_RAD),
+      EXPR_VM_LABEL(EXPR_OP_RECTTOPOLR),
+      EXPR_VM_LABEL(EXPR_OP_RECTTOPOLA),
+      EXPR_VM_LABEL(EXPR_OP_POLTORECTX),
+      EXPR_VM_LABEL(EXPR_OP_POLTORECTY),
+      EXPR_VM_LABEL(EXPR_OP_EQUAL),
+      EXPR_VM_LABEL(EXPR_OP_ABOVE),
+      EXPR_VM_LABEL(EXPR_OP_BELOW),
+      EXPR_VM_LABEL(EXPR_OP_AVG),
+      EXPR_VM_LABEL(EXPR_OP_CLIP),
+      EXPR_VM_LABEL(EXPR_OP_CLAMP),
+      EXPR_VM_LABEL(EXPR_OP_PNTCHANGE),
+      EXPR_VM_LABEL(EXPR_OP_POLY),
+      EXPR_VM_LABEL(EXPR_OP_AND),
+      EXPR_VM_LABEL(EXPR_OP_OR),
+      EXPR_VM_LABEL(EXPR_OP_NOT)
+    };
+#endif
+
+  code = prog->code;
+  ip = code;
+  sp = stack - 1;
+
+  EXPR_VM_BEGIN()
+
+  EXPR_VM_CASE(EXPR_OP_END)
+  {
+    *val = *sp;
+    return EXPR_ERROR_NOERROR;
+  }
+
+  EXPR_VM_CASE(EXPR_OP_VALUE)
+  {
+    *++sp = ip->data.value;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_LOAD)
+  {
+    *++sp = *(vars[ip->arg]);
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_STORE)
+  {
+    *(vars[ip->arg]) = *sp;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_POP)
+  {
+    sp--;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_ADD)
+  {
+    sp--;
+    *sp = sp[0] + sp[1];
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_SUBTRACT)
+  {
+    sp--;
+    *sp = sp[0] - sp[1];
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_MULTIPLY)
+  {
+    sp--;
+    *sp = sp[0] * sp[1];
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_DIVIDE)
+  {
+    sp--;
+
+    if(sp[1] != 0.0)
+      *sp = sp[0] / sp[1];
+    else
+      {
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+        return EXPR_ERROR_DIVBYZERO;
+#else
+        *sp = 0.0;
+#endif
+      }
+
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_MATH2(EXPR_OP_EXPONENT, pow)
+
+  EXPR_VM_CASE(EXPR_OP_NEGATE)
+  {
+    *sp = -*sp;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_JUMP)
+  {
+    /* Going backwards is a loop, check for a break */
+    if(ip->arg < ip - code && obj)
+      {
+        if(exprCheckBreak(obj, (int)(ip - code) - ip->arg + 1) != EXPR_ERROR_NOERROR)
+          return EXPR_ERROR_BREAK;
+      }
+
+    EXPR_VM_JUMP(ip->arg);
+  }
+
+  EXPR_VM_CASE(EXPR_OP_JUMPZ)
+  {
+    if(*sp-- == 0.0)
+      {
+        EXPR_VM_JUMP(ip->arg);
+      }
+
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_SELECT)
+  {
+    d1 = *sp--;
+
+    if(d1 < 0.0)
+      {
+        EXPR_VM_NEXT();
+      }
+    else if(d1 == 0.0)
+      {
+        EXPR_VM_JUMP(ip->data.jump[0]);
+      }
+
+    EXPR_VM_JUMP(ip->data.jump[1]);
+  }
+
+  EXPR_VM_CASE(EXPR_OP_CALL)
+  {
+    /* Function solvers evaluate their own arguments */
+    node = ip->data.node;
+    d1 = 0.0;
+
+    err = (*(node->data.function.fptr))(obj,
+                                         node->data.function.nodes, node->data.function.nodecount,
+                                         node->data.function.refs, node->data.function.refcount, &d1);
+    if(err)
+      return err;
+
+    *++sp = d1;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_CALLVAL)
+  {
+    /* The arguments are the top items, replaced by the result */
+    node = ip->data.node;
+    sp -= ip->arg;
+    d1 = 0.0;
+
+    err = (*(node->data.function.eager->eptr))(obj, sp + 1, ip->arg,
+                                               node->data.function.refs, node->data.function.refcount, &d1);
+    if(err)
+      return err;
+
+    *++sp = d1;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_ABS)
+  {
+    /* Like the node tree, NaN is negated too */
+    if(!(*sp >= 0))
+      *sp = -*sp;
+
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_MATH2(EXPR_OP_MOD, fmod)
+
+  EXPR_VM_CASE(EXPR_OP_IPART)
+  {
+    EXPR_RESET_ERR();
+    modf(*sp, &d1);
+    EXPR_CHECK_ERR();
+
+    *sp = d1;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_FPART)
+  {
+    EXPR_RESET_ERR();
+    *sp = modf(*sp, &d1);
+    EXPR_CHECK_ERR();
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_MIN)
+  {
+    sp -= ip->arg - 1;
+    d1 = sp[0];
+
+    for(pos = 1; pos < ip->arg; pos++)
+      {
+        if(sp[pos] < d1)
+          d1 = sp[pos];
+      }
+
+    *sp = d1;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_MAX)
+  {
+    sp -= ip->arg - 1;
+    d1 = sp[0];
+
+    for(pos = 1; pos < ip->arg; pos++)
+      {
+        if(sp[pos] > d1)
+          d1 = sp[pos];
+      }
+
+    *sp = d1;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_MATH2(EXPR_OP_POW, pow)
+  EXPR_VM_MATH1(EXPR_OP_SQRT, sqrt)
+  EXPR_VM_MATH1(EXPR_OP_SIN, sin)
+  EXPR_VM_MATH1(EXPR_OP_SINH, sinh)
+  EXPR_VM_MATH1(EXPR_OP_ASIN, asin)
+  EXPR_VM_MATH1(EXPR_OP_COS, cos)
+  EXPR_VM_MATH1(EXPR_OP_COSH, cosh)
+  EXPR_VM_MATH1(EXPR_OP_ACOS, acos)
+  EXPR_VM_MATH1(EXPR_OP_TAN, tan)
+  EXPR_VM_MATH1(EXPR_OP_TANH, tanh)
+  EXPR_VM_MATH1(EXPR_OP_ATAN, atan)
+  EXPR_VM_MATH2(EXPR_OP_ATAN2, atan2)
+  EXPR_VM_MATH1(EXPR_OP_LOG, log10)
+
+  EXPR_VM_CASE(EXPR_OP_POW10)
+  {
+    EXPR_RESET_ERR();
+    *sp = pow(10.0, *sp);
+    EXPR_CHECK_ERR();
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_MATH1(EXPR_OP_LN, log)
+  EXPR_VM_MATH1(EXPR_OP_EXP, exp)
+
+  EXPR_VM_CASE(EXPR_OP_LOGN)
+  {
+    sp--;
+
+    EXPR_RESET_ERR();
+    d1 = log(sp[0]);
+    EXPR_CHECK_ERR();
+    d2 = log(sp[1]);
+    EXPR_CHECK_ERR();
+
+    if(d2 == 0.0)
+      {
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+        return EXPR_ERROR_OUTOFRANGE;
+#else
+        *sp = 0.0;
+        EXPR_VM_NEXT();
+#endif
+      }
+
+    *sp = d1 / d2;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_CEIL)
+  {
+    *sp = ceil(*sp);
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_FLOOR)
+  {
+    *sp = floor(*sp);
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_RAND)
+  {
+    long a;
+
+    a = ((long)(*(vars[ip->arg]))) * 214013L + 2531011L;
+    *(vars[ip->arg]) = (EXPRTYPE)a;
+
+    *++sp = (EXPRTYPE)((a >> 16) & 0x7FFF) / (EXPRTYPE)(32768);
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_RANDOM)
+  {
+    long a;
+
+    sp--;
+
+    a = ((long)(*(vars[ip->arg]))) * 214013L + 2531011L;
+    *(vars[ip->arg]) = (EXPRTYPE)a;
+
+    d1 = (EXPRTYPE)((a >> 16) & 0x7FFF) / (EXPRTYPE)(32767);
+    *sp = (d1 * (sp[1] - sp[0])) + sp[0];
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_RANDOMIZE)
+  {
+    static int curcall = 0;
+
+    curcall++;
+
+    *(vars[ip->arg]) = (EXPRTYPE)((clock() + 1024 + curcall) * time(NULL));
+
+    *++sp = 0.0;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_DEG)
+  {
+    *sp = (180.0 * *sp) / M_PI;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_RAD)
+  {
+    *sp = (M_PI * *sp) / 180.0;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_RECTTOPOLR)
+  {
+    sp--;
+
+    EXPR_RESET_ERR();
+    *sp = sqrt((sp[0] * sp[0]) + (sp[1] * sp[1]));
+    EXPR_CHECK_ERR();
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_RECTTOPOLA)
+  {
+    sp--;
+
+    EXPR_RESET_ERR();
+    d1 = atan2(sp[1], sp[0]);
+    EXPR_CHECK_ERR();
+
+    if(d1 < 0.0)
+      d1 += (2.0 * M_PI);
+
+    *sp = d1;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_POLTORECTX)
+  {
+    sp--;
+
+    EXPR_RESET_ERR();
+    *sp = sp[0] * cos(sp[1]);
+    EXPR_CHECK_ERR();
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_POLTORECTY)
+  {
+    sp--;
+
+    EXPR_RESET_ERR();
+    *sp = sp[0] * sin(sp[1]);
+    EXPR_CHECK_ERR();
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_EQUAL)
+  {
+    sp--;
+    *sp = (sp[0] == sp[1]) ? 1.0 : 0.0;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_ABOVE)
+  {
+    sp--;
+    *sp = (sp[0] > sp[1]) ? 1.0 : 0.0;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_BELOW)
+  {
+    sp--;
+    *sp = (sp[0] < sp[1]) ? 1.0 : 0.0;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_AVG)
+  {
+    sp -= ip->arg - 1;
+    d1 = 0.0;
+
+    for(pos = 0; pos < ip->arg; pos++)
+      d1 += sp[pos];
+
+    *sp = d1 / (EXPRTYPE)(ip->arg);
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_CLIP)
+  {
+    sp -= 2;
+
+    if(sp[0] < sp[1])
+      *sp = sp[1];
+    else if(sp[0] > sp[2])
+      *sp = sp[2];
+
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_CLAMP)
+  {
+    sp -= 2;
+
+    EXPR_RESET_ERR();
+    d1 = fmod(sp[0] - sp[1], sp[2] - sp[1]);
+    EXPR_CHECK_ERR();
+
+    if(d1 < 0.0)
+      *sp = d1 + sp[2];
+    else
+      *sp = d1 + sp[1];
+
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_PNTCHANGE)
+  {
+    sp -= 4;
+
+    /* sp[0] to sp[4] are side1, side2, new1, new2 and the point */
+    d1 = sp[1] - sp[0];
+
+    if(d1 == 0.0)
+      {
+        /* Result is side1 */
+        EXPR_VM_NEXT();
+      }
+
+    *sp = sp[2] + (((sp[4] - sp[0]) / d1) * (sp[3] - sp[2]));
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_POLY)
+  {
+    sp -= ip->arg - 1;
+    d1 = (EXPRTYPE)(ip->arg) - 2.0;
+    d2 = 0.0;
+
+    for(pos = 1; pos < ip->arg; pos++)
+      {
+        EXPR_RESET_ERR();
+        d2 = d2 + (sp[pos] * pow(sp[0], d1));
+        EXPR_CHECK_ERR();
+
+        d1 = d1 - 1.0;
+      }
+
+    *sp = d2;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_AND)
+  {
+    sp--;
+    *sp = (sp[0] == 0.0 || sp[1] == 0.0) ? 0.0 : 1.0;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_OR)
+  {
+    sp--;
+    *sp = (sp[0] != 0.0 || sp[1] != 0.0) ? 1.0 : 0.0;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_CASE(EXPR_OP_NOT)
+  {
+    *sp = (*sp != 0.0) ? 0.0 : 1.0;
+    EXPR_VM_NEXT();
+  }
+
+  EXPR_VM_FINISH()
 }
 
 /* Evaluate a node */
@@ -56,17 +703,11 @@ int exprEvalNode(exprObj *obj, exprNode *nodes, int curnode, EXPRTYPE *val)
   /* Update n to point to correct node */
   nodes += curnode;
 
-  /* Check breaker count */
-  if(obj->breakcur-- <= 0)
-    {
-      /* Reset count before returning */
-      obj->breakcur = obj->breakcount;
-
-      if(exprGetBreakResult(obj))
-        {
-          return EXPR_ERROR_BREAK;
-        }
-    }
+#if(EXPR_PROFILE)
+  /* The profiler evaluates the node again after starting its timer */
+  if(EXPR_UNLIKELY(obj->profile != NULL) && obj->profile->current != nodes)
+    return exprProfileNode(obj, nodes, val);
+#endif
 
   switch(nodes->type)
     {
@@ -263,3 +904,40 @@ int exprEvalNode(exprObj *obj, exprNode *nodes, int curnode, EXPRTYPE *val)
 
   return EXPR_ERROR_NOERROR;
 }
+
+/* Evaluate the arguments of an eager function node in order and
+   call it with their values.  This is not part of exprEvalNode so
+   the recursion does not carry the array of values. */
+int exprEvalEager(exprObj *obj, exprNode *node, EXPRTYPE *val)
+{
+  EXPRTYPE buf[EXPR_EAGER_ARGS];
+  EXPRTYPE *args;
+  int count, pos;
+  int err;
+
+  count = node->data.function.nodecount;
+  args = buf;
+
+  if(count > EXPR_EAGER_ARGS)
+    {
+      args = exprAllocRawMem(count * sizeof(EXPRTYPE));
+      if(args == NULL)
+        return EXPR_ERROR_MEMORY;
+    }
+
+  err = EXPR_ERROR_NOERROR;
+
+  for(pos = 0; pos < count && err == EXPR_ERROR_NOERROR; pos++)
+    err = exprEvalNode(obj, node->data.function.nodes, pos, &(args[pos]));
+
+  if(err == EXPR_ERROR_NOERROR)
+    {
+      err = (*(node->data.function.eager->eptr))(obj, args, count,
+                                                 node->data.function.refs, node->data.function.refcount, val);
+    }
+
+  if(args != buf)
+    exprFreeMem(args);
+
+  return err;
+}
@@ -48,10 +48,33 @@ enum
     EXPR_ERROR_CONSTANTASSIGN, /* Assignment to a constant */
     EXPR_ERROR_REFCONSTANT, /* Constant used as a reference parameter */
     EXPR_ERROR_OUTOFRANGE, /* A bad value was passed to a function */
+    EXPR_ERROR_NOTSHAREABLE, /* Expression calls custom functions and can not have contexts */
+    EXPR_ERROR_NONATIVE, /* Expression can not be translated to native code */
+    EXPR_ERROR_NOPROFILE, /* Profiling is not built in or not started */
 
     EXPR_ERROR_USER /* Custom errors should be larger than this */
     };
 
+/* Flags for exprOptimize */
+enum
+    {
+    EXPR_OPT_FOLD = 1, /* Evaluate parts that only use numbers */
+    EXPR_OPT_CONSTANTS = 2, /* Treat constants as numbers, the constant list must not change */
+    EXPR_OPT_SIMPLIFY = 4, /* Remove operations that do nothing, like x*1 and --x */
+    EXPR_OPT_STRICT = 8, /* Only simplify where results and errors are exactly the same */
+    EXPR_OPT_CSE = 16 /* Evaluate repeated subexpressions once */
+    };
+
+/* Flags for exprFuncListAddEx, what a function promises about itself */
+enum
+    {
+    EXPR_FUNC_PURE = 1, /* Changes no variables or other state, except written references */
+    EXPR_FUNC_DETERMINISTIC = 2, /* Result only depends on the arguments and references */
+    EXPR_FUNC_READREFS = 4, /* Reads the values of its reference parameters */
+    EXPR_FUNC_WRITEREFS = 8, /* Changes its reference parameters */
+    EXPR_FUNC_EVALNODES = 16 /* Evaluates its argument nodes itself, maybe not all or more than once */
+    };
+
 /* Macros */
 
 /* Forward declarations */
@@ -59,10 +82,82 @@ typedef struct _exprNode exprNode;
 typedef struct _exprFuncList exprFuncList;
 typedef struct _exprValList exprValList;
 typedef struct _exprObj exprObj;
+typedef struct _exprArena exprArena;
+typedef struct _exprContext exprContext;
+typedef struct _exprNative exprNative;
+typedef struct _exprCache exprCache;
+typedef struct _exprGroup exprGroup;
+typedef struct _exprPool exprPool;
+
+/* Binding of a variable to a column of values for exprEvalBatch */
+typedef struct _exprBinding
+{
+  EXPRTYPE *addr; /* Address of the variable, from exprValListGetAddress */
+  const EXPRTYPE *data; /* Value for the first row */
+  int stride; /* Distance in items between the values of each row */
+} exprBinding;
+
+/* Counters of an expression cache */
+typedef struct _exprCacheStats
+{
+  unsigned long hits; /* Texts found in the cache */
+  unsigned long misses; /* Texts that were parsed */
+  unsigned long evictions; /* Expressions freed to stay in the budget */
+  int entries; /* Expressions in the cache */
+  unsigned long bytes; /* Memory used by the expressions */
+  unsigned long budget; /* Memory the cache tries to stay within */
+} exprCacheStats;
+
+/* Counters of the memory the library has allocated */
+typedef struct _exprMemStats
+{
+  unsigned long allocs; /* Blocks allocated, including resizes */
+  unsigned long frees; /* Blocks freed */
+  unsigned long bytes; /* Bytes asked for by the allocations */
+} exprMemStats;
+
+/* Counters of the whole library, see exprGetStats */
+typedef struct _exprStats
+{
+  unsigned long parses; /* Calls of exprParse */
+  unsigned long parseerrors[EXPR_ERROR_USER + 1]; /* Failed parses by error code, other codes at EXPR_ERROR_USER */
+  unsigned long evals; /* Expressions evaluated, counting each of a batch or range */
+  unsigned long evalerrors[EXPR_ERROR_USER + 1]; /* Failed evaluations by error code, other codes at EXPR_ERROR_USER */
+  unsigned long nodes; /* Estimate of the nodes evaluated */
+  unsigned long breaks; /* Calls of breaker functions */
+  unsigned long allocs; /* Blocks allocated, including resizes */
+  unsigned long frees; /* Blocks freed */
+  unsigned long bytes; /* Bytes asked for by the allocations */
+  long livenodes; /* Nodes of parsed expressions not yet cleared or freed */
+} exprStats;
+
+/* Description of a function for exprFuncListAddEx */
+typedef struct _exprFuncInfo
+{
+  int flags; /* EXPR_FUNC_* flags */
+  int cost; /* Rough time of a call without its arguments, an addition is 1 */
+} exprFuncInfo;
 
 /* Function types */
 typedef int (*exprFuncType)(exprObj *obj, exprNode *nodes, int nodecount, EXPRTYPE **refs, int refcount, EXPRTYPE *val);
 typedef int (*exprBreakFuncType)(exprObj *obj);
+typedef int (*exprJitFunc)(exprObj *obj, EXPRTYPE *val);
+typedef int (*exprNativeFunc)(EXPRTYPE **vars, EXPRTYPE *val);
+typedef int (*exprEagerFuncType)(exprObj *obj, const EXPRTYPE *args, int argcount, EXPRTYPE **refs, int refcount,
+    EXPRTYPE *val);
+typedef int (*exprEagerBatchFuncType)(exprObj *obj, const EXPRTYPE **args, int argcount, int count, EXPRTYPE *out);
+typedef void *(*exprAllocFuncType)(void *context, unsigned long size);
+typedef void *(*exprReallocFuncType)(void *context, void *data, unsigned long size);
+typedef void (*exprFreeFuncType)(void *context, void *data);
+
+/* Memory functions the library uses, see exprSetDefaultAllocator */
+typedef struct _exprAllocator
+{
+  exprAllocFuncType allocfunc; /* Like malloc, the memory need not be zeroed */
+  exprReallocFuncType reallocfunc; /* Like realloc, data may be NULL */
+  exprFreeFuncType freefunc; /* Like free, never given NULL */
+  void *context; /* Passed to each function */
+} exprAllocator;
 
 
 
@@ -73,13 +168,20 @@ void exprGetVersion(int *major, int *minor);
 
 /* Functions for function lists */
 int exprFuncListCreate(exprFuncList **flist);
+int exprFuncListCreateEx(exprFuncList **flist, exprAllocator *alloc);
 int exprFuncListAdd(exprFuncList *flist, char *name, exprFuncType ptr, int min, int max, int refmin, int refmax);
+int exprFuncListAddEx(exprFuncList *flist, char *name, exprFuncType ptr, int min, int max, int refmin, int refmax,
+    exprFuncInfo *info);
+int exprFuncListAddEager(exprFuncList *flist, char *name, exprEagerFuncType ptr, exprEagerBatchFuncType batch,
+    int min, int max, int refmin, int refmax, exprFuncInfo *info);
+int exprFuncListGetInfo(exprFuncList *flist, char *name, exprFuncInfo *info);
 int exprFuncListFree(exprFuncList *flist);
 int exprFuncListClear(exprFuncList *flist);
 int exprFuncListInit(exprFuncList *flist);
 
 /* Functions for value lists */
 int exprValListCreate(exprValList **vlist);
+int exprValListCreateEx(exprValList **vlist, exprAllocator *alloc);
 int exprValListAdd(exprValList *vlist, char *name, EXPRTYPE val);
 int exprValListSet(exprValList *vlist, char *name, EXPRTYPE val);
 int exprValListGet(exprValList *vlist, char *name, EXPRTYPE *val);
@@ -93,20 +195,110 @@ int exprValListInit(exprValList *vlist);
 /* Functions for expression objects */
 int exprCreate(exprObj **obj, exprFuncList *flist, exprValList *vlist, exprValList *clist,
     exprBreakFuncType breaker, void *userdata);
+int exprCreateEx(exprObj **obj, exprFuncList *flist, exprValList *vlist, exprValList *clist,
+    exprBreakFuncType breaker, void *userdata, exprAllocator *alloc);
 int exprFree(exprObj *obj);
 int exprClear(exprObj *obj);
 int exprParse(exprObj *obj, char *expr);
 int exprEval(exprObj *obj, EXPRTYPE *val);
 int exprEvalNode(exprObj *obj, exprNode *nodes, int curnode, EXPRTYPE *val);
+int exprCompile(exprObj *obj);
+int exprEvalCompiled(exprObj *obj, EXPRTYPE *val);
+int exprEvalBatch(exprObj *obj, int count, exprBinding *bindings, int bindcount, EXPRTYPE *out);
+int exprOptimize(exprObj *obj, int flags);
+int exprJitCompile(exprObj *obj);
 exprFuncList *exprGetFuncList(exprObj *obj);
 exprValList *exprGetVarList(exprObj *obj);
 exprValList *exprGetConstList(exprObj *obj);
 exprBreakFuncType exprGetBreakFunc(exprObj *obj);
+exprJitFunc exprGetJitFunc(exprObj *obj);
 int exprGetBreakResult(exprObj *obj);
 void* exprGetUserData(exprObj *obj);
 void exprSetUserData(exprObj *obj, void *userdata);
 void exprSetBreakCount(exprObj *obj, int count);
+void exprSetCancel(exprObj *obj, int cancel);
+int exprGetCancel(exprObj *obj);
+int exprCheckBreak(exprObj *obj, int cost);
+void exprSetCompile(exprObj *obj, int compile);
 void exprGetErrorPosition(exprObj *obj, int *start, int *end);
+int exprSetArena(exprObj *obj, exprArena *arena);
+
+/* Functions for evaluation contexts */
+int exprContextCreate(exprContext **ctx, exprObj *obj);
+int exprContextFree(exprContext *ctx);
+int exprContextEval(exprContext *ctx, EXPRTYPE *val);
+int exprContextGetAddress(exprContext *ctx, char *name, EXPRTYPE **addr);
+int exprContextSetAddress(exprContext *ctx, char *name, EXPRTYPE *addr);
+int exprEvalRange(exprObj *obj, EXPRTYPE *var, long begin, long end, EXPRTYPE *out, exprPool *pool);
+
+/* Functions for expression caches */
+int exprCacheCreate(exprCache **cache, unsigned long budget);
+int exprCacheFree(exprCache *cache);
+int exprCacheClear(exprCache *cache);
+int exprCacheGet(exprCache *cache, exprObj **obj, exprFuncList *flist, exprValList *vlist,
+    exprValList *clist, char *expr);
+int exprCacheRelease(exprCache *cache, exprObj *obj);
+int exprCacheGetStats(exprCache *cache, exprCacheStats *stats);
+
+/* Functions for groups of expressions */
+int exprGroupCreate(exprGroup **group);
+int exprGroupFree(exprGroup *group);
+int exprGroupAdd(exprGroup *group, exprObj *obj);
+int exprGroupUpdate(exprGroup *group);
+int exprGroupEval(exprGroup *group, int *count);
+int exprGroupGetResult(exprGroup *group, int index, EXPRTYPE *val);
+int exprGroupEvalParallel(exprGroup *group, exprPool *pool, int *count);
+
+/* Functions for thread pools */
+int exprPoolCreate(exprPool **pool, int threads);
+int exprPoolFree(exprPool *pool);
+int exprPoolGetThreads(exprPool *pool, int *threads);
+
+/* Functions for generated C source and native code */
+int exprSourceCreate(exprObj *obj, char *name, char **source);
+int exprSourceFree(char *source);
+int exprNativeCreate(exprNative **native, exprObj *obj, char *dir);
+int exprNativeFree(exprNative *native);
+int exprNativeEval(exprNative *native, EXPRTYPE *val);
+exprNativeFunc exprNativeGetFunc(exprNative *native);
+
+/* Functions for profiling */
+int exprSetProfile(exprObj *obj, int profile);
+int exprProfileReset(exprObj *obj);
+int exprProfileReport(exprObj *obj, char *expr, char **report);
+int exprProfileReportFree(char *report);
+
+/* Functions for arenas */
+int exprArenaCreate(exprArena **arena, int blocksize);
+int exprArenaCreateEx(exprArena **arena, int blocksize, exprAllocator *alloc);
+int exprArenaFree(exprArena *arena);
+int exprArenaReset(exprArena *arena);
+
+/* Functions for memory statistics */
+int exprGetMemStats(exprMemStats *stats);
+
+/* Functions for allocators */
+int exprSetDefaultAllocator(exprAllocator *alloc);
+int exprGetDefaultAllocator(exprAllocator *alloc);
+
+/* Functions for library statistics */
+int exprGetStats(exprStats *stats);
+
+/* Array versions of the built in functions */
+int exprKernelSin(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask);
+int exprKernelCos(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask);
+int exprKernelExp(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask);
+int exprKernelLn(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask);
+int exprKernelSqrt(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask);
+int exprKernelPow(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *y, int count, unsigned char *mask);
+int exprKernelClamp(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *lo, const EXPRTYPE *hi, int count, unsigned char *mask);
+int exprKernelPoly(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *coefs, int ncoefs, int stride, int count, unsigned char *mask);
+int exprKernelAbs(EXPRTYPE *out, const EXPRTYPE *x, int count);
+int exprKernelFloor(EXPRTYPE *out, const EXPRTYPE *x, int count);
+int exprKernelCeil(EXPRTYPE *out, const EXPRTYPE *x, int count);
+int exprKernelMin(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count);
+int exprKernelMax(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count);
+int exprKernelClip(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *lo, const EXPRTYPE *hi, int count);
 
 /* Other useful routines */
 int exprValidIdent(char *name);
@@ -16,12 +16,21 @@
 #include "exprmem.h"
 
 /* Internal functions */
-static exprFunc *exprCreateFunc(char *name, exprFuncType ptr, int type, int min, int max, int refmin, int refmax);
-static void exprFuncListFreeData(exprFunc *func);
+static exprFunc *exprCreateFunc(exprAllocator *alloc, char *name, exprFuncType ptr, int type, int min, int max, int refmin, int refmax, exprFuncInfo *info);
+static void exprFuncListFreeData(exprAllocator *alloc, exprFunc *func);
+static exprFunc *exprFuncListFind(exprFuncList *flist, char *name, int len);
+static int exprFuncListInsert(exprFuncList *flist, exprFunc *func);
 
 
 /* This function creates the function list, */
 int exprFuncListCreate(exprFuncList **flist)
+    {
+    return exprFuncListCreateEx(flist, NULL);
+    }
+
+/* Create a function list that takes the memory for itself and its
+   items from an allocator, or the default one if alloc is NULL */
+int exprFuncListCreateEx(exprFuncList **flist, exprAllocator *alloc)
     {
     exprFuncList *tmp;
 
@@ -30,11 +39,13 @@ int exprFuncListCreate(exprFuncList **flist)
 
     *flist = NULL; /* Set to NULL initially */
 
-    tmp = exprAllocMem(sizeof(exprFuncList));
+    tmp = exprAllocFrom(alloc, sizeof(exprFuncList));
 
     if(tmp == NULL)
         return EXPR_ERROR_MEMORY; /* Could not allocate memory */
 
+    exprAllocatorInit(&(tmp->alloc), alloc);
+
     /* Update pointer */
     *flist = tmp;
 
@@ -43,9 +54,18 @@ int exprFuncListCreate(exprFuncList **flist)
 
 /* Add a function to the list */
 int exprFuncListAdd(exprFuncList *flist, char *name, exprFuncType ptr, int min, int max, int refmin, int refmax)
+    {
+    /* Nothing is known about what it does */
+    return exprFuncListAddEx(flist, name, ptr, min, max, refmin, refmax, NULL);
+    }
+
+/* Add a function to the list with a description of what it does.
+   The optimizer only moves or removes calls that the flags say are
+   safe to.  info may be NULL if nothing is known. */
+int exprFuncListAddEx(exprFuncList *flist, char *name, exprFuncType ptr, int min, int max, int refmin, int refmax,
+    exprFuncInfo *info)
     {
     exprFunc *tmp;
-    exprFunc *cur;
     int result;
 
     if(flist == NULL)
@@ -82,40 +102,21 @@ int exprFuncListAdd(exprFuncList *flist, char *name, exprFuncType ptr, int min,
             }
         }
 
-    if(flist->head == NULL)
-        {
-        /* Create the node right here */
-        tmp = exprCreateFunc(name, ptr, EXPR_NODETYPE_FUNCTION, min, max, refmin, refmax);
-
-        if(tmp == NULL)
-            return EXPR_ERROR_MEMORY;
-
-        flist->head = tmp;
-        return EXPR_ERROR_NOERROR;
-        }
-
     /* See if it already exists */
-    cur = flist->head;
-
-    while(cur)
-        {
-        result = strcmp(name, cur->fname);
-
-        if(result == 0)
-            return EXPR_ERROR_ALREADYEXISTS;
-
-        cur = cur->next;
-        }
+    if(exprFuncListFind(flist, name, (int)strlen(name)))
+        return EXPR_ERROR_ALREADYEXISTS;
 
     /* It did not exist, so add it at the head */
-    tmp = exprCreateFunc(name, ptr, EXPR_NODETYPE_FUNCTION, min, max, refmin, refmax);
+    tmp = exprCreateFunc(&(flist->alloc), name, ptr, EXPR_NODETYPE_FUNCTION, min, max, refmin, refmax, info);
 
     if(tmp == NULL)
         return EXPR_ERROR_MEMORY;
 
-    tmp->next = flist->head;
-    flist->head = tmp;
-    return EXPR_ERROR_NOERROR;
+    result = exprFuncListInsert(flist, tmp);
+    if(result != EXPR_ERROR_NOERROR)
+        exprFuncListFreeData(&(flist->alloc), tmp);
+
+    return result;
     }
 
 /* Add a function node type to the list
@@ -123,10 +124,10 @@ int exprFuncListAdd(exprFuncList *flist, char *name, exprFuncType ptr, int min,
    pointer is NULL and the node type specifies the function
    to do.  exprEvalNode handles this, instead of calling
    a function solver. */
-int exprFuncListAddType(exprFuncList *flist, char *name, int type, int min, int max, int refmin, int refmax)
+int exprFuncListAddType(exprFuncList *flist, char *name, int type, int min, int max, int refmin, int refmax,
+    exprFuncInfo *info)
     {
     exprFunc *tmp;
-    exprFunc *cur;
     int result;
 
     if(flist == NULL)
@@ -163,39 +164,55 @@ int exprFuncListAddType(exprFuncList *flist, char *name, int type, int min, int
             }
         }
 
-    if(flist->head == NULL)
-        {
-        /* Create the node right here */
-        tmp = exprCreateFunc(name, NULL, type, min, max, refmin, refmax);
+    /* See if it already exists */
+    if(exprFuncListFind(flist, name, (int)strlen(name)))
+        return EXPR_ERROR_ALREADYEXISTS;
 
-        if(tmp == NULL)
-            return EXPR_ERROR_MEMORY;
+    /* It did not exist, so add it at the head */
+    tmp = exprCreateFunc(&(flist->alloc), name, NULL, type, min, max, refmin, refmax, info);
 
-        flist->head = tmp;
-        return EXPR_ERROR_NOERROR;
-        }
+    if(tmp == NULL)
+        return EXPR_ERROR_MEMORY;
 
-    /* See if it already exists */
-    cur = flist->head;
+    result = exprFuncListInsert(flist, tmp);
+    if(result != EXPR_ERROR_NOERROR)
+        exprFuncListFreeData(&(flist->alloc), tmp);
 
-    while(cur)
-        {
-        result = strcmp(name, cur->fname);
+    return result;
+    }
+
+/* Add a function that is called with the values of its arguments
+   instead of the nodes.  The arguments are always evaluated in
+   order before the call.  batch may be NULL, otherwise it is used
+   when the expression is evaluated for many rows at once. */
+int exprFuncListAddEager(exprFuncList *flist, char *name, exprEagerFuncType ptr, exprEagerBatchFuncType batch,
+    int min, int max, int refmin, int refmax, exprFuncInfo *info)
+    {
+    exprFuncInfo tmp;
+    int result;
 
-        if(result == 0)
-            return EXPR_ERROR_ALREADYEXISTS;
+    if(ptr == NULL)
+        return EXPR_ERROR_NULLPOINTER;
 
-        cur = cur->next;
+    if(info)
+        tmp = *info;
+    else
+        {
+        tmp.flags = EXPR_FUNC_UNKNOWN;
+        tmp.cost = EXPR_FUNC_COST;
         }
 
-    /* It did not exist, so add it at the head */
-    tmp = exprCreateFunc(name, NULL, type, min, max, refmin, refmax);
+    /* It never sees the nodes */
+    tmp.flags &= ~EXPR_FUNC_EVALNODES;
 
-    if(tmp == NULL)
-        return EXPR_ERROR_MEMORY;
+    result = exprFuncListAddType(flist, name, EXPR_NODEFUNC_EAGER, min, max, refmin, refmax, &tmp);
+    if(result != EXPR_ERROR_NOERROR)
+        return result;
+
+    /* New functions are added at the head */
+    flist->head->eptr = ptr;
+    flist->head->bptr = batch;
 
-    tmp->next = flist->head;
-    flist->head = tmp;
     return EXPR_ERROR_NOERROR;
     }
 
@@ -204,7 +221,7 @@ int exprFuncListAddType(exprFuncList *flist, char *name, int type, int min, int
 int exprFuncListGet(exprFuncList *flist, char *name, exprFuncType *ptr, int *type, int *min, int *max, int *refmin, int *refmax)
     {
     exprFunc *cur;
-    int result;
+    int err;
 
     if(flist == NULL)
         return EXPR_ERROR_NULLPOINTER;
@@ -212,28 +229,59 @@ int exprFuncListGet(exprFuncList *flist, char *name, exprFuncType *ptr, int *typ
     if(name == NULL || name[0] == '\0')
         return EXPR_ERROR_NOTFOUND;
 
+    err = exprFuncListGetLen(flist, name, (int)strlen(name), &cur);
+    if(err != EXPR_ERROR_NOERROR)
+        return err;
+
+    *ptr = cur->fptr;
+    *min = cur->min;
+    *max = cur->max;
+    *refmin = cur->refmin;
+    *refmax = cur->refmax;
+    *type = cur->type;
+
+    return EXPR_ERROR_NOERROR;
+    }
+
+/* Get the description of a function */
+int exprFuncListGetInfo(exprFuncList *flist, char *name, exprFuncInfo *info)
+    {
+    exprFunc *cur;
+
+    if(flist == NULL || info == NULL)
+        return EXPR_ERROR_NULLPOINTER;
+
+    if(name == NULL || name[0] == '\0')
+        return EXPR_ERROR_NOTFOUND;
+
+    cur = exprFuncListFind(flist, name, (int)strlen(name));
+    if(cur == NULL)
+        return EXPR_ERROR_NOTFOUND;
+
+    info->flags = cur->flags;
+    info->cost = cur->cost;
+
+    return EXPR_ERROR_NOERROR;
+    }
+
+/* Get a function named by the first len characters of name */
+int exprFuncListGetLen(exprFuncList *flist, char *name, int len, exprFunc **func)
+    {
+    exprFunc *cur;
+
+    if(flist == NULL)
+        return EXPR_ERROR_NULLPOINTER;
+
     /* Search for the item */
-    cur = flist->head;
+    cur = exprFuncListFind(flist, name, len);
 
-    while(cur)
+    if(cur)
         {
-        result = strcmp(name, cur->fname);
-
-        if(result == 0)
-            {
-            /* We found it. */
-            *ptr = cur->fptr;
-            *min = cur->min;
-            *max = cur->max;
-            *refmin = cur->refmin;
-            *refmax = cur->refmax;
-            *type = cur->type;
-
-            /* return now */
-            return EXPR_ERROR_NOERROR;
-            }
+        /* We found it. */
+        *func = cur;
 
-        cur = cur->next;
+        /* return now */
+        return EXPR_ERROR_NOERROR;
         }
 
     /* If we got here, we did not find the item in the list */
@@ -243,15 +291,20 @@ int exprFuncListGet(exprFuncList *flist, char *name, exprFuncType *ptr, int *typ
 /* This routine will free the function list */
 int exprFuncListFree(exprFuncList *flist)
     {
+    exprAllocator alloc;
+
     /* Make sure it exists, if not it is not error */
     if(flist == NULL)
         return EXPR_ERROR_NOERROR;
 
-    /* Free the nodes */
-    exprFuncListFreeData(flist->head);
+    alloc = flist->alloc;
+
+    /* Free the nodes and table */
+    exprFuncListFreeData(&alloc, flist->head);
+    exprFreeFrom(&alloc, flist->table);
 
     /* Free the container */
-    exprFreeMem(flist);
+    exprFreeFrom(&alloc, flist);
 
     return EXPR_ERROR_NOERROR;
     }
@@ -265,16 +318,21 @@ int exprFuncListClear(exprFuncList *flist)
     /* Free the nodes only */
     if(flist->head)
         {
-        exprFuncListFreeData(flist->head);
+        exprFuncListFreeData(&(flist->alloc), flist->head);
 
         flist->head = NULL;
         }
 
+    exprFreeFrom(&(flist->alloc), flist->table);
+    flist->table = NULL;
+    flist->tablesize = 0;
+    flist->count = 0;
+
     return EXPR_ERROR_NOERROR;
     }
 
 /* This routine will free any child nodes, and then free itself */
-void exprFuncListFreeData(exprFunc *func)
+void exprFuncListFreeData(exprAllocator *alloc, exprFunc *func)
     {
     exprFunc *next;
 
@@ -284,17 +342,85 @@ void exprFuncListFreeData(exprFunc *func)
         next = func->next;
 
         /* Free name */
-        exprFreeMem(func->fname);
+        exprFreeFrom(alloc, func->fname);
 
         /* Free ourself */
-        exprFreeMem(func);
+        exprFreeFrom(alloc, func);
 
         func = next;
         }
     }
 
+/* Find a function by the first len characters of name */
+static exprFunc *exprFuncListFind(exprFuncList *flist, char *name, int len)
+    {
+    exprFunc *cur;
+    unsigned int hash;
+    int pos, mask;
+
+    if(flist->table == NULL)
+        return NULL;
+
+    hash = exprHashName(name, len);
+    mask = flist->tablesize - 1;
+
+    /* Probe until an empty entry */
+    for(pos = (int)(hash & mask); (cur = flist->table[pos]) != NULL; pos = (pos + 1) & mask)
+        {
+        if(cur->hash == hash && strncmp(name, cur->fname, len) == 0 && cur->fname[len] == '\0')
+            return cur;
+        }
+
+    return NULL;
+    }
+
+/* Add a function to the table and the beginning of the list */
+static int exprFuncListInsert(exprFuncList *flist, exprFunc *func)
+    {
+    exprFunc **table;
+    exprFunc *cur;
+    int size, pos, mask;
+
+    /* Grow the table when three quarters full */
+    if((flist->count + 1) * 4 > flist->tablesize * 3)
+        {
+        size = flist->tablesize ? flist->tablesize * 2 : EXPR_HASH_INITSIZE;
+
+        table = exprAllocFrom(&(flist->alloc), size * sizeof(exprFunc*));
+        if(table == NULL)
+            return EXPR_ERROR_MEMORY;
+
+        mask = size - 1;
+
+        for(cur = flist->head; cur; cur = cur->next)
+            {
+            for(pos = (int)(cur->hash & mask); table[pos]; pos = (pos + 1) & mask)
+                ;
+
+            table[pos] = cur;
+            }
+
+        exprFreeFrom(&(flist->alloc), flist->table);
+        flist->table = table;
+        flist->tablesize = size;
+        }
+
+    mask = flist->tablesize - 1;
+
+    for(pos = (int)(func->hash & mask); flist->table[pos]; pos = (pos + 1) & mask)
+        ;
+
+    flist->table[pos] = func;
+    flist->count++;
+
+    func->next = flist->head;
+    flist->head = func;
+
+    return EXPR_ERROR_NOERROR;
+    }
+
 /* This routine will create the function object */
-exprFunc *exprCreateFunc(char *name, exprFuncType ptr, int type, int min, int max, int refmin, int refmax)
+exprFunc *exprCreateFunc(exprAllocator *alloc, char *name, exprFuncType ptr, int type, int min, int max, int refmin, int refmax, exprFuncInfo *info)
     {
     exprFunc *tmp;
     char *vtmp;
@@ -302,16 +428,16 @@ exprFunc *exprCreateFunc(char *name, exprFuncType ptr, int type, int min, int ma
     /* We already checked the name in exprFuncListAdd */
 
     /* Create it */
-    tmp = exprAllocMem(sizeof(exprFunc));
+    tmp = exprAllocFrom(alloc, sizeof(exprFunc));
     if(tmp == NULL)
         return NULL;
 
-    /* Allocate space for the name */
-    vtmp = exprAllocMem(strlen(name) + 1);
+    /* Allocate space for the name, it is copied over */
+    vtmp = exprAllocRawFrom(alloc, strlen(name) + 1);
 
     if(vtmp == NULL)
         {
-        exprFreeMem(tmp);
+        exprFreeFrom(alloc, tmp);
         return NULL;
         }
 
@@ -324,6 +450,18 @@ exprFunc *exprCreateFunc(char *name, exprFuncType ptr, int type, int min, int ma
     tmp->refmin = refmin;
     tmp->refmax = refmax;
     tmp->type = type;
+    tmp->hash = exprHashName(name, (int)strlen(name));
+
+    if(info)
+        {
+        tmp->flags = info->flags;
+        tmp->cost = info->cost;
+        }
+    else
+        {
+        tmp->flags = EXPR_FUNC_UNKNOWN;
+        tmp->cost = EXPR_FUNC_COST;
+        }
 
     return tmp;
     }
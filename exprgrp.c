@@ -0,0 +1,990 @@
+/*
+  File: exprgrp.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Groups of expressions evaluated when what they read changes
+
+  This file is part of ExprEval.
+*/
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+
+/* Internal functions */
+static int exprGroupBuild(exprGroup *group);
+static int exprGroupScan(exprGroup *group, int item, exprNode *node, int cond, int writes);
+static int exprGroupUse(exprGroup *group, int item, EXPRTYPE *addr, int write, int cond, int writes);
+static int exprGroupFindVar(exprGroup *group, EXPRTYPE *addr);
+static int exprGroupReserve(exprGroup *group, int count);
+static int exprGroupSort(exprGroup *group);
+static void exprGroupChanged(exprGroup *group, int var, int rank, int parallel);
+static int exprGroupEvalItem(exprGroup *group, int index, int parallel);
+static int exprGroupLink(exprGroup *group);
+static int exprGroupTask(void *data, int task, int worker);
+
+
+/* Create an empty group */
+int exprGroupCreate(exprGroup **group)
+{
+  exprGroup *tmp;
+
+  if(group == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *group = NULL;
+
+  tmp = exprAllocMem(sizeof(exprGroup));
+  if(tmp == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  *group = tmp;
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Free a group.  The expressions are not freed. */
+int exprGroupFree(exprGroup *group)
+{
+  if(group == NULL)
+    return EXPR_ERROR_NOERROR;
+
+  exprFreeMem(group->items);
+  exprFreeMem(group->vars);
+  exprFreeMem(group->table);
+  exprFreeMem(group->pool);
+  exprFreeMem(group->order);
+  exprFreeMem(group->waits);
+  exprFreeMem(group->nextstart);
+  exprFreeMem(group->next);
+  exprFreeMem(group);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Add a parsed expression to a group.  Its index is the number of
+   expressions added before it.  It must stay parsed the same way
+   while in the group, see exprGroupUpdate. */
+int exprGroupAdd(exprGroup *group, exprObj *obj)
+{
+  exprGroupItem *items;
+  int size;
+
+  if(group == NULL || obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  /* Must have parsed successfully */
+  if(obj->parsedbad || !obj->parsedgood || obj->headnode == NULL)
+    return EXPR_ERROR_BADEXPR;
+
+  if(group->itemcount == group->itemsize)
+    {
+      size = group->itemsize ? group->itemsize * 2 : EXPR_HASH_INITSIZE;
+
+      items = exprReallocMem(group->items, size * sizeof(exprGroupItem));
+      if(items == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      group->items = items;
+      group->itemsize = size;
+    }
+
+  memset(&(group->items[group->itemcount]), 0, sizeof(exprGroupItem));
+  group->items[group->itemcount].obj = obj;
+  group->items[group->itemcount].dirty = 1;
+  group->itemcount++;
+
+  group->stale = 1;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Find what the expressions read and assign again at the next
+   exprGroupEval, after some were parsed again or optimized.  All
+   of them are evaluated then. */
+int exprGroupUpdate(exprGroup *group)
+{
+  if(group == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  group->stale = 1;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Evaluate the expressions of the group that read a variable or
+   constant whose value changed since they were last evaluated, or
+   that were never evaluated.  Changes are found by comparing the
+   values, so they may be made with exprValListSet or through the
+   addresses.  Expressions that assign variables are evaluated
+   before those reading them, otherwise in the order added.  One
+   assigning a variable that another before it changed is evaluated
+   again, so the last one sets it as when all are evaluated.
+   Expressions calling functions that are not pure and
+   deterministic are always evaluated.  count gets the number
+   evaluated and may be NULL.  All are evaluated even if some fail,
+   the first error is returned and those failing are evaluated
+   again next time. */
+int exprGroupEval(exprGroup *group, int *count)
+{
+  exprGroupItem *item;
+  int pos, var;
+  int evaluated;
+  int err;
+
+  if(count)
+    *count = 0;
+
+  if(group == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(group->stale)
+    {
+      err = exprGroupBuild(group);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+    }
+
+  /* Changes made since the last time */
+  for(var = 0; var < group->varcount; var++)
+    exprGroupChanged(group, var, -1, 0);
+
+  err = EXPR_ERROR_NOERROR;
+  evaluated = 0;
+
+  for(pos = 0; pos < group->itemcount; pos++)
+    {
+      item = &(group->items[group->order[pos]]);
+
+      if(!exprGroupEvalItem(group, group->order[pos], 0))
+        continue;
+
+      evaluated++;
+
+      if(item->err != EXPR_ERROR_NOERROR && err == EXPR_ERROR_NOERROR)
+        err = item->err;
+    }
+
+  if(count)
+    *count = evaluated;
+
+  return err;
+}
+
+/* Evaluate the expressions of the group like exprGroupEval, with
+   the threads of a pool.  Those that do not depend on each other
+   are evaluated at the same time.  One reading a variable that
+   another assigns waits for it, as does one assigning a variable
+   others read or assign earlier in the order of exprGroupEval, so
+   the results are the same.  Expressions calling functions that
+   are not pure run alone.  Pure custom functions must be safe to
+   call from several threads at once.  Each expression must be in
+   the group only once. */
+int exprGroupEvalParallel(exprGroup *group, exprPool *pool, int *count)
+{
+  exprGroupItem *item;
+  exprGroupVar *v;
+  int pos, var;
+  int evaluated;
+  int err;
+
+  if(count)
+    *count = 0;
+
+  if(group == NULL || pool == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(group->stale)
+    {
+      err = exprGroupBuild(group);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+    }
+
+  if(group->waits == NULL)
+    {
+      err = exprGroupLink(group);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+    }
+
+  /* Changes made since the last time */
+  for(var = 0; var < group->varcount; var++)
+    exprGroupChanged(group, var, -1, 0);
+
+  group->tick++;
+
+  err = exprPoolRun(pool, group->itemcount, group->waits, group->nextstart, group->next, exprGroupTask,
+      group);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  /* Readers before the change, or the item making it, see it next
+     time as with exprGroupEval */
+  for(var = 0; var < group->varcount; var++)
+    {
+      v = &(group->vars[var]);
+
+      if(v->changed != group->tick)
+        continue;
+
+      for(pos = 0; pos < v->readercount; pos++)
+        {
+          item = &(group->items[group->pool[v->readers + pos]]);
+
+          if(item->rank <= v->changer)
+            item->dirty = 1;
+        }
+    }
+
+  /* The first error in the order, as in exprGroupEval */
+  evaluated = 0;
+
+  for(pos = 0; pos < group->itemcount; pos++)
+    {
+      item = &(group->items[group->order[pos]]);
+
+      if(!item->ran)
+        continue;
+
+      evaluated++;
+
+      if(item->err != EXPR_ERROR_NOERROR && err == EXPR_ERROR_NOERROR)
+        err = item->err;
+    }
+
+  if(count)
+    *count = evaluated;
+
+  return err;
+}
+
+/* Get the result of the last evaluation of an expression in the
+   group.  Its error is returned. */
+int exprGroupGetResult(exprGroup *group, int index, EXPRTYPE *val)
+{
+  if(group == NULL || val == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(index < 0 || index >= group->itemcount)
+    return EXPR_ERROR_NOTFOUND;
+
+  *val = group->items[index].result;
+
+  return group->items[index].err;
+}
+
+
+/* Find the variables each expression reads and assigns, who reads
+   and assigns each variable, and the order to evaluate the
+   expressions in */
+static int exprGroupBuild(exprGroup *group)
+{
+  exprGroupItem *item;
+  exprGroupVar *v;
+  int pos, var, index, total;
+  int err;
+
+  group->varcount = 0;
+  group->poolcount = 0;
+
+  exprFreeMem(group->waits);
+  exprFreeMem(group->nextstart);
+  exprFreeMem(group->next);
+  group->waits = NULL;
+  group->nextstart = NULL;
+  group->next = NULL;
+
+  for(pos = 0; pos < group->tablesize; pos++)
+    group->table[pos] = -1;
+
+  /* What was read before may have changed without being seen */
+  for(index = 0; index < group->itemcount; index++)
+    {
+      item = &(group->items[index]);
+      item->dirty = 1;
+      item->always = 0;
+      item->anywrite = 0;
+
+      item->reads = group->poolcount;
+      err = exprGroupScan(group, index, item->obj->headnode, 0, 0);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+
+      item->readcount = group->poolcount - item->reads;
+
+      item->writes = group->poolcount;
+      err = exprGroupScan(group, index, item->obj->headnode, 0, 1);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+
+      item->writecount = group->poolcount - item->writes;
+    }
+
+  /* Count the readers and writers of each variable and make room
+     for them */
+  for(var = 0; var < group->varcount; var++)
+    {
+      group->vars[var].readercount = 0;
+      group->vars[var].writercount = 0;
+    }
+
+  total = 0;
+
+  for(index = 0; index < group->itemcount; index++)
+    {
+      item = &(group->items[index]);
+
+      for(pos = 0; pos < item->readcount; pos++)
+        group->vars[group->pool[item->reads + pos]].readercount++;
+
+      for(pos = 0; pos < item->writecount; pos++)
+        group->vars[group->pool[item->writes + pos]].writercount++;
+
+      total += item->readcount + item->writecount;
+    }
+
+  err = exprGroupReserve(group, total);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  for(var = 0; var < group->varcount; var++)
+    {
+      v = &(group->vars[var]);
+      v->readers = group->poolcount;
+      group->poolcount += v->readercount;
+      v->readercount = 0;
+
+      v->writers = group->poolcount;
+      group->poolcount += v->writercount;
+      v->writercount = 0;
+    }
+
+  /* Writers are listed in the order added */
+  for(index = 0; index < group->itemcount; index++)
+    {
+      item = &(group->items[index]);
+
+      for(pos = 0; pos < item->readcount; pos++)
+        {
+          v = &(group->vars[group->pool[item->reads + pos]]);
+          group->pool[v->readers + v->readercount++] = index;
+        }
+
+      for(pos = 0; pos < item->writecount; pos++)
+        {
+          v = &(group->vars[group->pool[item->writes + pos]]);
+          group->pool[v->writers + v->writercount++] = index;
+        }
+    }
+
+  err = exprGroupSort(group);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  for(var = 0; var < group->varcount; var++)
+    group->vars[var].last = *(group->vars[var].addr);
+
+  group->stale = 0;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Add the variables a node reads before assigning them (writes is
+   0), or those it assigns (writes is 1), to the pool.  cond is
+   non-zero if the node may not be evaluated. */
+static int exprGroupScan(exprGroup *group, int item, exprNode *node, int cond, int writes)
+{
+  exprGroupItem *cur;
+  exprNode *nodes;
+  int count, pos, flags;
+  int argcond;
+  int err;
+
+  switch(node->type)
+    {
+      case EXPR_NODETYPE_VALUE:
+        return EXPR_ERROR_NOERROR;
+
+      case EXPR_NODETYPE_VARIABLE:
+        return exprGroupUse(group, item, node->data.variable.vaddr, 0, cond, writes);
+
+      case EXPR_NODETYPE_ASSIGN:
+        err = exprGroupScan(group, item, node->data.assign.node, cond, writes);
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
+
+        return exprGroupUse(group, item, node->data.assign.vaddr, 1, cond, writes);
+
+      case EXPR_NODETYPE_FUNCTION:
+        nodes = node->data.function.nodes;
+        count = node->data.function.nodecount;
+        flags = node->data.function.flags;
+
+        for(pos = 0; pos < count; pos++)
+          {
+            /* Only the first argument of the built in ones is always
+               evaluated, custom ones may evaluate none */
+            argcond = (flags & EXPR_FUNC_EVALNODES) && (node->data.function.fptr != NULL || pos > 0);
+
+            err = exprGroupScan(group, item, &(nodes[pos]), cond || argcond, writes);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+          }
+
+        for(pos = 0; pos < node->data.function.refcount; pos++)
+          {
+            if(flags & EXPR_FUNC_READREFS)
+              {
+                err = exprGroupUse(group, item, node->data.function.refs[pos], 0, cond, writes);
+                if(err != EXPR_ERROR_NOERROR)
+                  return err;
+              }
+
+            if(flags & EXPR_FUNC_WRITEREFS)
+              {
+                err = exprGroupUse(group, item, node->data.function.refs[pos], 1, cond, writes);
+                if(err != EXPR_ERROR_NOERROR)
+                  return err;
+              }
+          }
+
+        cur = &(group->items[item]);
+
+        if(!(flags & EXPR_FUNC_PURE))
+          {
+            cur->always = 1;
+            cur->anywrite = 1;
+          }
+
+        if(!(flags & EXPR_FUNC_DETERMINISTIC))
+          cur->always = 1;
+
+        return EXPR_ERROR_NOERROR;
+
+      default:
+        for(pos = 0; pos < node->data.oper.nodecount; pos++)
+          {
+            err = exprGroupScan(group, item, &(node->data.oper.nodes[pos]), cond, writes);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+          }
+
+        return EXPR_ERROR_NOERROR;
+    }
+}
+
+/* Note a read or an assignment of a variable by an item.  A read
+   after the item surely assigned the variable does not count. */
+static int exprGroupUse(exprGroup *group, int item, EXPRTYPE *addr, int write, int cond, int writes)
+{
+  exprGroupVar *v;
+  int var, mark;
+
+  var = exprGroupFindVar(group, addr);
+  if(var < 0)
+    return EXPR_ERROR_MEMORY;
+
+  v = &(group->vars[var]);
+  mark = item + 1;
+
+  if(write)
+    {
+      if(!cond)
+        v->setmark = mark;
+
+      if(!writes || v->writemark == mark)
+        return EXPR_ERROR_NOERROR;
+
+      v->writemark = mark;
+    }
+  else
+    {
+      if(writes || v->setmark == mark || v->readmark == mark)
+        return EXPR_ERROR_NOERROR;
+
+      v->readmark = mark;
+    }
+
+  if(exprGroupReserve(group, 1) != EXPR_ERROR_NOERROR)
+    return EXPR_ERROR_MEMORY;
+
+  group->pool[group->poolcount++] = var;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Get the index of a variable, adding it if needed.  -1 if out of
+   memory. */
+static int exprGroupFindVar(exprGroup *group, EXPRTYPE *addr)
+{
+  exprGroupVar *vars;
+  int *table;
+  int size, pos, mask, var;
+
+  if(group->tablesize)
+    {
+      mask = group->tablesize - 1;
+
+      /* Probe until the variable or an empty entry */
+      for(pos = (int)(((size_t)addr / sizeof(EXPRTYPE)) & mask); group->table[pos] != -1; pos = (pos + 1) & mask)
+        {
+          if(group->vars[group->table[pos]].addr == addr)
+            return group->table[pos];
+        }
+    }
+
+  if(group->varcount == group->varsize)
+    {
+      size = group->varsize ? group->varsize * 2 : EXPR_HASH_INITSIZE;
+
+      vars = exprReallocMem(group->vars, size * sizeof(exprGroupVar));
+      if(vars == NULL)
+        return -1;
+
+      group->vars = vars;
+      group->varsize = size;
+    }
+
+  /* Grow the table when three quarters full */
+  if((group->varcount + 1) * 4 > group->tablesize * 3)
+    {
+      size = group->tablesize ? group->tablesize * 2 : EXPR_HASH_INITSIZE;
+
+      table = exprAllocMem(size * sizeof(int));
+      if(table == NULL)
+        return -1;
+
+      mask = size - 1;
+
+      for(pos = 0; pos < size; pos++)
+        table[pos] = -1;
+
+      for(var = 0; var < group->varcount; var++)
+        {
+          for(pos = (int)(((size_t)group->vars[var].addr / sizeof(EXPRTYPE)) & mask); table[pos] != -1;
+              pos = (pos + 1) & mask)
+            ;
+
+          table[pos] = var;
+        }
+
+      exprFreeMem(group->table);
+      group->table = table;
+      group->tablesize = size;
+    }
+
+  mask = group->tablesize - 1;
+
+  for(pos = (int)(((size_t)addr / sizeof(EXPRTYPE)) & mask); group->table[pos] != -1; pos = (pos + 1) & mask)
+    ;
+
+  var = group->varcount++;
+  group->table[pos] = var;
+
+  memset(&(group->vars[var]), 0, sizeof(exprGroupVar));
+  group->vars[var].addr = addr;
+
+  return var;
+}
+
+/* Make room for count more indexes in the pool */
+static int exprGroupReserve(exprGroup *group, int count)
+{
+  int *pool;
+  int size;
+
+  if(group->poolcount + count <= group->poolsize)
+    return EXPR_ERROR_NOERROR;
+
+  size = group->poolsize ? group->poolsize : EXPR_HASH_INITSIZE;
+  while(size < group->poolcount + count)
+    size *= 2;
+
+  pool = exprReallocMem(group->pool, size * sizeof(int));
+  if(pool == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  group->pool = pool;
+  group->poolsize = size;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Order the items so those assigning a variable come before those
+   reading it, and after those added before them assigning it.
+   Items in a cycle, and those after them, are left in the order
+   they were added. */
+static int exprGroupSort(exprGroup *group)
+{
+  exprGroupItem *item;
+  exprGroupVar *v;
+  int *order, *wait;
+  int head, tail;
+  int index, pos, reader, writer;
+
+  order = exprAllocMem(group->itemcount * sizeof(int) + 1);
+  wait = exprAllocMem(group->itemcount * sizeof(int) + 1);
+
+  if(order == NULL || wait == NULL)
+    {
+      exprFreeMem(order);
+      exprFreeMem(wait);
+      return EXPR_ERROR_MEMORY;
+    }
+
+  /* Number of assignments each item waits for, with the one before
+     it of each variable it assigns */
+  for(index = 0; index < group->itemcount; index++)
+    {
+      item = &(group->items[index]);
+
+      for(pos = 0; pos < item->writecount; pos++)
+        {
+          v = &(group->vars[group->pool[item->writes + pos]]);
+
+          for(reader = 0; reader < v->readercount; reader++)
+            {
+              if(group->pool[v->readers + reader] != index)
+                wait[group->pool[v->readers + reader]]++;
+            }
+
+          if(group->pool[v->writers] != index)
+            wait[index]++;
+        }
+    }
+
+  tail = 0;
+
+  for(index = 0; index < group->itemcount; index++)
+    {
+      if(wait[index] == 0)
+        order[tail++] = index;
+    }
+
+  for(head = 0; head < tail; head++)
+    {
+      index = order[head];
+      item = &(group->items[index]);
+
+      for(pos = 0; pos < item->writecount; pos++)
+        {
+          v = &(group->vars[group->pool[item->writes + pos]]);
+
+          for(reader = 0; reader < v->readercount; reader++)
+            {
+              if(group->pool[v->readers + reader] != index &&
+                --wait[group->pool[v->readers + reader]] == 0)
+                {
+                  order[tail++] = group->pool[v->readers + reader];
+                }
+            }
+
+          /* The next one assigning it */
+          for(writer = 0; group->pool[v->writers + writer] != index; writer++)
+            ;
+
+          if(++writer < v->writercount && --wait[group->pool[v->writers + writer]] == 0)
+            order[tail++] = group->pool[v->writers + writer];
+        }
+    }
+
+  for(index = 0; tail < group->itemcount; index++)
+    {
+      if(wait[index] > 0)
+        order[tail++] = index;
+    }
+
+  for(pos = 0; pos < group->itemcount; pos++)
+    group->items[order[pos]].rank = pos;
+
+  exprFreeMem(wait);
+  exprFreeMem(group->order);
+  group->order = order;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Note a change of a variable's value by the item of a rank, -1 if
+   made outside the group.  Its readers are marked, and those
+   assigning it after the change so the last one still sets it.
+   In parallel, items only mark themselves, so readers and writers
+   after the change look for it when they run. */
+static void exprGroupChanged(exprGroup *group, int var, int rank, int parallel)
+{
+  exprGroupVar *v;
+  exprGroupItem *item;
+  int pos;
+
+  v = &(group->vars[var]);
+
+  if(memcmp(v->addr, &(v->last), sizeof(EXPRTYPE)) == 0)
+    return;
+
+  v->last = *(v->addr);
+
+  if(parallel)
+    {
+      v->changed = group->tick;
+      v->changer = rank;
+      return;
+    }
+
+  for(pos = 0; pos < v->readercount; pos++)
+    group->items[group->pool[v->readers + pos]].dirty = 1;
+
+  for(pos = 0; pos < v->writercount; pos++)
+    {
+      item = &(group->items[group->pool[v->writers + pos]]);
+
+      if(item->rank > rank)
+        item->dirty = 1;
+    }
+}
+
+/* Evaluate an item if what it reads changed and note changes of
+   what it assigned.  parallel is non-zero when run by a pool.
+   Returns non-zero if it was evaluated. */
+static int exprGroupEvalItem(exprGroup *group, int index, int parallel)
+{
+  exprGroupItem *item;
+  exprGroupVar *v;
+  int pos, var;
+
+  item = &(group->items[index]);
+
+  /* Changes made by items before it in this run, of what it reads
+     or assigns */
+  if(parallel && !item->dirty)
+    {
+      for(pos = 0; pos < item->readcount + item->writecount; pos++)
+        {
+          if(pos < item->readcount)
+            v = &(group->vars[group->pool[item->reads + pos]]);
+          else
+            v = &(group->vars[group->pool[item->writes + pos - item->readcount]]);
+
+          if(v->changed == group->tick && v->changer < item->rank)
+            {
+              item->dirty = 1;
+              break;
+            }
+        }
+    }
+
+  if(!item->dirty && !item->always)
+    return 0;
+
+  item->dirty = 0;
+  item->err = exprEval(item->obj, &(item->result));
+
+  if(item->err != EXPR_ERROR_NOERROR)
+    item->dirty = 1;
+
+  /* Readers and later writers of what it assigned, even if it
+     failed after */
+  if(item->anywrite)
+    {
+      for(var = 0; var < group->varcount; var++)
+        exprGroupChanged(group, var, item->rank, parallel);
+    }
+  else
+    {
+      for(var = 0; var < item->writecount; var++)
+        exprGroupChanged(group, group->pool[item->writes + var], item->rank, parallel);
+    }
+
+  return 1;
+}
+
+/* Find the items each item waits for when run in parallel.  Going
+   through the order of exprGroupEval, a reader waits for the last
+   item assigning the variable before it, and an item assigning a
+   variable waits for the last one assigning it and those reading
+   it since.  An item that may change any variable waits for all
+   before it, and all after it wait for it. */
+static int exprGroupLink(exprGroup *group)
+{
+  exprGroupItem *item;
+  int *lastwriter, *readhead, *stamp;
+  int *readitem, *readnext;
+  int *from, *to;
+  int *since;
+  int *waits, *nextstart, *next;
+  int index, pos, var, read, epoch;
+  int barrier, sincecount;
+  int total, edges, nodes;
+
+  total = 0;
+  for(index = 0; index < group->itemcount; index++)
+    total += group->items[index].readcount;
+
+  /* Each read makes at most two links, each assignment one, and
+     each item two around items that may change any variable */
+  edges = 2 * total + 2 * group->itemcount;
+  for(index = 0; index < group->itemcount; index++)
+    edges += group->items[index].writecount;
+
+  lastwriter = exprAllocMem(3 * group->varcount * sizeof(int) + 1);
+  readitem = exprAllocMem(2 * total * sizeof(int) + 1);
+  from = exprAllocMem(2 * edges * sizeof(int) + 1);
+  since = exprAllocMem(group->itemcount * sizeof(int) + 1);
+  waits = exprAllocMem(group->itemcount * sizeof(int) + 1);
+  nextstart = exprAllocMem((group->itemcount + 1) * sizeof(int));
+  next = exprAllocMem(edges * sizeof(int) + 1);
+
+  if(lastwriter == NULL || readitem == NULL || from == NULL || since == NULL || waits == NULL ||
+    nextstart == NULL || next == NULL)
+    {
+      exprFreeMem(lastwriter);
+      exprFreeMem(readitem);
+      exprFreeMem(from);
+      exprFreeMem(since);
+      exprFreeMem(waits);
+      exprFreeMem(nextstart);
+      exprFreeMem(next);
+      return EXPR_ERROR_MEMORY;
+    }
+
+  readhead = lastwriter + group->varcount;
+  stamp = readhead + group->varcount;
+  readnext = readitem + total;
+  to = from + edges;
+
+  /* Variables whose stamp is not the epoch have nothing since the
+     last item that may change any variable */
+  epoch = 1;
+  barrier = -1;
+  sincecount = 0;
+  nodes = 0;
+  edges = 0;
+
+  for(pos = 0; pos < group->itemcount; pos++)
+    {
+      index = group->order[pos];
+      item = &(group->items[index]);
+
+      if(item->anywrite)
+        {
+          if(sincecount == 0 && barrier >= 0)
+            {
+              from[edges] = barrier;
+              to[edges++] = index;
+            }
+
+          for(read = 0; read < sincecount; read++)
+            {
+              from[edges] = since[read];
+              to[edges++] = index;
+            }
+
+          barrier = index;
+          sincecount = 0;
+          epoch++;
+          continue;
+        }
+
+      if(barrier >= 0)
+        {
+          from[edges] = barrier;
+          to[edges++] = index;
+        }
+
+      for(read = 0; read < item->readcount; read++)
+        {
+          var = group->pool[item->reads + read];
+
+          if(stamp[var] != epoch)
+            {
+              stamp[var] = epoch;
+              lastwriter[var] = -1;
+              readhead[var] = -1;
+            }
+
+          if(lastwriter[var] >= 0)
+            {
+              from[edges] = lastwriter[var];
+              to[edges++] = index;
+            }
+
+          readitem[nodes] = index;
+          readnext[nodes] = readhead[var];
+          readhead[var] = nodes++;
+        }
+
+      for(read = 0; read < item->writecount; read++)
+        {
+          var = group->pool[item->writes + read];
+
+          if(stamp[var] != epoch)
+            {
+              stamp[var] = epoch;
+              lastwriter[var] = -1;
+              readhead[var] = -1;
+            }
+
+          if(lastwriter[var] >= 0 && lastwriter[var] != index)
+            {
+              from[edges] = lastwriter[var];
+              to[edges++] = index;
+            }
+
+          for(; readhead[var] >= 0; readhead[var] = readnext[readhead[var]])
+            {
+              if(readitem[readhead[var]] != index)
+                {
+                  from[edges] = readitem[readhead[var]];
+                  to[edges++] = index;
+                }
+            }
+
+          lastwriter[var] = index;
+        }
+
+      since[sincecount++] = index;
+    }
+
+  /* Lists of the items waiting for each */
+  for(read = 0; read < edges; read++)
+    {
+      nextstart[from[read] + 1]++;
+      waits[to[read]]++;
+    }
+
+  for(index = 0; index < group->itemcount; index++)
+    nextstart[index + 1] += nextstart[index];
+
+  for(read = 0; read < edges; read++)
+    next[nextstart[from[read]]++] = to[read];
+
+  for(index = group->itemcount; index > 0; index--)
+    nextstart[index] = nextstart[index - 1];
+
+  nextstart[0] = 0;
+
+  exprFreeMem(lastwriter);
+  exprFreeMem(readitem);
+  exprFreeMem(from);
+  exprFreeMem(since);
+
+  group->waits = waits;
+  group->nextstart = nextstart;
+  group->next = next;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Pool task evaluating an item */
+static int exprGroupTask(void *data, int task, int worker)
+{
+  exprGroup *group;
+
+  (void)worker;
+
+  group = (exprGroup*)data;
+  group->items[task].ran = exprGroupEvalItem(group, task, 1);
+
+  return EXPR_ERROR_NOERROR;
+}
@@ -625,7 +625,7 @@
         EXPR_CHECK_ERR();
 
         if(tmp < 0.0)
-          *val = tmp = (2.0 * M_PI);
+          *val = tmp + (2.0 * M_PI);
         else
           *val = tmp;
       }
@@ -828,7 +828,7 @@
       err = exprEvalNode(obj, nodes->data.function.nodes, 1, &d1);
 
     if(!err)
-      err = exprEvalNode(obj, nodes->data.function.nodes, 1, &d2);
+      err = exprEvalNode(obj, nodes->data.function.nodes, 2, &d2);
 
     if(!err)
       {
@@ -1037,6 +1037,11 @@
             err = exprEvalNode(obj, nodes->data.function.nodes, 1, &test);
             if(err)
               return err;
+
+            /* Check for a break once per pass */
+            err = exprCheckBreak(obj, nodes->data.function.nodecount);
+            if(err)
+              return err;
           }
       }
     else
@@ -1057,3 +1062,9 @@
 
     break;
   }
+
+/* custom function taking values */
+  case EXPR_NODEFUNC_EAGER:
+  {
+    return exprEvalEager(obj, nodes, val);
+  }
@@ -32,6 +32,9 @@
 /* Math routines */
 #include <math.h>
 
+/* Floating point limits */
+#include <float.h>
+
 /* Time */
 #include <time.h>
 
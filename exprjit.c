@@ -0,0 +1,950 @@
+/*
+  File: exprjit.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Translate compiled programs to x86-64 machine code
+
+  This file is part of ExprEval.
+
+  The code keeps the evaluation stack of the program in its own
+  stack frame.  The depth of the stack before each instruction is
+  known when translating, so each item has a fixed place and
+  nothing moves a stack pointer at run time.  Variable addresses
+  and numbers are part of the code.  The math routines are called
+  directly.  Instructions that are seldom used are handed to the
+  virtual machine one at a time so their results stay the same.
+*/
+
+/* Anonymous memory from mmap is not part of strict C */
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+#include <errno.h>
+
+#if(EXPR_JIT) && defined(__x86_64__) && defined(__linux__)
+#define EXPR_JIT_X86_64
+#include <sys/mman.h>
+#endif
+
+
+#ifdef EXPR_JIT_X86_64
+
+/* Places a jump can go besides an instruction */
+#define EXPR_JIT_EXIT -1 /* Return with the error in eax */
+#define EXPR_JIT_RANGE -2 /* Return EXPR_ERROR_OUTOFRANGE */
+#define EXPR_JIT_ZERO -3 /* Return EXPR_ERROR_DIVBYZERO */
+
+/* Largest stack the code may keep in its frame */
+#define EXPR_JIT_MAXDEPTH 8192
+
+/* Condition codes for exprJitJump and exprJitShort */
+#define EXPR_JIT_JMP -1
+#define EXPR_JIT_JB 0x2
+#define EXPR_JIT_JAE 0x3
+#define EXPR_JIT_JE 0x4
+#define EXPR_JIT_JNE 0x5
+#define EXPR_JIT_JP 0xA
+
+/* Emit a string of bytes */
+#define EXPR_JIT_CODE(buf, s) exprJitCode(buf, s, sizeof(s) - 1)
+
+/* Emit an instruction using a stack item, [rbx + slot * 8] */
+#define EXPR_JIT_MEM(buf, s, reg, slot) exprJitMem(buf, s, sizeof(s) - 1, reg, slot)
+
+/* Instructions using a stack item */
+#define EXPR_JIT_MOVSD_LOAD "\xF2\x0F\x10"
+#define EXPR_JIT_MOVSD_STORE "\xF2\x0F\x11"
+#define EXPR_JIT_ADDSD "\xF2\x0F\x58"
+#define EXPR_JIT_SUBSD "\xF2\x0F\x5C"
+#define EXPR_JIT_MULSD "\xF2\x0F\x59"
+#define EXPR_JIT_CMPSD "\xF2\x0F\xC2"
+#define EXPR_JIT_MOV_LOAD "\x48\x8B"
+#define EXPR_JIT_MOV_STORE "\x48\x89"
+#define EXPR_JIT_LEA "\x48\x8D"
+
+/* Predicates for cmpsd */
+#define EXPR_JIT_CMPEQ 0
+#define EXPR_JIT_CMPLT 1
+
+/* Address of a routine the code calls */
+typedef void (*exprJitAddr)(void);
+
+/* Jump to patch once the code is laid out */
+typedef struct _exprJitFixup
+{
+  size_t pos; /* Position of the 32 bit offset */
+  int target; /* Instruction or EXPR_JIT_EXIT, _RANGE or _ZERO */
+} exprJitFixup;
+
+/* Code being generated */
+typedef struct _exprJitBuf
+{
+  unsigned char *code; /* Generated code */
+  size_t count; /* Bytes used */
+  size_t size; /* Bytes allocated */
+  int err; /* Set when an allocation fails */
+  exprJitFixup *fixups; /* Jumps to patch */
+  int fixcount; /* Number of jumps to patch */
+} exprJitBuf;
+
+/* Internal functions */
+static int exprJitGenerate(exprAllocator *alloc, exprProgram *prog, exprJit **jit);
+static int exprJitDepth(exprProgram *prog, int *depth, int *maxdepth);
+static int exprJitStack(exprInstr *ip);
+static int exprJitSlow(int op);
+static exprJitAddr exprJitMath(int op);
+static void exprJitByte(exprJitBuf *buf, int byte);
+static void exprJitCode(exprJitBuf *buf, const char *bytes, int len);
+static void exprJitInt(exprJitBuf *buf, long value);
+static void exprJitPtr(exprJitBuf *buf, const void *ptr);
+static void exprJitMem(exprJitBuf *buf, const char *op, int len, int reg, int slot);
+static void exprJitCall(exprJitBuf *buf, exprJitAddr func);
+static void exprJitConst(exprJitBuf *buf, int reg, EXPRTYPE value);
+static void exprJitJump(exprJitBuf *buf, int cc, int target);
+static size_t exprJitShort(exprJitBuf *buf, int cc);
+static void exprJitHere(exprJitBuf *buf, size_t pos);
+
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+static int *exprJitErrno(void);
+#endif
+
+#endif /* EXPR_JIT_X86_64 */
+
+
+/* Translate the compiled program of an expression to machine code.
+   The expression is compiled first if needed.  exprEvalCompiled
+   then runs the machine code, which gives the same results and
+   errors as the program.  Programs that call custom functions
+   taking nodes are not translated and EXPR_ERROR_NONATIVE is
+   returned, the expression still evaluates like before. */
+int exprJitCompile(exprObj *obj)
+{
+  int err;
+
+  if(obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  /* Must have parsed successfully */
+  if(obj->parsedbad || !obj->parsedgood || obj->headnode == NULL)
+    return EXPR_ERROR_BADEXPR;
+
+  if(obj->program == NULL)
+    {
+      err = exprCompile(obj);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+    }
+
+  /* Replace any older code */
+  exprFreeJit(&(obj->alloc), obj->jit);
+  obj->jit = NULL;
+
+#ifdef EXPR_JIT_X86_64
+  return exprJitGenerate(&(obj->alloc), obj->program, &(obj->jit));
+#else
+  return EXPR_ERROR_NONATIVE;
+#endif
+}
+
+/* Get the machine code of an expression, NULL if there is none.
+   It must be called with the expression it belongs to. */
+exprJitFunc exprGetJitFunc(exprObj *obj)
+{
+  return (obj == NULL || obj->jit == NULL) ? NULL : obj->jit->func;
+}
+
+/* Free machine code */
+void exprFreeJit(exprAllocator *alloc, exprJit *jit)
+{
+  if(jit == NULL)
+    return;
+
+#ifdef EXPR_JIT_X86_64
+  munmap(jit->code, jit->size);
+#endif
+
+  /* The programs are in the same allocation */
+  exprFreeFrom(alloc, jit);
+}
+
+
+#ifdef EXPR_JIT_X86_64
+
+/* Generate the code for a program.  The code is called as
+   func(obj, val) and keeps obj in r13, val in r14, errno's address
+   in r12 and the stack in its frame at rbx.  The header and its
+   programs come from alloc. */
+static int exprJitGenerate(exprAllocator *alloc, exprProgram *prog, exprJit **jit)
+{
+  exprJitBuf buf;
+  exprJit *tmp;
+  exprInstr *ip;
+  exprProgram *call;
+  size_t *labels;
+  size_t pos, skip, done;
+  int *depth;
+  int maxdepth, frame;
+  int calls, index;
+  int d, t, slot, arg;
+  int err;
+  char *mem;
+  void *code;
+
+  /* Custom functions evaluate the nodes */
+  calls = 0;
+
+  for(index = 0; index < prog->count; index++)
+    {
+      if(prog->code[index].op == EXPR_OP_CALL)
+        return EXPR_ERROR_NONATIVE;
+
+      if(exprJitSlow(prog->code[index].op))
+        calls++;
+    }
+
+  depth = exprAllocMem(prog->count * sizeof(int));
+  labels = exprAllocMem(prog->count * sizeof(size_t));
+
+  memset(&buf, 0, sizeof(exprJitBuf));
+  buf.fixups = exprAllocMem((prog->count * 4 + 4) * sizeof(exprJitFixup));
+
+  /* Programs for the virtual machine follow the header */
+  mem = exprAllocFrom(alloc, sizeof(exprJit) + calls * (sizeof(exprProgram) + 2 * sizeof(exprInstr)));
+  tmp = (exprJit*)mem;
+
+  if(depth == NULL || labels == NULL || buf.fixups == NULL || mem == NULL)
+    {
+      err = EXPR_ERROR_MEMORY;
+      goto cleanup;
+    }
+
+  mem += sizeof(exprJit);
+  tmp->calls = (exprProgram*)mem;
+  mem += calls * sizeof(exprProgram);
+
+  err = exprJitDepth(prog, depth, &maxdepth);
+  if(err != EXPR_ERROR_NOERROR)
+    goto cleanup;
+
+  /* The frame keeps rsp 16 byte aligned for calls after the four
+     registers are saved */
+  frame = ((maxdepth * 8 + 15) & ~15) + 8;
+
+  /* push rbx, r12, r13, r14; sub rsp, frame; mov rbx, rsp */
+  EXPR_JIT_CODE(&buf, "\x53\x41\x54\x41\x55\x41\x56\x48\x81\xEC");
+  exprJitInt(&buf, frame);
+  EXPR_JIT_CODE(&buf, "\x48\x89\xE3");
+
+  /* mov r13, rdi; mov r14, rsi */
+  EXPR_JIT_CODE(&buf, "\x49\x89\xFD\x49\x89\xF6");
+
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+  /* errno belongs to the thread, find it once; mov r12, rax */
+  exprJitCall(&buf, (exprJitAddr)exprJitErrno);
+  EXPR_JIT_CODE(&buf, "\x49\x89\xC4");
+#endif
+
+  call = tmp->calls;
+
+  for(index = 0; index < prog->count; index++)
+    {
+      labels[index] = buf.count;
+
+      /* Nothing reaches this instruction */
+      if(depth[index] < 0)
+        continue;
+
+      ip = &(prog->code[index]);
+      d = depth[index];
+      t = d - 1;
+
+      /* Hand seldom used instructions to the virtual machine with
+         the stack set up so it works on our items in place */
+      if(exprJitSlow(ip->op))
+        {
+          call->code = (exprInstr*)mem;
+          mem += 2 * sizeof(exprInstr);
+          call->code[0] = *ip;
+          call->code[1].op = EXPR_OP_END;
+          call->count = 2;
+          call->vars = prog->vars;
+          call->varcount = prog->varcount;
+          call->stack = NULL;
+          call->depth = 0;
+
+          /* exprRunProgram(NULL, call, vars, stack, val) with the
+             result item as val; xor edi, edi.  Eager functions get
+             the expression instead; mov rdi, r13 */
+          slot = d + exprJitStack(ip) - 1;
+
+          if(ip->op == EXPR_OP_CALLVAL)
+            EXPR_JIT_CODE(&buf, "\x4C\x89\xEF");
+          else
+            EXPR_JIT_CODE(&buf, "\x31\xFF");
+
+          EXPR_JIT_CODE(&buf, "\x48\xBE");
+          exprJitPtr(&buf, call);
+          EXPR_JIT_CODE(&buf, "\x48\xBA");
+          exprJitPtr(&buf, prog->vars);
+          EXPR_JIT_MEM(&buf, EXPR_JIT_LEA, 1, d);
+          EXPR_JIT_MEM(&buf, "\x4C\x8D", 0, slot);
+          exprJitCall(&buf, (exprJitAddr)exprRunProgram);
+          EXPR_JIT_CODE(&buf, "\x85\xC0");
+          exprJitJump(&buf, EXPR_JIT_JNE, EXPR_JIT_EXIT);
+
+          call++;
+          continue;
+        }
+
+      /* Routines from the math library */
+      if(exprJitMath(ip->op))
+        {
+          /* Two argument routines work on the item below the top */
+          slot = (exprJitStack(ip) < 0) ? t - 1 : t;
+
+          if(ip->op != EXPR_OP_CEIL && ip->op != EXPR_OP_FLOOR)
+            {
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+              /* mov dword [r12], 0 */
+              EXPR_JIT_CODE(&buf, "\x41\xC7\x04\x24\x00\x00\x00\x00");
+#endif
+            }
+
+          EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, slot);
+          if(slot != t)
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 1, t);
+
+          exprJitCall(&buf, exprJitMath(ip->op));
+          EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_STORE, 0, slot);
+
+          if(ip->op != EXPR_OP_CEIL && ip->op != EXPR_OP_FLOOR)
+            {
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+              /* cmp dword [r12], 0 */
+              EXPR_JIT_CODE(&buf, "\x41\x83\x3C\x24\x00");
+              exprJitJump(&buf, EXPR_JIT_JNE, EXPR_JIT_RANGE);
+#endif
+            }
+
+          continue;
+        }
+
+      switch(ip->op)
+        {
+          case EXPR_OP_END:
+            /* movsd [r14], xmm0; xor eax, eax */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t);
+            EXPR_JIT_CODE(&buf, "\xF2\x41\x0F\x11\x06\x31\xC0");
+            exprJitJump(&buf, EXPR_JIT_JMP, EXPR_JIT_EXIT);
+            break;
+
+          case EXPR_OP_VALUE:
+            /* mov rax, value */
+            EXPR_JIT_CODE(&buf, "\x48\xB8");
+            exprJitCode(&buf, (const char*)&(ip->data.value), sizeof(EXPRTYPE));
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOV_STORE, 0, d);
+            break;
+
+          case EXPR_OP_LOAD:
+            /* mov rax, address; mov rax, [rax] */
+            EXPR_JIT_CODE(&buf, "\x48\xB8");
+            exprJitPtr(&buf, prog->vars[ip->arg]);
+            EXPR_JIT_CODE(&buf, "\x48\x8B\x00");
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOV_STORE, 0, d);
+            break;
+
+          case EXPR_OP_STORE:
+            /* mov rax, address; mov rcx, top; mov [rax], rcx */
+            EXPR_JIT_CODE(&buf, "\x48\xB8");
+            exprJitPtr(&buf, prog->vars[ip->arg]);
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOV_LOAD, 1, t);
+            EXPR_JIT_CODE(&buf, "\x48\x89\x08");
+            break;
+
+          case EXPR_OP_POP:
+            break;
+
+          case EXPR_OP_ADD:
+          case EXPR_OP_SUBTRACT:
+          case EXPR_OP_MULTIPLY:
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t - 1);
+
+            if(ip->op == EXPR_OP_ADD)
+              EXPR_JIT_MEM(&buf, EXPR_JIT_ADDSD, 0, t);
+            else if(ip->op == EXPR_OP_SUBTRACT)
+              EXPR_JIT_MEM(&buf, EXPR_JIT_SUBSD, 0, t);
+            else
+              EXPR_JIT_MEM(&buf, EXPR_JIT_MULSD, 0, t);
+
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_STORE, 0, t - 1);
+            break;
+
+          case EXPR_OP_DIVIDE:
+            /* xorpd xmm2, xmm2; ucomisd xmm1, xmm2 */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 1, t);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x57\xD2\x66\x0F\x2E\xCA");
+
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+            skip = exprJitShort(&buf, EXPR_JIT_JP);
+            exprJitJump(&buf, EXPR_JIT_JE, EXPR_JIT_ZERO);
+            exprJitHere(&buf, skip);
+
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t - 1);
+            EXPR_JIT_CODE(&buf, "\xF2\x0F\x5E\xC1"); /* divsd xmm0, xmm1 */
+#else
+            /* The part that divides by 0 is 0; xorpd xmm0, xmm0 */
+            skip = exprJitShort(&buf, EXPR_JIT_JP);
+            pos = exprJitShort(&buf, EXPR_JIT_JNE);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x57\xC0");
+            done = exprJitShort(&buf, EXPR_JIT_JMP);
+            exprJitHere(&buf, skip);
+            exprJitHere(&buf, pos);
+
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t - 1);
+            EXPR_JIT_CODE(&buf, "\xF2\x0F\x5E\xC1"); /* divsd xmm0, xmm1 */
+            exprJitHere(&buf, done);
+#endif
+
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_STORE, 0, t - 1);
+            break;
+
+          case EXPR_OP_NEGATE:
+            /* btc qword top, 63 */
+            EXPR_JIT_MEM(&buf, "\x48\x0F\xBA", 7, t);
+            exprJitByte(&buf, 63);
+            break;
+
+          case EXPR_OP_ABS:
+            /* Like the node tree, 0 and above stay, so -0 stays
+               and NaN changes; xorpd xmm1, xmm1; ucomisd xmm0, xmm1 */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x57\xC9\x66\x0F\x2E\xC1");
+            skip = exprJitShort(&buf, EXPR_JIT_JAE);
+            EXPR_JIT_MEM(&buf, "\x48\x0F\xBA", 7, t);
+            exprJitByte(&buf, 63);
+            exprJitHere(&buf, skip);
+            break;
+
+          case EXPR_OP_JUMP:
+            /* Going backwards is a loop, check for a break like the
+               virtual machine; mov rdi, r13; mov esi, count */
+            if(ip->arg < index)
+              {
+                EXPR_JIT_CODE(&buf, "\x4C\x89\xEF\xBE");
+                exprJitInt(&buf, index - ip->arg + 1);
+                exprJitCall(&buf, (exprJitAddr)exprCheckBreak);
+                EXPR_JIT_CODE(&buf, "\x85\xC0"); /* test eax, eax */
+                exprJitJump(&buf, EXPR_JIT_JNE, EXPR_JIT_EXIT);
+              }
+
+            exprJitJump(&buf, EXPR_JIT_JMP, ip->arg);
+            break;
+
+          case EXPR_OP_JUMPZ:
+            /* xorpd xmm1, xmm1; ucomisd xmm0, xmm1 */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x57\xC9\x66\x0F\x2E\xC1");
+            skip = exprJitShort(&buf, EXPR_JIT_JP);
+            exprJitJump(&buf, EXPR_JIT_JE, ip->arg);
+            exprJitHere(&buf, skip);
+            break;
+
+          case EXPR_OP_SELECT:
+            /* NaN is not below or equal to 0 */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x57\xC9\x66\x0F\x2E\xC1");
+            exprJitJump(&buf, EXPR_JIT_JP, ip->data.jump[1]);
+            exprJitJump(&buf, EXPR_JIT_JB, index + 1);
+            exprJitJump(&buf, EXPR_JIT_JE, ip->data.jump[0]);
+            exprJitJump(&buf, EXPR_JIT_JMP, ip->data.jump[1]);
+            break;
+
+          case EXPR_OP_MIN:
+          case EXPR_OP_MAX:
+            /* minsd and maxsd keep the second operand unless the
+               first is smaller or larger, like the loop does */
+            slot = d - ip->arg;
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 1, slot);
+
+            for(arg = 1; arg < ip->arg; arg++)
+              {
+                EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, slot + arg);
+
+                if(ip->op == EXPR_OP_MIN)
+                  EXPR_JIT_CODE(&buf, "\xF2\x0F\x5D\xC1"); /* minsd xmm0, xmm1 */
+                else
+                  EXPR_JIT_CODE(&buf, "\xF2\x0F\x5F\xC1"); /* maxsd xmm0, xmm1 */
+
+                EXPR_JIT_CODE(&buf, "\x66\x0F\x28\xC8"); /* movapd xmm1, xmm0 */
+              }
+
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_STORE, 1, slot);
+            break;
+
+          case EXPR_OP_DEG:
+          case EXPR_OP_RAD:
+            /* Same order of operations as the virtual machine */
+            exprJitConst(&buf, 0, (ip->op == EXPR_OP_DEG) ? 180.0 : M_PI);
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MULSD, 0, t);
+            exprJitConst(&buf, 1, (ip->op == EXPR_OP_DEG) ? M_PI : 180.0);
+            EXPR_JIT_CODE(&buf, "\xF2\x0F\x5E\xC1"); /* divsd xmm0, xmm1 */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_STORE, 0, t);
+            break;
+
+          case EXPR_OP_EQUAL:
+          case EXPR_OP_BELOW:
+            /* cmpsd gives a mask that selects 1.0 */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t - 1);
+            EXPR_JIT_MEM(&buf, EXPR_JIT_CMPSD, 0, t);
+            exprJitByte(&buf, (ip->op == EXPR_OP_EQUAL) ? EXPR_JIT_CMPEQ : EXPR_JIT_CMPLT);
+            exprJitConst(&buf, 2, 1.0);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x54\xC2"); /* andpd xmm0, xmm2 */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_STORE, 0, t - 1);
+            break;
+
+          case EXPR_OP_ABOVE:
+            /* a > b is b < a */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t);
+            EXPR_JIT_MEM(&buf, EXPR_JIT_CMPSD, 0, t - 1);
+            exprJitByte(&buf, EXPR_JIT_CMPLT);
+            exprJitConst(&buf, 2, 1.0);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x54\xC2");
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_STORE, 0, t - 1);
+            break;
+
+          case EXPR_OP_AND:
+          case EXPR_OP_OR:
+            /* NaN counts as not 0; xorpd xmm2, xmm2;
+               cmpneqsd xmm0, xmm2; cmpneqsd xmm1, xmm2 */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t - 1);
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 1, t);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x57\xD2\xF2\x0F\xC2\xC2\x04\xF2\x0F\xC2\xCA\x04");
+
+            if(ip->op == EXPR_OP_AND)
+              EXPR_JIT_CODE(&buf, "\x66\x0F\x54\xC1"); /* andpd xmm0, xmm1 */
+            else
+              EXPR_JIT_CODE(&buf, "\x66\x0F\x56\xC1"); /* orpd xmm0, xmm1 */
+
+            exprJitConst(&buf, 2, 1.0);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x54\xC2");
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_STORE, 0, t - 1);
+            break;
+
+          case EXPR_OP_NOT:
+            /* xorpd xmm1, xmm1; cmpeqsd xmm0, xmm1 */
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_LOAD, 0, t);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x57\xC9\xF2\x0F\xC2\xC1\x00");
+            exprJitConst(&buf, 2, 1.0);
+            EXPR_JIT_CODE(&buf, "\x66\x0F\x54\xC2");
+            EXPR_JIT_MEM(&buf, EXPR_JIT_MOVSD_STORE, 0, t);
+            break;
+
+          default:
+            err = EXPR_ERROR_NONATIVE;
+            goto cleanup;
+        }
+    }
+
+  /* add rsp, frame; pop r14, r13, r12, rbx; ret */
+  pos = buf.count;
+  EXPR_JIT_CODE(&buf, "\x48\x81\xC4");
+  exprJitInt(&buf, frame);
+  EXPR_JIT_CODE(&buf, "\x41\x5E\x41\x5D\x41\x5C\x5B\xC3");
+
+  /* mov eax, error; jmp exit */
+  skip = buf.count;
+  exprJitByte(&buf, 0xB8);
+  exprJitInt(&buf, EXPR_ERROR_OUTOFRANGE);
+  exprJitJump(&buf, EXPR_JIT_JMP, EXPR_JIT_EXIT);
+
+  done = buf.count;
+  exprJitByte(&buf, 0xB8);
+  exprJitInt(&buf, EXPR_ERROR_DIVBYZERO);
+  exprJitJump(&buf, EXPR_JIT_JMP, EXPR_JIT_EXIT);
+
+  if(buf.err != EXPR_ERROR_NOERROR)
+    {
+      err = buf.err;
+      goto cleanup;
+    }
+
+  /* Patch the jumps, offsets are from the end of the jump */
+  for(index = 0; index < buf.fixcount; index++)
+    {
+      size_t target;
+      unsigned long rel;
+      int where = buf.fixups[index].target;
+
+      if(where == EXPR_JIT_EXIT)
+        target = pos;
+      else if(where == EXPR_JIT_RANGE)
+        target = skip;
+      else if(where == EXPR_JIT_ZERO)
+        target = done;
+      else
+        target = labels[where];
+
+      rel = (unsigned long)(target - (buf.fixups[index].pos + 4));
+
+      for(arg = 0; arg < 4; arg++)
+        buf.code[buf.fixups[index].pos + arg] = (unsigned char)((rel >> (arg * 8)) & 0xFF);
+    }
+
+  /* Executable memory, written before it can run */
+  tmp->size = buf.count;
+  code = mmap(NULL, tmp->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(code == MAP_FAILED)
+    {
+      err = EXPR_ERROR_MEMORY;
+      goto cleanup;
+    }
+
+  memcpy(code, buf.code, buf.count);
+
+  /* Systems that forbid executable memory cannot run it */
+  if(mprotect(code, tmp->size, PROT_READ | PROT_EXEC) != 0)
+    {
+      munmap(code, tmp->size);
+      err = EXPR_ERROR_NONATIVE;
+      goto cleanup;
+    }
+
+  tmp->code = code;
+  tmp->callcount = calls;
+  memcpy(&(tmp->func), &code, sizeof(tmp->func));
+
+  *jit = tmp;
+  tmp = NULL;
+  err = EXPR_ERROR_NOERROR;
+
+cleanup:
+  exprFreeFrom(alloc, tmp);
+  exprFreeMem(depth);
+  exprFreeMem(labels);
+  exprFreeMem(buf.fixups);
+  exprFreeMem(buf.code);
+
+  return err;
+}
+
+/* Find the stack depth before each instruction, -1 for instructions
+   nothing reaches.  The compiler gives each instruction the same
+   depth on every path, which is checked here. */
+static int exprJitDepth(exprProgram *prog, int *depth, int *maxdepth)
+{
+  exprInstr *ip;
+  int index, cur, after;
+  int targets[2];
+  int count, pos;
+
+  for(index = 0; index < prog->count; index++)
+    depth[index] = -1;
+
+  cur = 0;
+  *maxdepth = 1;
+
+  for(index = 0; index < prog->count; index++)
+    {
+      ip = &(prog->code[index]);
+
+      if(depth[index] >= 0)
+        {
+          if(cur >= 0 && cur != depth[index])
+            return EXPR_ERROR_NONATIVE;
+
+          cur = depth[index];
+        }
+      else if(cur < 0)
+        continue;
+      else
+        depth[index] = cur;
+
+      after = cur + exprJitStack(ip);
+      if(after < 0 || after > EXPR_JIT_MAXDEPTH)
+        return EXPR_ERROR_NONATIVE;
+
+      if(after > *maxdepth)
+        *maxdepth = after;
+
+      count = 0;
+      switch(ip->op)
+        {
+          case EXPR_OP_JUMP:
+          case EXPR_OP_JUMPZ:
+            targets[count++] = ip->arg;
+            break;
+
+          case EXPR_OP_SELECT:
+            targets[count++] = ip->data.jump[0];
+            targets[count++] = ip->data.jump[1];
+            break;
+        }
+
+      for(pos = 0; pos < count; pos++)
+        {
+          if(targets[pos] < 0 || targets[pos] >= prog->count)
+            return EXPR_ERROR_NONATIVE;
+
+          if(depth[targets[pos]] < 0)
+            depth[targets[pos]] = after;
+          else if(depth[targets[pos]] != after)
+            return EXPR_ERROR_NONATIVE;
+        }
+
+      /* Nothing falls through to the next instruction */
+      if(ip->op == EXPR_OP_JUMP || ip->op == EXPR_OP_END)
+        cur = -1;
+      else
+        cur = after;
+    }
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Change of the stack depth by an instruction */
+static int exprJitStack(exprInstr *ip)
+{
+  switch(ip->op)
+    {
+      case EXPR_OP_VALUE:
+      case EXPR_OP_LOAD:
+      case EXPR_OP_CALL:
+      case EXPR_OP_RAND:
+      case EXPR_OP_RANDOMIZE:
+        return 1;
+
+      case EXPR_OP_POP:
+      case EXPR_OP_ADD:
+      case EXPR_OP_SUBTRACT:
+      case EXPR_OP_MULTIPLY:
+      case EXPR_OP_DIVIDE:
+      case EXPR_OP_EXPONENT:
+      case EXPR_OP_JUMPZ:
+      case EXPR_OP_SELECT:
+      case EXPR_OP_MOD:
+      case EXPR_OP_POW:
+      case EXPR_OP_ATAN2:
+      case EXPR_OP_LOGN:
+      case EXPR_OP_RANDOM:
+      case EXPR_OP_RECTTOPOLR:
+      case EXPR_OP_RECTTOPOLA:
+      case EXPR_OP_POLTORECTX:
+      case EXPR_OP_POLTORECTY:
+      case EXPR_OP_EQUAL:
+      case EXPR_OP_ABOVE:
+      case EXPR_OP_BELOW:
+      case EXPR_OP_AND:
+      case EXPR_OP_OR:
+        return -1;
+
+      case EXPR_OP_MIN:
+      case EXPR_OP_MAX:
+      case EXPR_OP_AVG:
+      case EXPR_OP_POLY:
+      case EXPR_OP_CALLVAL:
+        return 1 - ip->arg;
+
+      case EXPR_OP_CLIP:
+      case EXPR_OP_CLAMP:
+        return -2;
+
+      case EXPR_OP_PNTCHANGE:
+        return -4;
+
+      default:
+        return 0;
+    }
+}
+
+/* Is the instruction handed to the virtual machine? */
+static int exprJitSlow(int op)
+{
+  switch(op)
+    {
+      case EXPR_OP_IPART:
+      case EXPR_OP_FPART:
+      case EXPR_OP_POW10:
+      case EXPR_OP_LOGN:
+      case EXPR_OP_RAND:
+      case EXPR_OP_RANDOM:
+      case EXPR_OP_RANDOMIZE:
+      case EXPR_OP_RECTTOPOLR:
+      case EXPR_OP_RECTTOPOLA:
+      case EXPR_OP_POLTORECTX:
+      case EXPR_OP_POLTORECTY:
+      case EXPR_OP_AVG:
+      case EXPR_OP_CLIP:
+      case EXPR_OP_CLAMP:
+      case EXPR_OP_PNTCHANGE:
+      case EXPR_OP_POLY:
+      case EXPR_OP_CALLVAL:
+        return 1;
+
+      default:
+        return 0;
+    }
+}
+
+/* Math routine of an instruction, NULL if it has none */
+static exprJitAddr exprJitMath(int op)
+{
+  double (*func1)(double) = NULL;
+  double (*func2)(double, double) = NULL;
+
+  switch(op)
+    {
+      case EXPR_OP_EXPONENT:
+      case EXPR_OP_POW: func2 = pow; break;
+      case EXPR_OP_MOD: func2 = fmod; break;
+      case EXPR_OP_ATAN2: func2 = atan2; break;
+      case EXPR_OP_SQRT: func1 = sqrt; break;
+      case EXPR_OP_SIN: func1 = sin; break;
+      case EXPR_OP_SINH: func1 = sinh; break;
+      case EXPR_OP_ASIN: func1 = asin; break;
+      case EXPR_OP_COS: func1 = cos; break;
+      case EXPR_OP_COSH: func1 = cosh; break;
+      case EXPR_OP_ACOS: func1 = acos; break;
+      case EXPR_OP_TAN: func1 = tan; break;
+      case EXPR_OP_TANH: func1 = tanh; break;
+      case EXPR_OP_ATAN: func1 = atan; break;
+      case EXPR_OP_LOG: func1 = log10; break;
+      case EXPR_OP_LN: func1 = log; break;
+      case EXPR_OP_EXP: func1 = exp; break;
+      case EXPR_OP_CEIL: func1 = ceil; break;
+      case EXPR_OP_FLOOR: func1 = floor; break;
+    }
+
+  if(func2)
+    return (exprJitAddr)func2;
+
+  return (exprJitAddr)func1;
+}
+
+/* Add a byte to the code */
+static void exprJitByte(exprJitBuf *buf, int byte)
+{
+  unsigned char *tmp;
+
+  if(buf->count >= buf->size)
+    {
+      tmp = exprReallocMem(buf->code, buf->size ? buf->size * 2 : 4096);
+      if(tmp == NULL)
+        {
+          /* Keep writing over the last byte until the end */
+          buf->err = EXPR_ERROR_MEMORY;
+          if(buf->size == 0)
+            return;
+
+          buf->count = buf->size - 1;
+        }
+      else
+        {
+          buf->code = tmp;
+          buf->size = buf->size ? buf->size * 2 : 4096;
+        }
+    }
+
+  buf->code[buf->count++] = (unsigned char)byte;
+}
+
+/* Add bytes to the code */
+static void exprJitCode(exprJitBuf *buf, const char *bytes, int len)
+{
+  int pos;
+
+  for(pos = 0; pos < len; pos++)
+    exprJitByte(buf, (unsigned char)bytes[pos]);
+}
+
+/* Add a 32 bit value */
+static void exprJitInt(exprJitBuf *buf, long value)
+{
+  int pos;
+
+  for(pos = 0; pos < 4; pos++)
+    exprJitByte(buf, (int)((value >> (pos * 8)) & 0xFF));
+}
+
+/* Add a 64 bit address */
+static void exprJitPtr(exprJitBuf *buf, const void *ptr)
+{
+  exprJitCode(buf, (const char*)&ptr, sizeof(ptr));
+}
+
+/* Add an instruction with register reg and the stack item slot */
+static void exprJitMem(exprJitBuf *buf, const char *op, int len, int reg, int slot)
+{
+  exprJitCode(buf, op, len);
+  exprJitByte(buf, 0x83 | (reg << 3));
+  exprJitInt(buf, (long)slot * 8);
+}
+
+/* Call a routine; mov rax, func; call rax */
+static void exprJitCall(exprJitBuf *buf, exprJitAddr func)
+{
+  EXPR_JIT_CODE(buf, "\x48\xB8");
+  exprJitCode(buf, (const char*)&func, sizeof(func));
+  EXPR_JIT_CODE(buf, "\xFF\xD0");
+}
+
+/* Put a number in an xmm register; mov rax, value; movq xmm, rax */
+static void exprJitConst(exprJitBuf *buf, int reg, EXPRTYPE value)
+{
+  EXPR_JIT_CODE(buf, "\x48\xB8");
+  exprJitCode(buf, (const char*)&value, sizeof(EXPRTYPE));
+  EXPR_JIT_CODE(buf, "\x66\x48\x0F\x6E");
+  exprJitByte(buf, 0xC0 | (reg << 3));
+}
+
+/* Jump to an instruction or exit, patched when all code is there */
+static void exprJitJump(exprJitBuf *buf, int cc, int target)
+{
+  if(cc == EXPR_JIT_JMP)
+    exprJitByte(buf, 0xE9);
+  else
+    {
+      exprJitByte(buf, 0x0F);
+      exprJitByte(buf, 0x80 | cc);
+    }
+
+  buf->fixups[buf->fixcount].pos = buf->count;
+  buf->fixups[buf->fixcount].target = target;
+  buf->fixcount++;
+
+  exprJitInt(buf, 0);
+}
+
+/* Short jump forward, returns where to patch with exprJitHere */
+static size_t exprJitShort(exprJitBuf *buf, int cc)
+{
+  exprJitByte(buf, (cc == EXPR_JIT_JMP) ? 0xEB : (0x70 | cc));
+  exprJitByte(buf, 0);
+
+  return buf->count - 1;
+}
+
+/* Make a short jump land at the current position */
+static void exprJitHere(exprJitBuf *buf, size_t pos)
+{
+  if(buf->err == EXPR_ERROR_NOERROR)
+    buf->code[pos] = (unsigned char)(buf->count - pos - 1);
+}
+
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+
+/* Address of errno for the calling thread */
+static int *exprJitErrno(void)
+{
+  return &errno;
+}
+
+#endif
+
+#endif /* EXPR_JIT_X86_64 */
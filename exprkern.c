@@ -0,0 +1,564 @@
+/*
+  File: exprkern.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Array versions of the built in functions
+
+  This file is part of ExprEval.
+*/
+
+/*
+  The kernels work on arrays of values instead of one value at a
+  time.  Instead of errno, a kernel that can fail sets an item of
+  mask for each item of the result that hit a domain or range error
+  (the items the scalar solvers would report with errno) and returns
+  EXPR_ERROR_OUTOFRANGE if any did.  mask may be NULL.  The result
+  may be the same array as an argument.
+
+  Exact operations (sqrt, abs, floor, ceil, min, max and clip) have
+  SSE2, AVX and AVX-512 versions.  The rest call the math library
+  for each item so their results match exprEval exactly.
+*/
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+
+#include <float.h>
+
+#if(EXPR_KERNEL_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EXPR_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+/* Error tests for one item, without branches */
+#define EXPR_KERNEL_NAN(r, x) (((r) != (r)) & ((x) == (x))) /* NaN from a number */
+#define EXPR_KERNEL_INF(r, x) ((fabs(r) == HUGE_VAL) & (fabs(x) < HUGE_VAL)) /* Infinity from a finite number */
+#define EXPR_KERNEL_TINY(r, x) ((fabs(r) < DBL_MIN) & ((x) != 0.0) & (fabs(x) < HUGE_VAL)) /* Underflow */
+
+/* Kernels that can be vectorized */
+typedef struct _exprKernelOps
+{
+  int (*ksqrt)(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask);
+  void (*kabs)(EXPRTYPE *out, const EXPRTYPE *x, int count);
+  void (*kfloor)(EXPRTYPE *out, const EXPRTYPE *x, int count);
+  void (*kceil)(EXPRTYPE *out, const EXPRTYPE *x, int count);
+  void (*kmin)(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count);
+  void (*kmax)(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count);
+  void (*kclip)(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *lo, const EXPRTYPE *hi, int count);
+} exprKernelOps;
+
+
+/* Portable kernels */
+
+static int exprKernelSqrtC(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask)
+{
+  int pos, flag, any = 0;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      flag = (x[pos] < 0.0);
+      out[pos] = sqrt(x[pos]);
+
+      any |= flag;
+      if(mask)
+        mask[pos] = (unsigned char)flag;
+    }
+
+  return any;
+}
+
+static void exprKernelAbsC(EXPRTYPE *out, const EXPRTYPE *x, int count)
+{
+  int pos;
+
+  for(pos = 0; pos < count; pos++)
+    out[pos] = (x[pos] >= 0.0) ? x[pos] : -x[pos];
+}
+
+static void exprKernelFloorC(EXPRTYPE *out, const EXPRTYPE *x, int count)
+{
+  int pos;
+
+  for(pos = 0; pos < count; pos++)
+    out[pos] = floor(x[pos]);
+}
+
+static void exprKernelCeilC(EXPRTYPE *out, const EXPRTYPE *x, int count)
+{
+  int pos;
+
+  for(pos = 0; pos < count; pos++)
+    out[pos] = ceil(x[pos]);
+}
+
+static void exprKernelMinC(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count)
+{
+  int pos;
+
+  for(pos = 0; pos < count; pos++)
+    out[pos] = (b[pos] < a[pos]) ? b[pos] : a[pos];
+}
+
+static void exprKernelMaxC(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count)
+{
+  int pos;
+
+  for(pos = 0; pos < count; pos++)
+    out[pos] = (b[pos] > a[pos]) ? b[pos] : a[pos];
+}
+
+static void exprKernelClipC(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *lo, const EXPRTYPE *hi, int count)
+{
+  int pos;
+  EXPRTYPE d1;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      d1 = x[pos];
+
+      if(d1 < lo[pos])
+        d1 = lo[pos];
+      else if(d1 > hi[pos])
+        d1 = hi[pos];
+
+      out[pos] = d1;
+    }
+}
+
+static exprKernelOps exprKernelOpsC =
+  {
+    exprKernelSqrtC,
+    exprKernelAbsC,
+    exprKernelFloorC,
+    exprKernelCeilC,
+    exprKernelMinC,
+    exprKernelMaxC,
+    exprKernelClipC
+  };
+
+
+#ifdef EXPR_KERNEL_X86
+
+/* Store a bit mask as one item per lane */
+static void exprKernelBits(unsigned char *mask, int bits, int count)
+{
+  int pos;
+
+  for(pos = 0; pos < count; pos++)
+    mask[pos] = (unsigned char)((bits >> pos) & 1);
+}
+
+/* SSE2 kernels */
+#define EXPR_KN(name) name##SSE2
+#define EXPR_KT __attribute__((target("sse2")))
+#define EXPR_KW 2
+#define EXPR_KV __m128d
+#define EXPR_KV_LOAD(p) _mm_loadu_pd(p)
+#define EXPR_KV_STORE(p, v) _mm_storeu_pd(p, v)
+#define EXPR_KV_SET(d) _mm_set1_pd(d)
+#define EXPR_KV_LT(a, b) _mm_cmplt_pd(a, b)
+#define EXPR_KV_GE(a, b) _mm_cmpge_pd(a, b)
+#define EXPR_KV_BITS(m) _mm_movemask_pd(m)
+#define EXPR_KV_BLEND(a, b, m) _mm_or_pd(_mm_and_pd(m, b), _mm_andnot_pd(m, a))
+#define EXPR_KV_NEG(v) _mm_xor_pd(v, _mm_set1_pd(-0.0))
+#define EXPR_KV_SQRT(v) _mm_sqrt_pd(v)
+#define EXPR_KV_MIN(a, b) _mm_min_pd(a, b)
+#define EXPR_KV_MAX(a, b) _mm_max_pd(a, b)
+
+#include "exprkimp.h"
+
+static exprKernelOps exprKernelOpsSSE2 =
+  {
+    exprKernelSqrtSSE2,
+    exprKernelAbsSSE2,
+    exprKernelFloorC, /* SSE2 has no rounding instruction */
+    exprKernelCeilC,
+    exprKernelMinSSE2,
+    exprKernelMaxSSE2,
+    exprKernelClipSSE2
+  };
+
+#undef EXPR_KN
+#undef EXPR_KT
+#undef EXPR_KW
+#undef EXPR_KV
+#undef EXPR_KV_LOAD
+#undef EXPR_KV_STORE
+#undef EXPR_KV_SET
+#undef EXPR_KV_LT
+#undef EXPR_KV_GE
+#undef EXPR_KV_BITS
+#undef EXPR_KV_BLEND
+#undef EXPR_KV_NEG
+#undef EXPR_KV_SQRT
+#undef EXPR_KV_MIN
+#undef EXPR_KV_MAX
+
+/* AVX kernels */
+#define EXPR_KN(name) name##AVX
+#define EXPR_KT __attribute__((target("avx")))
+#define EXPR_KW 4
+#define EXPR_KV __m256d
+#define EXPR_KV_LOAD(p) _mm256_loadu_pd(p)
+#define EXPR_KV_STORE(p, v) _mm256_storeu_pd(p, v)
+#define EXPR_KV_SET(d) _mm256_set1_pd(d)
+#define EXPR_KV_LT(a, b) _mm256_cmp_pd(a, b, _CMP_LT_OQ)
+#define EXPR_KV_GE(a, b) _mm256_cmp_pd(a, b, _CMP_GE_OQ)
+#define EXPR_KV_BITS(m) _mm256_movemask_pd(m)
+#define EXPR_KV_BLEND(a, b, m) _mm256_blendv_pd(a, b, m)
+#define EXPR_KV_NEG(v) _mm256_xor_pd(v, _mm256_set1_pd(-0.0))
+#define EXPR_KV_SQRT(v) _mm256_sqrt_pd(v)
+#define EXPR_KV_MIN(a, b) _mm256_min_pd(a, b)
+#define EXPR_KV_MAX(a, b) _mm256_max_pd(a, b)
+#define EXPR_KV_FLOOR(v) _mm256_floor_pd(v)
+#define EXPR_KV_CEIL(v) _mm256_ceil_pd(v)
+
+#include "exprkimp.h"
+
+static exprKernelOps exprKernelOpsAVX =
+  {
+    exprKernelSqrtAVX,
+    exprKernelAbsAVX,
+    exprKernelFloorAVX,
+    exprKernelCeilAVX,
+    exprKernelMinAVX,
+    exprKernelMaxAVX,
+    exprKernelClipAVX
+  };
+
+#undef EXPR_KN
+#undef EXPR_KT
+#undef EXPR_KW
+#undef EXPR_KV
+#undef EXPR_KV_LOAD
+#undef EXPR_KV_STORE
+#undef EXPR_KV_SET
+#undef EXPR_KV_LT
+#undef EXPR_KV_GE
+#undef EXPR_KV_BITS
+#undef EXPR_KV_BLEND
+#undef EXPR_KV_NEG
+#undef EXPR_KV_SQRT
+#undef EXPR_KV_MIN
+#undef EXPR_KV_MAX
+#undef EXPR_KV_FLOOR
+#undef EXPR_KV_CEIL
+
+/* AVX-512 kernels.  Comparisons give a bit mask directly. */
+#define EXPR_KN(name) name##AVX512
+#define EXPR_KT __attribute__((target("avx512f")))
+#define EXPR_KW 8
+#define EXPR_KV __m512d
+#define EXPR_KV_LOAD(p) _mm512_loadu_pd(p)
+#define EXPR_KV_STORE(p, v) _mm512_storeu_pd(p, v)
+#define EXPR_KV_SET(d) _mm512_set1_pd(d)
+#define EXPR_KV_LT(a, b) _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ)
+#define EXPR_KV_GE(a, b) _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ)
+#define EXPR_KV_BITS(m) ((int)(m))
+#define EXPR_KV_BLEND(a, b, m) _mm512_mask_blend_pd(m, a, b)
+#define EXPR_KV_NEG(v) _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(v), \
+  _mm512_castpd_si512(_mm512_set1_pd(-0.0))))
+#define EXPR_KV_SQRT(v) _mm512_sqrt_pd(v)
+#define EXPR_KV_MIN(a, b) _mm512_min_pd(a, b)
+#define EXPR_KV_MAX(a, b) _mm512_max_pd(a, b)
+#define EXPR_KV_FLOOR(v) _mm512_roundscale_pd(v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)
+#define EXPR_KV_CEIL(v) _mm512_roundscale_pd(v, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC)
+
+#include "exprkimp.h"
+
+static exprKernelOps exprKernelOpsAVX512 =
+  {
+    exprKernelSqrtAVX512,
+    exprKernelAbsAVX512,
+    exprKernelFloorAVX512,
+    exprKernelCeilAVX512,
+    exprKernelMinAVX512,
+    exprKernelMaxAVX512,
+    exprKernelClipAVX512
+  };
+
+#endif /* EXPR_KERNEL_X86 */
+
+
+/* Kernels for this processor.  Picking them more than once from
+   different threads is harmless since the result is the same. */
+static exprKernelOps *exprKernelCurrent = NULL;
+
+static exprKernelOps *exprKernelGetOps(void)
+{
+  exprKernelOps *ops = exprKernelCurrent;
+
+  if(ops)
+    return ops;
+
+  ops = &exprKernelOpsC;
+
+#ifdef EXPR_KERNEL_X86
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("avx512f"))
+    ops = &exprKernelOpsAVX512;
+  else if(__builtin_cpu_supports("avx"))
+    ops = &exprKernelOpsAVX;
+  else if(__builtin_cpu_supports("sse2"))
+    ops = &exprKernelOpsSSE2;
+#endif
+
+  exprKernelCurrent = ops;
+  return ops;
+}
+
+
+/* sqrt */
+int exprKernelSqrt(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask)
+{
+  if(out == NULL || x == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(exprKernelGetOps()->ksqrt(out, x, count, mask))
+    return EXPR_ERROR_OUTOFRANGE;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* abs */
+int exprKernelAbs(EXPRTYPE *out, const EXPRTYPE *x, int count)
+{
+  if(out == NULL || x == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  exprKernelGetOps()->kabs(out, x, count);
+  return EXPR_ERROR_NOERROR;
+}
+
+/* floor */
+int exprKernelFloor(EXPRTYPE *out, const EXPRTYPE *x, int count)
+{
+  if(out == NULL || x == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  exprKernelGetOps()->kfloor(out, x, count);
+  return EXPR_ERROR_NOERROR;
+}
+
+/* ceil */
+int exprKernelCeil(EXPRTYPE *out, const EXPRTYPE *x, int count)
+{
+  if(out == NULL || x == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  exprKernelGetOps()->kceil(out, x, count);
+  return EXPR_ERROR_NOERROR;
+}
+
+/* min */
+int exprKernelMin(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count)
+{
+  if(out == NULL || a == NULL || b == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  exprKernelGetOps()->kmin(out, a, b, count);
+  return EXPR_ERROR_NOERROR;
+}
+
+/* max */
+int exprKernelMax(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count)
+{
+  if(out == NULL || a == NULL || b == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  exprKernelGetOps()->kmax(out, a, b, count);
+  return EXPR_ERROR_NOERROR;
+}
+
+/* clip */
+int exprKernelClip(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *lo, const EXPRTYPE *hi, int count)
+{
+  if(out == NULL || x == NULL || lo == NULL || hi == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  exprKernelGetOps()->kclip(out, x, lo, hi, count);
+  return EXPR_ERROR_NOERROR;
+}
+
+/* sin */
+int exprKernelSin(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask)
+{
+  int pos, flag, any = 0;
+  EXPRTYPE d1;
+
+  if(out == NULL || x == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      d1 = sin(x[pos]);
+      flag = EXPR_KERNEL_NAN(d1, x[pos]);
+      out[pos] = d1;
+
+      any |= flag;
+      if(mask)
+        mask[pos] = (unsigned char)flag;
+    }
+
+  return any ? EXPR_ERROR_OUTOFRANGE : EXPR_ERROR_NOERROR;
+}
+
+/* cos */
+int exprKernelCos(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask)
+{
+  int pos, flag, any = 0;
+  EXPRTYPE d1;
+
+  if(out == NULL || x == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      d1 = cos(x[pos]);
+      flag = EXPR_KERNEL_NAN(d1, x[pos]);
+      out[pos] = d1;
+
+      any |= flag;
+      if(mask)
+        mask[pos] = (unsigned char)flag;
+    }
+
+  return any ? EXPR_ERROR_OUTOFRANGE : EXPR_ERROR_NOERROR;
+}
+
+/* exp, which fails on overflow and underflow */
+int exprKernelExp(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask)
+{
+  int pos, flag, any = 0;
+  EXPRTYPE d1;
+
+  if(out == NULL || x == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      d1 = exp(x[pos]);
+      flag = EXPR_KERNEL_INF(d1, x[pos]) | ((d1 < DBL_MIN) & (x[pos] > -HUGE_VAL));
+      out[pos] = d1;
+
+      any |= flag;
+      if(mask)
+        mask[pos] = (unsigned char)flag;
+    }
+
+  return any ? EXPR_ERROR_OUTOFRANGE : EXPR_ERROR_NOERROR;
+}
+
+/* ln, which fails for zero and negative numbers */
+int exprKernelLn(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask)
+{
+  int pos, flag, any = 0;
+
+  if(out == NULL || x == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      flag = (x[pos] <= 0.0);
+      out[pos] = log(x[pos]);
+
+      any |= flag;
+      if(mask)
+        mask[pos] = (unsigned char)flag;
+    }
+
+  return any ? EXPR_ERROR_OUTOFRANGE : EXPR_ERROR_NOERROR;
+}
+
+/* pow */
+int exprKernelPow(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *y, int count, unsigned char *mask)
+{
+  int pos, flag, any = 0;
+  EXPRTYPE d1, d2, d3;
+
+  if(out == NULL || x == NULL || y == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      d1 = x[pos];
+      d2 = y[pos];
+      d3 = pow(d1, d2);
+
+      flag = (EXPR_KERNEL_NAN(d3, d1) & (d2 == d2)) |
+        (EXPR_KERNEL_INF(d3, d1) & (fabs(d2) < HUGE_VAL)) |
+        (EXPR_KERNEL_TINY(d3, d1) & (fabs(d2) < HUGE_VAL));
+      out[pos] = d3;
+
+      any |= flag;
+      if(mask)
+        mask[pos] = (unsigned char)flag;
+    }
+
+  return any ? EXPR_ERROR_OUTOFRANGE : EXPR_ERROR_NOERROR;
+}
+
+/* clamp, which wraps x into the range lo to hi */
+int exprKernelClamp(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *lo, const EXPRTYPE *hi, int count, unsigned char *mask)
+{
+  int pos, flag, any = 0;
+  EXPRTYPE d1, d2, d3;
+
+  if(out == NULL || x == NULL || lo == NULL || hi == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      d1 = x[pos] - lo[pos];
+      d2 = hi[pos] - lo[pos];
+      d3 = fmod(d1, d2);
+
+      flag = EXPR_KERNEL_NAN(d3, d1) & (d2 == d2);
+      out[pos] = (d3 < 0.0) ? d3 + hi[pos] : d3 + lo[pos];
+
+      any |= flag;
+      if(mask)
+        mask[pos] = (unsigned char)flag;
+    }
+
+  return any ? EXPR_ERROR_OUTOFRANGE : EXPR_ERROR_NOERROR;
+}
+
+/* poly.  coefs holds ncoefs arrays, stride items apart, starting
+   with the coefficient of the highest power */
+int exprKernelPoly(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *coefs, int ncoefs, int stride, int count, unsigned char *mask)
+{
+  int pos, arg, flag, any = 0;
+  EXPRTYPE d1, d2, d3, total;
+
+  if(out == NULL || x == NULL || (coefs == NULL && ncoefs > 0))
+    return EXPR_ERROR_NULLPOINTER;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      d1 = x[pos];
+      d2 = (EXPRTYPE)(ncoefs - 1);
+      total = 0.0;
+      flag = 0;
+
+      for(arg = 0; arg < ncoefs; arg++)
+        {
+          d3 = pow(d1, d2);
+          flag |= EXPR_KERNEL_NAN(d3, d1) | EXPR_KERNEL_INF(d3, d1) | EXPR_KERNEL_TINY(d3, d1);
+
+          total = total + (coefs[(size_t)arg * stride + pos] * d3);
+          d2 = d2 - 1.0;
+        }
+
+      out[pos] = total;
+
+      any |= flag;
+      if(mask)
+        mask[pos] = (unsigned char)flag;
+    }
+
+  return any ? EXPR_ERROR_OUTOFRANGE : EXPR_ERROR_NOERROR;
+}
@@ -0,0 +1,135 @@
+/*
+  File: exprkimp.h
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Vector kernel bodies for exprkern.c
+
+  This file is part of ExprEval.
+*/
+
+/*
+  This is included by exprkern.c once for each instruction set.
+  Before including it, exprkern.c defines:
+
+  EXPR_KN(name): name of a function for this instruction set
+  EXPR_KT: attribute to compile a function for this instruction set
+  EXPR_KW: number of items in a vector
+  EXPR_KV: vector type
+  EXPR_KV_LOAD(p), EXPR_KV_STORE(p, v): unaligned load and store
+  EXPR_KV_SET(d): vector with d in every lane
+  EXPR_KV_LT(a, b), EXPR_KV_GE(a, b): lanes where a < b and a >= b
+  EXPR_KV_BITS(m): bit mask from a lane comparison
+  EXPR_KV_BLEND(a, b, m): b where m is set, otherwise a
+  EXPR_KV_NEG(v), EXPR_KV_SQRT(v): flip the sign bit and square root
+  EXPR_KV_MIN(a, b), EXPR_KV_MAX(a, b): a < b ? a : b and a > b ? a : b
+  EXPR_KV_FLOOR(v), EXPR_KV_CEIL(v): optional rounding
+
+  Each function works on whole vectors and finishes the last
+  few items with the portable kernels.
+*/
+
+
+/* sqrt */
+EXPR_KT static int EXPR_KN(exprKernelSqrt)(EXPRTYPE *out, const EXPRTYPE *x, int count, unsigned char *mask)
+{
+  EXPR_KV v, zero;
+  int pos, bits, any;
+
+  zero = EXPR_KV_SET(0.0);
+  any = 0;
+
+  for(pos = 0; pos + EXPR_KW <= count; pos += EXPR_KW)
+    {
+      v = EXPR_KV_LOAD(x + pos);
+      bits = EXPR_KV_BITS(EXPR_KV_LT(v, zero));
+      EXPR_KV_STORE(out + pos, EXPR_KV_SQRT(v));
+
+      any |= bits;
+      if(mask)
+        exprKernelBits(mask + pos, bits, EXPR_KW);
+    }
+
+  return any | exprKernelSqrtC(out + pos, x + pos, count - pos, mask ? mask + pos : NULL);
+}
+
+/* abs */
+EXPR_KT static void EXPR_KN(exprKernelAbs)(EXPRTYPE *out, const EXPRTYPE *x, int count)
+{
+  EXPR_KV v, zero;
+  int pos;
+
+  zero = EXPR_KV_SET(0.0);
+
+  for(pos = 0; pos + EXPR_KW <= count; pos += EXPR_KW)
+    {
+      v = EXPR_KV_LOAD(x + pos);
+      EXPR_KV_STORE(out + pos, EXPR_KV_BLEND(EXPR_KV_NEG(v), v, EXPR_KV_GE(v, zero)));
+    }
+
+  exprKernelAbsC(out + pos, x + pos, count - pos);
+}
+
+#ifdef EXPR_KV_FLOOR
+/* floor */
+EXPR_KT static void EXPR_KN(exprKernelFloor)(EXPRTYPE *out, const EXPRTYPE *x, int count)
+{
+  int pos;
+
+  for(pos = 0; pos + EXPR_KW <= count; pos += EXPR_KW)
+    EXPR_KV_STORE(out + pos, EXPR_KV_FLOOR(EXPR_KV_LOAD(x + pos)));
+
+  exprKernelFloorC(out + pos, x + pos, count - pos);
+}
+
+/* ceil */
+EXPR_KT static void EXPR_KN(exprKernelCeil)(EXPRTYPE *out, const EXPRTYPE *x, int count)
+{
+  int pos;
+
+  for(pos = 0; pos + EXPR_KW <= count; pos += EXPR_KW)
+    EXPR_KV_STORE(out + pos, EXPR_KV_CEIL(EXPR_KV_LOAD(x + pos)));
+
+  exprKernelCeilC(out + pos, x + pos, count - pos);
+}
+#endif
+
+/* min, b replaces a only when b < a like the scalar solver */
+EXPR_KT static void EXPR_KN(exprKernelMin)(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count)
+{
+  int pos;
+
+  for(pos = 0; pos + EXPR_KW <= count; pos += EXPR_KW)
+    EXPR_KV_STORE(out + pos, EXPR_KV_MIN(EXPR_KV_LOAD(b + pos), EXPR_KV_LOAD(a + pos)));
+
+  exprKernelMinC(out + pos, a + pos, b + pos, count - pos);
+}
+
+/* max */
+EXPR_KT static void EXPR_KN(exprKernelMax)(EXPRTYPE *out, const EXPRTYPE *a, const EXPRTYPE *b, int count)
+{
+  int pos;
+
+  for(pos = 0; pos + EXPR_KW <= count; pos += EXPR_KW)
+    EXPR_KV_STORE(out + pos, EXPR_KV_MAX(EXPR_KV_LOAD(b + pos), EXPR_KV_LOAD(a + pos)));
+
+  exprKernelMaxC(out + pos, a + pos, b + pos, count - pos);
+}
+
+/* clip */
+EXPR_KT static void EXPR_KN(exprKernelClip)(EXPRTYPE *out, const EXPRTYPE *x, const EXPRTYPE *lo, const EXPRTYPE *hi, int count)
+{
+  EXPR_KV v, l, h;
+  int pos;
+
+  for(pos = 0; pos + EXPR_KW <= count; pos += EXPR_KW)
+    {
+      v = EXPR_KV_LOAD(x + pos);
+      l = EXPR_KV_LOAD(lo + pos);
+      h = EXPR_KV_LOAD(hi + pos);
+
+      /* x > hi ? hi : x, then lo where x < lo */
+      EXPR_KV_STORE(out + pos, EXPR_KV_BLEND(EXPR_KV_MIN(h, v), l, EXPR_KV_LT(v, l)));
+    }
+
+  exprKernelClipC(out + pos, x + pos, lo + pos, hi + pos, count - pos);
+}
@@ -12,28 +12,341 @@
 
 #include "exprmem.h"
 
-/* Allocate memory and zero it */
+/* Chunk headers are padded so the memory after them is aligned */
+typedef union _exprChunkAlign
+{
+  exprChunk chunk;
+  EXPRTYPE value;
+  void *ptr;
+} exprChunkAlign;
+
+/* Internal functions */
+static void *exprMemMalloc(void *context, unsigned long size);
+static void *exprMemRealloc(void *context, void *data, unsigned long size);
+static void exprMemFree(void *context, void *data);
+
+/* Allocator used when none is given */
+static exprAllocator exprMemDefault = {exprMemMalloc, exprMemRealloc, exprMemFree, NULL};
+
+
+/* Allocate memory from the default allocator and zero it */
 void* exprAllocMem(size_t size)
 {
-  void *data = malloc(size);
+  return exprAllocFrom(NULL, size);
+}
+
+/* Allocate memory from the default allocator, it is not zeroed */
+void* exprAllocRawMem(size_t size)
+{
+  return exprAllocRawFrom(NULL, size);
+}
+
+/* Change the size of memory from the default allocator, new memory
+   is not zeroed */
+void* exprReallocMem(void *data, size_t size)
+{
+  return exprReallocFrom(NULL, data, size);
+}
+
+/* Free memory from the default allocator */
+void exprFreeMem(void *data)
+{
+  exprFreeFrom(NULL, data);
+}
+
+/* Allocate memory and zero it */
+void* exprAllocFrom(exprAllocator *alloc, size_t size)
+{
+  void *data = exprAllocRawFrom(alloc, size);
+
+  if(data)
+    memset(data, 0, size);
+
+  return data;
+}
+
+/* Allocate memory, it is not zeroed */
+void* exprAllocRawFrom(exprAllocator *alloc, size_t size)
+{
+  void *data;
+
+  if(alloc == NULL)
+    alloc = &exprMemDefault;
+
+  data = (*(alloc->allocfunc))(alloc->context, (unsigned long)size);
 
   if(data)
     {
-      memset(data, 0, size);
+      exprStatBlock *stat = EXPR_STAT_BLOCK();
+
+      EXPR_STAT_ADD(stat, allocs, 1);
+      EXPR_STAT_ADD(stat, bytes, size);
     }
 
   return data;
 }
 
+/* Change the size of memory, new memory is not zeroed */
+void* exprReallocFrom(exprAllocator *alloc, void *data, size_t size)
+{
+  void *tmp;
+
+  if(alloc == NULL)
+    alloc = &exprMemDefault;
+
+  tmp = (*(alloc->reallocfunc))(alloc->context, data, (unsigned long)size);
+
+  if(tmp)
+    {
+      exprStatBlock *stat = EXPR_STAT_BLOCK();
+
+      EXPR_STAT_ADD(stat, allocs, 1);
+      EXPR_STAT_ADD(stat, bytes, size);
+    }
+
+  return tmp;
+}
+
 /* Free memory */
-void exprFreeMem(void *data)
+void exprFreeFrom(exprAllocator *alloc, void *data)
 {
   if(data)
-    free(data);
+    {
+      exprStatBlock *stat = EXPR_STAT_BLOCK();
+
+      if(alloc == NULL)
+        alloc = &exprMemDefault;
+
+      (*(alloc->freefunc))(alloc->context, data);
+
+      EXPR_STAT_ADD(stat, frees, 1);
+    }
+}
+
+/* Set the allocator of a new object, the default one if alloc is NULL */
+void exprAllocatorInit(exprAllocator *dest, exprAllocator *alloc)
+{
+  *dest = (alloc == NULL) ? exprMemDefault : *alloc;
 }
 
-/* Allocate a list of nodes */
-exprNode *exprAllocNodes(size_t count)
+/* Set the allocator used by objects created without one and for
+   memory the library uses for itself.  NULL goes back to malloc,
+   realloc and free.  Objects keep the allocator they were created
+   with.  Set it before the library allocates anything, since memory
+   it holds on its own is freed with the allocator set at the time. */
+int exprSetDefaultAllocator(exprAllocator *alloc)
 {
-  return exprAllocMem(count * sizeof(exprNode));
+  if(alloc == NULL)
+    {
+      exprMemDefault.allocfunc = exprMemMalloc;
+      exprMemDefault.reallocfunc = exprMemRealloc;
+      exprMemDefault.freefunc = exprMemFree;
+      exprMemDefault.context = NULL;
+
+      return EXPR_ERROR_NOERROR;
+    }
+
+  if(alloc->allocfunc == NULL || alloc->reallocfunc == NULL || alloc->freefunc == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  exprMemDefault = *alloc;
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Get the allocator used by objects created without one */
+int exprGetDefaultAllocator(exprAllocator *alloc)
+{
+  if(alloc == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *alloc = exprMemDefault;
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Allocate a list of nodes from an arena */
+exprNode *exprAllocNodes(exprArena *arena, size_t count)
+{
+  exprNode *nodes;
+
+  nodes = exprArenaAlloc(arena, count * sizeof(exprNode), EXPR_MEM_ALIGN);
+  if(nodes)
+    memset(nodes, 0, count * sizeof(exprNode));
+
+  return nodes;
+}
+
+/* Get size bytes from a list of chunks, adding a chunk of at least
+   chunksize bytes when the newest is full.  Pieces are only freed
+   all at once by exprFreeChunks.  Use an align of 1 for strings and
+   sizeof(EXPRTYPE) or sizeof(void*) for other data. */
+void *exprAllocChunk(exprAllocator *alloc, exprChunk **chunks, size_t size, size_t align, size_t chunksize)
+{
+  exprChunk *cur;
+  size_t used;
+
+  cur = *chunks;
+
+  if(cur)
+    {
+      used = (cur->used + align - 1) / align * align;
+
+      if(used + size <= cur->size)
+        {
+          cur->used = used + size;
+          return (char*)cur + sizeof(exprChunkAlign) + used;
+        }
+    }
+
+  /* Start a new chunk */
+  if(chunksize < size)
+    chunksize = size;
+
+  cur = exprAllocRawFrom(alloc, sizeof(exprChunkAlign) + chunksize);
+  if(cur == NULL)
+    return NULL;
+
+  cur->next = *chunks;
+  cur->size = chunksize;
+  cur->used = size;
+  *chunks = cur;
+
+  return (char*)cur + sizeof(exprChunkAlign);
+}
+
+/* Free a list of chunks */
+void exprFreeChunks(exprAllocator *alloc, exprChunk *chunks)
+{
+  exprChunk *next;
+
+  while(chunks)
+    {
+      next = chunks->next;
+      exprFreeFrom(alloc, chunks);
+      chunks = next;
+    }
+}
+
+/* Create an arena.  Memory is taken from the system blocksize
+   bytes at a time, or a default size if blocksize is 0. */
+int exprArenaCreate(exprArena **arena, int blocksize)
+{
+  return exprArenaCreateEx(arena, blocksize, NULL);
+}
+
+/* Create an arena taking its memory from an allocator, or the
+   default one if alloc is NULL */
+int exprArenaCreateEx(exprArena **arena, int blocksize, exprAllocator *alloc)
+{
+  exprArena *tmp;
+
+  if(arena == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *arena = NULL;
+
+  tmp = exprAllocFrom(alloc, sizeof(exprArena));
+  if(tmp == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  tmp->blocksize = (blocksize > 0) ? (size_t)blocksize : EXPR_ARENA_BLOCKSIZE;
+  exprAllocatorInit(&(tmp->alloc), alloc);
+
+  *arena = tmp;
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Free an arena and everything allocated from it */
+int exprArenaFree(exprArena *arena)
+{
+  exprAllocator alloc;
+
+  if(arena == NULL)
+    return EXPR_ERROR_NOERROR;
+
+  alloc = arena->alloc;
+
+  exprFreeChunks(&alloc, arena->chunks);
+  exprFreeFrom(&alloc, arena);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Release everything allocated from an arena.  If more than one
+   block was used, the next block is made big enough for all of
+   them so the same work fits in one block next time. */
+int exprArenaReset(exprArena *arena)
+{
+  exprChunk *cur;
+  size_t total;
+
+  if(arena == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  cur = arena->chunks;
+
+  if(cur && cur->next == NULL)
+    {
+      cur->used = 0;
+      return EXPR_ERROR_NOERROR;
+    }
+
+  for(total = 0; cur; cur = cur->next)
+    total += cur->size;
+
+  if(total > arena->blocksize)
+    arena->blocksize = total;
+
+  exprFreeChunks(&(arena->alloc), arena->chunks);
+  arena->chunks = NULL;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Allocate memory from an arena.  It is not zeroed. */
+void *exprArenaAlloc(exprArena *arena, size_t size, size_t align)
+{
+  return exprAllocChunk(&(arena->alloc), &(arena->chunks), size, align, arena->blocksize);
+}
+
+/* Default allocator */
+static void *exprMemMalloc(void *context, unsigned long size)
+{
+  (void)context;
+
+  return malloc(size);
+}
+
+static void *exprMemRealloc(void *context, void *data, unsigned long size)
+{
+  (void)context;
+
+  return realloc(data, size);
+}
+
+static void exprMemFree(void *context, void *data)
+{
+  (void)context;
+
+  free(data);
+}
+
+/* Get the counts of allocations made by the library since it was
+   loaded.  Take the difference of two calls to measure some work. */
+int exprGetMemStats(exprMemStats *stats)
+{
+  exprStats all;
+  int err;
+
+  if(stats == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  err = exprGetStats(&all);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  stats->allocs = all.allocs;
+  stats->frees = all.frees;
+  stats->bytes = all.bytes;
+
+  return EXPR_ERROR_NOERROR;
 }
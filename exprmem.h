@@ -13,9 +13,25 @@
 /* Needed for exprNode */
 #include "exprpriv.h"
 
+/* Alignment for arena memory holding values or pointers */
+#define EXPR_MEM_ALIGN (sizeof(EXPRTYPE) > sizeof(void*) ? sizeof(EXPRTYPE) : sizeof(void*))
+
+/* The *Mem functions use the default allocator, the *From functions
+   the one given or the default one if it is NULL.  The Raw ones do
+   not zero the memory. */
 void* exprAllocMem(size_t size);
+void* exprAllocRawMem(size_t size);
+void* exprReallocMem(void *data, size_t size);
 void exprFreeMem(void *data);
-exprNode *exprAllocNodes(size_t count);
+void* exprAllocFrom(exprAllocator *alloc, size_t size);
+void* exprAllocRawFrom(exprAllocator *alloc, size_t size);
+void* exprReallocFrom(exprAllocator *alloc, void *data, size_t size);
+void exprFreeFrom(exprAllocator *alloc, void *data);
+void exprAllocatorInit(exprAllocator *dest, exprAllocator *alloc);
+exprNode *exprAllocNodes(exprArena *arena, size_t count);
+void *exprArenaAlloc(exprArena *arena, size_t size, size_t align);
+void *exprAllocChunk(exprAllocator *alloc, exprChunk **chunks, size_t size, size_t align, size_t chunksize);
+void exprFreeChunks(exprAllocator *alloc, exprChunk *chunks);
 
 
 #endif /* __BAVII_EXPRMEM_H */
@@ -13,22 +13,30 @@
 #include "exprpriv.h"
 #include "exprmem.h"
 
-/* Internal functions */
-static void exprFreeNodeData(exprNode *node);
-
 
 /* Function to create an expression object */
 int exprCreate(exprObj **obj, exprFuncList *flist, exprValList *vlist, exprValList *clist,
                exprBreakFuncType breaker, void *userdata)
+{
+  return exprCreateEx(obj, flist, vlist, clist, breaker, userdata, NULL);
+}
+
+/* Create an expression object that takes the memory for itself, its
+   nodes and its compiled code from an allocator, or the default one
+   if alloc is NULL */
+int exprCreateEx(exprObj **obj, exprFuncList *flist, exprValList *vlist, exprValList *clist,
+               exprBreakFuncType breaker, void *userdata, exprAllocator *alloc)
 {
   exprObj *tmp;
 
   /* Allocate memory for the object */
-  tmp = exprAllocMem(sizeof(exprObj));
+  tmp = exprAllocFrom(alloc, sizeof(exprObj));
 
   if(tmp == NULL)
     return EXPR_ERROR_MEMORY;
 
+  exprAllocatorInit(&(tmp->alloc), alloc);
+
 
   /* Assign data */
   tmp->flist = flist;
@@ -38,6 +46,7 @@ int exprCreate(exprObj **obj, exprFuncList *flist, exprValList *vlist, exprValLi
   tmp->userdata = userdata;
   tmp->breakcount = 100000; /* Default breaker count setting */
   tmp->breakcur = 0;
+  tmp->cancel = &(tmp->cancelled);
 
   /* Update pointer */
   *obj = tmp;
@@ -49,15 +58,27 @@ int exprCreate(exprObj **obj, exprFuncList *flist, exprValList *vlist, exprValLi
 /* Free the expression */
 int exprFree(exprObj *obj)
 {
+  exprAllocator alloc;
+
   if(obj == NULL)
     return EXPR_ERROR_NOERROR;
 
-  /* First free the node data */
-  exprFreeNodeData(obj->headnode);
-  exprFreeMem(obj->headnode);
+  alloc = obj->alloc;
+
+  /* Free the compiled program, its machine code and token list */
+  exprFreeJit(&alloc, obj->jit);
+  exprFreeProgram(&alloc, obj->program);
+  exprFreeFrom(&alloc, obj->tokens);
+  exprSetProfile(obj, 0);
+
+  EXPR_STAT_ADD(EXPR_STAT_BLOCK(), nodesfreed, obj->nodecount);
+
+  /* The nodes are freed with our arena */
+  if(obj->ownarena)
+    exprArenaFree(obj->arena);
 
   /* Free ourself */
-  exprFreeMem(obj);
+  exprFreeFrom(&alloc, obj);
 
   return EXPR_ERROR_NOERROR;
 }
@@ -68,11 +89,24 @@ int exprClear(exprObj *obj)
   if(obj == NULL)
     return EXPR_ERROR_NOERROR;
 
-  /* Free the node data only, keep function, variable, constant lists */
-  exprFreeNodeData(obj->headnode);
-  exprFreeMem(obj->headnode);
+  /* Free the node data only, keep function, variable, constant lists.
+     Our own arena keeps its memory for the next parse. */
+  exprFreeJit(&(obj->alloc), obj->jit);
+  exprFreeProgram(&(obj->alloc), obj->program);
+
+  /* The profile counts nodes that are being freed */
+  if(obj->profile)
+    exprProfileClear(obj->profile);
+
+  if(obj->ownarena)
+    exprArenaReset(obj->arena);
+
+  EXPR_STAT_ADD(EXPR_STAT_BLOCK(), nodesfreed, obj->nodecount);
 
   obj->headnode = NULL;
+  obj->nodecount = 0;
+  obj->program = NULL;
+  obj->jit = NULL;
   obj->parsedbad = 0;
   obj->parsedgood = 0;
 
@@ -152,84 +186,92 @@ void exprSetBreakCount(exprObj *obj, int count)
     }
 }
 
-/* Get error position */
-void exprGetErrorPosition(exprObj *obj, int *start, int *end)
+/* Ask evaluations of an expression and its contexts to stop with
+   EXPR_ERROR_BREAK the next time they check, or allow them again if
+   cancel is zero.  May be called from another thread. */
+void exprSetCancel(exprObj *obj, int cancel)
 {
   if(obj)
+    EXPR_FLAG_SET(obj->cancel, cancel != 0);
+}
+
+/* Get whether evaluations of an expression are cancelled */
+int exprGetCancel(exprObj *obj)
+{
+  return (obj == NULL) ? 0 : EXPR_FLAG_GET(obj->cancel);
+}
+
+/* Check whether an evaluation should stop, counting cost against
+   the break count.  Evaluations check at the end of each pass
+   through a loop and between blocks of rows, and custom functions
+   that loop should do the same.  Returns EXPR_ERROR_BREAK if the
+   expression was cancelled or the breaker function says so. */
+int exprCheckBreak(exprObj *obj, int cost)
+{
+  if(obj == NULL)
+    return EXPR_ERROR_NOERROR;
+
+  /* Counted as nodes evaluated when the evaluation is counted */
+  obj->loopnodes += cost;
+
+  if(EXPR_FLAG_GET(obj->cancel))
+    return EXPR_ERROR_BREAK;
+
+  if(obj->breakerfunc == NULL)
+    return EXPR_ERROR_NOERROR;
+
+  obj->breakcur -= cost;
+  if(obj->breakcur <= 0)
     {
-      if(start)
-        *start = obj->starterr;
+      obj->breakcur = obj->breakcount;
+      EXPR_STAT_ADD(EXPR_STAT_BLOCK(), breaks, 1);
 
-      if(end)
-        *end = obj->enderr;
+      if((*(obj->breakerfunc))(obj))
+        return EXPR_ERROR_BREAK;
     }
+
+  return EXPR_ERROR_NOERROR;
 }
 
-/* This function will free a node's data */
-static void exprFreeNodeData(exprNode *node)
+/* Set whether exprParse compiles the expression */
+void exprSetCompile(exprObj *obj, int compile)
 {
-  int pos;
+  if(obj)
+    obj->compile = compile;
+}
+
+/* Set the arena to parse into.  The caller must not reset or free it
+   while the expression is parsed.  NULL makes the expression use its
+   own arena. */
+int exprSetArena(exprObj *obj, exprArena *arena)
+{
+  if(obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(obj->parsedbad != 0)
+    return EXPR_ERROR_ALREADYPARSEDBAD;
+
+  if(obj->parsedgood != 0)
+    return EXPR_ERROR_ALREADYPARSEDGOOD;
 
-  if(node == NULL)
-    return;
+  if(obj->ownarena)
+    exprArenaFree(obj->arena);
 
-  /* free data based on type */
-  switch(node->type)
+  obj->arena = arena;
+  obj->ownarena = 0;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Get error position */
+void exprGetErrorPosition(exprObj *obj, int *start, int *end)
+{
+  if(obj)
     {
-      case EXPR_NODETYPE_ADD:
-      case EXPR_NODETYPE_SUBTRACT:
-      case EXPR_NODETYPE_MULTIPLY:
-      case EXPR_NODETYPE_DIVIDE:
-      case EXPR_NODETYPE_EXPONENT:
-      case EXPR_NODETYPE_NEGATE:
-      case EXPR_NODETYPE_MULTI:
-        /* Free operation data */
-        if(node->data.oper.nodes)
-          {
-            for(pos = 0; pos < node->data.oper.nodecount; pos++)
-              exprFreeNodeData(&(node->data.oper.nodes[pos]));
-
-            exprFreeMem(node->data.oper.nodes);
-          }
-
-        break;
-
-
-      case EXPR_NODETYPE_VALUE:
-        /* Nothing to free for value */
-        break;
-
-      case EXPR_NODETYPE_VARIABLE:
-        /* Nothing to free for variable */
-        break;
-
-      case EXPR_NODETYPE_FUNCTION:
-        /* Free data of each subnode */
-        if(node->data.function.nodes)
-          {
-            for(pos = 0; pos < node->data.function.nodecount; pos++)
-              exprFreeNodeData(&(node->data.function.nodes[pos]));
-
-            /* Free the subnode array */
-            exprFreeMem(node->data.function.nodes);
-          }
-
-        /* Free reference variable list */
-        if(node->data.function.refs)
-          exprFreeMem(node->data.function.refs);
-
-        break;
-
-      case EXPR_NODETYPE_ASSIGN:
-        /* Free subnode data */
-        if(node->data.assign.node)
-          {
-            exprFreeNodeData(node->data.assign.node);
-
-            /* Free the subnode */
-            exprFreeMem(node->data.assign.node);
-          }
-
-        break;
+      if(start)
+        *start = obj->starterr;
+
+      if(end)
+        *end = obj->enderr;
     }
 }
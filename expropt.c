@@ -0,0 +1,754 @@
+/*
+  File: expropt.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Optimize a parsed expression
+
+  This file is part of ExprEval.
+*/
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+
+/* Subexpression that may be evaluated once */
+typedef struct _exprOptSub
+{
+  exprNode *node; /* The node */
+  unsigned int hash; /* Hash of the structure */
+  int stamp; /* When the node is done being evaluated */
+  int start; /* Index of the first subexpression inside it */
+  int first; /* Earlier identical subexpression with the value, -1 if none */
+  int next; /* Next subexpression with the same hash, -1 if none */
+  EXPRTYPE *temp; /* Hidden variable with the value, NULL if not needed */
+} exprOptSub;
+
+/* When a variable was last written */
+typedef struct _exprOptWrite
+{
+  EXPRTYPE *addr; /* The variable, NULL for an empty entry */
+  int stamp; /* When it was written */
+} exprOptWrite;
+
+/* State for finding common subexpressions */
+typedef struct _exprOptCSE
+{
+  exprObj *obj; /* Expression being optimized */
+  exprOptSub *subs; /* Subexpressions in the order they are done */
+  int subcount; /* Number of subexpressions */
+  int *buckets; /* First subexpression for each hash, -1 if none */
+  exprOptWrite *writes; /* Hash table of written variables */
+  int mask; /* Size of buckets and writes less one */
+  int stamp; /* Counts steps of the evaluation */
+  int killall; /* When a function that may change anything last ran */
+} exprOptCSE;
+
+
+/* Internal functions */
+static int exprOptimizeNode(exprObj *obj, exprNode *node, int flags);
+static void exprOptimizeFold(exprObj *obj, exprNode *node);
+static void exprOptimizeSimplify(exprNode *node, int flags);
+static int exprOptimizeIsConstant(exprObj *obj, EXPRTYPE *addr);
+static int exprOptimizeIsValue(exprNode *node, EXPRTYPE value);
+static void exprOptimizeReplace(exprNode *node, int keep);
+static int exprOptimizeCSE(exprObj *obj);
+static int exprOptimizeCount(exprNode *node);
+static void exprOptimizeScan(exprOptCSE *cse, exprNode *node, int cond, unsigned int *hash, int *pure);
+static int exprOptimizeSame(exprNode *node1, exprNode *node2);
+static int exprOptimizeUnchanged(exprOptCSE *cse, exprNode *node, int stamp);
+static int exprOptimizeWrite(exprOptCSE *cse, EXPRTYPE *addr, int stamp);
+static unsigned int exprOptimizeMix(unsigned int hash, void *data, size_t size);
+
+
+/* Optimize a parsed expression.  Subexpressions that only use
+   numbers are evaluated once and replaced by their value.  With
+   EXPR_OPT_CONSTANTS, constants are treated as numbers, so later
+   changes to the constant list will not be seen.  With
+   EXPR_OPT_SIMPLIFY, operations that do nothing are removed.
+   EXPR_OPT_STRICT limits this to changes that give the exact
+   same results and errors.  With EXPR_OPT_CSE, subexpressions
+   that are repeated with the same values are evaluated once. */
+int exprOptimize(exprObj *obj, int flags)
+{
+  int err;
+  int jit;
+
+  if(obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  /* Must have parsed successfully */
+  if(obj->parsedbad || !obj->parsedgood || obj->headnode == NULL)
+    return EXPR_ERROR_BADEXPR;
+
+  err = exprOptimizeNode(obj, obj->headnode, flags);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  /* After the other changes, which can make subexpressions equal */
+  if(flags & EXPR_OPT_CSE)
+    {
+      err = exprOptimizeCSE(obj);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+    }
+
+  /* Counts of the nodes from before the changes */
+  if(obj->profile)
+    exprProfileClear(obj->profile);
+
+  /* The program and its machine code must match the nodes */
+  if(obj->program)
+    {
+      jit = (obj->jit != NULL);
+
+      err = exprCompile(obj);
+      if(err == EXPR_ERROR_NOERROR && jit)
+        err = exprJitCompile(obj);
+
+      return err;
+    }
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Optimize a node after its subnodes */
+static int exprOptimizeNode(exprObj *obj, exprNode *node, int flags)
+{
+  int pos;
+  int err;
+
+  switch(node->type)
+    {
+      case EXPR_NODETYPE_MULTI:
+      case EXPR_NODETYPE_ADD:
+      case EXPR_NODETYPE_SUBTRACT:
+      case EXPR_NODETYPE_MULTIPLY:
+      case EXPR_NODETYPE_DIVIDE:
+      case EXPR_NODETYPE_EXPONENT:
+      case EXPR_NODETYPE_NEGATE:
+        for(pos = 0; pos < node->data.oper.nodecount; pos++)
+          {
+            err = exprOptimizeNode(obj, &(node->data.oper.nodes[pos]), flags);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+          }
+
+        break;
+
+      case EXPR_NODETYPE_FUNCTION:
+        for(pos = 0; pos < node->data.function.nodecount; pos++)
+          {
+            err = exprOptimizeNode(obj, &(node->data.function.nodes[pos]), flags);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+          }
+
+        break;
+
+      case EXPR_NODETYPE_ASSIGN:
+        return exprOptimizeNode(obj, node->data.assign.node, flags);
+
+      case EXPR_NODETYPE_VARIABLE:
+        /* Frozen constants become values */
+        if((flags & EXPR_OPT_CONSTANTS) && exprOptimizeIsConstant(obj, node->data.variable.vaddr))
+          {
+            EXPRTYPE value = *(node->data.variable.vaddr);
+
+            node->type = EXPR_NODETYPE_VALUE;
+            node->data.value.value = value;
+          }
+
+        return EXPR_ERROR_NOERROR;
+
+      default:
+        return EXPR_ERROR_NOERROR;
+    }
+
+  if(flags & (EXPR_OPT_FOLD | EXPR_OPT_CONSTANTS))
+    exprOptimizeFold(obj, node);
+
+  if(flags & EXPR_OPT_SIMPLIFY)
+    exprOptimizeSimplify(node, flags);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Replace a node by its value if all subnodes are values and the
+   node has no side effects.  A node that fails to evaluate is
+   left alone so the error still happens at evaluation time. */
+static void exprOptimizeFold(exprObj *obj, exprNode *node)
+{
+  exprNode *nodes;
+  int count, pos;
+  EXPRTYPE value;
+
+  if(node->type == EXPR_NODETYPE_FUNCTION)
+    {
+      /* Only functions whose result depends on nothing but the
+         arguments, and that change nothing, can be done early */
+      if((node->data.function.flags & (EXPR_FUNC_PURE | EXPR_FUNC_DETERMINISTIC)) !=
+        (EXPR_FUNC_PURE | EXPR_FUNC_DETERMINISTIC) || node->data.function.refcount != 0)
+        {
+          return;
+        }
+
+      /* A loop with a true condition would never end */
+      if(node->data.function.fptr == NULL && node->data.function.type == EXPR_NODEFUNC_FOR)
+        return;
+
+      nodes = node->data.function.nodes;
+      count = node->data.function.nodecount;
+    }
+  else
+    {
+      nodes = node->data.oper.nodes;
+      count = node->data.oper.nodecount;
+    }
+
+  for(pos = 0; pos < count; pos++)
+    {
+      if(nodes[pos].type != EXPR_NODETYPE_VALUE)
+        return;
+    }
+
+  if(exprEvalNode(obj, node, 0, &value) != EXPR_ERROR_NOERROR)
+    return;
+
+  /* The subnodes stay in the arena until the expression is cleared */
+  node->type = EXPR_NODETYPE_VALUE;
+  node->data.value.value = value;
+}
+
+/* Remove operations that do nothing */
+static void exprOptimizeSimplify(exprNode *node, int flags)
+{
+  exprNode *nodes;
+  int strict = (flags & EXPR_OPT_STRICT);
+
+  switch(node->type)
+    {
+      case EXPR_NODETYPE_ADD:
+        /* x+0 is 0 instead of x for x = -0, but x+-0 is always x */
+        nodes = node->data.oper.nodes;
+
+        if(exprOptimizeIsValue(&(nodes[1]), -0.0) || (!strict && exprOptimizeIsValue(&(nodes[1]), 0.0)))
+          exprOptimizeReplace(node, 0);
+        else if(exprOptimizeIsValue(&(nodes[0]), -0.0) || (!strict && exprOptimizeIsValue(&(nodes[0]), 0.0)))
+          exprOptimizeReplace(node, 1);
+
+        break;
+
+      case EXPR_NODETYPE_SUBTRACT:
+        nodes = node->data.oper.nodes;
+
+        if(exprOptimizeIsValue(&(nodes[1]), 0.0) || (!strict && exprOptimizeIsValue(&(nodes[1]), -0.0)))
+          exprOptimizeReplace(node, 0);
+
+        break;
+
+      case EXPR_NODETYPE_MULTIPLY:
+        if(exprOptimizeIsValue(&(node->data.oper.nodes[1]), 1.0))
+          exprOptimizeReplace(node, 0);
+        else if(exprOptimizeIsValue(&(node->data.oper.nodes[0]), 1.0))
+          exprOptimizeReplace(node, 1);
+
+        break;
+
+      case EXPR_NODETYPE_DIVIDE:
+        if(exprOptimizeIsValue(&(node->data.oper.nodes[1]), 1.0))
+          exprOptimizeReplace(node, 0);
+
+        break;
+
+      case EXPR_NODETYPE_EXPONENT:
+        nodes = node->data.oper.nodes;
+
+        if(exprOptimizeIsValue(&(nodes[1]), 1.0))
+          {
+            exprOptimizeReplace(node, 0);
+          }
+        else if(exprOptimizeIsValue(&(nodes[1]), 2.0) && !strict &&
+          nodes[0].type == EXPR_NODETYPE_VARIABLE)
+          {
+            /* x*x does not report overflow like pow does */
+            node->type = EXPR_NODETYPE_MULTIPLY;
+            nodes[1] = nodes[0];
+          }
+
+        break;
+
+      case EXPR_NODETYPE_NEGATE:
+        nodes = node->data.oper.nodes;
+
+        if(nodes[0].type == EXPR_NODETYPE_NEGATE)
+          {
+            /* Skip the outer node and keep the inner one's subnode */
+            exprOptimizeReplace(node, 0);
+            exprOptimizeReplace(node, 0);
+          }
+
+        break;
+
+      case EXPR_NODETYPE_FUNCTION:
+        nodes = node->data.function.nodes;
+
+        /* Only one side of an if with a known condition is used */
+        if(node->data.function.fptr == NULL && node->data.function.type == EXPR_NODEFUNC_IF &&
+          nodes[0].type == EXPR_NODETYPE_VALUE)
+          {
+            exprOptimizeReplace(node, (nodes[0].data.value.value != 0.0) ? 1 : 2);
+          }
+
+        break;
+    }
+}
+
+/* Is the address that of a constant? */
+static int exprOptimizeIsConstant(exprObj *obj, EXPRTYPE *addr)
+{
+  EXPRTYPE *caddr;
+  void *cookie;
+
+  if(obj->clist == NULL)
+    return 0;
+
+  cookie = exprValListGetNext(obj->clist, NULL, NULL, &caddr, NULL);
+  while(cookie)
+    {
+      if(caddr == addr)
+        return 1;
+
+      cookie = exprValListGetNext(obj->clist, NULL, NULL, &caddr, cookie);
+    }
+
+  return 0;
+}
+
+/* Is the node exactly the given value?  0 and -0 are different */
+static int exprOptimizeIsValue(exprNode *node, EXPRTYPE value)
+{
+  return (node->type == EXPR_NODETYPE_VALUE &&
+    memcmp(&(node->data.value.value), &value, sizeof(EXPRTYPE)) == 0);
+}
+
+/* Replace a node by one of its subnodes.  The others stay in the
+   arena until the expression is cleared. */
+static void exprOptimizeReplace(exprNode *node, int keep)
+{
+  if(node->type == EXPR_NODETYPE_FUNCTION)
+    *node = node->data.function.nodes[keep];
+  else
+    *node = node->data.oper.nodes[keep];
+}
+
+/* Evaluate repeated subexpressions once.  The first one keeps its
+   value in a hidden variable and later ones use that variable.  Only
+   subexpressions without side effects are used, the earlier one must
+   always be evaluated before the later one, and no variable it uses
+   may change in between.  So the results and errors are the same. */
+static int exprOptimizeCSE(exprObj *obj)
+{
+  exprOptCSE cse;
+  exprOptSub *sub, *first;
+  exprNode *copy;
+  unsigned int hash;
+  int size, pos, end;
+  int pure;
+  char *dead;
+  int err;
+
+  memset(&cse, 0, sizeof(exprOptCSE));
+  cse.obj = obj;
+
+  /* Tables with room for every node */
+  size = exprOptimizeCount(obj->headnode);
+
+  cse.mask = 15;
+  while(cse.mask < size * 2)
+    cse.mask = (cse.mask << 1) | 1;
+
+  cse.subs = exprAllocMem(size * sizeof(exprOptSub));
+  cse.buckets = exprAllocMem((cse.mask + 1) * sizeof(int));
+  cse.writes = exprAllocMem((cse.mask + 1) * sizeof(exprOptWrite));
+  dead = exprAllocMem(size);
+
+  if(cse.subs == NULL || cse.buckets == NULL || cse.writes == NULL || dead == NULL)
+    {
+      err = EXPR_ERROR_MEMORY;
+      goto cleanup;
+    }
+
+  for(pos = 0; pos <= cse.mask; pos++)
+    cse.buckets[pos] = -1;
+
+  exprOptimizeScan(&cse, obj->headnode, 0, &hash, &pure);
+
+  /* Subexpressions come after the ones inside them, so going
+     backward finds the largest repeated ones first */
+  for(pos = cse.subcount - 1; pos >= 0; pos--)
+    {
+      sub = &(cse.subs[pos]);
+
+      if(sub->first < 0 || dead[pos])
+        continue;
+
+      /* The first one can not be inside a repeated one, since that
+         one would have an earlier copy of it */
+      first = &(cse.subs[sub->first]);
+
+      if(first->temp == NULL)
+        {
+          copy = exprAllocNodes(obj->arena, 1);
+          first->temp = exprArenaAlloc(obj->arena, sizeof(EXPRTYPE), EXPR_MEM_ALIGN);
+
+          if(copy == NULL || first->temp == NULL)
+            {
+              err = EXPR_ERROR_MEMORY;
+              goto cleanup;
+            }
+
+          obj->nodecount++;
+          EXPR_STAT_ADD(EXPR_STAT_BLOCK(), nodesmade, 1);
+
+          *(first->temp) = 0.0;
+
+          /* Keep the value while evaluating it */
+          *copy = *(first->node);
+          first->node->type = EXPR_NODETYPE_ASSIGN;
+          first->node->data.assign.vaddr = first->temp;
+          first->node->data.assign.node = copy;
+        }
+
+      /* The nodes inside stay in the arena until the expression is
+         cleared */
+      sub->node->type = EXPR_NODETYPE_VARIABLE;
+      sub->node->data.variable.vaddr = first->temp;
+
+      for(end = sub->start; end < pos; end++)
+        dead[end] = 1;
+    }
+
+  err = EXPR_ERROR_NOERROR;
+
+cleanup:
+  exprFreeMem(cse.subs);
+  exprFreeMem(cse.buckets);
+  exprFreeMem(cse.writes);
+  exprFreeMem(dead);
+
+  return err;
+}
+
+/* Count the nodes and reference variables of a node */
+static int exprOptimizeCount(exprNode *node)
+{
+  int count = 1;
+  int pos;
+
+  switch(node->type)
+    {
+      case EXPR_NODETYPE_MULTI:
+      case EXPR_NODETYPE_ADD:
+      case EXPR_NODETYPE_SUBTRACT:
+      case EXPR_NODETYPE_MULTIPLY:
+      case EXPR_NODETYPE_DIVIDE:
+      case EXPR_NODETYPE_EXPONENT:
+      case EXPR_NODETYPE_NEGATE:
+        for(pos = 0; pos < node->data.oper.nodecount; pos++)
+          count += exprOptimizeCount(&(node->data.oper.nodes[pos]));
+
+        break;
+
+      case EXPR_NODETYPE_FUNCTION:
+        for(pos = 0; pos < node->data.function.nodecount; pos++)
+          count += exprOptimizeCount(&(node->data.function.nodes[pos]));
+
+        count += node->data.function.refcount;
+        break;
+
+      case EXPR_NODETYPE_ASSIGN:
+        count += exprOptimizeCount(node->data.assign.node);
+        break;
+    }
+
+  return count;
+}
+
+/* Visit nodes in the order they are evaluated, finding the hash of
+   each and if it has side effects.  Nodes that are evaluated every
+   time the part of the expression they are in is (cond is 0) and
+   that have no side effects are subexpressions.  Each is matched to
+   an earlier identical one if there is one with the same values. */
+static void exprOptimizeScan(exprOptCSE *cse, exprNode *node, int cond, unsigned int *hash, int *pure)
+{
+  exprOptSub *sub;
+  exprNode *nodes;
+  unsigned int subhash;
+  int count, pos, start;
+  int subpure, flags, argcond;
+  int cur;
+
+  *hash = exprOptimizeMix(2166136261U, &(node->type), sizeof(int));
+  *pure = 1;
+  start = cse->subcount;
+
+  switch(node->type)
+    {
+      case EXPR_NODETYPE_VALUE:
+        *hash = exprOptimizeMix(*hash, &(node->data.value.value), sizeof(EXPRTYPE));
+        return;
+
+      case EXPR_NODETYPE_VARIABLE:
+        *hash = exprOptimizeMix(*hash, &(node->data.variable.vaddr), sizeof(EXPRTYPE*));
+        return;
+
+      case EXPR_NODETYPE_ASSIGN:
+        exprOptimizeScan(cse, node->data.assign.node, cond, &subhash, &subpure);
+        exprOptimizeWrite(cse, node->data.assign.vaddr, ++cse->stamp);
+
+        *pure = 0;
+        return;
+
+      case EXPR_NODETYPE_MULTI:
+      case EXPR_NODETYPE_ADD:
+      case EXPR_NODETYPE_SUBTRACT:
+      case EXPR_NODETYPE_MULTIPLY:
+      case EXPR_NODETYPE_DIVIDE:
+      case EXPR_NODETYPE_EXPONENT:
+      case EXPR_NODETYPE_NEGATE:
+        for(pos = 0; pos < node->data.oper.nodecount; pos++)
+          {
+            exprOptimizeScan(cse, &(node->data.oper.nodes[pos]), cond, &subhash, &subpure);
+
+            *hash = exprOptimizeMix(*hash, &subhash, sizeof(unsigned int));
+            *pure = *pure && subpure;
+          }
+
+        /* The statements are not a value to keep */
+        if(node->type == EXPR_NODETYPE_MULTI)
+          return;
+
+        break;
+
+      case EXPR_NODETYPE_FUNCTION:
+        nodes = node->data.function.nodes;
+        count = node->data.function.nodecount;
+
+        flags = node->data.function.flags;
+
+        *hash = exprOptimizeMix(*hash, &(node->data.function.type), sizeof(int));
+        *hash = exprOptimizeMix(*hash, &(node->data.function.fptr), sizeof(exprFuncType));
+
+        if(node->data.function.eager)
+          *hash = exprOptimizeMix(*hash, &(node->data.function.eager->eptr), sizeof(exprEagerFuncType));
+
+        for(pos = 0; pos < count; pos++)
+          {
+            /* Only the first argument of the built in ones is always
+               evaluated, custom ones may evaluate none */
+            if(flags & EXPR_FUNC_EVALNODES)
+              {
+                argcond = (node->data.function.fptr != NULL || pos > 0);
+                exprOptimizeScan(cse, &(nodes[pos]), cond || argcond, &subhash, &subpure);
+              }
+            else
+              exprOptimizeScan(cse, &(nodes[pos]), cond, &subhash, &subpure);
+
+            *hash = exprOptimizeMix(*hash, &subhash, sizeof(unsigned int));
+            *pure = *pure && subpure;
+          }
+
+        /* Results using reference parameters are not kept */
+        if(node->data.function.refcount != 0)
+          *pure = 0;
+
+        if(flags & EXPR_FUNC_WRITEREFS)
+          {
+            for(pos = 0; pos < node->data.function.refcount; pos++)
+              exprOptimizeWrite(cse, node->data.function.refs[pos], ++cse->stamp);
+          }
+
+        /* It can change any variable */
+        if(!(flags & EXPR_FUNC_PURE))
+          {
+            cse->killall = ++cse->stamp;
+            *pure = 0;
+          }
+
+        if(!(flags & EXPR_FUNC_DETERMINISTIC))
+          *pure = 0;
+
+        /* Loops usually assign */
+        if(node->data.function.fptr == NULL && node->data.function.type == EXPR_NODEFUNC_FOR)
+          *pure = 0;
+
+        break;
+
+      default:
+        *pure = 0;
+        return;
+    }
+
+  if(!*pure || cond)
+    return;
+
+  sub = &(cse->subs[cse->subcount]);
+  sub->node = node;
+  sub->hash = *hash;
+  sub->stamp = ++cse->stamp;
+  sub->start = start;
+  sub->first = -1;
+  sub->temp = NULL;
+
+  /* Find an earlier one with nothing it uses written since */
+  for(cur = cse->buckets[*hash & cse->mask]; cur >= 0; cur = cse->subs[cur].next)
+    {
+      if(cse->subs[cur].hash == *hash && cse->subs[cur].stamp > cse->killall &&
+        exprOptimizeSame(cse->subs[cur].node, node) &&
+        exprOptimizeUnchanged(cse, node, cse->subs[cur].stamp))
+        {
+          sub->first = cur;
+          break;
+        }
+    }
+
+  /* Only the first ones are found again */
+  if(sub->first < 0)
+    {
+      sub->next = cse->buckets[*hash & cse->mask];
+      cse->buckets[*hash & cse->mask] = cse->subcount;
+    }
+
+  cse->subcount++;
+}
+
+/* Are two nodes without side effects the same? */
+static int exprOptimizeSame(exprNode *node1, exprNode *node2)
+{
+  exprNode *nodes1, *nodes2;
+  int count, pos;
+
+  if(node1->type != node2->type)
+    return 0;
+
+  switch(node1->type)
+    {
+      case EXPR_NODETYPE_VALUE:
+        return (memcmp(&(node1->data.value.value), &(node2->data.value.value), sizeof(EXPRTYPE)) == 0);
+
+      case EXPR_NODETYPE_VARIABLE:
+        return (node1->data.variable.vaddr == node2->data.variable.vaddr);
+
+      case EXPR_NODETYPE_FUNCTION:
+        if(node1->data.function.type != node2->data.function.type ||
+          node1->data.function.fptr != node2->data.function.fptr ||
+          node1->data.function.nodecount != node2->data.function.nodecount)
+          {
+            return 0;
+          }
+
+        if(node1->data.function.eager &&
+          node1->data.function.eager->eptr != node2->data.function.eager->eptr)
+          {
+            return 0;
+          }
+
+        nodes1 = node1->data.function.nodes;
+        nodes2 = node2->data.function.nodes;
+        count = node1->data.function.nodecount;
+        break;
+
+      default:
+        if(node1->data.oper.nodecount != node2->data.oper.nodecount)
+          return 0;
+
+        nodes1 = node1->data.oper.nodes;
+        nodes2 = node2->data.oper.nodes;
+        count = node1->data.oper.nodecount;
+        break;
+    }
+
+  for(pos = 0; pos < count; pos++)
+    {
+      if(!exprOptimizeSame(&(nodes1[pos]), &(nodes2[pos])))
+        return 0;
+    }
+
+  return 1;
+}
+
+/* Were all variables a node uses last written before stamp? */
+static int exprOptimizeUnchanged(exprOptCSE *cse, exprNode *node, int stamp)
+{
+  exprNode *nodes;
+  int count, pos;
+
+  switch(node->type)
+    {
+      case EXPR_NODETYPE_VALUE:
+        return 1;
+
+      case EXPR_NODETYPE_VARIABLE:
+        return (exprOptimizeWrite(cse, node->data.variable.vaddr, 0) < stamp);
+
+      case EXPR_NODETYPE_FUNCTION:
+        nodes = node->data.function.nodes;
+        count = node->data.function.nodecount;
+        break;
+
+      default:
+        nodes = node->data.oper.nodes;
+        count = node->data.oper.nodecount;
+        break;
+    }
+
+  for(pos = 0; pos < count; pos++)
+    {
+      if(!exprOptimizeUnchanged(cse, &(nodes[pos]), stamp))
+        return 0;
+    }
+
+  return 1;
+}
+
+/* Record when a variable is written, or with a stamp of 0 just get
+   when it was last written.  0 if it never was. */
+static int exprOptimizeWrite(exprOptCSE *cse, EXPRTYPE *addr, int stamp)
+{
+  exprOptWrite *cur;
+  unsigned int pos;
+
+  pos = exprOptimizeMix(2166136261U, &addr, sizeof(EXPRTYPE*)) & cse->mask;
+
+  /* Probe until the variable or an empty entry */
+  while(cse->writes[pos].addr != NULL && cse->writes[pos].addr != addr)
+    pos = (pos + 1) & cse->mask;
+
+  cur = &(cse->writes[pos]);
+
+  if(stamp == 0)
+    return (cur->addr == NULL) ? 0 : cur->stamp;
+
+  cur->addr = addr;
+  cur->stamp = stamp;
+
+  return stamp;
+}
+
+/* Add bytes to a hash, like exprHashName */
+static unsigned int exprOptimizeMix(unsigned int hash, void *data, size_t size)
+{
+  unsigned char *bytes = (unsigned char*)data;
+  unsigned long tmp = hash;
+
+  while(size-- > 0)
+    {
+      tmp ^= *bytes++;
+      tmp = (tmp * 16777619UL) & 0xFFFFFFFFUL;
+    }
+
+  return (unsigned int)tmp;
+}
@@ -14,18 +14,19 @@
 #include "exprmem.h"
 
 /* Data structure used by parser */
-typedef struct _exprToken
+struct _exprToken
 {
   int type; /* token type */
   int start; /* token start position */
   int end; /* token end position */
+  int len; /* token length */
 
   union _tdata
   {
-    char *str; /* string data */
+    char *str; /* identifier, not terminated, in the expression string */
     EXPRTYPE val; /* value data */
   } data;
-} exprToken;
+};
 
 /* Defines for token types */
 #define EXPR_TOKEN_UNKNOWN 0
@@ -43,444 +44,293 @@ typedef struct _exprToken
 #define EXPR_TOKEN_EQUAL 12
 #define EXPR_TOKEN_HAT 13
 
-/* Internal functions */
-int exprMultiParse(exprObj *obj, exprNode *node, exprToken *tokens, int count);
-int exprInternalParse(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end);
-int exprInternalParseAssign(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index);
-int exprInternalParseAdd(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index);
-int exprInternalParseSub(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index);
-int exprInternalParseMul(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index);
-int exprInternalParseDiv(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index);
-int exprInternalParsePosNeg(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index);
-int exprInternalParseExp(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index);
-int exprInternalParseFunction(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int p1, int p2);
-int exprInternalParseVarVal(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end);
-int exprStringToTokenList(exprObj *obj, char *expr, exprToken **tokens, int *count);
-void exprFreeTokenList(exprToken *tokens, int count);
+/* Operator precedence, higher is done first */
+#define EXPR_PREC_ADD 1 /* + and - */
+#define EXPR_PREC_MUL 2 /* * and / */
+#define EXPR_PREC_EXP 3 /* ^ */
+
+/* Function argument stack size for the first function call */
+#define EXPR_PARSE_STACKSIZE 16
 
-/* This frees a token list */
-void exprFreeTokenList(exprToken *tokens, int count)
+/* State of the parser while parsing the subexpressions */
+typedef struct _exprParser
 {
-  int pos;
+  exprObj *obj; /* Object being parsed */
+  exprToken *tokens; /* Token list, ending with a semicolon */
+  int pos; /* Index of the next token */
 
-  if(tokens == NULL)
-    return;
+  exprNode *args; /* Arguments of the functions being parsed */
+  int argcount; /* Number of arguments on the stack */
+  int argsize; /* Number of arguments with room */
 
-  for(pos = 0; pos < count; pos++)
-    {
-      if(tokens[pos].type == EXPR_TOKEN_IDENTIFIER)
-        exprFreeMem(tokens[pos].data.str);
-    }
+  EXPRTYPE **refs; /* Reference arguments of the functions being parsed */
+  int refcount; /* Number of reference arguments on the stack */
+  int refsize; /* Number of reference arguments with room */
+} exprParser;
 
-  exprFreeMem(tokens);
-}
+/* Internal functions */
+int exprInternalParseText(exprObj *obj, char *expr);
+int exprMultiParse(exprObj *obj, exprNode *node, exprToken *tokens, int count);
+int exprInternalParse(exprParser *parser, exprNode *node);
+int exprInternalParseAssign(exprParser *parser, exprNode *node);
+int exprInternalParseBinary(exprParser *parser, exprNode *node, int prec);
+int exprInternalParseUnary(exprParser *parser, exprNode *node);
+int exprInternalParsePrimary(exprParser *parser, exprNode *node);
+int exprInternalParseFunction(exprParser *parser, exprNode *node);
+int exprInternalParseVar(exprParser *parser, int index, int consterr, EXPRTYPE **addr);
+int exprInternalParsePushArg(exprParser *parser, exprNode *arg);
+int exprInternalParsePushRef(exprParser *parser, EXPRTYPE *addr);
+int exprInternalParseError(exprParser *parser, int first, int last, int err);
+void exprInternalParseSpanAdd(int start, int end, int *first, int *last);
+int exprStringToTokenList(exprObj *obj, char *expr, exprToken **tokens, int *count);
+EXPRTYPE exprParseValue(char *str, int len);
 
-/* This converts an expression string to a token list */
+/* This converts an expression string to a token list in a single
+   pass.  The list is kept by the object and grows as needed, and
+   identifiers point into the expression string. */
 int exprStringToTokenList(exprObj *obj, char *expr, exprToken **tokens, int *count)
 {
-  int found;
   exprToken *list;
-  int pass;
-  int pos, len;
+  int size;
+  int pos;
   int tpos;
-  int comment; /* Is a comment active */
-  int start, ilen;
-  char buf[EXPR_MAXIDENTSIZE + 1];
+  int type;
+  int start;
 
   /* Set initial variables */
-  found = 0;
   tpos = 0;
-  list = NULL;
-  comment = 0;
   *tokens = NULL;
   *count = 0;
 
-
   /* Check string length */
-  len = strlen(expr);
-  if(len == 0)
+  if(expr[0] == '\0')
     return EXPR_ERROR_EMPTYEXPR;
 
-  /* Two passes, one to count, one to tokenize */
-  for(pass = 0; pass <= 1; pass++)
+  for(pos = 0; expr[pos] != '\0'; pos++)
     {
-      for(pos = 0; pos < len; pos++)
+      start = pos;
+
+      switch(expr[pos])
         {
-          switch(expr[pos])
-            {
-              /* Comment */
-              case '#':
-                {
-                  /* Only set it if a comment is not already active */
-                  if(!comment)
-                    comment = 1;
+          /* Comment, skip to the end of the line */
+          case '#':
+            while(expr[pos + 1] != '\0' && expr[pos + 1] != '\r' && expr[pos + 1] != '\n')
+              pos++;
 
-                  break;
-                }
+            continue;
 
-                /* Newline characters turn off comments */
-              case '\r':
-              case '\n':
-                {
-                  /* If a comment is active, unset it */
-                  if(comment)
-                    comment = 0;
+          case '(':
+            type = EXPR_TOKEN_OPAREN;
+            break;
 
-                  break;
-                }
+          case ')':
+            type = EXPR_TOKEN_CPAREN;
+            break;
 
-                /* Open parenthesis */
-              case '(':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_OPAREN;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          case '+':
+            type = EXPR_TOKEN_PLUS;
+            break;
 
-                /* Close parenthesis */
-              case ')':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_CPAREN;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          case '-':
+            type = EXPR_TOKEN_HYPHEN;
+            break;
 
-                /* Plus */
-              case '+':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_PLUS;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          case '*':
+            type = EXPR_TOKEN_ASTERISK;
+            break;
 
-                /* Hyphen */
-              case '-':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_HYPHEN;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          case '/':
+            type = EXPR_TOKEN_FSLASH;
+            break;
 
-                /* Asterisk */
-              case '*':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_ASTERISK;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          case '^':
+            type = EXPR_TOKEN_HAT;
+            break;
 
-                /* Forward slash */
-              case '/':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_FSLASH;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          case '&':
+            type = EXPR_TOKEN_AMPERSAND;
+            break;
 
-                /* Hat */
-              case '^':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_HAT;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          case ';':
+            type = EXPR_TOKEN_SEMICOLON;
+            break;
 
-                /* Ampersand */
-              case '&':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_AMPERSAND;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          case ',':
+            type = EXPR_TOKEN_COMMA;
+            break;
 
-                /* Semicolon */
-              case ';':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_SEMICOLON;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          case '=':
+            type = EXPR_TOKEN_EQUAL;
+            break;
 
-                /* Comma */
-              case ',':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_COMMA;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+          /* Identifiers and values */
+          default:
+            if(expr[pos] == '.' || isdigit(expr[pos]))
+              {
+                /* Find digits before a period */
+                while(isdigit(expr[pos]))
+                  pos++;
 
-                /* Equal sign */
-              case '=':
-                {
-                  if(!comment)
-                    {
-                      if(pass == 0)
-                        found++;
-                      else
-                        {
-                          list[tpos].type = EXPR_TOKEN_EQUAL;
-                          list[tpos].start = pos;
-                          list[tpos].end = pos;
-                          tpos++;
-                        }
-                    }
-
-                  break;
-                }
+                /* Find a period */
+                if(expr[pos] == '.')
+                  pos++;
 
-                /* Identifiers and values */
-              default:
-                {
-                  if(!comment)
-                    {
-                      if(expr[pos] == '.' || isdigit(expr[pos]))
-                        {
-                          /* Value */
-                          start = pos;
-
-                          /* Find digits before a period */
-                          while(isdigit(expr[pos]))
-                            pos++;
-
-                          /* Find a period */
-                          if(expr[pos] == '.')
-                            pos++;
-
-                          /* Find digits after a period */
-                          while(isdigit(expr[pos]))
-                            pos++;
-
-                          /* pos is AFTER last item, back up */
-                          pos--;
-
-                          if(pass == 0)
-                            found++;
-                          else
-                            {
-                              ilen = pos - start + 1;
-
-                              /* Is the value to large */
-                              if(ilen > EXPR_MAXIDENTSIZE)
-                                {
-                                  obj->starterr = start;
-                                  obj->enderr = pos;
-                                  exprFreeTokenList(list, found);
-                                  return EXPR_ERROR_BADIDENTIFIER;
-                                }
-
-                              /* Create value token */
-                              strncpy(buf, expr + start, ilen);
-                              buf[ilen] = '\0';
-
-                              list[tpos].type = EXPR_TOKEN_VALUE;
-                              list[tpos].start = start;
-                              list[tpos].end = pos;
-                              list[tpos].data.val = (EXPRTYPE)atof(buf);
-                              tpos++;
-                            }
-                        }
-                      else if(expr[pos] == '_' || isalpha(expr[pos]))
-                        {
-                          /* Identifier */
-                          start = pos;
-
-                          /* Find rest of identifier */
-                          while(expr[pos] == '_' || isalnum(expr[pos]))
-                            pos++;
-
-                          /* pos is AFTER last item, back up */
-                          pos--;
-
-                          if(pass == 0)
-                            found++;
-                          else
-                            {
-                              ilen = pos - start + 1;
-
-                              /* Is the value to large */
-                              if(ilen > EXPR_MAXIDENTSIZE)
-                                {
-                                  obj->starterr = start;
-                                  obj->enderr = pos;
-                                  exprFreeTokenList(list, found);
-                                  return EXPR_ERROR_BADIDENTIFIER;
-                                }
-
-                              /* Create value token */
-                              strncpy(buf, expr + start, ilen);
-                              buf[ilen] = '\0';
-
-                              /* Allocate memory for identifier */
-                              list[tpos].data.str = exprAllocMem(ilen + 1);
-                              if(list[tpos].data.str == NULL)
-                                {
-                                  exprFreeTokenList(list, found);
-                                  return EXPR_ERROR_MEMORY;
-                                }
-
-                              list[tpos].type = EXPR_TOKEN_IDENTIFIER;
-                              list[tpos].start = start;
-                              list[tpos].end = pos;
-                              strcpy(list[tpos].data.str, buf);
-                              tpos++;
-                            }
-                        }
-                      else if(isspace(expr[pos]))
-                        {
-                          /* Spaces are ignored, do nothing */
-                        }
-                      else
-                        {
-                          /* Unknown */
-                          obj->starterr = obj->enderr = pos;
-                          exprFreeTokenList(list, found);
-                          return EXPR_ERROR_INVALIDCHAR;
-                        }
-                    }
-
-                  break;
-                }
-            }
+                /* Find digits after a period */
+                while(isdigit(expr[pos]))
+                  pos++;
+
+                /* pos is AFTER last item, back up */
+                pos--;
+
+                type = EXPR_TOKEN_VALUE;
+              }
+            else if(expr[pos] == '_' || isalpha(expr[pos]))
+              {
+                /* Find rest of identifier */
+                while(expr[pos] == '_' || isalnum(expr[pos]))
+                  pos++;
+
+                /* pos is AFTER last item, back up */
+                pos--;
+
+                type = EXPR_TOKEN_IDENTIFIER;
+              }
+            else if(isspace(expr[pos]))
+              {
+                /* Spaces are ignored */
+                continue;
+              }
+            else
+              {
+                /* Unknown */
+                obj->starterr = obj->enderr = pos;
+                return EXPR_ERROR_INVALIDCHAR;
+              }
+
+            /* Is the value or identifier to large */
+            if(pos - start + 1 > EXPR_MAXIDENTSIZE)
+              {
+                obj->starterr = start;
+                obj->enderr = pos;
+                return EXPR_ERROR_BADIDENTIFIER;
+              }
+
+            break;
         }
 
-      /* If pass is 0, allocate memory for next pass */
-      if(pass == 0)
+      /* Make room for the token */
+      if(tpos == obj->tokensize)
         {
-          /* First, make sure all comments were ended */
-          if(comment)
-            comment = 0;
+          size = obj->tokensize ? obj->tokensize * 2 : EXPR_TOKEN_INITSIZE;
 
-          /* Make sure the expression is not empty */
-          if(found == 0)
-            return EXPR_ERROR_EMPTYEXPR;
-
-          /* Allocate memory for token list */
-          list = exprAllocMem(found * sizeof(exprToken));
+          list = exprReallocFrom(&(obj->alloc), obj->tokens, size * sizeof(exprToken));
           if(list == NULL)
             return EXPR_ERROR_MEMORY;
 
-          tpos = 0;
+          obj->tokens = list;
+          obj->tokensize = size;
         }
+
+      list = &(obj->tokens[tpos++]);
+      list->type = type;
+      list->start = start;
+      list->end = pos;
+      list->len = pos - start + 1;
+
+      if(type == EXPR_TOKEN_VALUE)
+        list->data.val = exprParseValue(expr + start, list->len);
+      else
+        list->data.str = expr + start;
     }
 
-  *count = found;
-  *tokens = list;
+  /* Make sure the expression is not empty */
+  if(tpos == 0)
+    return EXPR_ERROR_EMPTYEXPR;
+
+  *count = tpos;
+  *tokens = obj->tokens;
   return EXPR_ERROR_NOERROR;
 }
 
+/* Convert the text of a value token.  With no more than 15
+   significant digits and 22 digits after the period, both the
+   digits and the power of ten are exact doubles, so a single
+   correctly rounded divide gives the exact result.  Other values,
+   and machines that divide with extra precision, use strtod. */
+EXPRTYPE exprParseValue(char *str, int len)
+{
+  static const double powers[] =
+    {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+  char buf[EXPR_MAXIDENTSIZE + 1];
+  double digits;
+  int pos, count, scale, period;
+
+  digits = 0.0;
+  count = scale = period = 0;
+
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD == 0
+  for(pos = 0; pos < len; pos++)
+    {
+      if(str[pos] == '.')
+        {
+          period = 1;
+          continue;
+        }
+
+      /* Leading zeros are not significant */
+      if(count != 0 || str[pos] != '0')
+        {
+          if(++count > 15)
+            break;
+
+          digits = digits * 10.0 + (str[pos] - '0');
+        }
+
+      if(period)
+        scale++;
+    }
+
+  if(pos == len && scale <= 22)
+    return (EXPRTYPE)(digits / powers[scale]);
+#endif
+
+  /* Value tokens are never longer than EXPR_MAXIDENTSIZE */
+  memcpy(buf, str, len);
+  buf[len] = '\0';
+
+  return (EXPRTYPE)strtod(buf, NULL);
+}
+
 
-/* This is the main parsing routine */
+/* This is the main parsing routine.  It counts the parse and the
+   nodes it made for exprGetStats. */
 int exprParse(exprObj *obj, char *expr)
+{
+  exprStatBlock *stat;
+  int before, err;
+
+  before = (obj == NULL) ? 0 : obj->nodecount;
+
+  err = exprInternalParseText(obj, expr);
+
+  stat = EXPR_STAT_BLOCK();
+  EXPR_STAT_ADD(stat, parses, 1);
+
+  if(err != EXPR_ERROR_NOERROR)
+    EXPR_STAT_ADD(stat, parseerrors[EXPR_STAT_CODE(err)], 1);
+
+  if(obj != NULL)
+    EXPR_STAT_ADD(stat, nodesmade, obj->nodecount - before);
+
+  return err;
+}
+
+
+/* Parse the text of an expression */
+int exprInternalParseText(exprObj *obj, char *expr)
 {
   exprToken *tokens;
   int count;
@@ -505,32 +355,48 @@ int exprParse(exprObj *obj, char *expr)
   if(expr == NULL)
     return EXPR_ERROR_NULLPOINTER;
 
+  /* Use our own arena unless one was given */
+  if(obj->arena == NULL)
+    {
+      err = exprArenaCreateEx(&(obj->arena), 0, &(obj->alloc));
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+
+      obj->ownarena = 1;
+    }
+
   /* Create token list */
   err = exprStringToTokenList(obj, expr, &tokens, &count);
   if(err != EXPR_ERROR_NOERROR)
     return err;
 
   /* Create head pointer */
-  tmp = exprAllocNodes(1);
+  tmp = exprAllocNodes(obj->arena, 1);
   if(tmp == NULL)
-    {
-      exprFreeTokenList(tokens, count);
-      return EXPR_ERROR_MEMORY;
-    }
+    return EXPR_ERROR_MEMORY;
 
   obj->headnode = tmp;
+  obj->nodecount++;
 
   /* Call the multiparse routine to parse subexpressions */
   err = exprMultiParse(obj, tmp, tokens, count);
 
-  /* Free the token list */
-  exprFreeTokenList(tokens, count);
-
   /* successful parse? */
   if(err == EXPR_ERROR_NOERROR)
     {
       obj->parsedgood = 1;
       obj->parsedbad = 0;
+
+      /* Compile if requested */
+      if(obj->compile)
+        {
+          err = exprCompile(obj);
+          if(err != EXPR_ERROR_NOERROR)
+            {
+              obj->parsedbad = 1;
+              obj->parsedgood = 0;
+            }
+        }
     }
   else
     {
@@ -548,6 +414,7 @@ int exprMultiParse(exprObj *obj, exprNode *node, exprToken *tokens, int count)
   int pos, plevel, last;
   int num, cur, err;
   exprNode *tmp;
+  exprParser parser;
 
   plevel = 0;
   num = 0;
@@ -616,524 +483,297 @@ int exprMultiParse(exprObj *obj, exprNode *node, exprToken *tokens, int count)
   /* Now we know how many arguments there are */
 
   /* Allocate array of subnodes */
-  tmp = exprAllocNodes(num);
+  tmp = exprAllocNodes(obj->arena, num);
   if(tmp == NULL)
     return EXPR_ERROR_MEMORY;
 
+  obj->nodecount += num;
+
   /* Set the current node's data */
   node->type = EXPR_NODETYPE_MULTI;
+  node->token = 0;
   node->data.oper.nodes = tmp;
   node->data.oper.nodecount = num;
 
-  /* now we parse each subexpression */
-  last = 0; /* Not for last semicolon, but for first char of subexpr */
-  cur = 0;
-
-  for(pos = 0; pos < count; pos++)
-    {
-      if(tokens[pos].type == EXPR_TOKEN_SEMICOLON)
-        {
-          /* Everything from last up to pos - 1 is a parameter */
-          err = exprInternalParse(obj, &(tmp[cur]), tokens, last, pos - 1);
-          if(err != EXPR_ERROR_NOERROR)
-            return err;
-
-          /* Update last position and current argument */
-          last = pos + 1;
-          cur++;
-        }
-    }
+  /* now we parse each subexpression.  The token list ends with a
+     semicolon, so the parser may always look at the next token
+     after anything but a semicolon. */
+  memset(&parser, 0, sizeof(exprParser));
+  parser.obj = obj;
+  parser.tokens = tokens;
 
-  return EXPR_ERROR_NOERROR;
-}
+  err = EXPR_ERROR_NOERROR;
 
-/* This function parses each subnode and recurses if needed */
-int exprInternalParse(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end)
-{
-  int pos;
-  int plevel = 0; /* Paren level */
-  int fgopen = -1; /* First paren group open index */
-  int fgclose = -1; /* First paren group close index */
-  int assignindex = -1; /* First = at plevel 0 for assignment */
-  int addsubindex = -1; /* Last + or - at plevel 0 for adding or subtracting */
-  int muldivindex = -1; /* Last * or / at plevel 0 for multiplying or dividing */
-  int expindex = -1; /* Last ^ fount at plevel 0 for exponents */
-  int posnegindex = -1; /* First +,- at plevel 0 for positive,negative */
-
-  /* Make sure some conditions are right */
-  if(start > end)
-    return EXPR_ERROR_UNKNOWN;
-
-  /* Scan the string for certain characters */
-  for(pos = start; pos <= end; pos++)
+  for(cur = 0; cur < num; cur++)
     {
-      switch(tokens[pos].type)
-        {
-          case EXPR_TOKEN_OPAREN:
-            plevel++;
-
-            /* First group open? */
-            if(plevel == 1 && fgopen == -1)
-              fgopen = pos;
-            break;
-
-          case EXPR_TOKEN_CPAREN:
-            plevel--;
-
-            /* First group close? */
-            if(plevel == 0 && fgclose == -1)
-              fgclose = pos;
-
-            if(plevel < 0)
-              {
-                obj->starterr = tokens[pos].start;
-                obj->enderr = tokens[pos].end;
-                return EXPR_ERROR_UNMATCHEDPAREN;
-              }
-            break;
-
-          case EXPR_TOKEN_EQUAL:
-            /* Assignment found */
-            if(plevel == 0)
-              {
-                if(assignindex == -1)
-                  assignindex = pos;
-              }
-            break;
-
-          case EXPR_TOKEN_ASTERISK:
-          case EXPR_TOKEN_FSLASH:
-            /* Multiplication or division */
-            if(plevel == 0)
-              muldivindex = pos;
-            break;
-
-          case EXPR_TOKEN_HAT:
-            /* Exponent */
-            if(plevel == 0)
-              expindex = pos;
-            break;
-
-
-          case EXPR_TOKEN_PLUS:
-          case EXPR_TOKEN_HYPHEN:
-            /* Addition or positive or subtraction or negative*/
-            if(plevel == 0)
-              {
-                if(pos == start)
-                  {
-                    /* At the start area, positive/negative */
-                    if(posnegindex == -1)
-                      posnegindex = pos;
-                  }
-                else
-                  {
-                    /* Not at start, check item in front */
-                    switch(tokens[pos - 1].type)
-                      {
-                        case EXPR_TOKEN_EQUAL: /* Equal sign */
-                        case EXPR_TOKEN_PLUS: /* Add/positive sign */
-                        case EXPR_TOKEN_HYPHEN: /* Subtract/negative sign */
-                        case EXPR_TOKEN_ASTERISK: /* Multiply sign */
-                        case EXPR_TOKEN_FSLASH: /* Divide sign */
-                        case EXPR_TOKEN_HAT: /* Exponent sign */
-
-                          /* After theses, it is positive/negative */
-                          if(posnegindex == -1)
-                            posnegindex = pos;
-
-                          break;
-
-                        default:
-                          /* Otherwise it is addition/subtraction */
-                          addsubindex = pos;
-                          break;
-                      }
-                  }
-              }
-            break;
+      err = exprInternalParse(&parser, &(tmp[cur]));
+      if(err != EXPR_ERROR_NOERROR)
+        break;
 
+      /* Anything left before the semicolon is an error */
+      if(tokens[parser.pos].type != EXPR_TOKEN_SEMICOLON)
+        {
+          err = exprInternalParseError(&parser, parser.pos, parser.pos, EXPR_ERROR_SYNTAX);
+          break;
         }
-    }
-
-  /* plevel should now be zero */
-  if(plevel != 0)
-    return EXPR_ERROR_UNMATCHEDPAREN;
-
-  /* We must parse the data in a certain order to maintain the
-     correct order of operators at evaluation time */
-
-  /* First, take care of assignment */
-  if(assignindex != -1)
-    return exprInternalParseAssign(obj, node, tokens, start, end, assignindex);
-
-  /* Addition or subtraction is next */
-  if(addsubindex != -1)
-    {
-      if(tokens[addsubindex].type == EXPR_TOKEN_PLUS)
-        return exprInternalParseAdd(obj, node, tokens, start, end, addsubindex);
-      else
-        return exprInternalParseSub(obj, node, tokens, start, end, addsubindex);
-    }
-
 
-  /* Multiplycation or division */
-  if(muldivindex != -1)
-    {
-      if(tokens[muldivindex].type == EXPR_TOKEN_ASTERISK)
-        return exprInternalParseMul(obj, node, tokens, start, end, muldivindex);
-      else
-        return exprInternalParseDiv(obj, node, tokens, start, end, muldivindex);
+      parser.pos++;
     }
 
-  /* Exponent */
-  if(expindex != -1)
-    return exprInternalParseExp(obj, node, tokens, start, end, expindex);
-
-  /* Negation */
-  if(posnegindex != -1)
-    return exprInternalParsePosNeg(obj, node, tokens, start, end, posnegindex);
+  exprFreeMem(parser.args);
+  exprFreeMem(parser.refs);
 
+  return err;
+}
 
-  /* Grouped parenthesis */
-  if(fgopen == start)
-    {
-      /* Closing paren. should be at the end */
-      if(fgclose == end)
-        {
-          /* Anything between them */
-          if(fgclose > fgopen + 1)
-            {
-              return exprInternalParse(obj, node, tokens, fgopen + 1, fgclose - 1);
-            }
-          else
-            {
-              /* Nothing between them */
-              obj->starterr = tokens[fgopen].start;
-              obj->enderr = tokens[fgclose].end;
-              return EXPR_ERROR_SYNTAX;
-            }
-        }
-      else /* Closing paren not at the end */
-        return EXPR_ERROR_SYNTAX;
-    }
+/* Parse an expression starting at the current token.  Parsing stops
+   at the first token that can not continue the expression. */
+int exprInternalParse(exprParser *parser, exprNode *node)
+{
+  exprToken *tokens = parser->tokens;
 
-  /* Functions */
-  if(fgopen > start)
-    {
-      /* Closing paren should be at end */
-      if(fgclose == end)
-        {
-          return exprInternalParseFunction(obj, node, tokens, start, end, fgopen, fgclose);
-        }
-      else /* Closing paren not at end */
-        return EXPR_ERROR_SYNTAX;
-    }
+  /* An identifier followed by an equal sign is an assignment */
+  if(tokens[parser->pos].type == EXPR_TOKEN_IDENTIFIER && tokens[parser->pos + 1].type == EXPR_TOKEN_EQUAL)
+    return exprInternalParseAssign(parser, node);
 
-  /* If it was none of the above, it must be a variable or value */
-  return exprInternalParseVarVal(obj, node, tokens, start, end);
+  return exprInternalParseBinary(parser, node, EXPR_PREC_ADD);
 }
 
 /* Function to parse an assignment node */
-int exprInternalParseAssign(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index)
+int exprInternalParseAssign(exprParser *parser, exprNode *node)
 {
   exprNode *tmp;
-  exprValList *l;
   EXPRTYPE *addr;
+  int index, err;
 
-  /* Make sure the equal sign is not at the start or end */
-  if(index != start + 1 || index >= end)
-    {
-      obj->starterr = tokens[index].start;
-      obj->enderr = tokens[index].end;
-      return EXPR_ERROR_SYNTAX;
-    }
-
-  /* Make sure item before equal sign is an identifier */
-  if(tokens[index - 1].type != EXPR_TOKEN_IDENTIFIER)
-    {
-      obj->starterr = tokens[index - 1].start;
-      obj->enderr = tokens[index].end;
-      return EXPR_ERROR_SYNTAX;
-    }
+  /* The identifier is before the equal sign */
+  index = parser->pos + 1;
 
   /* Create expression subnode */
-  tmp = exprAllocNodes(1);
+  tmp = exprAllocNodes(parser->obj->arena, 1);
   if(tmp == NULL)
-    {
-      return EXPR_ERROR_MEMORY;
-    }
+    return EXPR_ERROR_MEMORY;
 
+  parser->obj->nodecount++;
 
   /* Set the data */
   node->type = EXPR_NODETYPE_ASSIGN;
+  node->token = index;
   node->data.assign.node = tmp;
 
-
-  /*
-    The fast access method directly accesses the memory address
-    of the variable's value at evaluation time.  Because of this,
-    we must make sure the variable does exists in the variable list.
-  */
-
-  /* Make sure name is not a constant name */
-  l = exprGetConstList(obj);
-  if(l)
-    {
-      exprValListGetAddress(l, tokens[index - 1].data.str, &addr);
-      if(addr)
-        {
-          obj->starterr = tokens[index - 1].start;
-          obj->enderr = tokens[index].end;
-          return EXPR_ERROR_CONSTANTASSIGN;
-        }
-    }
-
-  /* Get the variable list */
-  l = exprGetVarList(obj);
-  if(l == NULL)
-    return EXPR_ERROR_NOVARLIST;
-
-  /* Get variable address if already in the list */
-  exprValListGetAddress(l, tokens[index - 1].data.str, &addr);
-  if(addr == NULL) /* Variable not in the list, add it */
+  /* The name must not be a constant */
+  err = exprInternalParseVar(parser, index - 1, EXPR_ERROR_CONSTANTASSIGN, &addr);
+  if(err != EXPR_ERROR_NOERROR)
     {
-      exprValListAdd(l, tokens[index - 1].data.str, 0.0);
+      if(err == EXPR_ERROR_CONSTANTASSIGN)
+        exprInternalParseError(parser, index - 1, index, err);
 
-      /* Try to get address again */
-      exprValListGetAddress(l, tokens[index - 1].data.str, &addr);
-      if(addr == NULL) /* Could not add variable */
-        return EXPR_ERROR_MEMORY; /* Could not add variable to list */
+      return err;
     }
 
   node->data.assign.vaddr = addr;
 
-  /* Parse the subnode */
-  return exprInternalParse(obj, tmp, tokens, index + 1, end);
+  /* Parse the subnode, which may be another assignment */
+  parser->pos = index + 1;
+  return exprInternalParse(parser, tmp);
 }
 
-/* Function to parse an addition operator */
-int exprInternalParseAdd(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index)
+/* Parse operators with at least the given precedence.  Operators of
+   the same precedence are done from left to right, so 2^3^2 is 64 */
+int exprInternalParseBinary(exprParser *parser, exprNode *node, int prec)
 {
   exprNode *tmp;
-  int err;
+  int type, opprec, err;
 
-  /* Make sure plus sign is at a good place */
-  if(index <= start || index >= end)
-    {
-      obj->starterr = tokens[index].start;
-      obj->enderr = tokens[index].end;
-      return EXPR_ERROR_SYNTAX;
-    }
-
-  /* Allocate space for 2 subnodes */
-  tmp = exprAllocNodes(2);
-  if(tmp == NULL)
-    return EXPR_ERROR_MEMORY;
-
-
-  /* Set the data */
-  node->type = EXPR_NODETYPE_ADD;
-  node->data.oper.nodes = tmp;
-  node->data.oper.nodecount = 2;
-
-  /* parse the left side */
-  err = exprInternalParse(obj, &(tmp[0]), tokens, start, index - 1);
+  /* Parse the left side */
+  err = exprInternalParseUnary(parser, node);
   if(err != EXPR_ERROR_NOERROR)
     return err;
 
-  /* parse the right side */
-  return exprInternalParse(obj, &(tmp[1]), tokens, index + 1, end);
-}
-
-/* Function to parse a subtraction operator */
-int exprInternalParseSub(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index)
-{
-  exprNode *tmp;
-  int err;
-
-  /* Make sure minus sign is at a good place */
-  if(index <= start || index >= end)
+  for(;;)
     {
-      obj->starterr = tokens[index].start;
-      obj->enderr = tokens[index].end;
-      return EXPR_ERROR_SYNTAX;
-    }
-
-  /* Allocate space for 2 subnodes */
-  tmp = exprAllocNodes(2);
-  if(tmp == NULL)
-    return EXPR_ERROR_MEMORY;
+      switch(parser->tokens[parser->pos].type)
+        {
+          case EXPR_TOKEN_PLUS:
+            type = EXPR_NODETYPE_ADD;
+            opprec = EXPR_PREC_ADD;
+            break;
 
+          case EXPR_TOKEN_HYPHEN:
+            type = EXPR_NODETYPE_SUBTRACT;
+            opprec = EXPR_PREC_ADD;
+            break;
 
-  /* Set the data */
-  node->type = EXPR_NODETYPE_SUBTRACT;
-  node->data.oper.nodes = tmp;
-  node->data.oper.nodecount = 2;
+          case EXPR_TOKEN_ASTERISK:
+            type = EXPR_NODETYPE_MULTIPLY;
+            opprec = EXPR_PREC_MUL;
+            break;
 
-  /* parse the left side */
-  err = exprInternalParse(obj, &(tmp[0]), tokens, start, index - 1);
-  if(err != EXPR_ERROR_NOERROR)
-    return err;
+          case EXPR_TOKEN_FSLASH:
+            type = EXPR_NODETYPE_DIVIDE;
+            opprec = EXPR_PREC_MUL;
+            break;
 
-  /* parse the right side */
-  return exprInternalParse(obj, &(tmp[1]), tokens, index + 1, end);
-}
+          case EXPR_TOKEN_HAT:
+            type = EXPR_NODETYPE_EXPONENT;
+            opprec = EXPR_PREC_EXP;
+            break;
 
-/* Function to parse a multiplication operator */
-int exprInternalParseMul(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index)
-{
-  exprNode *tmp;
-  int err;
+          default:
+            /* Not an operator */
+            return EXPR_ERROR_NOERROR;
+        }
 
-  /* Make sure times sign is at a good place */
-  if(index <= start || index >= end)
-    {
-      obj->starterr = tokens[index].start;
-      obj->enderr = tokens[index].end;
-      return EXPR_ERROR_SYNTAX;
-    }
+      /* Lower operators are for the caller */
+      if(opprec < prec)
+        return EXPR_ERROR_NOERROR;
 
+      /* Allocate space for 2 subnodes */
+      tmp = exprAllocNodes(parser->obj->arena, 2);
+      if(tmp == NULL)
+        return EXPR_ERROR_MEMORY;
 
-  /* Allocate space for 2 subnodes */
-  tmp = exprAllocNodes(2);
-  if(tmp == NULL)
-    return EXPR_ERROR_MEMORY;
+      parser->obj->nodecount += 2;
 
+      /* What we have so far is the left side */
+      tmp[0] = *node;
 
-  /* Set the data */
-  node->type = EXPR_NODETYPE_MULTIPLY;
-  node->data.oper.nodes = tmp;
-  node->data.oper.nodecount = 2;
+      node->type = type;
+      node->token = parser->pos + 1;
+      node->data.oper.nodes = tmp;
+      node->data.oper.nodecount = 2;
 
-  /* parse the left side */
-  err = exprInternalParse(obj, &(tmp[0]), tokens, start, index - 1);
-  if(err != EXPR_ERROR_NOERROR)
-    return err;
+      /* parse the right side, only higher operators are part of it */
+      parser->pos++;
 
-  /* parse the right side */
-  return exprInternalParse(obj, &(tmp[1]), tokens, index + 1, end);
+      err = exprInternalParseBinary(parser, &(tmp[1]), opprec + 1);
+      if(err != EXPR_ERROR_NOERROR)
+        return err;
+    }
 }
 
-/* Function to parse a division operator */
-int exprInternalParseDiv(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index)
+/* Function to parse for positive and negative.  These are done
+   before any other operator, so -2^2 is 4 */
+int exprInternalParseUnary(exprParser *parser, exprNode *node)
 {
   exprNode *tmp;
-  int err;
 
-  /* Make sure slash sign is at a good place */
-  if(index <= start || index >= end)
+  for(;;)
     {
-      obj->starterr = tokens[index].start;
-      obj->enderr = tokens[index].end;
-      return EXPR_ERROR_SYNTAX;
-    }
-
-
-  /* Allocate space for 2 subnodes */
-  tmp = exprAllocNodes(2);
-  if(tmp == NULL)
-    return EXPR_ERROR_MEMORY;
-
-
-  /* Set the data */
-  node->type = EXPR_NODETYPE_DIVIDE;
-  node->data.oper.nodes = tmp;
-  node->data.oper.nodecount = 2;
+      switch(parser->tokens[parser->pos].type)
+        {
+          case EXPR_TOKEN_PLUS:
+            /* Positive does nothing */
+            parser->pos++;
+            break;
 
-  /* parse the left side */
-  err = exprInternalParse(obj, &(tmp[0]), tokens, start, index - 1);
-  if(err != EXPR_ERROR_NOERROR)
-    return err;
+          case EXPR_TOKEN_HYPHEN:
+            /* Allocate subnode */
+            tmp = exprAllocNodes(parser->obj->arena, 1);
+            if(tmp == NULL)
+              return EXPR_ERROR_MEMORY;
+
+            parser->obj->nodecount++;
+
+            /* Set data */
+            node->type = EXPR_NODETYPE_NEGATE;
+            node->token = parser->pos + 1;
+            node->data.oper.nodes = tmp;
+            node->data.oper.nodecount = 1;
+
+            /* Continue with the subnode */
+            node = tmp;
+            parser->pos++;
+            break;
 
-  /* parse the right side */
-  return exprInternalParse(obj, &(tmp[1]), tokens, index + 1, end);
+          default:
+            return exprInternalParsePrimary(parser, node);
+        }
+    }
 }
 
-/* Function to parse an exponent operator */
-int exprInternalParseExp(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index)
+/* Parse a group, function, variable, or value */
+int exprInternalParsePrimary(exprParser *parser, exprNode *node)
 {
-  exprNode *tmp;
-  int err;
-
-  /* Make sure exponent sign is at a good place */
-  if(index <= start || index >= end)
-    {
-      obj->starterr = tokens[index].start;
-      obj->enderr = tokens[index].end;
-      return EXPR_ERROR_SYNTAX;
-    }
-
-
-  /* Allocate space for 2 subnodes */
-  tmp = exprAllocNodes(2);
-  if(tmp == NULL)
-    return EXPR_ERROR_MEMORY;
+  exprToken *tokens = parser->tokens;
+  EXPRTYPE *addr;
+  int index, err;
 
+  index = parser->pos;
 
-  /* Set the data */
-  node->type = EXPR_NODETYPE_EXPONENT;
-  node->data.oper.nodes = tmp;
-  node->data.oper.nodecount = 2;
+  switch(tokens[index].type)
+    {
+      case EXPR_TOKEN_OPAREN:
+        /* Grouped parenthesis, with something between them */
+        if(tokens[index + 1].type == EXPR_TOKEN_CPAREN)
+          return exprInternalParseError(parser, index, index + 1, EXPR_ERROR_SYNTAX);
 
-  /* parse the left side */
-  err = exprInternalParse(obj, &(tmp[0]), tokens, start, index - 1);
-  if(err != EXPR_ERROR_NOERROR)
-    return err;
+        parser->pos++;
 
-  /* parse the right side */
-  return exprInternalParse(obj, &(tmp[1]), tokens, index + 1, end);
-}
+        err = exprInternalParse(parser, node);
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
 
-/* Function to parse for positive and negative */
-int exprInternalParsePosNeg(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int index)
-{
-  exprNode *tmp;
+        /* Closing paren should be next */
+        if(tokens[parser->pos].type != EXPR_TOKEN_CPAREN)
+          return exprInternalParseError(parser, parser->pos, parser->pos, EXPR_ERROR_SYNTAX);
 
-  /* Position should be the same as start */
-  if(index != start)
-    {
-      obj->starterr = tokens[index].start;
-      obj->enderr = tokens[index].end;
-      return EXPR_ERROR_UNKNOWN;
-    }
+        parser->pos++;
+        return EXPR_ERROR_NOERROR;
 
-  /* If it is a positive, just parse the internal of it */
-  if(tokens[index].type == EXPR_TOKEN_PLUS)
-    return exprInternalParse(obj, node, tokens, index + 1, end);
-  else
-    {
-      /* Allocate subnode */
-      tmp = exprAllocNodes(1);
-      if(tmp == NULL)
+      case EXPR_TOKEN_IDENTIFIER:
+        /* Functions */
+        if(tokens[index + 1].type == EXPR_TOKEN_OPAREN)
+          return exprInternalParseFunction(parser, node);
+
+        /* Variables and constants */
+        err = exprInternalParseVar(parser, index, EXPR_ERROR_NOERROR, &addr);
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
+
+        /*
+          Constants are also variable nodes so the application can
+          change a constant's value and it will reflect in expression
+        */
+        node->type = EXPR_NODETYPE_VARIABLE;
+        node->token = index + 1;
+        node->data.variable.vaddr = addr;
+
+        parser->pos++;
         return EXPR_ERROR_NOERROR;
 
+      case EXPR_TOKEN_VALUE:
+        node->type = EXPR_NODETYPE_VALUE;
+        node->token = index + 1;
+        node->data.value.value = tokens[index].data.val;
 
-      /* Set data */
-      node->type = EXPR_NODETYPE_NEGATE;
-      node->data.oper.nodes = tmp;
-      node->data.oper.nodecount = 1;
+        parser->pos++;
+        return EXPR_ERROR_NOERROR;
 
-      /* Parse the subnode */
-      return exprInternalParse(obj, tmp, tokens, index + 1, end);
+      default:
+        /* Anything else can not start an expression */
+        return exprInternalParseError(parser, index, index, EXPR_ERROR_SYNTAX);
     }
 }
 
 /* Function will parse a call to a function */
-int exprInternalParseFunction(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end, int p1, int p2)
+int exprInternalParseFunction(exprParser *parser, exprNode *node)
 {
-  int pos;
-  int num, cur;
-  int refnum, refcur;
-  int plevel = 0;
-  int lv, err;
+  exprToken *tokens = parser->tokens;
+  exprObj *obj = parser->obj;
+  int name, close, index;
+  int firstarg, firstref;
+  int num, refnum;
+  int err;
   exprNode *tmp;
+  exprNode arg;
   exprFuncType fptr;
   int argmin, argmax;
   int refargmin, refargmax;
-  int type;
+  int type, flags;
   exprFuncList *l;
-  exprValList *vars;
+  exprFunc *func;
+  exprEager *eager;
   EXPRTYPE *addr;
   EXPRTYPE **reftmp;
 
@@ -1142,417 +782,336 @@ int exprInternalParseFunction(exprObj *obj, exprNode *node, exprToken *tokens, i
   if(l == NULL)
     return EXPR_ERROR_NOSUCHFUNCTION;
 
-  /* check paren. location */
-  if(p2 <= p1)
-    return EXPR_ERROR_SYNTAX;
-
-  /* second paren. should not be after the end */
-  if(p2 > end)
-    return EXPR_ERROR_SYNTAX;
-
-  /* Item before parenthesis should be an identifier */
-  if(tokens[p1 - 1].type != EXPR_TOKEN_IDENTIFIER)
-    {
-      obj->starterr = tokens[p1 - 1].start;
-      obj->enderr = tokens[p1].end;
-      return EXPR_ERROR_SYNTAX;
-    }
-
+  name = parser->pos;
 
   /* Look up the function */
-  err = exprFuncListGet(l, tokens[p1 - 1].data.str, &fptr, &type, &argmin, &argmax, &refargmin, &refargmax);
+  err = exprFuncListGetLen(l, tokens[name].data.str, tokens[name].len, &func);
   if(err != EXPR_ERROR_NOERROR)
     {
       if(err == EXPR_ERROR_NOTFOUND)
-        {
-          obj->starterr = tokens[p1 - 1].start;
-          obj->enderr = tokens[p1 - 1].end;
-          return EXPR_ERROR_NOSUCHFUNCTION;
-        }
+        return exprInternalParseError(parser, name, name, EXPR_ERROR_NOSUCHFUNCTION);
       else
         return err;
     }
 
+  fptr = func->fptr;
+  type = func->type;
+  flags = func->flags;
+  argmin = func->min;
+  argmax = func->max;
+  refargmin = func->refmin;
+  refargmax = func->refmax;
+
   /* Make sure the function exists */
   if(fptr == NULL && type == 0)
-    {
-      obj->starterr = tokens[p1 - 1].start;
-      obj->enderr = tokens[p1 - 1].end;
-      return EXPR_ERROR_NOSUCHFUNCTION;
-    }
+    return exprInternalParseError(parser, name, name, EXPR_ERROR_NOSUCHFUNCTION);
 
-  /* Count arguments */
-  if(p2 == p1 + 1)
-    {
-      num = 0;
-      refnum = 0;
-    }
-  else
-    {
-      num = 1;
-      refnum = 0;
+  /* Arguments are kept on the parser's stacks until the closing
+     parenthesis, since nested calls use the stacks too */
+  firstarg = parser->argcount;
+  firstref = parser->refcount;
 
+  parser->pos = name + 2;
 
-      /* count commas */
-      for(pos = p1 + 1; pos < p2; pos++)
+  if(tokens[parser->pos].type != EXPR_TOKEN_CPAREN)
+    {
+      for(;;)
         {
-          switch(tokens[pos].type)
+          index = parser->pos;
+
+          if(tokens[index].type == EXPR_TOKEN_AMPERSAND)
             {
-              case EXPR_TOKEN_OPAREN:
-                plevel++;
-                break;
+              /* It is a reference, only an identifier may follow */
+              if(tokens[index + 1].type != EXPR_TOKEN_IDENTIFIER)
+                return exprInternalParseError(parser, index, index + 1, EXPR_ERROR_SYNTAX);
 
-              case EXPR_TOKEN_CPAREN:
-                plevel--;
-                if(plevel < 0)
-                  {
-                    obj->starterr = tokens[pos].start;
-                    obj->enderr = tokens[pos].end;
-                    return EXPR_ERROR_UNMATCHEDPAREN;
-                  }
-                break;
+              if(tokens[index + 2].type != EXPR_TOKEN_COMMA && tokens[index + 2].type != EXPR_TOKEN_CPAREN)
+                return exprInternalParseError(parser, index, index + 2, EXPR_ERROR_SYNTAX);
 
-              case EXPR_TOKEN_COMMA:
-                /* Found comma */
-                if(plevel == 0)
-                  num++;
-                break;
+              /* Make sure it is not a constant */
+              err = exprInternalParseVar(parser, index + 1, EXPR_ERROR_REFCONSTANT, &addr);
+              if(err != EXPR_ERROR_NOERROR)
+                {
+                  if(err == EXPR_ERROR_REFCONSTANT)
+                    exprInternalParseError(parser, index, index + 1, err);
 
-              case EXPR_TOKEN_AMPERSAND:
-                /* Found reference mark */
-                if(plevel == 0)
-                  {
-                    /* This may only occur after the open parenthesis or comma */
-                    if(tokens[pos - 1].type == EXPR_TOKEN_OPAREN || tokens[pos - 1].type == EXPR_TOKEN_COMMA)
-                      refnum++;
-                    else
-                      return EXPR_ERROR_SYNTAX;
-                  }
-                break;
+                  return err;
+                }
+
+              err = exprInternalParsePushRef(parser, addr);
+              if(err != EXPR_ERROR_NOERROR)
+                return err;
+
+              parser->pos = index + 2;
             }
-        }
+          else
+            {
+              err = exprInternalParse(parser, &arg);
+              if(err != EXPR_ERROR_NOERROR)
+                return err;
+
+              err = exprInternalParsePushArg(parser, &arg);
+              if(err != EXPR_ERROR_NOERROR)
+                return err;
+            }
+
+          /* A comma or the closing paren should be next */
+          if(tokens[parser->pos].type == EXPR_TOKEN_CPAREN)
+            break;
+
+          if(tokens[parser->pos].type != EXPR_TOKEN_COMMA)
+            return exprInternalParseError(parser, parser->pos, parser->pos, EXPR_ERROR_SYNTAX);
 
-      /* plevel should be zero */
-      if(plevel != 0)
-        return EXPR_ERROR_UNMATCHEDPAREN;
+          parser->pos++;
+        }
     }
 
-  /* We now have the number of total arguments and
-     number of ref arguments.  Get number of normal
-     arguments */
-  num = num - refnum;
+  close = parser->pos++;
+
+  num = parser->argcount - firstarg;
+  refnum = parser->refcount - firstref;
 
   /* Make sure number of arguments is correct */
   /* Here we make sure the limits are greater
      or equal to zero because any negative number
      could be used to specify no limit */
-  if(argmin >= 0 && num < argmin)
+  if((argmin >= 0 && num < argmin) || (argmax >= 0 && num > argmax) ||
+    (refargmin >= 0 && refnum < refargmin) || (refargmax >= 0 && refnum > refargmax))
     {
-      obj->starterr = tokens[p1 - 1].start;
-      obj->enderr = tokens[p2].end;
-      return EXPR_ERROR_BADNUMBERARGUMENTS;
-    }
-
-  if(argmax >= 0 && num > argmax)
-    {
-      obj->starterr = tokens[p1 - 1].start;
-      obj->enderr = tokens[p2].end;
-      return EXPR_ERROR_BADNUMBERARGUMENTS;
-    }
-
-  if(refargmin >= 0 && refnum < refargmin)
-    {
-      obj->starterr = tokens[p1 - 1].start;
-      obj->enderr = tokens[p2].end;
-      return EXPR_ERROR_BADNUMBERARGUMENTS;
-    }
-
-  if(refargmax >= 0 && refnum > refargmax)
-    {
-      obj->starterr = tokens[p1 - 1].start;
-      obj->enderr = tokens[p2].end;
-      return EXPR_ERROR_BADNUMBERARGUMENTS;
+      return exprInternalParseError(parser, name, close, EXPR_ERROR_BADNUMBERARGUMENTS);
     }
 
   /* Set tmp to null in case of no arguments */
   tmp = NULL;
   reftmp = NULL;
+  eager = NULL;
 
   if(num > 0)
     {
       /* Allocate subnodes */
-      tmp = exprAllocNodes(num);
+      tmp = exprAllocNodes(obj->arena, num);
       if(tmp == NULL)
         return EXPR_ERROR_MEMORY;
+
+      obj->nodecount += num;
+      memcpy(tmp, parser->args + firstarg, num * sizeof(exprNode));
     }
 
   if(refnum > 0)
     {
       /* Allocate ref pointers */
-      reftmp = exprAllocMem(sizeof(EXPRTYPE*) * refnum);
+      reftmp = exprArenaAlloc(obj->arena, sizeof(EXPRTYPE*) * refnum, EXPR_MEM_ALIGN);
       if(reftmp == NULL)
-        {
-          exprFreeMem(tmp);
-          return EXPR_ERROR_MEMORY;
-        }
+        return EXPR_ERROR_MEMORY;
+
+      memcpy(reftmp, parser->refs + firstref, refnum * sizeof(EXPRTYPE*));
     }
 
+  if(fptr == NULL && type == EXPR_NODEFUNC_EAGER)
+    {
+      /* The list may change before the expression is freed */
+      eager = exprArenaAlloc(obj->arena, sizeof(exprEager), EXPR_MEM_ALIGN);
+      if(eager == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      eager->eptr = func->eptr;
+      eager->bptr = func->bptr;
+    }
 
+  /* Remove our arguments from the stacks */
+  parser->argcount = firstarg;
+  parser->refcount = firstref;
 
   /* Set this node's data */
   node->type = EXPR_NODETYPE_FUNCTION;
+  node->token = name + 1;
   node->data.function.fptr = fptr;
   node->data.function.nodecount = num;
   node->data.function.nodes = tmp;
   node->data.function.refcount = refnum;
   node->data.function.refs = reftmp;
   node->data.function.type = type;
+  node->data.function.flags = flags;
+  node->data.function.eager = eager;
+  node->data.function.func = func;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Get the address of the identifier at index.  A constant's address
+   is returned when consterr is EXPR_ERROR_NOERROR, otherwise consterr
+   is returned.  Variables are added to the variable list if needed. */
+int exprInternalParseVar(exprParser *parser, int index, int consterr, EXPRTYPE **addr)
+{
+  exprToken *token = &(parser->tokens[index]);
+  exprValList *l;
 
-  /* parse each subnode */
-  if(num + refnum > 0)
+  /* check to see if it is a constant */
+  l = exprGetConstList(parser->obj);
+  if(l != NULL)
     {
-      plevel = 0;
-      cur = 0;
-      refcur = 0;
-      lv = p1 + 1;
+      if(exprValListGetAddressLen(l, token->data.str, token->len, addr) == EXPR_ERROR_NOERROR)
+        return consterr;
+    }
 
-      /* look for commas if more than 1 arg */
-      if(num + refnum > 1)
-        {
-          for(pos = p1 + 1; pos < p2; pos++)
-            {
-              switch(tokens[pos].type)
-                {
-                  case EXPR_TOKEN_OPAREN:
-                    plevel++;
-                    break;
-
-                  case EXPR_TOKEN_CPAREN:
-                    plevel--;
-                    break; /* Already checked paren nesting above */
-
-                  case EXPR_TOKEN_COMMA:
-                    /* Found comma */
-                    if(plevel == 0)
-                      {
-                        /* parse inside */
-                        if(tokens[lv].type == EXPR_TOKEN_AMPERSAND)
-                          {
-                            if(lv != pos - 2)
-                              {
-                                obj->starterr = tokens[lv].start;
-                                obj->enderr = tokens[pos].end;
-                                return EXPR_ERROR_SYNTAX;
-                              }
-
-                            /* It is a reference */
-                            if(tokens[lv + 1].type != EXPR_TOKEN_IDENTIFIER)
-                              {
-                                obj->starterr = tokens[lv].start;
-                                obj->enderr = tokens[lv + 1].end;
-                                return EXPR_ERROR_SYNTAX;
-                              }
-
-
-                            /* Make sure it is not a constant */
-                            vars = exprGetConstList(obj);
-                            if(vars)
-                              {
-                                exprValListGetAddress(vars, tokens[lv + 1].data.str, &addr);
-                                if(addr)
-                                  {
-                                    obj->starterr = tokens[lv].start;
-                                    obj->enderr = tokens[lv + 1].start;
-                                    return EXPR_ERROR_REFCONSTANT;
-                                  }
-                              }
-
-                            /* Get variable list */
-                            vars = exprGetVarList(obj);
-                            if(vars == NULL)
-                              return EXPR_ERROR_NOVARLIST;
-
-                            /* Get variable address */
-                            exprValListGetAddress(vars, tokens[lv + 1].data.str, &addr);
-                            if(addr == NULL)
-                              {
-                                /* Add variable to list */
-                                exprValListAdd(vars, tokens[lv + 1].data.str, 0.0);
-
-                                /* Try to get address again */
-                                exprValListGetAddress(vars, tokens[lv + 1].data.str, &addr);
-                                if(addr == NULL)
-                                  return EXPR_ERROR_MEMORY; /* Could not add variable */
-                              }
-
-                            /* Set reference item */
-                            reftmp[refcur] = addr;
-
-                            /* increase ref arg number and lv position*/
-                            refcur++;
-                            lv = pos + 1;
-                          }
-                        else
-                          {
-                            err = exprInternalParse(obj, &(tmp[cur]), tokens, lv, pos - 1);
-                            if(err != EXPR_ERROR_NOERROR)
-                              return err;
-
-                            /* increase arg number and lv position*/
-                            lv = pos + 1;
-                            cur++;
-                          }
-                      }
-                    break;
-                }
-            }
-        }
+  /*
+    The fast access method directly accesses the memory address
+    of the variable's value at evaluation time.  Because of this,
+    we must make sure the variable does exists in the variable list.
+  */
 
-      /* lv should point after the last comma, or open paren. if only 1 arg */
-      if(tokens[lv].type == EXPR_TOKEN_AMPERSAND)
-        {
-          if(lv != p2 - 2)
-            {
-              obj->starterr = tokens[lv].start;
-              obj->enderr = tokens[p2].end;
-              return EXPR_ERROR_SYNTAX;
-            }
+  /* Get the variable list */
+  l = exprGetVarList(parser->obj);
+  if(l == NULL)
+    return EXPR_ERROR_NOVARLIST;
 
-          /* It is a reference */
-          if(tokens[lv + 1].type != EXPR_TOKEN_IDENTIFIER)
-            {
-              obj->starterr = tokens[lv].start;
-              obj->enderr = tokens[lv + 1].end;
-              return EXPR_ERROR_SYNTAX;
-            }
+  /* Get variable address if already in the list */
+  exprValListGetAddressLen(l, token->data.str, token->len, addr);
+  if(*addr == NULL) /* Variable not in the list, add it */
+    {
+      exprValListAddLen(l, token->data.str, token->len, 0.0);
 
-          /* Make sure it is not a constant */
-          vars = exprGetConstList(obj);
-          if(vars)
-            {
-              exprValListGetAddress(vars, tokens[lv + 1].data.str, &addr);
-              if(addr)
-                {
-                  obj->starterr = tokens[lv].start;
-                  obj->enderr = tokens[lv + 1].start;
-                  return EXPR_ERROR_REFCONSTANT;
-                }
-            }
+      /* Try to get address again */
+      exprValListGetAddressLen(l, token->data.str, token->len, addr);
+      if(*addr == NULL) /* Could not add variable */
+        return EXPR_ERROR_MEMORY; /* Could not add variable to list */
+    }
 
-          /* Get variable list */
-          vars = exprGetVarList(obj);
-          if(vars == NULL)
-            return EXPR_ERROR_NOVARLIST;
+  return EXPR_ERROR_NOERROR;
+}
 
-          /* Get variable address */
-          exprValListGetAddress(vars, tokens[lv + 1].data.str, &addr);
-          if(addr == NULL)
-            {
-              /* Add variable to list */
-              exprValListAdd(vars, tokens[lv + 1].data.str, 0.0);
+/* Add a function argument to the parser's stack */
+int exprInternalParsePushArg(exprParser *parser, exprNode *arg)
+{
+  exprNode *tmp;
+  int size;
 
-              /* Try to get address again */
-              exprValListGetAddress(vars, tokens[lv + 1].data.str, &addr);
-              if(addr == NULL)
-                return EXPR_ERROR_MEMORY; /* Could not add variable */
-            }
+  if(parser->argcount == parser->argsize)
+    {
+      size = parser->argsize ? parser->argsize * 2 : EXPR_PARSE_STACKSIZE;
 
-          /* Set reference item */
-          reftmp[refcur] = addr;
-        }
-      else
-        {
-          err = exprInternalParse(obj, &(tmp[cur]), tokens, lv, p2 - 1);
-          if(err != EXPR_ERROR_NOERROR)
-            return err;
-        }
+      tmp = exprReallocMem(parser->args, size * sizeof(exprNode));
+      if(tmp == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      parser->args = tmp;
+      parser->argsize = size;
     }
 
+  parser->args[parser->argcount++] = *arg;
 
   return EXPR_ERROR_NOERROR;
 }
 
-/* Parse a variable or value */
-int exprInternalParseVarVal(exprObj *obj, exprNode *node, exprToken *tokens, int start, int end)
+/* Add a reference argument to the parser's stack */
+int exprInternalParsePushRef(exprParser *parser, EXPRTYPE *addr)
 {
-  exprValList *l;
-  EXPRTYPE *addr;
+  EXPRTYPE **tmp;
+  int size;
 
-
-  /* Make sure positions are correct */
-  if(start != end)
+  if(parser->refcount == parser->refsize)
     {
-      return EXPR_ERROR_UNKNOWN;
+      size = parser->refsize ? parser->refsize * 2 : EXPR_PARSE_STACKSIZE;
+
+      tmp = exprReallocMem(parser->refs, size * sizeof(EXPRTYPE*));
+      if(tmp == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      parser->refs = tmp;
+      parser->refsize = size;
     }
 
+  parser->refs[parser->refcount++] = addr;
 
-  /* Are we an identifier */
-  if(tokens[start].type == EXPR_TOKEN_IDENTIFIER)
-    {
-      /* we are an identifier */
+  return EXPR_ERROR_NOERROR;
+}
 
-      /* check to see if it is a constant */
-      l = exprGetConstList(obj);
-      if(l != NULL)
-        {
-          if(exprValListGetAddress(l, tokens[start].data.str, &addr) == EXPR_ERROR_NOERROR)
-            {
-              /* We found it in the constant list */
+/* Set the error position to the tokens from first to last */
+int exprInternalParseError(exprParser *parser, int first, int last, int err)
+{
+  parser->obj->starterr = parser->tokens[first].start;
+  parser->obj->enderr = parser->tokens[last].end;
 
-              /*
-                Treat is like a variable node so application can change
-                constant value and it will reflect in expression
-              */
+  return err;
+}
 
-              node->type = EXPR_NODETYPE_VARIABLE;
-              node->data.variable.vaddr = addr;
-              return EXPR_ERROR_NOERROR;
-            }
-        }
+/* Get the positions in the expression of the first and last
+   characters of a node, from the tokens of the last parse, or -1 if
+   not known.  func is called with the positions of each node below
+   it and then of the node, if not NULL. */
+void exprParseSpans(exprObj *obj, exprNode *node, exprSpanFunc func, void *data, int *start, int *end)
+{
+  exprNode *sub;
+  int count, pos, first, last, depth;
 
-      /* Not found in the constant list, so it must be a variable */
+  *start = *end = -1;
 
-      /* Set node type */
-      node->type = EXPR_NODETYPE_VARIABLE;
+  switch(node->type)
+    {
+      case EXPR_NODETYPE_ASSIGN:
+        sub = node->data.assign.node;
+        count = 1;
+        break;
+
+      case EXPR_NODETYPE_FUNCTION:
+        sub = node->data.function.nodes;
+        count = node->data.function.nodecount;
+        break;
+
+      case EXPR_NODETYPE_VALUE:
+      case EXPR_NODETYPE_VARIABLE:
+        sub = NULL;
+        count = 0;
+        break;
+
+      default:
+        sub = node->data.oper.nodes;
+        count = node->data.oper.nodecount;
+        break;
+    }
 
-      /*
-        The fast access method directly accesses the memory address
-        of the variable's value at evaluation time.  Because of this,
-        we must make sure the variable does exists in the variable list.
-      */
+  for(pos = 0; pos < count; pos++)
+    {
+      exprParseSpans(obj, &(sub[pos]), func, data, &first, &last);
+      exprInternalParseSpanAdd(first, last, start, end);
+    }
 
-      /* Get the variable list */
-      l = exprGetVarList(obj);
-      if(l == NULL)
-        return EXPR_ERROR_NOVARLIST;
+  /* The token list is not kept by expressions in a cache */
+  if(node->token > 0 && obj->tokens)
+    {
+      pos = node->token - 1;
+      exprInternalParseSpanAdd(obj->tokens[pos].start, obj->tokens[pos].end, start, end);
 
-      /* Get variable address if already in the list */
-      exprValListGetAddress(l, tokens[start].data.str, &addr);
-      if(addr == NULL) /* Variable not in the list, add it */
+      /* A call ends with its closing parenthesis */
+      if(node->type == EXPR_NODETYPE_FUNCTION)
         {
-          exprValListAdd(l, tokens[start].data.str, 0.0);
+          depth = 0;
 
-          /* Try to get address again */
-          exprValListGetAddress(l, tokens[start].data.str, &addr);
-          if(addr == NULL) /* Could not add variable */
-            return EXPR_ERROR_MEMORY; /* Could not add variable to list */
+          for(pos++; ; pos++)
+            {
+              if(obj->tokens[pos].type == EXPR_TOKEN_OPAREN)
+                depth++;
+              else if(obj->tokens[pos].type == EXPR_TOKEN_CPAREN && --depth == 0)
+                break;
+            }
+
+          exprInternalParseSpanAdd(obj->tokens[pos].start, obj->tokens[pos].end, start, end);
         }
+    }
 
-      node->data.variable.vaddr = addr;
+  if(func)
+    (*func)(data, node, *start, *end);
+}
 
-      return EXPR_ERROR_NOERROR;
-    }
-  else if(tokens[start].type == EXPR_TOKEN_VALUE)
-    {
-      /* we are a value */
-      node->type = EXPR_NODETYPE_VALUE;
-      node->data.value.value = tokens[start].data.val;
-      return EXPR_ERROR_NOERROR;
-    }
-  else
-    {
-      obj->starterr = tokens[start].start;
-      obj->enderr = tokens[end].end;
-      return EXPR_ERROR_UNKNOWN;
-    }
+/* Widen the positions first to last to include start to end */
+void exprInternalParseSpanAdd(int start, int end, int *first, int *last)
+{
+  if(start < 0)
+    return;
+
+  if(*first < 0 || start < *first)
+    *first = start;
+
+  if(end > *last)
+    *last = end;
 }
@@ -0,0 +1,577 @@
+/*
+  File: exprpool.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Pools of threads running tasks that wait for each other
+
+  This file is part of ExprEval.
+
+  Each thread has a deque of tasks that are ready.  It takes the
+  newest one from its own deque, and when that is empty it steals
+  the oldest one of another thread.  A finished task makes the
+  tasks waiting for it ready on the deque of the thread that ran
+  it, so work that depends on each other tends to stay on the same
+  processor.  The deques follow Chase and Lev, "Dynamic Circular
+  Work-Stealing Deque", with the atomics of Le et al.  Each task
+  is queued once per run, so the deques never wrap or grow while
+  running.
+*/
+
+/* Threads and sysconf are not part of strict C */
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+#if(EXPR_THREADS) && defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__))
+#define EXPR_POOL_THREADS
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+/* Most threads a pool runs */
+#define EXPR_POOL_MAXTHREADS 256
+
+/* Bytes kept between counters changed by different threads */
+#define EXPR_POOL_LINE 64
+
+
+#ifdef EXPR_POOL_THREADS
+
+/* Ready tasks of a thread.  The thread adds and takes at the
+   bottom, others steal at the top. */
+typedef struct _exprPoolDeque
+{
+  long top;
+  char pad1[EXPR_POOL_LINE - sizeof(long)];
+  long bottom;
+  char pad2[EXPR_POOL_LINE - sizeof(long)];
+  int *tasks;
+  char pad3[EXPR_POOL_LINE - sizeof(int*)];
+} exprPoolDeque;
+
+/* Thread of a pool */
+typedef struct _exprPoolWorker
+{
+  struct _exprPool *pool;
+  int index; /* Index of its deque, 0 is the calling thread */
+  pthread_t handle;
+} exprPoolWorker;
+
+#endif
+
+/* Pool of threads */
+struct _exprPool
+{
+  int threads; /* Threads running tasks, with the calling one */
+  int *pending; /* Tasks each task still waits for, then the ready ones */
+  int pendingsize;
+
+#ifdef EXPR_POOL_THREADS
+  exprPoolDeque *deques; /* Deque of each thread */
+  int capacity; /* Tasks each deque holds, a power of 2 */
+  exprPoolWorker *workers; /* Threads besides the calling one */
+  int started; /* Number of them running */
+
+  /* The run in progress */
+  int count; /* Number of tasks */
+  int *nextstart, *next; /* Tasks waiting for each */
+  exprPoolFunc func;
+  void *data;
+  int done; /* Tasks finished */
+  int err; /* First error of a task */
+
+  pthread_mutex_t lock; /* Guards the members below */
+  pthread_cond_t wake; /* A run started or the pool is freed */
+  pthread_cond_t idle; /* A thread finished its part of a run */
+  unsigned long generation; /* Runs started */
+  int finished; /* Threads done with the current run */
+  int quit; /* The threads should end */
+#endif
+};
+
+
+/* Internal functions */
+static int exprPoolReserve(exprPool *pool, int count);
+static int exprPoolRunSerial(exprPool *pool, int count, int *nextstart, int *next, exprPoolFunc func,
+    void *data);
+
+#ifdef EXPR_POOL_THREADS
+static void *exprPoolThread(void *arg);
+static void exprPoolWork(exprPool *pool, int self);
+static void exprPoolPush(exprPool *pool, exprPoolDeque *deque, int task);
+static int exprPoolTake(exprPool *pool, exprPoolDeque *deque);
+static int exprPoolSteal(exprPool *pool, exprPoolDeque *deque);
+#endif
+
+
+/* Create a pool running tasks on threads threads, counting the one
+   calling exprPoolRun.  0 or less uses one per processor.  Where
+   threads are not available, or EXPR_THREADS is 0, the pool runs
+   everything on the calling thread. */
+int exprPoolCreate(exprPool **pool, int threads)
+{
+  exprPool *tmp;
+#ifdef EXPR_POOL_THREADS
+  int pos;
+#endif
+
+  if(pool == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *pool = NULL;
+
+#ifdef EXPR_POOL_THREADS
+  if(threads <= 0)
+    {
+#ifdef _SC_NPROCESSORS_ONLN
+      threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+      if(threads <= 0)
+        threads = 1;
+    }
+
+  if(threads > EXPR_POOL_MAXTHREADS)
+    threads = EXPR_POOL_MAXTHREADS;
+#else
+  threads = 1;
+#endif
+
+  tmp = exprAllocMem(sizeof(exprPool));
+  if(tmp == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  tmp->threads = threads;
+
+#ifdef EXPR_POOL_THREADS
+  if(threads > 1)
+    {
+      tmp->deques = exprAllocMem(threads * sizeof(exprPoolDeque));
+      tmp->workers = exprAllocMem(threads * sizeof(exprPoolWorker));
+
+      if(tmp->deques == NULL || tmp->workers == NULL)
+        {
+          exprFreeMem(tmp->deques);
+          exprFreeMem(tmp->workers);
+          exprFreeMem(tmp);
+          return EXPR_ERROR_MEMORY;
+        }
+
+      pthread_mutex_init(&(tmp->lock), NULL);
+      pthread_cond_init(&(tmp->wake), NULL);
+      pthread_cond_init(&(tmp->idle), NULL);
+
+      /* Run with the threads that could be started */
+      for(pos = 1; pos < threads; pos++)
+        {
+          tmp->workers[tmp->started].pool = tmp;
+          tmp->workers[tmp->started].index = pos;
+
+          if(pthread_create(&(tmp->workers[tmp->started].handle), NULL, exprPoolThread,
+              &(tmp->workers[tmp->started])) != 0)
+            {
+              break;
+            }
+
+          tmp->started++;
+        }
+
+      tmp->threads = tmp->started + 1;
+    }
+#endif
+
+  *pool = tmp;
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Free a pool, ending its threads.  It must not be running. */
+int exprPoolFree(exprPool *pool)
+{
+#ifdef EXPR_POOL_THREADS
+  int pos;
+#endif
+
+  if(pool == NULL)
+    return EXPR_ERROR_NOERROR;
+
+#ifdef EXPR_POOL_THREADS
+  if(pool->deques)
+    {
+      pthread_mutex_lock(&(pool->lock));
+      pool->quit = 1;
+      pthread_cond_broadcast(&(pool->wake));
+      pthread_mutex_unlock(&(pool->lock));
+
+      for(pos = 0; pos < pool->started; pos++)
+        pthread_join(pool->workers[pos].handle, NULL);
+
+      pthread_cond_destroy(&(pool->idle));
+      pthread_cond_destroy(&(pool->wake));
+      pthread_mutex_destroy(&(pool->lock));
+
+      for(pos = 0; pos < pool->threads; pos++)
+        exprFreeMem(pool->deques[pos].tasks);
+
+      exprFreeMem(pool->deques);
+      exprFreeMem(pool->workers);
+    }
+#endif
+
+  exprFreeMem(pool->pending);
+  exprFreeMem(pool);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Get the number of threads running tasks, with the calling one */
+int exprPoolGetThreads(exprPool *pool, int *threads)
+{
+  if(pool == NULL || threads == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *threads = pool->threads;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Run count tasks, returning when all are done.  Task t waits for
+   waits[t] others, or none if waits is NULL, and the tasks waiting
+   for it are next[nextstart[t]] up to next[nextstart[t + 1]].  The
+   waits must not make a cycle.  func is called for each task with
+   the index of the thread, from 0 to the number of threads, and
+   tasks that do not wait for each other may be called at the same
+   time.  All tasks are run even if some fail, and an error of one
+   is returned.  Only one run at a time may use a pool. */
+int exprPoolRun(exprPool *pool, int count, int *waits, int *nextstart, int *next, exprPoolFunc func,
+    void *data)
+{
+#ifdef EXPR_POOL_THREADS
+  exprPoolDeque *deque;
+  int pos, task, thread;
+  long mask;
+#endif
+  int err;
+
+  if(pool == NULL || func == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(count <= 0)
+    return EXPR_ERROR_NOERROR;
+
+  err = exprPoolReserve(pool, count);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  if(waits)
+    memcpy(pool->pending, waits, count * sizeof(int));
+  else
+    memset(pool->pending, 0, count * sizeof(int));
+
+  if(pool->threads == 1)
+    return exprPoolRunSerial(pool, count, nextstart, next, func, data);
+
+#ifdef EXPR_POOL_THREADS
+  /* Deal the ready tasks to the threads */
+  mask = pool->capacity - 1;
+  thread = 0;
+
+  for(pos = 0; pos < pool->threads; pos++)
+    {
+      pool->deques[pos].top = 0;
+      pool->deques[pos].bottom = 0;
+    }
+
+  for(task = 0; task < count; task++)
+    {
+      if(pool->pending[task] == 0)
+        {
+          deque = &(pool->deques[thread]);
+          deque->tasks[deque->bottom++ & mask] = task;
+
+          if(++thread == pool->threads)
+            thread = 0;
+        }
+    }
+
+  pool->count = count;
+  pool->nextstart = nextstart;
+  pool->next = next;
+  pool->func = func;
+  pool->data = data;
+  pool->done = 0;
+  pool->err = EXPR_ERROR_NOERROR;
+
+  pthread_mutex_lock(&(pool->lock));
+  pool->finished = 0;
+  pool->generation++;
+  pthread_cond_broadcast(&(pool->wake));
+  pthread_mutex_unlock(&(pool->lock));
+
+  exprPoolWork(pool, 0);
+
+  /* The threads must be done with the run before it is changed */
+  pthread_mutex_lock(&(pool->lock));
+  while(pool->finished < pool->started)
+    pthread_cond_wait(&(pool->idle), &(pool->lock));
+  pthread_mutex_unlock(&(pool->lock));
+
+  return pool->err;
+#else
+  return EXPR_ERROR_NOERROR;
+#endif
+}
+
+
+/* Make room to run count tasks */
+static int exprPoolReserve(exprPool *pool, int count)
+{
+  int *pending;
+#ifdef EXPR_POOL_THREADS
+  int *tasks;
+  int size, pos;
+#endif
+
+  /* The serial run keeps its queue after the counts */
+  if(pool->pendingsize < count)
+    {
+      pending = exprReallocMem(pool->pending, 2 * count * sizeof(int));
+      if(pending == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      pool->pending = pending;
+      pool->pendingsize = count;
+    }
+
+#ifdef EXPR_POOL_THREADS
+  if(pool->threads > 1 && pool->capacity < count)
+    {
+      size = pool->capacity ? pool->capacity : EXPR_HASH_INITSIZE;
+      while(size < count)
+        size *= 2;
+
+      for(pos = 0; pos < pool->threads; pos++)
+        {
+          tasks = exprReallocMem(pool->deques[pos].tasks, size * sizeof(int));
+          if(tasks == NULL)
+            return EXPR_ERROR_MEMORY;
+
+          pool->deques[pos].tasks = tasks;
+        }
+
+      pool->capacity = size;
+    }
+#endif
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Run the tasks on the calling thread, in the order they become
+   ready */
+static int exprPoolRunSerial(exprPool *pool, int count, int *nextstart, int *next, exprPoolFunc func,
+    void *data)
+{
+  int *pending, *queue;
+  int head, tail, pos, task;
+  int err, taskerr;
+
+  pending = pool->pending;
+  queue = pool->pending + pool->pendingsize;
+  tail = 0;
+
+  for(task = 0; task < count; task++)
+    {
+      if(pending[task] == 0)
+        queue[tail++] = task;
+    }
+
+  err = EXPR_ERROR_NOERROR;
+
+  for(head = 0; head < tail; head++)
+    {
+      task = queue[head];
+
+      taskerr = func(data, task, 0);
+      if(taskerr != EXPR_ERROR_NOERROR && err == EXPR_ERROR_NOERROR)
+        err = taskerr;
+
+      if(nextstart)
+        {
+          for(pos = nextstart[task]; pos < nextstart[task + 1]; pos++)
+            {
+              if(--pending[next[pos]] == 0)
+                queue[tail++] = next[pos];
+            }
+        }
+    }
+
+  return err;
+}
+
+
+#ifdef EXPR_POOL_THREADS
+
+/* Wait for runs and take part in them until the pool is freed */
+static void *exprPoolThread(void *arg)
+{
+  exprPoolWorker *worker;
+  exprPool *pool;
+  unsigned long generation;
+
+  worker = (exprPoolWorker*)arg;
+  pool = worker->pool;
+  generation = 0;
+
+  pthread_mutex_lock(&(pool->lock));
+
+  for(;;)
+    {
+      while(!pool->quit && pool->generation == generation)
+        pthread_cond_wait(&(pool->wake), &(pool->lock));
+
+      if(pool->quit)
+        break;
+
+      generation = pool->generation;
+      pthread_mutex_unlock(&(pool->lock));
+
+      exprPoolWork(pool, worker->index);
+
+      pthread_mutex_lock(&(pool->lock));
+      if(++pool->finished == pool->started)
+        pthread_cond_signal(&(pool->idle));
+    }
+
+  pthread_mutex_unlock(&(pool->lock));
+
+  return NULL;
+}
+
+/* Run tasks of the current run until all are done */
+static void exprPoolWork(exprPool *pool, int self)
+{
+  exprPoolDeque *own;
+  unsigned int seed;
+  int task, pos, victim, err, expected;
+
+  own = &(pool->deques[self]);
+  seed = (unsigned int)self * 2654435761u + 1;
+
+  while(__atomic_load_n(&(pool->done), __ATOMIC_ACQUIRE) < pool->count)
+    {
+      task = exprPoolTake(pool, own);
+
+      /* Steal from the others, starting at a random one so thieves
+         do not all try the same deque */
+      if(task < 0)
+        {
+          seed = seed * 1103515245u + 12345u;
+          victim = (int)((seed >> 16) % (unsigned int)pool->threads);
+
+          for(pos = 0; pos < pool->threads && task < 0; pos++)
+            {
+              if(victim != self)
+                task = exprPoolSteal(pool, &(pool->deques[victim]));
+
+              if(++victim == pool->threads)
+                victim = 0;
+            }
+        }
+
+      if(task < 0)
+        {
+          sched_yield();
+          continue;
+        }
+
+      err = pool->func(pool->data, task, self);
+      if(err != EXPR_ERROR_NOERROR)
+        {
+          expected = EXPR_ERROR_NOERROR;
+          __atomic_compare_exchange_n(&(pool->err), &expected, err, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+
+      if(pool->nextstart)
+        {
+          for(pos = pool->nextstart[task]; pos < pool->nextstart[task + 1]; pos++)
+            {
+              if(__atomic_sub_fetch(&(pool->pending[pool->next[pos]]), 1, __ATOMIC_ACQ_REL) == 0)
+                exprPoolPush(pool, own, pool->next[pos]);
+            }
+        }
+
+      __atomic_add_fetch(&(pool->done), 1, __ATOMIC_RELEASE);
+    }
+}
+
+/* Add a task at the bottom of the thread's own deque */
+static void exprPoolPush(exprPool *pool, exprPoolDeque *deque, int task)
+{
+  long bottom;
+
+  bottom = __atomic_load_n(&(deque->bottom), __ATOMIC_RELAXED);
+
+  __atomic_store_n(&(deque->tasks[bottom & (pool->capacity - 1)]), task, __ATOMIC_RELAXED);
+  __atomic_store_n(&(deque->bottom), bottom + 1, __ATOMIC_RELEASE);
+}
+
+/* Take the newest task of the thread's own deque, -1 if empty */
+static int exprPoolTake(exprPool *pool, exprPoolDeque *deque)
+{
+  long top, bottom;
+  int task;
+
+  bottom = __atomic_load_n(&(deque->bottom), __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&(deque->bottom), bottom, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  top = __atomic_load_n(&(deque->top), __ATOMIC_RELAXED);
+
+  if(top > bottom)
+    {
+      __atomic_store_n(&(deque->bottom), bottom + 1, __ATOMIC_RELAXED);
+      return -1;
+    }
+
+  task = __atomic_load_n(&(deque->tasks[bottom & (pool->capacity - 1)]), __ATOMIC_RELAXED);
+
+  /* The last one may be stolen at the same time */
+  if(top == bottom)
+    {
+      if(!__atomic_compare_exchange_n(&(deque->top), &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        task = -1;
+
+      __atomic_store_n(&(deque->bottom), bottom + 1, __ATOMIC_RELAXED);
+    }
+
+  return task;
+}
+
+/* Steal the oldest task of another thread's deque, -1 if empty or
+   another thread took it first */
+static int exprPoolSteal(exprPool *pool, exprPoolDeque *deque)
+{
+  long top, bottom;
+  int task;
+
+  top = __atomic_load_n(&(deque->top), __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  bottom = __atomic_load_n(&(deque->bottom), __ATOMIC_ACQUIRE);
+
+  if(top >= bottom)
+    return -1;
+
+  task = __atomic_load_n(&(deque->tasks[top & (pool->capacity - 1)]), __ATOMIC_RELAXED);
+
+  if(!__atomic_compare_exchange_n(&(deque->top), &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    return -1;
+
+  return task;
+}
+
+#endif
@@ -23,7 +23,7 @@
   Version number
 */
 #define EXPR_VERSIONMAJOR 2
-#define EXPR_VERSIONMINOR 7
+#define EXPR_VERSIONMINOR 8
 
 /* Node types */
 enum
@@ -95,12 +95,95 @@ enum
     EXPR_NODEFUNC_OR,
     EXPR_NODEFUNC_NOT,
     EXPR_NODEFUNC_FOR,
-    EXPR_NODEFUNC_MANY
+    EXPR_NODEFUNC_MANY,
+    EXPR_NODEFUNC_EAGER /* Custom function taking values, see exprFuncListAddEager */
+  };
+
+/* Opcodes for compiled programs.  Each instruction works on an
+   evaluation stack.  Functions solved by exprEvalNode have their
+   own opcode so the VM does not need a second dispatch. */
+enum
+  {
+    EXPR_OP_END = 0, /* Stop, result is on top of stack */
+    EXPR_OP_VALUE, /* Push data.value */
+    EXPR_OP_LOAD, /* Push *vars[arg] */
+    EXPR_OP_STORE, /* *vars[arg] = top, top is kept */
+    EXPR_OP_POP, /* Discard top */
+    EXPR_OP_ADD,
+    EXPR_OP_SUBTRACT,
+    EXPR_OP_MULTIPLY,
+    EXPR_OP_DIVIDE,
+    EXPR_OP_EXPONENT,
+    EXPR_OP_NEGATE,
+    EXPR_OP_JUMP, /* Jump to arg */
+    EXPR_OP_JUMPZ, /* Pop, jump to arg if zero */
+    EXPR_OP_SELECT, /* Pop, negative falls through, zero jumps to data.jump[0], positive to data.jump[1] */
+    EXPR_OP_CALL, /* Call data.node's function solver, push result */
+    EXPR_OP_CALLVAL, /* Call data.node's eager function with the top arg items */
+    EXPR_OP_ABS,
+    EXPR_OP_MOD,
+    EXPR_OP_IPART,
+    EXPR_OP_FPART,
+    EXPR_OP_MIN, /* arg is the argument count */
+    EXPR_OP_MAX, /* arg is the argument count */
+    EXPR_OP_POW,
+    EXPR_OP_SQRT,
+    EXPR_OP_SIN,
+    EXPR_OP_SINH,
+    EXPR_OP_ASIN,
+    EXPR_OP_COS,
+    EXPR_OP_COSH,
+    EXPR_OP_ACOS,
+    EXPR_OP_TAN,
+    EXPR_OP_TANH,
+    EXPR_OP_ATAN,
+    EXPR_OP_ATAN2,
+    EXPR_OP_LOG,
+    EXPR_OP_POW10,
+    EXPR_OP_LN,
+    EXPR_OP_EXP,
+    EXPR_OP_LOGN,
+    EXPR_OP_CEIL,
+    EXPR_OP_FLOOR,
+    EXPR_OP_RAND, /* arg is the slot of the seed */
+    EXPR_OP_RANDOM, /* arg is the slot of the seed */
+    EXPR_OP_RANDOMIZE, /* arg is the slot of the seed */
+    EXPR_OP_DEG,
+    EXPR_OP_RAD,
+    EXPR_OP_RECTTOPOLR,
+    EXPR_OP_RECTTOPOLA,
+    EXPR_OP_POLTORECTX,
+    EXPR_OP_POLTORECTY,
+    EXPR_OP_EQUAL,
+    EXPR_OP_ABOVE,
+    EXPR_OP_BELOW,
+    EXPR_OP_AVG, /* arg is the argument count */
+    EXPR_OP_CLIP,
+    EXPR_OP_CLAMP,
+    EXPR_OP_PNTCHANGE,
+    EXPR_OP_POLY, /* arg is the argument count */
+    EXPR_OP_AND,
+    EXPR_OP_OR,
+    EXPR_OP_NOT,
+
+    EXPR_OP_COUNT /* Number of opcodes */
   };
 
 /* Forward declarations */
 typedef struct _exprFunc exprFunc;
 typedef struct _exprVal exprVal;
+typedef struct _exprChunk exprChunk;
+typedef struct _exprInstr exprInstr;
+typedef struct _exprProgram exprProgram;
+typedef struct _exprJit exprJit;
+typedef struct _exprToken exprToken;
+typedef struct _exprCacheEntry exprCacheEntry;
+typedef struct _exprEager exprEager;
+typedef struct _exprGroupItem exprGroupItem;
+typedef struct _exprGroupVar exprGroupVar;
+typedef struct _exprProfile exprProfile;
+typedef struct _exprProfileItem exprProfileItem;
+typedef struct _exprStatBlock exprStatBlock;
 
 /* Expression object */
 struct _exprObj
@@ -117,8 +200,38 @@ struct _exprObj
   int parsedbad; /* non-zero if parsed but unsuccessful */
   int breakcount; /* how often to check the breaker function */
   int breakcur; /* do we check the breaker function yet */
+  int cancelled; /* Set by exprSetCancel */
+  int *cancel; /* Flag checked, that of the expression a context copies */
   int starterr; /* start position of an error */
   int enderr; /* end position of an error */
+
+  struct _exprProgram *program; /* Compiled program, NULL if not compiled */
+  int compile; /* non-zero to compile at the end of exprParse */
+  struct _exprJit *jit; /* Native code of the program, NULL if none */
+
+  struct _exprArena *arena; /* Memory for nodes */
+  int ownarena; /* non-zero if the arena belongs to the object */
+
+  struct _exprToken *tokens; /* Token list kept between parses */
+  int tokensize; /* Number of tokens with room in the list */
+  int nodecount; /* Nodes made by the parse, freed by exprClear */
+  unsigned long loopnodes; /* Cost given to exprCheckBreak since the last evaluation was counted */
+
+  struct _exprCacheEntry *cacheentry; /* Cache entry holding the object, NULL if none */
+  struct _exprProfile *profile; /* Counts of exprSetProfile, NULL if not profiling */
+
+  exprAllocator alloc; /* Memory of the object, its tokens, nodes and compiled code */
+};
+
+/* Evaluation context for a shared program.  The variable table,
+   values and stack live in the same allocation. */
+struct _exprContext
+{
+  struct _exprObj obj; /* Copy of the expression, for the breaker */
+  struct _exprProgram *prog; /* Program of the expression */
+  EXPRTYPE **vars; /* Address of each variable slot */
+  EXPRTYPE *values; /* The context's own variable values */
+  EXPRTYPE *stack; /* Evaluation stack */
 };
 
 /* Object for a function */
@@ -129,36 +242,85 @@ struct _exprFunc
   int min, max; /* Min and max args for the function. */
   int refmin, refmax; /* Min and max ref. variables for the function */
   int type; /* Function node type.  exprEvalNOde solves the function */
+  int flags; /* EXPR_FUNC_* flags */
+  int cost; /* Rough time of a call */
+  exprEagerFuncType eptr; /* Callback taking values for EXPR_NODEFUNC_EAGER */
+  exprEagerBatchFuncType bptr; /* Callback taking columns of values, may be NULL */
+  unsigned int hash; /* Hash of the name */
 
   struct _exprFunc *next; /* For linked list */
 };
 
-/* Function list object */
+/* Callbacks of an eager function, copied to the arena of each
+   expression calling it */
+struct _exprEager
+{
+  exprEagerFuncType eptr; /* Called with the values of the arguments */
+  exprEagerBatchFuncType bptr; /* Called with columns of values, may be NULL */
+};
+
+/* Function list object.  The linked list keeps the order items
+   were added in, the hash table is for finding them by name. */
 struct _exprFuncList
 {
   struct _exprFunc *head;
+  struct _exprFunc **table; /* Open addressing hash table */
+  int tablesize; /* Size of the table, a power of 2 */
+  int count; /* Number of items */
+
+  exprAllocator alloc; /* Memory of the list and its items */
+};
+
+/* Memory handed out in pieces, see exprAllocChunk */
+struct _exprChunk
+{
+  struct _exprChunk *next; /* Older chunk */
+  size_t size; /* Bytes in the chunk */
+  size_t used; /* Bytes handed out */
+};
+
+/* Arena for parsed expressions */
+struct _exprArena
+{
+  struct _exprChunk *chunks; /* Blocks of memory, newest first */
+  size_t blocksize; /* Size of new blocks */
+
+  exprAllocator alloc; /* Memory of the arena and its blocks */
 };
 
 /* Object for values */
 struct _exprVal
 {
   char *vname; /* Name of the value */
-  EXPRTYPE vval; /* Value of the value */
-  EXPRTYPE *vptr; /* Pointer to a value.  Used only if not NULL */
+  EXPRTYPE *vaddr; /* Address of the value, in the list's storage unless added by address */
+  unsigned int hash; /* Hash of the name */
 
   struct _exprVal *next; /* For linked list */
 };
 
-/* Value list */
+/* Value list.  The linked list keeps the order items were added
+   in, the hash table is for finding them by name.  Items, values
+   and names are each kept together in chunks so the values an
+   expression uses are close in memory and never move. */
 struct _exprValList
 {
   struct _exprVal *head;
+  struct _exprVal **table; /* Open addressing hash table */
+  int tablesize; /* Size of the table, a power of 2 */
+  int count; /* Number of items */
+
+  struct _exprChunk *items; /* Storage for exprVal objects */
+  struct _exprChunk *values; /* Storage for values */
+  struct _exprChunk *names; /* Storage for names */
+
+  exprAllocator alloc; /* Memory of the list and its items */
 };
 
 /* Expression node type */
 struct _exprNode
 {
   int type; /* Node type */
+  int token; /* Index of the node's token in the last parse plus 1, 0 if none */
 
   union _data /* Union of info for various types */
   {
@@ -189,17 +351,287 @@ struct _exprNode
       exprFuncType fptr; /* Function pointer */
       struct _exprNode *nodes; /* Array of argument nodes */
       int nodecount; /* Number of argument nodes */
+      int flags; /* EXPR_FUNC_* flags from the function list */
       EXPRTYPE **refs; /* Reference variables */
       int refcount; /* Number of variable references (not a reference counter) */
       int type; /* Type of function for exprEvalNode if fptr is NULL */
+      struct _exprEager *eager; /* Callbacks if type is EXPR_NODEFUNC_EAGER */
+      struct _exprFunc *func; /* Entry of the function list when parsed, only compared */
     } function;
   } data;
 };
 
 
+/* Compiled program instruction */
+struct _exprInstr
+{
+  int op; /* Opcode */
+  int arg; /* Slot, jump target or argument count */
+
+  union _idata
+  {
+    EXPRTYPE value; /* Value to push */
+    int jump[2]; /* Extra jump targets for EXPR_OP_SELECT */
+    struct _exprNode *node; /* Function node for EXPR_OP_CALL */
+  } data;
+};
+
+/* Compiled program.  The header, code, variable table and
+   evaluation stack all live in a single allocation. */
+struct _exprProgram
+{
+  struct _exprInstr *code; /* Instructions, ending with EXPR_OP_END */
+  int count; /* Number of instructions */
+  EXPRTYPE **vars; /* Addresses of variables used by the code */
+  int varcount; /* Number of variable slots */
+  EXPRTYPE *stack; /* Evaluation stack */
+  int depth; /* Maximum stack depth */
+};
+
+/* Native code for a compiled program.  Instructions the code hands
+   back to the virtual machine each have a program of their own. */
+struct _exprJit
+{
+  exprJitFunc func; /* Entry point of the code */
+  void *code; /* Executable memory */
+  size_t size; /* Size of the executable memory */
+  struct _exprProgram *calls; /* Programs for the virtual machine */
+  int callcount; /* Number of programs */
+};
+
+
+/* Compiled C source of an expression.  The table of variable
+   addresses follows in the same allocation. */
+struct _exprNative
+{
+  void *handle; /* Handle of the loaded library */
+  exprNativeFunc func; /* Entry point taking the table */
+  EXPRTYPE **vars; /* Addresses of the variables */
+  int varcount; /* Number of variables */
+};
+
+/* Expression in a cache.  The normal form of the text follows in
+   the same allocation. */
+struct _exprCacheEntry
+{
+  char *key; /* Normal form of the text */
+  size_t len; /* Length of the key */
+  unsigned int hash; /* Hash of the key */
+  struct _exprFuncList *flist; /* Lists the expression was parsed with */
+  struct _exprValList *vlist;
+  struct _exprValList *clist;
+  struct _exprObj *obj; /* Parsed and compiled expression */
+  size_t size; /* Bytes counted against the budget */
+  int refs; /* Number of users, not freed unless 0 */
+
+  struct _exprCacheEntry *next; /* Next in the same table chain */
+  struct _exprCacheEntry *newer; /* Used more recently */
+  struct _exprCacheEntry *older; /* Used less recently */
+};
+
+/* Expression of a group.  Lists are offsets into the group's pool
+   of variable indexes. */
+struct _exprGroupItem
+{
+  struct _exprObj *obj; /* Expression */
+  EXPRTYPE result; /* Result of the last evaluation */
+  int err; /* Error of the last evaluation */
+  int dirty; /* Something it reads changed since it was evaluated */
+  int always; /* Evaluated every time, its result may change by itself */
+  int anywrite; /* May change variables it does not name */
+  int reads, readcount; /* Variables read before being assigned */
+  int writes, writecount; /* Variables assigned */
+  int rank; /* Position in the order */
+  int ran; /* Evaluated by the last exprGroupEvalParallel */
+};
+
+/* Variable used by expressions of a group */
+struct _exprGroupVar
+{
+  EXPRTYPE *addr; /* Address of the value */
+  EXPRTYPE last; /* Value when last looked at */
+  int readers, readercount; /* Offset in the pool of expressions reading it */
+  int writers, writercount; /* Offset in the pool of expressions assigning it, in the order added */
+  int readmark, writemark, setmark; /* Item scanned when last added to its lists */
+  int changed; /* Tick of the last exprGroupEvalParallel that changed it */
+  int changer; /* Rank of the item that changed it then */
+};
+
+/* Expressions evaluated when what they read changes */
+struct _exprGroup
+{
+  struct _exprGroupItem *items; /* Expressions in the order added */
+  int itemcount, itemsize;
+  struct _exprGroupVar *vars; /* Variables of all expressions */
+  int varcount, varsize;
+  int *table; /* Open addressing table of variable indexes, -1 if empty */
+  int tablesize; /* Size of the table, a power of 2 */
+  int *pool; /* Lists of indexes */
+  int poolcount, poolsize;
+  int *order; /* Items, writers before readers */
+  int *waits; /* Items each item waits for when run in parallel, NULL if not made */
+  int *nextstart, *next; /* Items waiting for each item */
+  int tick; /* Number of exprGroupEvalParallel calls */
+  int stale; /* Items were added since the lists were made */
+};
+
+/* Counts of a node for the profiler */
+struct _exprProfileItem
+{
+  struct _exprNode *node; /* Node counted */
+  unsigned long visits; /* Times it was evaluated */
+  double total; /* Time with the nodes below it */
+  double self; /* Time without the nodes below it */
+  int start, end; /* Positions in the expression, -1 if not known */
+};
+
+/* Counters of a thread, added up by exprGetStats.  Only the thread
+   writes them. */
+struct _exprStatBlock
+{
+  unsigned long parses; /* Calls of exprParse */
+  unsigned long parseerrors[EXPR_ERROR_USER + 1]; /* Failed parses by error code */
+  unsigned long evals; /* Evaluations */
+  unsigned long evalerrors[EXPR_ERROR_USER + 1]; /* Failed evaluations by error code */
+  unsigned long nodes; /* Estimated nodes evaluated */
+  unsigned long breaks; /* Calls of breaker functions */
+  unsigned long allocs, frees, bytes; /* Memory from exprAllocMem and exprReallocMem */
+  unsigned long nodesmade, nodesfreed; /* Nodes of parsed expressions */
+  struct _exprStatBlock *next; /* Block of the next thread */
+};
+
+/* Profile of an expression */
+struct _exprProfile
+{
+  struct _exprProfileItem *items; /* Nodes in the order first evaluated */
+  int count, size;
+  int *table; /* Open addressing table of item indexes plus 1, 0 if empty */
+  int tablesize; /* Size of the table, a power of 2 */
+  struct _exprNode *current; /* Node being timed, evaluated without timing it again */
+  double below; /* Time of the nodes below the node being timed */
+};
 
 /* Functions for function lists */
-int exprFuncListAddType(exprFuncList *flist, char *name, int type, int min, int max, int refmin, int refmax);
+int exprFuncListAddType(exprFuncList *flist, char *name, int type, int min, int max, int refmin, int refmax,
+    exprFuncInfo *info);
 int exprFuncListGet(exprFuncList *flist, char *name, exprFuncType *ptr, int *type, int *min, int *max, int *refmin, int *refmax);
+int exprFuncListGetLen(exprFuncList *flist, char *name, int len, exprFunc **func);
+
+/* Functions for value lists, name is len characters and need not
+   be terminated.  The name must already be a valid identifier. */
+int exprValListAddLen(exprValList *vlist, char *name, int len, EXPRTYPE val);
+int exprValListGetAddressLen(exprValList *vlist, char *name, int len, EXPRTYPE **addr);
+
+/* Token list size for the first parse.  The list grows to twice
+   the size when full and is kept for the next parse. */
+#define EXPR_TOKEN_INITSIZE 64
+
+/* Size of blocks for an expression's own arena */
+#define EXPR_ARENA_BLOCKSIZE 4096
+
+/* Number of items in each chunk of a value list's storage */
+#define EXPR_VALCHUNK_ITEMS 64
+
+/* Hash table size when the first item is added.  Tables grow
+   to twice the size when they become three quarters full. */
+#define EXPR_HASH_INITSIZE 16
+
+/* Texts with a normal form shorter than this are looked up in
+   a cache without allocating */
+#define EXPR_CACHE_KEYSIZE 256
+
+/* Cost of a call to a function added without an estimate */
+#define EXPR_FUNC_COST 20
+
+/* What is assumed of a function added without a description.  It
+   may do anything with its arguments and references. */
+#define EXPR_FUNC_UNKNOWN (EXPR_FUNC_READREFS | EXPR_FUNC_WRITEREFS | EXPR_FUNC_EVALNODES)
+
+/* Eager functions with up to this many arguments get them in an
+   array on the stack when the node tree is evaluated */
+#define EXPR_EAGER_ARGS 16
+
+/* Flags read while another thread may set them */
+#if defined(__GNUC__)
+#define EXPR_FLAG_GET(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define EXPR_FLAG_SET(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#else
+#define EXPR_FLAG_GET(p) (*(volatile int*)(p))
+#define EXPR_FLAG_SET(p, v) (*(volatile int*)(p) = (v))
+#endif
+
+/* Tests that are almost always false */
+#if defined(__GNUC__)
+#define EXPR_UNLIKELY(x) __builtin_expect((x), 0)
+#else
+#define EXPR_UNLIKELY(x) (x)
+#endif
+
+/* Counters written by one thread and read by others */
+#if defined(__GNUC__)
+#define EXPR_COUNT_GET(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define EXPR_COUNT_SET(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#else
+#define EXPR_COUNT_GET(p) (*(p))
+#define EXPR_COUNT_SET(p, v) (*(p) = (v))
+#endif
+
+/* Counters of the calling thread, made when first used */
+#if(EXPR_THREADS) && defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__))
+#define EXPR_STAT_TLS
+extern __thread struct _exprStatBlock *exprStatLocal;
+#define EXPR_STAT_BLOCK() (exprStatLocal ? exprStatLocal : exprStatThread())
+#else
+extern struct _exprStatBlock exprStatGlobal;
+#define EXPR_STAT_BLOCK() (&exprStatGlobal)
+#endif
+
+/* Add to a counter of a thread's block */
+#define EXPR_STAT_ADD(block, field, n) EXPR_COUNT_SET(&((block)->field), (block)->field + (n))
+
+/* Slot of an error code in the counters, custom codes share the last */
+#define EXPR_STAT_CODE(err) (((err) > 0 && (err) < EXPR_ERROR_USER) ? (err) : EXPR_ERROR_USER)
+
+/* Count evaluations, the nodes they evaluated and their error */
+#define EXPR_STAT_EVAL(count, work, err) \
+  do \
+    { \
+      exprStatBlock *stat_ = EXPR_STAT_BLOCK(); \
+      EXPR_STAT_ADD(stat_, evals, (count)); \
+      EXPR_STAT_ADD(stat_, nodes, (work)); \
+      if((err) != EXPR_ERROR_NOERROR) \
+        EXPR_STAT_ADD(stat_, evalerrors[EXPR_STAT_CODE(err)], 1); \
+    } \
+  while(0)
+
+/* Utility functions */
+unsigned int exprHashName(char *name, int len);
+int exprEvalEager(exprObj *obj, exprNode *node, EXPRTYPE *val);
+
+/* Functions for compiled programs */
+int exprCompileProgram(exprAllocator *alloc, exprNode *node, exprProgram **prog);
+int exprRunProgram(exprObj *obj, exprProgram *prog, EXPRTYPE **vars, EXPRTYPE *stack, EXPRTYPE *val);
+void exprFreeProgram(exprAllocator *alloc, exprProgram *prog);
+void exprFreeJit(exprAllocator *alloc, exprJit *jit);
+
+/* Called for each node by exprParseSpans */
+typedef void (*exprSpanFunc)(void *data, exprNode *node, int start, int end);
+
+/* Functions for the parser */
+void exprParseSpans(exprObj *obj, exprNode *node, exprSpanFunc func, void *data, int *start, int *end);
+
+/* Functions for statistics */
+exprStatBlock *exprStatThread(void);
+
+/* Functions for the profiler */
+int exprProfileNode(exprObj *obj, exprNode *node, EXPRTYPE *val);
+void exprProfileClear(exprProfile *prof);
+
+/* Task run by a pool, worker is the index of the thread running it */
+typedef int (*exprPoolFunc)(void *data, int task, int worker);
+
+/* Functions for pools */
+int exprPoolRun(exprPool *pool, int count, int *waits, int *nextstart, int *next, exprPoolFunc func,
+    void *data);
 
 #endif /* __BAVII_EXPRPRIV_H */
@@ -0,0 +1,627 @@
+/*
+  File: exprprof.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Count and time the nodes of an expression
+
+  This file is part of ExprEval.
+
+  While an expression is profiled, exprEvalNode hands each node to
+  exprProfileNode, which reads the clock, evaluates the node and
+  reads the clock again.  The time of the nodes below a node is
+  taken out of its own time, so the report shows where the time is
+  spent.  Reading the clock takes time too, which is counted in the
+  node above the one timed, so the times are only useful compared
+  with each other.
+*/
+
+/* clock_gettime is not part of strict C */
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+
+/* Count processor cycles with the time stamp counter where there is
+   one, otherwise use the monotonic clock or the processor time */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EXPR_PROFILE_TSC
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) && defined(CLOCK_MONOTONIC)
+#define EXPR_PROFILE_MONOTONIC
+#endif
+#endif
+
+/* Hash of the address of a node */
+#define EXPR_PROFILE_HASH(node) ((unsigned int)((size_t)(node) / sizeof(exprNode)) * 2654435761u)
+
+/* Nodes counted at first */
+#define EXPR_PROFILE_SIZE 64
+
+/* Most nodes listed by a report */
+#define EXPR_PROFILE_NODES 50
+
+/* Characters of the expression shown for each node */
+#define EXPR_PROFILE_SHOW 40
+
+/* Longest line written at once */
+#define EXPR_PROFILE_LINESIZE (EXPR_MAXIDENTSIZE + 256)
+
+/* Text of a report */
+typedef struct _exprProfileBuf
+{
+  char *text; /* The text, always ending with a 0 */
+  size_t len; /* Length of the text */
+  size_t size; /* Bytes allocated */
+  int err; /* Set when an allocation fails */
+} exprProfileBuf;
+
+/* Counts added up for a kind of node */
+typedef struct _exprProfileSum
+{
+  unsigned long visits;
+  double self;
+} exprProfileSum;
+
+
+/* Internal functions */
+static double exprProfileTime(void);
+static int exprProfileFind(exprProfile *prof, exprNode *node);
+static int exprProfileAdd(exprProfile *prof, exprNode *node);
+static int exprProfileGrow(exprProfile *prof);
+static void exprProfileSpan(void *data, exprNode *node, int start, int end);
+static int exprProfileFunc(exprObj *obj, exprNode *node, exprFunc **func);
+static int exprProfileCompare(const void *a, const void *b);
+static void exprProfileSource(exprObj *obj, char *expr, int len, exprProfileItem *item, char *text);
+static void exprProfileLine(exprProfileBuf *buf, char *fmt, ...);
+
+
+/* Names of the node types */
+static char *exprProfileTypes[] =
+  {
+  "unknown", "statements", "add", "subtract", "multiply", "divide",
+  "exponent", "negate", "value", "variable", "assign", "function"
+  };
+
+#define EXPR_PROFILE_TYPES (int)(sizeof(exprProfileTypes) / sizeof(exprProfileTypes[0]))
+
+
+/* Start or stop profiling an expression.  While profiled, exprEval
+   counts how many times each node is evaluated and the time spent
+   in it, and exprEvalCompiled evaluates the nodes instead of the
+   program so it is counted too.  Contexts, exprEvalRange and the
+   function of exprGetJitFunc are not profiled.  Stopping frees the
+   counts. */
+int exprSetProfile(exprObj *obj, int profile)
+{
+  exprProfile *prof;
+
+  if(obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  prof = obj->profile;
+
+  if(!profile)
+    {
+      if(prof)
+        {
+          exprFreeMem(prof->items);
+          exprFreeMem(prof->table);
+          exprFreeMem(prof);
+        }
+
+      obj->profile = NULL;
+      return EXPR_ERROR_NOERROR;
+    }
+
+#if(EXPR_PROFILE)
+  if(prof == NULL)
+    {
+      prof = exprAllocMem(sizeof(exprProfile));
+      if(prof == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      obj->profile = prof;
+    }
+
+  return EXPR_ERROR_NOERROR;
+#else
+  return EXPR_ERROR_NOPROFILE;
+#endif
+}
+
+/* Forget the counts of an expression being profiled */
+int exprProfileReset(exprObj *obj)
+{
+  if(obj == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(obj->profile == NULL)
+    return EXPR_ERROR_NOPROFILE;
+
+  exprProfileClear(obj->profile);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Write a report of the counts of an expression being profiled.
+   expr is the text that was parsed, used to show the part of it each
+   node came from, or NULL to show only the type of the nodes.  The
+   report is freed with exprProfileReportFree. */
+int exprProfileReport(exprObj *obj, char *expr, char **report)
+{
+  exprProfile *prof;
+  exprProfileItem *sorted;
+  exprProfileSum types[EXPR_PROFILE_TYPES];
+  exprProfileSum *funcs;
+  exprProfileBuf buf;
+  exprProfileItem *item;
+  exprFunc *func;
+  char text[EXPR_PROFILE_SHOW + 8];
+  double all;
+  unsigned long evals;
+  int pos, index, len, start, end;
+
+  if(obj == NULL || report == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *report = NULL;
+
+  prof = obj->profile;
+  if(prof == NULL)
+    return EXPR_ERROR_NOPROFILE;
+
+  memset(&buf, 0, sizeof(exprProfileBuf));
+  memset(types, 0, sizeof(types));
+
+  funcs = exprAllocMem(((obj->flist) ? obj->flist->count : 0) * sizeof(exprProfileSum) + 1);
+  sorted = exprAllocMem(prof->count * sizeof(exprProfileItem) + 1);
+
+  if(funcs == NULL || sorted == NULL)
+    {
+      exprFreeMem(funcs);
+      exprFreeMem(sorted);
+      return EXPR_ERROR_MEMORY;
+    }
+
+  /* Positions of the nodes in the expression */
+  for(pos = 0; pos < prof->count; pos++)
+    prof->items[pos].start = prof->items[pos].end = -1;
+
+  if(obj->parsedgood && obj->headnode)
+    exprParseSpans(obj, obj->headnode, exprProfileSpan, prof, &start, &end);
+
+  /* Add up the counts */
+  all = 0.0;
+
+  for(pos = 0; pos < prof->count; pos++)
+    {
+      item = &(prof->items[pos]);
+      all += item->self;
+
+      index = item->node->type;
+      if(index < 0 || index >= EXPR_PROFILE_TYPES)
+        index = 0;
+
+      types[index].visits += item->visits;
+      types[index].self += item->self;
+
+      index = exprProfileFunc(obj, item->node, &func);
+      if(index >= 0)
+        {
+          funcs[index].visits += item->visits;
+          funcs[index].self += item->self;
+        }
+    }
+
+  if(all <= 0.0)
+    all = 1.0;
+
+  index = (obj->headnode) ? exprProfileFind(prof, obj->headnode) : -1;
+  evals = (index >= 0) ? prof->items[index].visits : 0;
+
+#if defined(EXPR_PROFILE_TSC)
+  exprProfileLine(&buf, "Profile of %lu evaluations, times in cycles", evals);
+#elif defined(EXPR_PROFILE_MONOTONIC)
+  exprProfileLine(&buf, "Profile of %lu evaluations, times in nanoseconds", evals);
+#else
+  exprProfileLine(&buf, "Profile of %lu evaluations, times in clock ticks", evals);
+#endif
+
+  /* By type of node */
+  exprProfileLine(&buf, "");
+  exprProfileLine(&buf, "%12s %14s %6s  %s", "visits", "self", "self%", "node type");
+
+  for(pos = 0; pos < EXPR_PROFILE_TYPES; pos++)
+    {
+      if(types[pos].visits)
+        {
+          exprProfileLine(&buf, "%12lu %14.0f %6.1f  %s", types[pos].visits, types[pos].self,
+            types[pos].self * 100.0 / all, exprProfileTypes[pos]);
+        }
+    }
+
+  /* By function */
+  exprProfileLine(&buf, "");
+  exprProfileLine(&buf, "%12s %14s %6s  %s", "visits", "self", "self%", "function");
+
+  for(func = (obj->flist) ? obj->flist->head : NULL, pos = 0; func; func = func->next, pos++)
+    {
+      if(funcs[pos].visits)
+        {
+          exprProfileLine(&buf, "%12lu %14.0f %6.1f  %s", funcs[pos].visits, funcs[pos].self,
+            funcs[pos].self * 100.0 / all, func->fname);
+        }
+    }
+
+  /* The nodes taking the most time */
+  memcpy(sorted, prof->items, prof->count * sizeof(exprProfileItem));
+  qsort(sorted, prof->count, sizeof(exprProfileItem), exprProfileCompare);
+
+  len = (expr) ? (int)strlen(expr) : 0;
+
+  exprProfileLine(&buf, "");
+  exprProfileLine(&buf, "%12s %14s %14s %6s %13s  %s", "visits", "total", "self", "self%", "position", "node");
+
+  for(pos = 0; pos < prof->count && pos < EXPR_PROFILE_NODES; pos++)
+    {
+      item = &(sorted[pos]);
+      exprProfileSource(obj, expr, len, item, text);
+
+      if(item->start >= 0)
+        {
+          exprProfileLine(&buf, "%12lu %14.0f %14.0f %6.1f %6d-%-6d  %s", item->visits, item->total, item->self,
+            item->self * 100.0 / all, item->start, item->end, text);
+        }
+      else
+        {
+          exprProfileLine(&buf, "%12lu %14.0f %14.0f %6.1f %13s  %s", item->visits, item->total, item->self,
+            item->self * 100.0 / all, "-", text);
+        }
+    }
+
+  exprFreeMem(funcs);
+  exprFreeMem(sorted);
+
+  if(buf.err != EXPR_ERROR_NOERROR)
+    {
+      exprFreeMem(buf.text);
+      return buf.err;
+    }
+
+  *report = buf.text;
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Free a report */
+int exprProfileReportFree(char *report)
+{
+  exprFreeMem(report);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Evaluate and time a node for exprEvalNode */
+int exprProfileNode(exprObj *obj, exprNode *node, EXPRTYPE *val)
+{
+  exprProfile *prof;
+  exprProfileItem *item;
+  exprNode *current;
+  double start, time, below;
+  int index, err;
+
+  prof = obj->profile;
+
+  /* Not counted if out of memory, but still evaluated */
+  index = exprProfileAdd(prof, node);
+
+  current = prof->current;
+  below = prof->below;
+
+  prof->current = node;
+  prof->below = 0.0;
+
+  start = exprProfileTime();
+  err = exprEvalNode(obj, node, 0, val);
+  time = exprProfileTime() - start;
+
+  /* Items may have moved while evaluating the nodes below */
+  if(index >= 0)
+    {
+      item = &(prof->items[index]);
+      item->visits++;
+      item->total += time;
+      item->self += time - prof->below;
+    }
+
+  prof->current = current;
+  prof->below = below + time;
+
+  return err;
+}
+
+/* Forget the counts of a profile, keeping its memory */
+void exprProfileClear(exprProfile *prof)
+{
+  prof->count = 0;
+  prof->current = NULL;
+  prof->below = 0.0;
+
+  if(prof->table)
+    memset(prof->table, 0, prof->tablesize * sizeof(int));
+}
+
+/* Read the clock */
+static double exprProfileTime(void)
+{
+#if defined(EXPR_PROFILE_TSC)
+  return (double)__builtin_ia32_rdtsc();
+#elif defined(EXPR_PROFILE_MONOTONIC)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#else
+  return (double)clock();
+#endif
+}
+
+/* Find the item of a node, -1 if not counted */
+static int exprProfileFind(exprProfile *prof, exprNode *node)
+{
+  unsigned int mask, pos;
+  int index;
+
+  if(prof->table == NULL)
+    return -1;
+
+  mask = (unsigned int)prof->tablesize - 1;
+
+  for(pos = EXPR_PROFILE_HASH(node) & mask; (index = prof->table[pos]) != 0; pos = (pos + 1) & mask)
+    {
+      if(prof->items[index - 1].node == node)
+        return index - 1;
+    }
+
+  return -1;
+}
+
+/* Find the item of a node, adding it if needed.  Returns -1 if out
+   of memory. */
+static int exprProfileAdd(exprProfile *prof, exprNode *node)
+{
+  exprProfileItem *item;
+  unsigned int mask, pos;
+  int index;
+
+  if(prof->count * 2 >= prof->tablesize)
+    {
+      if(exprProfileGrow(prof) != EXPR_ERROR_NOERROR)
+        return -1;
+    }
+
+  mask = (unsigned int)prof->tablesize - 1;
+
+  for(pos = EXPR_PROFILE_HASH(node) & mask; (index = prof->table[pos]) != 0; pos = (pos + 1) & mask)
+    {
+      if(prof->items[index - 1].node == node)
+        return index - 1;
+    }
+
+  if(prof->count == prof->size)
+    {
+      item = exprReallocMem(prof->items, prof->size * 2 * sizeof(exprProfileItem));
+      if(item == NULL)
+        return -1;
+
+      prof->items = item;
+      prof->size *= 2;
+    }
+
+  item = &(prof->items[prof->count]);
+  memset(item, 0, sizeof(exprProfileItem));
+  item->node = node;
+  item->start = item->end = -1;
+
+  prof->table[pos] = ++(prof->count);
+
+  return prof->count - 1;
+}
+
+/* Double the hash table, and make the first table and items */
+static int exprProfileGrow(exprProfile *prof)
+{
+  unsigned int mask, pos;
+  int *table;
+  int size, index;
+
+  if(prof->items == NULL)
+    {
+      prof->items = exprAllocMem(EXPR_PROFILE_SIZE * sizeof(exprProfileItem));
+      if(prof->items == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      prof->size = EXPR_PROFILE_SIZE;
+    }
+
+  size = prof->tablesize ? prof->tablesize * 2 : EXPR_PROFILE_SIZE * 2;
+
+  table = exprAllocMem(size * sizeof(int));
+  if(table == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  mask = (unsigned int)size - 1;
+
+  for(index = 0; index < prof->count; index++)
+    {
+      for(pos = EXPR_PROFILE_HASH(prof->items[index].node) & mask; table[pos]; pos = (pos + 1) & mask)
+        ;
+
+      table[pos] = index + 1;
+    }
+
+  exprFreeMem(prof->table);
+  prof->table = table;
+  prof->tablesize = size;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Set the positions of a counted node, called by exprParseSpans */
+static void exprProfileSpan(void *data, exprNode *node, int start, int end)
+{
+  exprProfile *prof = (exprProfile*)data;
+  int index;
+
+  index = exprProfileFind(prof, node);
+  if(index >= 0)
+    {
+      prof->items[index].start = start;
+      prof->items[index].end = end;
+    }
+}
+
+/* Find the function a node calls in the function list of the
+   expression by the entry it was parsed with, so names sharing a
+   solver are told apart.  The callbacks must still match in case
+   the list was cleared since.  Returns its index in the list, or
+   -1. */
+static int exprProfileFunc(exprObj *obj, exprNode *node, exprFunc **func)
+{
+  exprFunc *cur;
+  int pos;
+
+  *func = NULL;
+
+  if(node->type != EXPR_NODETYPE_FUNCTION || obj->flist == NULL)
+    return -1;
+
+  for(cur = obj->flist->head, pos = 0; cur; cur = cur->next, pos++)
+    {
+      if(cur != node->data.function.func)
+        continue;
+
+      if(node->data.function.fptr)
+        {
+          if(cur->fptr != node->data.function.fptr)
+            continue;
+        }
+      else
+        {
+          if(cur->fptr || cur->type != node->data.function.type)
+            continue;
+
+          /* Eager functions share a type */
+          if(cur->type == EXPR_NODEFUNC_EAGER &&
+            (node->data.function.eager == NULL || cur->eptr != node->data.function.eager->eptr))
+            continue;
+        }
+
+      *func = cur;
+      return pos;
+    }
+
+  return -1;
+}
+
+/* Sort items by their own time, most first */
+static int exprProfileCompare(const void *a, const void *b)
+{
+  double x = ((const exprProfileItem*)a)->self;
+  double y = ((const exprProfileItem*)b)->self;
+
+  return (x > y) ? -1 : (x < y);
+}
+
+/* Describe a node by the part of the expression it came from, or
+   by its type or function.  text must hold EXPR_PROFILE_SHOW + 8
+   characters. */
+static void exprProfileSource(exprObj *obj, char *expr, int len, exprProfileItem *item, char *text)
+{
+  exprFunc *func;
+  int pos, count, type;
+
+  if(expr == NULL || item->start < 0 || item->end >= len)
+    {
+      if(exprProfileFunc(obj, item->node, &func) >= 0)
+        {
+          sprintf(text, "(%.*s)", EXPR_PROFILE_SHOW, func->fname);
+          return;
+        }
+
+      type = item->node->type;
+      if(type < 0 || type >= EXPR_PROFILE_TYPES)
+        type = 0;
+
+      sprintf(text, "(%s)", exprProfileTypes[type]);
+      return;
+    }
+
+  count = item->end - item->start + 1;
+  if(count > EXPR_PROFILE_SHOW)
+    count = EXPR_PROFILE_SHOW - 3;
+
+  for(pos = 0; pos < count; pos++)
+    {
+      text[pos] = expr[item->start + pos];
+
+      /* Keep each node on one line */
+      if(isspace((unsigned char)text[pos]))
+        text[pos] = ' ';
+    }
+
+  if(count < item->end - item->start + 1)
+    {
+      strcpy(text + pos, "...");
+      return;
+    }
+
+  text[pos] = '\0';
+}
+
+/* Write a line of a report */
+static void exprProfileLine(exprProfileBuf *buf, char *fmt, ...)
+{
+  char line[EXPR_PROFILE_LINESIZE];
+  va_list args;
+  size_t len, size;
+  char *tmp;
+
+  if(buf->err != EXPR_ERROR_NOERROR)
+    return;
+
+  va_start(args, fmt);
+  len = vsprintf(line, fmt, args);
+  va_end(args);
+
+  strcpy(line + len, "\n");
+  len++;
+
+  if(buf->len + len + 1 > buf->size)
+    {
+      size = buf->size ? buf->size : 1024;
+      while(size < buf->len + len + 1)
+        size *= 2;
+
+      tmp = exprReallocMem(buf->text, size);
+      if(tmp == NULL)
+        {
+          buf->err = EXPR_ERROR_MEMORY;
+          return;
+        }
+
+      buf->text = tmp;
+      buf->size = size;
+    }
+
+  memcpy(buf->text + buf->len, line, len + 1);
+  buf->len += len;
+}
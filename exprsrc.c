@@ -0,0 +1,1270 @@
+/*
+  File: exprsrc.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Generate C source for an expression and load it compiled
+
+  This file is part of ExprEval.
+
+  The source has one function for the expression that takes a
+  structure with the address of each variable.  It follows
+  exprEvalNode, so the results and errors are the same.  Loops are
+  not written, since nothing could stop them.  exprNativeCreate compiles the
+  source with the system compiler into a shared library, keeps it
+  in a cache directory and loads it with dlopen.
+*/
+
+/* Shared library loading and getpid are not part of strict C */
+#if defined(__unix__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#if(EXPR_NATIVE) && (defined(__unix__) || defined(__APPLE__))
+#define EXPR_NATIVE_DL
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
+
+/* Name of the function in loaded libraries */
+#define EXPR_SOURCE_KERNEL "expr_kernel"
+
+/* Longest line written at once, not counting the indent */
+#define EXPR_SOURCE_LINESIZE (EXPR_MAXIDENTSIZE * 2 + 256)
+
+/* Text being written */
+typedef struct _exprSourceBuf
+{
+  char *text; /* The text, always ending with a 0 */
+  size_t len; /* Length of the text */
+  size_t size; /* Bytes allocated */
+  int err; /* Set when an allocation fails */
+} exprSourceBuf;
+
+/* Generator state */
+typedef struct _exprSource
+{
+  exprObj *obj; /* Expression being written */
+  exprSourceBuf body; /* Statements of the function */
+  int indent; /* Indent of the statements */
+  int temps; /* Number of temporaries used */
+  EXPRTYPE **vars; /* Address of each variable */
+  char **names; /* Member name of each variable */
+  int varcount; /* Number of variables */
+  int varsize; /* Room in vars and names */
+} exprSource;
+
+/* Internal functions */
+static int exprSourceGenerate(exprObj *obj, char *name, char **source, EXPRTYPE ***vars, int *varcount);
+static int exprSourceNode(exprSource *src, exprNode *node, int dest);
+static int exprSourceFunction(exprSource *src, exprNode *node, int dest);
+static int exprSourceArg(exprSource *src, exprNode *nodes, int pos, int *temp);
+static int exprSourceSlot(exprSource *src, EXPRTYPE *addr, int *slot);
+static char *exprSourceVar(exprSource *src, EXPRTYPE *addr);
+static void exprSourceMath(exprSource *src, int dest, char *func, int t1, int t2);
+static void exprSourceReset(exprSource *src);
+static void exprSourceCheck(exprSource *src);
+static void exprSourceLine(exprSource *src, char *fmt, ...);
+static void exprSourcePrint(exprSourceBuf *buf, int indent, char *fmt, va_list args);
+static void exprSourceAppend(exprSourceBuf *buf, char *text);
+static int exprSourceReserve(exprSourceBuf *buf, size_t len);
+static void exprSourceWrite(exprSourceBuf *buf, int indent, char *fmt, ...);
+static char *exprSourceNumber(EXPRTYPE value, char *text);
+static void exprSourceFreeState(exprSource *src);
+
+#ifdef EXPR_NATIVE_DL
+static void exprSourceHash(char *text, char *hash);
+static int exprSourceMatches(char *path, char *text);
+static int exprSourceSave(char *path, char *text);
+#endif
+
+
+/* Generate C source for a parsed expression.  The source has a
+   structure named name_vars with the address of each variable and
+   constant, a function name(struct name_vars *vars, double *val)
+   that returns an error code like exprEval, and a function
+   name_slots(double **slots, double *val) taking the addresses in
+   a table.  The source is freed with exprSourceFree.  Expressions
+   that call custom functions return EXPR_ERROR_NONATIVE, and so do
+   those using 'for', since neither the breaker nor exprSetCancel
+   could stop the loop.  A name longer than EXPR_MAXIDENTSIZE returns
+   EXPR_ERROR_BADIDENTIFIER. */
+int exprSourceCreate(exprObj *obj, char *name, char **source)
+{
+  EXPRTYPE **vars;
+  int varcount;
+  int err;
+
+  if(obj == NULL || name == NULL || source == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  err = exprSourceGenerate(obj, name, source, &vars, &varcount);
+
+  exprFreeMem(vars);
+  return err;
+}
+
+/* Free generated source */
+int exprSourceFree(char *source)
+{
+  exprFreeMem(source);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Compile the C source of an expression and load it.  The library
+   is kept in dir, named by a hash of the source, so later calls
+   with the same expression load it without compiling.  Each call
+   loads its own copy, so calls from several threads and hashes
+   that collide are safe.  Evaluating uses the variables and
+   constants the expression was parsed with, they must stay valid
+   as long as the native code is used.  The expression itself can
+   be freed. */
+int exprNativeCreate(exprNative **native, exprObj *obj, char *dir)
+{
+#ifdef EXPR_NATIVE_DL
+  exprNative *tmp;
+  EXPRTYPE **vars;
+  char *source, *mem;
+  char *cpath, *sopath, *tmpc, *tmpso, *cmd;
+  char hash[17];
+  long pid;
+  void *handle, *func;
+  size_t size;
+  int varcount, built;
+  int err;
+
+  if(native == NULL || obj == NULL || dir == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *native = NULL;
+
+  /* Paths are quoted for the shell */
+  if(strchr(dir, '\'') != NULL)
+    return EXPR_ERROR_NONATIVE;
+
+  err = exprSourceGenerate(obj, EXPR_SOURCE_KERNEL, &source, &vars, &varcount);
+  if(err != EXPR_ERROR_NOERROR)
+    {
+      exprFreeMem(vars);
+      return err;
+    }
+
+  /* Room for dir/expr_<hash>.<pid>.<address>.so in each path, the
+     command has two of them */
+  size = strlen(dir) + 96;
+  mem = exprAllocRawMem(size * 4);
+  cmd = exprAllocRawMem(size * 2 + strlen(EXPR_NATIVE_CC));
+  tmp = exprAllocMem(sizeof(exprNative) + varcount * sizeof(EXPRTYPE*));
+
+  if(mem == NULL || cmd == NULL || tmp == NULL)
+    {
+      err = EXPR_ERROR_MEMORY;
+      goto cleanup;
+    }
+
+  cpath = mem;
+  sopath = cpath + size;
+  tmpc = sopath + size;
+  tmpso = tmpc + size;
+
+  exprSourceHash(source, hash);
+  pid = (long)getpid();
+
+  sprintf(cpath, "%s/expr_%s.c", dir, hash);
+  sprintf(sopath, "%s/expr_%s.so", dir, hash);
+
+  /* The library is always loaded from a name of its own.  dlopen
+     returns the library already loaded under a name instead of
+     loading the file again, so a name shared by two expressions
+     could run the wrong code.  The address of the new object is
+     not used by any other native code loaded by this process until
+     it is freed and unloaded, and the process id keeps other
+     processes building in dir apart. */
+  sprintf(tmpc, "%s/expr_%s.%ld.%lx.c", dir, hash, pid, (unsigned long)tmp);
+  sprintf(tmpso, "%s/expr_%s.%ld.%lx.so", dir, hash, pid, (unsigned long)tmp);
+
+  /* The cached library is used if the source next to it is the
+     same, so hashes that collide only cost a compile */
+  built = 0;
+
+  if(!exprSourceMatches(cpath, source) || link(sopath, tmpso) != 0)
+    {
+      sprintf(cmd, EXPR_NATIVE_CC, tmpso, tmpc);
+
+      if(!exprSourceSave(tmpc, source))
+        {
+          err = EXPR_ERROR_NONATIVE;
+          goto cleanup;
+        }
+
+      if(system(cmd) != 0)
+        {
+          remove(tmpc);
+          remove(tmpso);
+          err = EXPR_ERROR_NONATIVE;
+          goto cleanup;
+        }
+
+      built = 1;
+    }
+
+  handle = dlopen(tmpso, RTLD_NOW | RTLD_LOCAL);
+
+  if(built && handle != NULL)
+    {
+      /* Keep it for later calls, the library first since the source
+         says it is ready.  Others never see half written files. */
+      rename(tmpso, sopath);
+      rename(tmpc, cpath);
+    }
+  else
+    {
+      remove(tmpso);
+
+      if(built)
+        remove(tmpc);
+    }
+
+  if(handle == NULL)
+    {
+      err = EXPR_ERROR_NONATIVE;
+      goto cleanup;
+    }
+
+  func = dlsym(handle, EXPR_SOURCE_KERNEL "_slots");
+  if(func == NULL)
+    {
+      dlclose(handle);
+      err = EXPR_ERROR_NONATIVE;
+      goto cleanup;
+    }
+
+  /* The variable table follows the header */
+  tmp->handle = handle;
+  memcpy(&(tmp->func), &func, sizeof(tmp->func));
+  tmp->vars = (EXPRTYPE**)(tmp + 1);
+  tmp->varcount = varcount;
+
+  if(varcount > 0)
+    memcpy(tmp->vars, vars, varcount * sizeof(EXPRTYPE*));
+
+  *native = tmp;
+  tmp = NULL;
+  err = EXPR_ERROR_NOERROR;
+
+cleanup:
+  exprFreeMem(tmp);
+  exprFreeMem(mem);
+  exprFreeMem(cmd);
+  exprFreeMem(vars);
+  exprFreeMem(source);
+
+  return err;
+#else
+  if(native == NULL || obj == NULL || dir == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  *native = NULL;
+  return EXPR_ERROR_NONATIVE;
+#endif
+}
+
+/* Unload native code */
+int exprNativeFree(exprNative *native)
+{
+  if(native == NULL)
+    return EXPR_ERROR_NOERROR;
+
+#ifdef EXPR_NATIVE_DL
+  dlclose(native->handle);
+#endif
+
+  /* The variable table is in the same allocation */
+  exprFreeMem(native);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Evaluate native code with the expression's variables */
+int exprNativeEval(exprNative *native, EXPRTYPE *val)
+{
+  EXPRTYPE dummy;
+  int err;
+
+  if(native == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  if(val == NULL)
+    val = &dummy;
+
+  err = (*(native->func))(native->vars, val);
+
+  /* The nodes of native code are not known */
+  EXPR_STAT_EVAL(1, 0, err);
+  return err;
+}
+
+/* Get the entry point taking a table of variable addresses, in the
+   order of the members of the structure in the source */
+exprNativeFunc exprNativeGetFunc(exprNative *native)
+{
+  return (native == NULL) ? NULL : native->func;
+}
+
+
+/* Generate the source, and the address of each variable in the
+   order of the structure */
+static int exprSourceGenerate(exprObj *obj, char *name, char **source, EXPRTYPE ***vars, int *varcount)
+{
+  exprSource src;
+  exprSourceBuf out;
+  int pos, err;
+
+  *source = NULL;
+  *vars = NULL;
+  *varcount = 0;
+
+  /* Must have parsed successfully */
+  if(obj->parsedbad || !obj->parsedgood || obj->headnode == NULL)
+    return EXPR_ERROR_BADEXPR;
+
+  /* Lines are formatted with the name twice, see EXPR_SOURCE_LINESIZE */
+  if(!exprValidIdent(name) || strlen(name) > EXPR_MAXIDENTSIZE)
+    return EXPR_ERROR_BADIDENTIFIER;
+
+  memset(&src, 0, sizeof(exprSource));
+  memset(&out, 0, sizeof(exprSourceBuf));
+  src.obj = obj;
+  src.indent = 2;
+  src.temps = 1;
+
+  /* The result is in t0 */
+  err = exprSourceNode(&src, obj->headnode, 0);
+  if(err == EXPR_ERROR_NOERROR && src.body.err != EXPR_ERROR_NOERROR)
+    err = src.body.err;
+
+  if(err != EXPR_ERROR_NOERROR)
+    {
+      exprSourceFreeState(&src);
+      return err;
+    }
+
+  exprSourceWrite(&out, 0, "/* Generated by ExprEval, do not edit */");
+  exprSourceWrite(&out, 0, "");
+  exprSourceWrite(&out, 0, "#include <errno.h>");
+  exprSourceWrite(&out, 0, "#include <math.h>");
+  exprSourceWrite(&out, 0, "#include <time.h>");
+  exprSourceWrite(&out, 0, "");
+  exprSourceWrite(&out, 0, "#define EXPR_ERROR_NOERROR %d", EXPR_ERROR_NOERROR);
+  exprSourceWrite(&out, 0, "#define EXPR_ERROR_DIVBYZERO %d", EXPR_ERROR_DIVBYZERO);
+  exprSourceWrite(&out, 0, "#define EXPR_ERROR_OUTOFRANGE %d", EXPR_ERROR_OUTOFRANGE);
+  exprSourceWrite(&out, 0, "");
+
+  /* Structure of variable addresses, C needs at least one member */
+  exprSourceWrite(&out, 0, "struct %s_vars", name);
+  exprSourceWrite(&out, 0, "{");
+
+  for(pos = 0; pos < src.varcount; pos++)
+    exprSourceWrite(&out, 2, "double *%s;", src.names[pos]);
+
+  if(src.varcount == 0)
+    exprSourceWrite(&out, 2, "double *unused;");
+
+  exprSourceWrite(&out, 0, "};");
+  exprSourceWrite(&out, 0, "");
+
+  exprSourceWrite(&out, 0, "int %s(struct %s_vars *vars, double *val)", name, name);
+  exprSourceWrite(&out, 0, "{");
+
+  for(pos = 0; pos < src.temps; pos++)
+    exprSourceWrite(&out, 2, "double t%d;", pos);
+
+  exprSourceWrite(&out, 0, "");
+  exprSourceAppend(&out, src.body.text);
+  exprSourceWrite(&out, 0, "");
+  exprSourceWrite(&out, 2, "*val = t0;");
+  exprSourceWrite(&out, 2, "return EXPR_ERROR_NOERROR;");
+  exprSourceWrite(&out, 0, "}");
+  exprSourceWrite(&out, 0, "");
+
+  exprSourceWrite(&out, 0, "int %s_slots(double **slots, double *val)", name);
+  exprSourceWrite(&out, 0, "{");
+  exprSourceWrite(&out, 2, "struct %s_vars vars;", name);
+  exprSourceWrite(&out, 0, "");
+
+  for(pos = 0; pos < src.varcount; pos++)
+    exprSourceWrite(&out, 2, "vars.%s = slots[%d];", src.names[pos], pos);
+
+  exprSourceWrite(&out, 0, "");
+  exprSourceWrite(&out, 2, "return %s(&vars, val);", name);
+  exprSourceWrite(&out, 0, "}");
+
+  if(out.err != EXPR_ERROR_NOERROR)
+    {
+      exprFreeMem(out.text);
+      exprSourceFreeState(&src);
+      return out.err;
+    }
+
+  *source = out.text;
+  *vars = src.vars;
+  *varcount = src.varcount;
+
+  src.vars = NULL;
+  exprSourceFreeState(&src);
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Write statements leaving the value of a node in temporary dest */
+static int exprSourceNode(exprSource *src, exprNode *node, int dest)
+{
+  char num[64];
+  char *var;
+  int t1, t2;
+  int pos, err;
+
+  switch(node->type)
+    {
+      case EXPR_NODETYPE_MULTI:
+        for(pos = 0; pos < node->data.oper.nodecount; pos++)
+          {
+            err = exprSourceNode(src, &(node->data.oper.nodes[pos]), dest);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+          }
+
+        return EXPR_ERROR_NOERROR;
+
+      case EXPR_NODETYPE_ADD:
+      case EXPR_NODETYPE_SUBTRACT:
+      case EXPR_NODETYPE_MULTIPLY:
+      case EXPR_NODETYPE_DIVIDE:
+      case EXPR_NODETYPE_EXPONENT:
+        err = exprSourceArg(src, node->data.oper.nodes, 0, &t1);
+        if(err == EXPR_ERROR_NOERROR)
+          err = exprSourceArg(src, node->data.oper.nodes, 1, &t2);
+
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
+
+        switch(node->type)
+          {
+            case EXPR_NODETYPE_ADD:
+              exprSourceLine(src, "t%d = t%d + t%d;", dest, t1, t2);
+              break;
+
+            case EXPR_NODETYPE_SUBTRACT:
+              exprSourceLine(src, "t%d = t%d - t%d;", dest, t1, t2);
+              break;
+
+            case EXPR_NODETYPE_MULTIPLY:
+              exprSourceLine(src, "t%d = t%d * t%d;", dest, t1, t2);
+              break;
+
+            case EXPR_NODETYPE_DIVIDE:
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+              exprSourceLine(src, "if(t%d == 0.0)", t2);
+              exprSourceLine(src, "  return EXPR_ERROR_DIVBYZERO;");
+              exprSourceLine(src, "t%d = t%d / t%d;", dest, t1, t2);
+#else
+              exprSourceLine(src, "t%d = (t%d != 0.0) ? t%d / t%d : 0.0;", dest, t2, t1, t2);
+#endif
+              break;
+
+            default:
+              exprSourceMath(src, dest, "pow", t1, t2);
+              break;
+          }
+
+        return EXPR_ERROR_NOERROR;
+
+      case EXPR_NODETYPE_NEGATE:
+        err = exprSourceArg(src, node->data.oper.nodes, 0, &t1);
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
+
+        exprSourceLine(src, "t%d = -t%d;", dest, t1);
+        return EXPR_ERROR_NOERROR;
+
+      case EXPR_NODETYPE_VALUE:
+        exprSourceLine(src, "t%d = %s;", dest, exprSourceNumber(node->data.value.value, num));
+        return EXPR_ERROR_NOERROR;
+
+      case EXPR_NODETYPE_VARIABLE:
+        var = exprSourceVar(src, node->data.variable.vaddr);
+        if(var == NULL)
+          return EXPR_ERROR_MEMORY;
+
+        exprSourceLine(src, "t%d = *vars->%s;", dest, var);
+        return EXPR_ERROR_NOERROR;
+
+      case EXPR_NODETYPE_ASSIGN:
+        err = exprSourceNode(src, node->data.assign.node, dest);
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
+
+        var = exprSourceVar(src, node->data.assign.vaddr);
+        if(var == NULL)
+          return EXPR_ERROR_MEMORY;
+
+        exprSourceLine(src, "*vars->%s = t%d;", var, dest);
+        return EXPR_ERROR_NOERROR;
+
+      case EXPR_NODETYPE_FUNCTION:
+        /* Custom functions need the expression */
+        if(node->data.function.fptr != NULL || node->data.function.type == EXPR_NODEFUNC_EAGER)
+          return EXPR_ERROR_NONATIVE;
+
+        return exprSourceFunction(src, node, dest);
+
+      default:
+        return EXPR_ERROR_UNKNOWN;
+    }
+}
+
+/* Write statements for a built in function, like exprilfs.h */
+static int exprSourceFunction(exprSource *src, exprNode *node, int dest)
+{
+  static char *math1[] =
+    {
+      "sqrt", "sin", "sinh", "asin", "cos", "cosh", "acos", "tan", "tanh", "atan", "log10", "log", "exp"
+    };
+
+  static int types1[] =
+    {
+      EXPR_NODEFUNC_SQRT, EXPR_NODEFUNC_SIN, EXPR_NODEFUNC_SINH, EXPR_NODEFUNC_ASIN,
+      EXPR_NODEFUNC_COS, EXPR_NODEFUNC_COSH, EXPR_NODEFUNC_ACOS, EXPR_NODEFUNC_TAN,
+      EXPR_NODEFUNC_TANH, EXPR_NODEFUNC_ATAN, EXPR_NODEFUNC_LOG, EXPR_NODEFUNC_LN,
+      EXPR_NODEFUNC_EXP
+    };
+
+  exprNode *nodes = node->data.function.nodes;
+  int count = node->data.function.nodecount;
+  int type = node->data.function.type;
+  char num[64];
+  char *var;
+  int t[5];
+  int pos, err;
+
+  /* Functions of one value from the math library */
+  for(pos = 0; pos < (int)(sizeof(types1) / sizeof(int)); pos++)
+    {
+      if(types1[pos] == type)
+        {
+          err = exprSourceArg(src, nodes, 0, &t[0]);
+          if(err != EXPR_ERROR_NOERROR)
+            return err;
+
+          exprSourceMath(src, dest, math1[pos], t[0], -1);
+          return EXPR_ERROR_NOERROR;
+        }
+    }
+
+  /* Functions using a reference variable */
+  var = NULL;
+  if(type == EXPR_NODEFUNC_RAND || type == EXPR_NODEFUNC_RANDOM || type == EXPR_NODEFUNC_RANDOMIZE)
+    {
+      var = exprSourceVar(src, node->data.function.refs[0]);
+      if(var == NULL)
+        return EXPR_ERROR_MEMORY;
+    }
+
+  /* Functions with a fixed number of values evaluate all of them
+     first */
+  switch(type)
+    {
+      case EXPR_NODEFUNC_ABS:
+      case EXPR_NODEFUNC_IPART:
+      case EXPR_NODEFUNC_FPART:
+      case EXPR_NODEFUNC_POW10:
+      case EXPR_NODEFUNC_CEIL:
+      case EXPR_NODEFUNC_FLOOR:
+      case EXPR_NODEFUNC_DEG:
+      case EXPR_NODEFUNC_RAD:
+      case EXPR_NODEFUNC_NOT:
+      case EXPR_NODEFUNC_MOD:
+      case EXPR_NODEFUNC_POW:
+      case EXPR_NODEFUNC_ATAN2:
+      case EXPR_NODEFUNC_LOGN:
+      case EXPR_NODEFUNC_RANDOM:
+      case EXPR_NODEFUNC_RECTTOPOLR:
+      case EXPR_NODEFUNC_RECTTOPOLA:
+      case EXPR_NODEFUNC_POLTORECTX:
+      case EXPR_NODEFUNC_POLTORECTY:
+      case EXPR_NODEFUNC_EQUAL:
+      case EXPR_NODEFUNC_ABOVE:
+      case EXPR_NODEFUNC_BELOW:
+      case EXPR_NODEFUNC_AND:
+      case EXPR_NODEFUNC_OR:
+      case EXPR_NODEFUNC_CLIP:
+      case EXPR_NODEFUNC_CLAMP:
+      case EXPR_NODEFUNC_PNTCHANGE:
+        for(pos = 0; pos < count && pos < 5; pos++)
+          {
+            err = exprSourceArg(src, nodes, pos, &t[pos]);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+          }
+
+        break;
+    }
+
+  switch(type)
+    {
+      case EXPR_NODEFUNC_ABS:
+        exprSourceLine(src, "t%d = (t%d >= 0) ? t%d : -t%d;", dest, t[0], t[0], t[0]);
+        break;
+
+      case EXPR_NODEFUNC_MOD:
+        exprSourceMath(src, dest, "fmod", t[0], t[1]);
+        break;
+
+      case EXPR_NODEFUNC_IPART:
+        exprSourceReset(src);
+        exprSourceLine(src, "modf(t%d, &t%d);", t[0], dest);
+        exprSourceCheck(src);
+        break;
+
+      case EXPR_NODEFUNC_FPART:
+        exprSourceReset(src);
+        exprSourceLine(src, "t%d = modf(t%d, &t%d);", dest, t[0], t[0]);
+        exprSourceCheck(src);
+        break;
+
+      case EXPR_NODEFUNC_MIN:
+      case EXPR_NODEFUNC_MAX:
+        err = exprSourceNode(src, &(nodes[0]), dest);
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
+
+        for(pos = 1; pos < count; pos++)
+          {
+            err = exprSourceArg(src, nodes, pos, &t[0]);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+
+            exprSourceLine(src, "if(t%d %c t%d)", t[0], (type == EXPR_NODEFUNC_MIN) ? '<' : '>', dest);
+            exprSourceLine(src, "  t%d = t%d;", dest, t[0]);
+          }
+
+        break;
+
+      case EXPR_NODEFUNC_POW:
+        exprSourceMath(src, dest, "pow", t[0], t[1]);
+        break;
+
+      case EXPR_NODEFUNC_ATAN2:
+        exprSourceMath(src, dest, "atan2", t[0], t[1]);
+        break;
+
+      case EXPR_NODEFUNC_POW10:
+        exprSourceReset(src);
+        exprSourceLine(src, "t%d = pow(10.0, t%d);", dest, t[0]);
+        exprSourceCheck(src);
+        break;
+
+      case EXPR_NODEFUNC_LOGN:
+        /* The logarithms replace the values */
+        exprSourceReset(src);
+        exprSourceLine(src, "t%d = log(t%d);", t[0], t[0]);
+        exprSourceCheck(src);
+        exprSourceLine(src, "t%d = log(t%d);", t[1], t[1]);
+        exprSourceCheck(src);
+
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+        exprSourceLine(src, "if(t%d == 0.0)", t[1]);
+        exprSourceLine(src, "  return EXPR_ERROR_OUTOFRANGE;");
+        exprSourceLine(src, "t%d = t%d / t%d;", dest, t[0], t[1]);
+#else
+        exprSourceLine(src, "t%d = (t%d != 0.0) ? t%d / t%d : 0.0;", dest, t[1], t[0], t[1]);
+#endif
+        break;
+
+      case EXPR_NODEFUNC_CEIL:
+        exprSourceLine(src, "t%d = ceil(t%d);", dest, t[0]);
+        break;
+
+      case EXPR_NODEFUNC_FLOOR:
+        exprSourceLine(src, "t%d = floor(t%d);", dest, t[0]);
+        break;
+
+      case EXPR_NODEFUNC_RAND:
+      case EXPR_NODEFUNC_RANDOM:
+        exprSourceLine(src, "{");
+        exprSourceLine(src, "  long a = ((long)(*vars->%s)) * 214013L + 2531011L;", var);
+        exprSourceLine(src, "");
+        exprSourceLine(src, "  *vars->%s = (double)a;", var);
+
+        if(type == EXPR_NODEFUNC_RAND)
+          exprSourceLine(src, "  t%d = (double)((a >> 16) & 0x7FFF) / (double)(32768);", dest);
+        else
+          exprSourceLine(src, "  t%d = ((double)((a >> 16) & 0x7FFF) / (double)(32767) * (t%d - t%d)) + t%d;",
+            dest, t[1], t[0], t[0]);
+
+        exprSourceLine(src, "}");
+        break;
+
+      case EXPR_NODEFUNC_RANDOMIZE:
+        /* Like compiled programs, the result is 0 */
+        exprSourceLine(src, "{");
+        exprSourceLine(src, "  static int curcall = 0;");
+        exprSourceLine(src, "");
+        exprSourceLine(src, "  curcall++;");
+        exprSourceLine(src, "  *vars->%s = (double)((clock() + 1024 + curcall) * time(NULL));", var);
+        exprSourceLine(src, "  t%d = 0.0;", dest);
+        exprSourceLine(src, "}");
+        break;
+
+      case EXPR_NODEFUNC_DEG:
+        exprSourceLine(src, "t%d = (180.0 * t%d) / %s;", dest, t[0], exprSourceNumber(M_PI, num));
+        break;
+
+      case EXPR_NODEFUNC_RAD:
+        exprSourceLine(src, "t%d = (%s * t%d) / 180.0;", dest, exprSourceNumber(M_PI, num), t[0]);
+        break;
+
+      case EXPR_NODEFUNC_RECTTOPOLR:
+        exprSourceReset(src);
+        exprSourceLine(src, "t%d = sqrt((t%d * t%d) + (t%d * t%d));", dest, t[0], t[0], t[1], t[1]);
+        exprSourceCheck(src);
+        break;
+
+      case EXPR_NODEFUNC_RECTTOPOLA:
+        exprSourceReset(src);
+        exprSourceLine(src, "t%d = atan2(t%d, t%d);", t[0], t[1], t[0]);
+        exprSourceCheck(src);
+        exprSourceLine(src, "t%d = (t%d < 0.0) ? t%d + (2.0 * %s) : t%d;", dest, t[0], t[0],
+          exprSourceNumber(M_PI, num), t[0]);
+        break;
+
+      case EXPR_NODEFUNC_POLTORECTX:
+      case EXPR_NODEFUNC_POLTORECTY:
+        exprSourceReset(src);
+        exprSourceLine(src, "t%d = t%d * %s(t%d);", dest, t[0], (type == EXPR_NODEFUNC_POLTORECTX) ? "cos" : "sin", t[1]);
+        exprSourceCheck(src);
+        break;
+
+      case EXPR_NODEFUNC_IF:
+      case EXPR_NODEFUNC_SELECT:
+        /* Only the chosen value is evaluated */
+        err = exprSourceArg(src, nodes, 0, &t[0]);
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
+
+        if(type == EXPR_NODEFUNC_IF)
+          exprSourceLine(src, "if(t%d != 0.0)", t[0]);
+        else
+          exprSourceLine(src, "if(t%d < 0.0)", t[0]);
+
+        exprSourceLine(src, "{");
+        src->indent += 2;
+        err = exprSourceNode(src, &(nodes[1]), dest);
+        src->indent -= 2;
+        exprSourceLine(src, "}");
+
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
+
+        if(type == EXPR_NODEFUNC_SELECT)
+          {
+            exprSourceLine(src, "else if(t%d == 0.0)", t[0]);
+            exprSourceLine(src, "{");
+            src->indent += 2;
+            err = exprSourceNode(src, &(nodes[2]), dest);
+            src->indent -= 2;
+            exprSourceLine(src, "}");
+
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+          }
+
+        exprSourceLine(src, "else");
+        exprSourceLine(src, "{");
+        src->indent += 2;
+        err = exprSourceNode(src, &(nodes[count - 1]), dest);
+        src->indent -= 2;
+        exprSourceLine(src, "}");
+
+        return err;
+
+      case EXPR_NODEFUNC_EQUAL:
+      case EXPR_NODEFUNC_ABOVE:
+      case EXPR_NODEFUNC_BELOW:
+        exprSourceLine(src, "t%d = (t%d %s t%d) ? 1.0 : 0.0;", dest, t[0],
+          (type == EXPR_NODEFUNC_EQUAL) ? "==" : (type == EXPR_NODEFUNC_ABOVE) ? ">" : "<", t[1]);
+        break;
+
+      case EXPR_NODEFUNC_AVG:
+        /* The sum is kept in dest */
+        exprSourceLine(src, "t%d = 0.0;", dest);
+
+        for(pos = 0; pos < count; pos++)
+          {
+            err = exprSourceArg(src, nodes, pos, &t[0]);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+
+            exprSourceLine(src, "t%d += t%d;", dest, t[0]);
+          }
+
+        sprintf(num, "%d", count);
+        exprSourceLine(src, "t%d = t%d / (double)(%s);", dest, dest, num);
+        break;
+
+      case EXPR_NODEFUNC_CLIP:
+        exprSourceLine(src, "if(t%d < t%d)", t[0], t[1]);
+        exprSourceLine(src, "  t%d = t%d;", dest, t[1]);
+        exprSourceLine(src, "else if(t%d > t%d)", t[0], t[2]);
+        exprSourceLine(src, "  t%d = t%d;", dest, t[2]);
+        exprSourceLine(src, "else");
+        exprSourceLine(src, "  t%d = t%d;", dest, t[0]);
+        break;
+
+      case EXPR_NODEFUNC_CLAMP:
+        exprSourceReset(src);
+        exprSourceLine(src, "t%d = fmod(t%d - t%d, t%d - t%d);", t[0], t[0], t[1], t[2], t[1]);
+        exprSourceCheck(src);
+        exprSourceLine(src, "t%d = (t%d < 0.0) ? t%d + t%d : t%d + t%d;", dest, t[0], t[0], t[2], t[0], t[1]);
+        break;
+
+      case EXPR_NODEFUNC_PNTCHANGE:
+        /* side1, side2, new1, new2 and the point */
+        exprSourceLine(src, "if(t%d - t%d == 0.0)", t[1], t[0]);
+        exprSourceLine(src, "  t%d = t%d;", dest, t[0]);
+        exprSourceLine(src, "else");
+        exprSourceLine(src, "  t%d = t%d + (((t%d - t%d) / (t%d - t%d)) * (t%d - t%d));", dest,
+          t[2], t[4], t[0], t[1], t[0], t[3], t[2]);
+        break;
+
+      case EXPR_NODEFUNC_POLY:
+        /* The total is kept in dest, the powers are known */
+        err = exprSourceArg(src, nodes, 0, &t[0]);
+        if(err != EXPR_ERROR_NOERROR)
+          return err;
+
+        exprSourceLine(src, "t%d = 0.0;", dest);
+
+        for(pos = 1; pos < count; pos++)
+          {
+            err = exprSourceArg(src, nodes, pos, &t[1]);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+
+            exprSourceReset(src);
+            exprSourceLine(src, "t%d = t%d + (t%d * pow(t%d, %s));", dest, dest, t[1], t[0],
+              exprSourceNumber((EXPRTYPE)(count - 1 - pos), num));
+            exprSourceCheck(src);
+          }
+
+        break;
+
+      case EXPR_NODEFUNC_AND:
+        exprSourceLine(src, "t%d = (t%d == 0.0 || t%d == 0.0) ? 0.0 : 1.0;", dest, t[0], t[1]);
+        break;
+
+      case EXPR_NODEFUNC_OR:
+        exprSourceLine(src, "t%d = (t%d != 0.0 || t%d != 0.0) ? 1.0 : 0.0;", dest, t[0], t[1]);
+        break;
+
+      case EXPR_NODEFUNC_NOT:
+        exprSourceLine(src, "t%d = (t%d != 0.0) ? 0.0 : 1.0;", dest, t[0]);
+        break;
+
+      case EXPR_NODEFUNC_FOR:
+        /* Native code has no way to be cancelled or to call the
+           breaker, so a loop could never be stopped */
+        return EXPR_ERROR_NONATIVE;
+
+      case EXPR_NODEFUNC_MANY:
+        for(pos = 0; pos < count; pos++)
+          {
+            err = exprSourceNode(src, &(nodes[pos]), dest);
+            if(err != EXPR_ERROR_NOERROR)
+              return err;
+          }
+
+        break;
+
+      default:
+        return EXPR_ERROR_UNKNOWN;
+    }
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Write a subnode into a new temporary */
+static int exprSourceArg(exprSource *src, exprNode *nodes, int pos, int *temp)
+{
+  *temp = src->temps++;
+
+  return exprSourceNode(src, &(nodes[pos]), *temp);
+}
+
+/* Find or add the slot of a variable address */
+static int exprSourceSlot(exprSource *src, EXPRTYPE *addr, int *slot)
+{
+  static char *keywords[] =
+    {
+      "auto", "break", "case", "char", "const", "continue", "default", "do",
+      "double", "else", "enum", "extern", "float", "for", "goto", "if",
+      "inline", "int", "long", "register", "restrict", "return", "short",
+      "signed", "sizeof", "static", "struct", "switch", "typedef", "union",
+      "unsigned", "void", "volatile", "while", "errno", "linux", "unix"
+    };
+
+  char *name, *tmpname;
+  EXPRTYPE *vaddr;
+  void *cookie;
+  size_t len;
+  int pos;
+
+  for(pos = 0; pos < src->varcount; pos++)
+    {
+      if(src->vars[pos] == addr)
+        {
+          *slot = pos;
+          return EXPR_ERROR_NOERROR;
+        }
+    }
+
+  if(src->varcount == src->varsize)
+    {
+      EXPRTYPE **vars;
+      char **names;
+      int size = src->varsize ? src->varsize * 2 : 16;
+
+      vars = exprReallocMem(src->vars, size * sizeof(EXPRTYPE*));
+      if(vars == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      src->vars = vars;
+
+      names = exprReallocMem(src->names, size * sizeof(char*));
+      if(names == NULL)
+        return EXPR_ERROR_MEMORY;
+
+      src->names = names;
+      src->varsize = size;
+    }
+
+  /* The member is named after the variable or constant */
+  name = NULL;
+
+  if(src->obj->vlist)
+    {
+      cookie = exprValListGetNext(src->obj->vlist, &name, NULL, &vaddr, NULL);
+      while(cookie && vaddr != addr)
+        cookie = exprValListGetNext(src->obj->vlist, &name, NULL, &vaddr, cookie);
+
+      if(cookie == NULL)
+        name = NULL;
+    }
+
+  if(name == NULL && src->obj->clist)
+    {
+      cookie = exprValListGetNext(src->obj->clist, &name, NULL, &vaddr, NULL);
+      while(cookie && vaddr != addr)
+        cookie = exprValListGetNext(src->obj->clist, &name, NULL, &vaddr, cookie);
+
+      if(cookie == NULL)
+        name = NULL;
+    }
+
+  /* Names that are C keywords or may be macros get the slot added,
+     so do names already used */
+  len = (name != NULL) ? strlen(name) : 0;
+  tmpname = exprAllocRawMem(len + 16);
+  if(tmpname == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  if(name == NULL)
+    sprintf(tmpname, "v%d", src->varcount);
+  else
+    {
+      strcpy(tmpname, name);
+
+      for(pos = 0; pos < (int)(sizeof(keywords) / sizeof(char*)); pos++)
+        {
+          if(strcmp(tmpname, keywords[pos]) == 0)
+            sprintf(tmpname + len, "_v%d", src->varcount);
+        }
+
+      /* Like HUGE_VAL and M_PI */
+      for(pos = 0; name[pos] != '\0'; pos++)
+        {
+          if(name[pos] >= 'a' && name[pos] <= 'z')
+            break;
+        }
+
+      if(name[pos] == '\0')
+        sprintf(tmpname + len, "_v%d", src->varcount);
+
+      for(pos = 0; pos < src->varcount; pos++)
+        {
+          if(strcmp(tmpname, src->names[pos]) == 0)
+            sprintf(tmpname + len, "_v%d", src->varcount);
+        }
+    }
+
+  src->vars[src->varcount] = addr;
+  src->names[src->varcount] = tmpname;
+  *slot = src->varcount++;
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Member name of a variable address, NULL if out of memory */
+static char *exprSourceVar(exprSource *src, EXPRTYPE *addr)
+{
+  int slot;
+
+  if(exprSourceSlot(src, addr, &slot) != EXPR_ERROR_NOERROR)
+    return NULL;
+
+  return src->names[slot];
+}
+
+/* Call a math routine of one or two values, t2 is -1 for one */
+static void exprSourceMath(exprSource *src, int dest, char *func, int t1, int t2)
+{
+  exprSourceReset(src);
+
+  if(t2 < 0)
+    exprSourceLine(src, "t%d = %s(t%d);", dest, func, t1);
+  else
+    exprSourceLine(src, "t%d = %s(t%d, t%d);", dest, func, t1, t2);
+
+  exprSourceCheck(src);
+}
+
+/* Reset the math error */
+static void exprSourceReset(exprSource *src)
+{
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+  exprSourceLine(src, "errno = 0;");
+#else
+  (void)src;
+#endif
+}
+
+/* Return if a math error happened */
+static void exprSourceCheck(exprSource *src)
+{
+#if(EXPR_ERROR_LEVEL >= EXPR_ERROR_LEVEL_CHECK)
+  exprSourceLine(src, "if(errno)");
+  exprSourceLine(src, "  return EXPR_ERROR_OUTOFRANGE;");
+#else
+  (void)src;
+#endif
+}
+
+/* Write a line of the function body */
+static void exprSourceLine(exprSource *src, char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  exprSourcePrint(&(src->body), src->indent, fmt, args);
+  va_end(args);
+}
+
+/* Write a line with the given indent */
+static void exprSourceWrite(exprSourceBuf *buf, int indent, char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  exprSourcePrint(buf, indent, fmt, args);
+  va_end(args);
+}
+
+/* Format a line, empty lines have no indent.  The line is formatted
+   in place at the end of the buffer, with room for the indent and
+   EXPR_SOURCE_LINESIZE more, since the indent has no limit. */
+static void exprSourcePrint(exprSourceBuf *buf, int indent, char *fmt, va_list args)
+{
+  char *line;
+  int len;
+
+  if(fmt[0] == '\0')
+    indent = 0;
+
+  if(!exprSourceReserve(buf, indent + EXPR_SOURCE_LINESIZE))
+    return;
+
+  line = buf->text + buf->len;
+  memset(line, ' ', indent);
+  len = indent;
+
+  len += vsprintf(line + len, fmt, args);
+  strcpy(line + len, "\n");
+
+  buf->len += len + 1;
+}
+
+/* Add text to a buffer */
+static void exprSourceAppend(exprSourceBuf *buf, char *text)
+{
+  size_t len = strlen(text);
+
+  if(!exprSourceReserve(buf, len))
+    return;
+
+  memcpy(buf->text + buf->len, text, len + 1);
+  buf->len += len;
+}
+
+/* Make room for len more characters and the ending 0 in a buffer,
+   returns 0 if there is not */
+static int exprSourceReserve(exprSourceBuf *buf, size_t len)
+{
+  size_t size;
+  char *tmp;
+
+  if(buf->err != EXPR_ERROR_NOERROR)
+    return 0;
+
+  if(buf->len + len + 1 > buf->size)
+    {
+      size = buf->size ? buf->size : 1024;
+      while(size < buf->len + len + 1)
+        size *= 2;
+
+      tmp = exprReallocMem(buf->text, size);
+      if(tmp == NULL)
+        {
+          buf->err = EXPR_ERROR_MEMORY;
+          return 0;
+        }
+
+      buf->text = tmp;
+      buf->size = size;
+    }
+
+  return 1;
+}
+
+/* Write a number so the compiler reads back the same value */
+static char *exprSourceNumber(EXPRTYPE value, char *text)
+{
+  if(value != value)
+    strcpy(text, "(HUGE_VAL - HUGE_VAL)");
+  else if(value == HUGE_VAL)
+    strcpy(text, "HUGE_VAL");
+  else if(value == -HUGE_VAL)
+    strcpy(text, "(-HUGE_VAL)");
+  else
+    {
+      sprintf(text, "%.17g", value);
+
+      /* Keep it a double, -0 must not become an int */
+      if(strpbrk(text, ".e") == NULL)
+        strcat(text, ".0");
+
+      if(text[0] == '-')
+        {
+          memmove(text + 1, text, strlen(text) + 1);
+          text[0] = '(';
+          strcat(text, ")");
+        }
+    }
+
+  return text;
+}
+
+/* Free the generator state */
+static void exprSourceFreeState(exprSource *src)
+{
+  int pos;
+
+  for(pos = 0; pos < src->varcount; pos++)
+    exprFreeMem(src->names[pos]);
+
+  exprFreeMem(src->names);
+  exprFreeMem(src->vars);
+  exprFreeMem(src->body.text);
+}
+
+
+#ifdef EXPR_NATIVE_DL
+
+/* 64 bit hash of the source as 16 hex digits, from an FNV-1a hash
+   and a second 32 bit hash with another multiplier and shift */
+static void exprSourceHash(char *text, char *hash)
+{
+  unsigned long h1 = 2166136261UL;
+  unsigned long h2 = 0x6A09E667UL;
+
+  while(*text)
+    {
+      h1 ^= (unsigned char)*text;
+      h1 = (h1 * 16777619UL) & 0xFFFFFFFFUL;
+      h2 ^= (unsigned char)*text++;
+      h2 = (h2 * 0x5BD1E995UL) & 0xFFFFFFFFUL;
+      h2 ^= h2 >> 15;
+    }
+
+  sprintf(hash, "%08lx%08lx", h1, h2);
+}
+
+/* Does a file hold exactly the text? */
+static int exprSourceMatches(char *path, char *text)
+{
+  FILE *file;
+  size_t len = strlen(text);
+  size_t pos;
+  int c;
+
+  file = fopen(path, "rb");
+  if(file == NULL)
+    return 0;
+
+  for(pos = 0; pos < len; pos++)
+    {
+      c = getc(file);
+      if(c != (unsigned char)text[pos])
+        break;
+    }
+
+  /* Must also end there */
+  if(pos == len)
+    c = getc(file);
+
+  fclose(file);
+
+  return (pos == len && c == EOF);
+}
+
+/* Write text to a file, returns 0 on failure */
+static int exprSourceSave(char *path, char *text)
+{
+  FILE *file;
+  size_t len = strlen(text);
+  int good;
+
+  file = fopen(path, "wb");
+  if(file == NULL)
+    return 0;
+
+  good = (fwrite(text, 1, len, file) == len);
+
+  if(fclose(file) != 0)
+    good = 0;
+
+  if(!good)
+    remove(path);
+
+  return good;
+}
+
+#endif /* EXPR_NATIVE_DL */
@@ -0,0 +1,196 @@
+/*
+  File: exprstat.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Counters of the whole library
+
+  This file is part of ExprEval.
+
+  Each thread counts into a block of its own, so counting takes no
+  lock and threads do not write to the same memory.  The blocks of
+  the running threads are kept in a list, and exprGetStats adds
+  them up.  When a thread ends its counts are added to the ones of
+  the threads that have ended and its block is freed.  Without
+  threads there is one block for the whole library.
+*/
+
+/* Threads are not part of strict C */
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+/* Includes */
+#include "exprincl.h"
+
+#include "exprpriv.h"
+#include "exprmem.h"
+
+#ifdef EXPR_STAT_TLS
+#include <pthread.h>
+#endif
+
+
+#ifdef EXPR_STAT_TLS
+
+/* Block of the calling thread, NULL until it first counts */
+__thread exprStatBlock *exprStatLocal = NULL;
+
+static pthread_mutex_t exprStatLock = PTHREAD_MUTEX_INITIALIZER; /* Guards the members below */
+static pthread_once_t exprStatOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t exprStatKey; /* Frees the block of a thread when it ends */
+static int exprStatKeyMade = 0;
+static exprStatBlock *exprStatList = NULL; /* Blocks of the running threads */
+static exprStatBlock exprStatEnded; /* Counts of the threads that have ended */
+
+/* Used by threads that could not get a block of their own.  Counts
+   from more than one of them at a time may be lost. */
+static exprStatBlock exprStatSpare;
+
+#else
+
+exprStatBlock exprStatGlobal;
+
+#endif
+
+/* Internal functions */
+static void exprStatSum(exprStats *stats, exprStatBlock *block);
+
+#ifdef EXPR_STAT_TLS
+static void exprStatInit(void);
+static void exprStatEnd(void *data);
+#endif
+
+
+/* Get the counters of the library since it was loaded, added up over
+   all threads.  Each counter is read on its own while other threads
+   keep counting, so the counters may be a little apart from each
+   other.  Take the difference of two calls to measure some work. */
+int exprGetStats(exprStats *stats)
+{
+  exprStatBlock *block;
+
+  if(stats == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  memset(stats, 0, sizeof(exprStats));
+
+#ifdef EXPR_STAT_TLS
+  pthread_mutex_lock(&exprStatLock);
+
+  exprStatSum(stats, &exprStatEnded);
+  exprStatSum(stats, &exprStatSpare);
+
+  for(block = exprStatList; block; block = block->next)
+    exprStatSum(stats, block);
+
+  pthread_mutex_unlock(&exprStatLock);
+#else
+  block = &exprStatGlobal;
+  exprStatSum(stats, block);
+#endif
+
+  return EXPR_ERROR_NOERROR;
+}
+
+/* Get the block of the calling thread, making it the first time */
+exprStatBlock *exprStatThread(void)
+{
+#ifdef EXPR_STAT_TLS
+  exprStatBlock *block;
+
+  pthread_once(&exprStatOnce, exprStatInit);
+
+  /* Not exprAllocMem, which counts into the block */
+  block = malloc(sizeof(exprStatBlock));
+  if(block == NULL || !exprStatKeyMade || pthread_setspecific(exprStatKey, block) != 0)
+    {
+      free(block);
+      return &exprStatSpare;
+    }
+
+  memset(block, 0, sizeof(exprStatBlock));
+
+  pthread_mutex_lock(&exprStatLock);
+  block->next = exprStatList;
+  exprStatList = block;
+  pthread_mutex_unlock(&exprStatLock);
+
+  exprStatLocal = block;
+  return block;
+#else
+  return &exprStatGlobal;
+#endif
+}
+
+/* Add the counters of a block to a snapshot */
+static void exprStatSum(exprStats *stats, exprStatBlock *block)
+{
+  int pos;
+
+  stats->parses += EXPR_COUNT_GET(&(block->parses));
+  stats->evals += EXPR_COUNT_GET(&(block->evals));
+  stats->nodes += EXPR_COUNT_GET(&(block->nodes));
+  stats->breaks += EXPR_COUNT_GET(&(block->breaks));
+  stats->allocs += EXPR_COUNT_GET(&(block->allocs));
+  stats->frees += EXPR_COUNT_GET(&(block->frees));
+  stats->bytes += EXPR_COUNT_GET(&(block->bytes));
+  stats->livenodes += (long)(EXPR_COUNT_GET(&(block->nodesmade)) - EXPR_COUNT_GET(&(block->nodesfreed)));
+
+  for(pos = 0; pos <= EXPR_ERROR_USER; pos++)
+    {
+      stats->parseerrors[pos] += EXPR_COUNT_GET(&(block->parseerrors[pos]));
+      stats->evalerrors[pos] += EXPR_COUNT_GET(&(block->evalerrors[pos]));
+    }
+}
+
+#ifdef EXPR_STAT_TLS
+
+/* Make the key that frees the blocks */
+static void exprStatInit(void)
+{
+  exprStatKeyMade = (pthread_key_create(&exprStatKey, exprStatEnd) == 0);
+}
+
+/* Keep the counts of a thread that is ending and free its block */
+static void exprStatEnd(void *data)
+{
+  exprStatBlock *block, **prev;
+  int pos;
+
+  block = (exprStatBlock*)data;
+
+  pthread_mutex_lock(&exprStatLock);
+
+  for(prev = &exprStatList; *prev; prev = &((*prev)->next))
+    {
+      if(*prev == block)
+        {
+          *prev = block->next;
+          break;
+        }
+    }
+
+  EXPR_STAT_ADD(&exprStatEnded, parses, block->parses);
+  EXPR_STAT_ADD(&exprStatEnded, evals, block->evals);
+  EXPR_STAT_ADD(&exprStatEnded, nodes, block->nodes);
+  EXPR_STAT_ADD(&exprStatEnded, breaks, block->breaks);
+  EXPR_STAT_ADD(&exprStatEnded, allocs, block->allocs);
+  EXPR_STAT_ADD(&exprStatEnded, frees, block->frees);
+  EXPR_STAT_ADD(&exprStatEnded, bytes, block->bytes);
+  EXPR_STAT_ADD(&exprStatEnded, nodesmade, block->nodesmade);
+  EXPR_STAT_ADD(&exprStatEnded, nodesfreed, block->nodesfreed);
+
+  for(pos = 0; pos <= EXPR_ERROR_USER; pos++)
+    {
+      EXPR_STAT_ADD(&exprStatEnded, parseerrors[pos], block->parseerrors[pos]);
+      EXPR_STAT_ADD(&exprStatEnded, evalerrors[pos], block->evalerrors[pos]);
+    }
+
+  pthread_mutex_unlock(&exprStatLock);
+
+  /* Destructors of other keys may still count, and get a new block */
+  exprStatLocal = NULL;
+  free(block);
+}
+
+#endif
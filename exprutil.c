@@ -20,6 +20,21 @@ void exprGetVersion(int *major, int *minor)
   *minor = EXPR_VERSIONMINOR;
 }
 
+/* Hash the first len characters of a name for the value and
+   function lists (FNV-1a) */
+unsigned int exprHashName(char *name, int len)
+{
+  unsigned long hash = 2166136261UL;
+
+  while(len-- > 0)
+    {
+      hash ^= (unsigned char)*name++;
+      hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+
+  return (unsigned int)hash;
+}
+
 /* This utility function determines if an identifier is valid */
 int exprValidIdent(char *name)
 {
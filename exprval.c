@@ -15,12 +15,20 @@
 
 
 /* Internal functions */
-static exprVal *exprCreateVal(char *name, EXPRTYPE val, EXPRTYPE *addr);
-static void exprValListFreeData(exprVal *val);
+static exprVal *exprCreateVal(exprValList *vlist, char *name, int len, EXPRTYPE val, EXPRTYPE *addr);
 static void exprValListResetData(exprVal *val);
+static exprVal *exprValListFind(exprValList *vlist, char *name, int len);
+static int exprValListInsert(exprValList *vlist, exprVal *val);
 
 /* This function creates the value list, */
 int exprValListCreate(exprValList **vlist)
+{
+  return exprValListCreateEx(vlist, NULL);
+}
+
+/* Create a value list that takes the memory for itself and its
+   items from an allocator, or the default one if alloc is NULL */
+int exprValListCreateEx(exprValList **vlist, exprAllocator *alloc)
 {
   exprValList *tmp;
 
@@ -29,11 +37,13 @@ int exprValListCreate(exprValList **vlist)
 
   *vlist = NULL; /* Set to NULL initially */
 
-  tmp = exprAllocMem(sizeof(exprValList));
+  tmp = exprAllocFrom(alloc, sizeof(exprValList));
 
   if(tmp == NULL)
     return EXPR_ERROR_MEMORY; /* Could not allocate memory */
 
+  exprAllocatorInit(&(tmp->alloc), alloc);
+
   /* Update pointer */
   *vlist = tmp;
 
@@ -44,8 +54,6 @@ int exprValListCreate(exprValList **vlist)
 int exprValListAdd(exprValList *vlist, char *name, EXPRTYPE val)
 {
   exprVal *tmp;
-  exprVal *cur;
-  int result;
 
   if(vlist == NULL)
     return EXPR_ERROR_NULLPOINTER;
@@ -54,48 +62,23 @@ int exprValListAdd(exprValList *vlist, char *name, EXPRTYPE val)
   if(!exprValidIdent(name))
     return EXPR_ERROR_BADIDENTIFIER;
 
-  if(vlist->head == NULL)
-    {
-      /* Create the node right here */
-      tmp = exprCreateVal(name, val, NULL);
-
-      if(tmp == NULL)
-        return EXPR_ERROR_MEMORY;
-
-      vlist->head = tmp;
-      return EXPR_ERROR_NOERROR;
-    }
-
   /* See if already exists */
-  cur = vlist->head;
-
-  while(cur)
-    {
-      result = strcmp(name, cur->vname);
-
-      if(result == 0)
-        return EXPR_ERROR_ALREADYEXISTS;
-
-      cur = cur->next;
-    }
+  if(exprValListFind(vlist, name, (int)strlen(name)))
+    return EXPR_ERROR_ALREADYEXISTS;
 
   /* We did not find it, create it and add it to the beginning */
-  tmp = exprCreateVal(name, val, NULL);
+  tmp = exprCreateVal(vlist, name, (int)strlen(name), val, NULL);
 
   if(tmp == NULL)
     return EXPR_ERROR_MEMORY;
 
-  tmp->next = vlist->head;
-  vlist->head = tmp;
-
-  return EXPR_ERROR_NOERROR;
+  return exprValListInsert(vlist, tmp);
 }
 
 /* Set a value in the list */
 int exprValListSet(exprValList *vlist, char *name, EXPRTYPE val)
 {
   exprVal *cur;
-  int result;
 
   if(vlist == NULL)
     return EXPR_ERROR_NULLPOINTER;
@@ -104,23 +87,13 @@ int exprValListSet(exprValList *vlist, char *name, EXPRTYPE val)
     return EXPR_ERROR_NOTFOUND;
 
   /* Find and set it */
-  cur = vlist->head;
+  cur = exprValListFind(vlist, name, (int)strlen(name));
 
-  while(cur)
+  if(cur)
     {
-      result = strcmp(name, cur->vname);
-
-      if(result == 0)
-        {
-          if(cur->vptr)
-            *(cur->vptr) = val;
-          else
-            cur->vval = val;
+      *(cur->vaddr) = val;
 
-          return EXPR_ERROR_NOERROR;
-        }
-
-      cur = cur->next;
+      return EXPR_ERROR_NOERROR;
     }
 
   return EXPR_ERROR_NOTFOUND;
@@ -130,7 +103,6 @@ int exprValListSet(exprValList *vlist, char *name, EXPRTYPE val)
 int exprValListGet(exprValList *vlist, char *name, EXPRTYPE *val)
 {
   exprVal *cur;
-  int result;
 
   if(vlist == NULL)
     return EXPR_ERROR_NULLPOINTER;
@@ -139,25 +111,15 @@ int exprValListGet(exprValList *vlist, char *name, EXPRTYPE *val)
     return EXPR_ERROR_NOTFOUND;
 
   /* Search for the item */
-  cur = vlist->head;
+  cur = exprValListFind(vlist, name, (int)strlen(name));
 
-  while(cur)
+  if(cur)
     {
-      result = strcmp(name, cur->vname);
+      /* We found it. */
+      *val = *(cur->vaddr);
 
-      if(result == 0)
-        {
-          /* We found it. */
-          if(cur->vptr)
-            *val = *(cur->vptr);
-          else
-            *val = cur->vval;
-
-          /* return now */
-          return EXPR_ERROR_NOERROR;
-        }
-
-      cur = cur->next;
+      /* return now */
+      return EXPR_ERROR_NOERROR;
     }
 
   /* If we got here, we did not find the item in the list */
@@ -168,8 +130,6 @@ int exprValListGet(exprValList *vlist, char *name, EXPRTYPE *val)
 int exprValListAddAddress(exprValList *vlist, char *name, EXPRTYPE *addr)
 {
   exprVal *tmp;
-  exprVal *cur;
-  int result;
 
   if(vlist == NULL)
     return EXPR_ERROR_NULLPOINTER;
@@ -178,48 +138,23 @@ int exprValListAddAddress(exprValList *vlist, char *name, EXPRTYPE *addr)
   if(!exprValidIdent(name))
     return EXPR_ERROR_BADIDENTIFIER;
 
-  if(vlist->head == NULL)
-    {
-      /* Create the node right here */
-      tmp = exprCreateVal(name, (EXPRTYPE)0.0, addr);
-
-      if(tmp == NULL)
-        return EXPR_ERROR_MEMORY;
-
-      vlist->head = tmp;
-      return EXPR_ERROR_NOERROR;
-    }
-
   /* See if it already exists */
-  cur = vlist->head;
-
-  while(cur)
-    {
-      result = strcmp(name, cur->vname);
-
-      if(result == 0)
-        return EXPR_ERROR_ALREADYEXISTS;
-
-      cur = cur->next;
-    }
+  if(exprValListFind(vlist, name, (int)strlen(name)))
+    return EXPR_ERROR_ALREADYEXISTS;
 
   /* Add it to the list */
-  tmp = exprCreateVal(name, (EXPRTYPE)0.0, addr);
+  tmp = exprCreateVal(vlist, name, (int)strlen(name), (EXPRTYPE)0.0, addr);
 
   if(tmp == NULL)
     return EXPR_ERROR_MEMORY;
 
-  tmp->next = vlist->head;
-  vlist->head = tmp;
-
-  return EXPR_ERROR_NOERROR;
+  return exprValListInsert(vlist, tmp);
 }
 
 /* Get memory address of a variable value in a value list */
 int exprValListGetAddress(exprValList *vlist, char *name, EXPRTYPE **addr)
 {
   exprVal *cur;
-  int result;
 
   if(vlist == NULL || addr == NULL)
     return EXPR_ERROR_NULLPOINTER;
@@ -231,31 +166,56 @@ int exprValListGetAddress(exprValList *vlist, char *name, EXPRTYPE **addr)
     return EXPR_ERROR_NOTFOUND;
 
   /* Search for the item */
-  cur = vlist->head;
+  cur = exprValListFind(vlist, name, (int)strlen(name));
 
-  while(cur)
+  if(cur)
     {
-      result = strcmp(name, cur->vname);
-
-      if(result == 0)
-        {
-          /* We found it. */
-          if(cur->vptr)
-            *addr = cur->vptr;
-          else
-            *addr = &(cur->vval);
-
-          /* return now */
-          return EXPR_ERROR_NOERROR;
-        }
+      /* We found it. */
+      *addr = cur->vaddr;
 
-      cur = cur->next;
+      /* return now */
+      return EXPR_ERROR_NOERROR;
     }
 
   /* If we got here, we did not find it in the list */
   return EXPR_ERROR_NOTFOUND;
 }
 
+/* Add a value named by the first len characters of name */
+int exprValListAddLen(exprValList *vlist, char *name, int len, EXPRTYPE val)
+{
+  exprVal *tmp;
+
+  if(vlist == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  /* See if already exists */
+  if(exprValListFind(vlist, name, len))
+    return EXPR_ERROR_ALREADYEXISTS;
+
+  tmp = exprCreateVal(vlist, name, len, val, NULL);
+
+  if(tmp == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  return exprValListInsert(vlist, tmp);
+}
+
+/* Get the address of a value named by the first len characters of name */
+int exprValListGetAddressLen(exprValList *vlist, char *name, int len, EXPRTYPE **addr)
+{
+  exprVal *cur;
+
+  if(vlist == NULL || addr == NULL)
+    return EXPR_ERROR_NULLPOINTER;
+
+  cur = exprValListFind(vlist, name, len);
+
+  *addr = cur ? cur->vaddr : NULL;
+
+  return cur ? EXPR_ERROR_NOERROR : EXPR_ERROR_NOTFOUND;
+}
+
 /* This function is used to enumerate the values in a value list */
 void *exprValListGetNext(exprValList *vlist, char **name, EXPRTYPE *value, EXPRTYPE** addr, void *cookie)
 {
@@ -280,20 +240,10 @@ void *exprValListGetNext(exprValList *vlist, char **name, EXPRTYPE *value, EXPRT
         *name = cur->vname;
 
       if(value)
-        {
-          if(cur->vptr)
-            *value = *(cur->vptr);
-          else
-            *value = cur->vval;
-        }
+        *value = *(cur->vaddr);
 
       if(addr)
-        {
-          if(cur->vptr)
-            *addr = cur->vptr;
-          else
-            *addr = &(cur->vval);
-        }
+        *addr = cur->vaddr;
     }
 
   /* If there was no value, return NULL, otherwise, return the item */
@@ -303,15 +253,22 @@ void *exprValListGetNext(exprValList *vlist, char **name, EXPRTYPE *value, EXPRT
 /* This routine will free the value list */
 int exprValListFree(exprValList *vlist)
 {
+  exprAllocator alloc;
+
   /* Make sure it exists, if not it is not error */
   if(vlist == NULL)
     return EXPR_ERROR_NOERROR;
 
-  /* Free the nodes */
-  exprValListFreeData(vlist->head);
+  alloc = vlist->alloc;
+
+  /* Free the storage and table */
+  exprFreeChunks(&alloc, vlist->items);
+  exprFreeChunks(&alloc, vlist->values);
+  exprFreeChunks(&alloc, vlist->names);
+  exprFreeFrom(&alloc, vlist->table);
 
   /* Freethe container */
-  exprFreeMem(vlist);
+  exprFreeFrom(&alloc, vlist);
 
   return EXPR_ERROR_NOERROR;
 }
@@ -327,43 +284,88 @@ int exprValListClear(exprValList *vlist)
   return EXPR_ERROR_NOERROR;
 }
 
-/* This routine will free any child nodes, and then free itself */
-static void exprValListFreeData(exprVal *val)
+/* This routine will reset variables to 0.0 */
+static void exprValListResetData(exprVal *val)
 {
-  exprVal *next;
-
   while(val)
     {
-      /* Remember the next */
-      next = val->next;
+      /* Reset data */
+      *(val->vaddr) = 0.0;
+
+      val = val->next;
+    }
+}
+
+/* Find a value by the first len characters of name */
+static exprVal *exprValListFind(exprValList *vlist, char *name, int len)
+{
+  exprVal *cur;
+  unsigned int hash;
+  int pos, mask;
 
-      /* Free name */
-      exprFreeMem(val->vname);
+  if(vlist->table == NULL)
+    return NULL;
 
-      /* Free ourself */
-      exprFreeMem(val);
+  hash = exprHashName(name, len);
+  mask = vlist->tablesize - 1;
 
-      val = next;
+  /* Probe until an empty entry */
+  for(pos = (int)(hash & mask); (cur = vlist->table[pos]) != NULL; pos = (pos + 1) & mask)
+    {
+      if(cur->hash == hash && strncmp(name, cur->vname, len) == 0 && cur->vname[len] == '\0')
+        return cur;
     }
+
+  return NULL;
 }
 
-/* This routine will reset variables to 0.0 */
-static void exprValListResetData(exprVal *val)
+/* Add a value to the table and the beginning of the list */
+static int exprValListInsert(exprValList *vlist, exprVal *val)
 {
-  while(val)
+  exprVal **table;
+  exprVal *cur;
+  int size, pos, mask;
+
+  /* Grow the table when three quarters full */
+  if((vlist->count + 1) * 4 > vlist->tablesize * 3)
     {
-      /* Reset data */
-      if(val->vptr)
-        *(val->vptr) = 0.0;
+      size = vlist->tablesize ? vlist->tablesize * 2 : EXPR_HASH_INITSIZE;
 
-      val->vval = 0.0;
+      table = exprAllocFrom(&(vlist->alloc), size * sizeof(exprVal*));
+      if(table == NULL)
+        return EXPR_ERROR_MEMORY;
 
-      val = val->next;
+      mask = size - 1;
+
+      for(cur = vlist->head; cur; cur = cur->next)
+        {
+          for(pos = (int)(cur->hash & mask); table[pos]; pos = (pos + 1) & mask)
+            ;
+
+          table[pos] = cur;
+        }
+
+      exprFreeFrom(&(vlist->alloc), vlist->table);
+      vlist->table = table;
+      vlist->tablesize = size;
     }
+
+  mask = vlist->tablesize - 1;
+
+  for(pos = (int)(val->hash & mask); vlist->table[pos]; pos = (pos + 1) & mask)
+    ;
+
+  vlist->table[pos] = val;
+  vlist->count++;
+
+  val->next = vlist->head;
+  vlist->head = val;
+
+  return EXPR_ERROR_NOERROR;
 }
 
 /* This routine will create the value object */
-static exprVal *exprCreateVal(char *name, EXPRTYPE val, EXPRTYPE *addr)
+static exprVal *exprCreateVal(exprValList *vlist, char *name, int len, EXPRTYPE val, EXPRTYPE *addr)
 {
   exprVal *tmp;
   char *vtmp;
@@ -371,24 +373,35 @@ static exprVal *exprCreateVal(char *name, EXPRTYPE val, EXPRTYPE *addr)
   /* Name already tested in exprValListAdd */
 
   /* Create it */
-  tmp = exprAllocMem(sizeof(exprVal));
+  tmp = exprAllocChunk(&(vlist->alloc), &(vlist->items), sizeof(exprVal), sizeof(void*),
+    EXPR_VALCHUNK_ITEMS * sizeof(exprVal));
   if(tmp == NULL)
     return NULL;
 
+  /* Space for the value unless it is somewhere else */
+  if(addr == NULL)
+    {
+      addr = exprAllocChunk(&(vlist->alloc), &(vlist->values), sizeof(EXPRTYPE), sizeof(EXPRTYPE),
+        EXPR_VALCHUNK_ITEMS * sizeof(EXPRTYPE));
+      if(addr == NULL)
+        return NULL;
+
+      *addr = val;
+    }
+
   /* Allocate space for the name */
-  vtmp = exprAllocMem(strlen(name) + 1);
+  vtmp = exprAllocChunk(&(vlist->alloc), &(vlist->names), len + 1, 1, EXPR_VALCHUNK_ITEMS * 16);
 
   if(vtmp == NULL)
-    {
-      exprFreeMem(tmp);
-      return NULL;
-    }
+    return NULL;
 
   /* Copy the data over */
-  strcpy(vtmp, name);
+  memcpy(vtmp, name, len);
+  vtmp[len] = '\0';
   tmp->vname = vtmp;
-  tmp->vval = val;
-  tmp->vptr = addr;
+  tmp->vaddr = addr;
+  tmp->hash = exprHashName(name, len);
+  tmp->next = NULL;
 
   return tmp;
 }
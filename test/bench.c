@@ -0,0 +1,394 @@
+/*
+  File: bench.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Time parsing and evaluation of a set of expressions
+
+  Each expression is parsed and evaluated over and over, once to
+  warm up and then for a number of repetitions, and the best and
+  median time of the repetitions is shown.  The allocations and
+  bytes of each parse come from exprGetMemStats.
+
+  Usage: bench [-json] [-reps count] [-time seconds]
+
+  Build with something like:
+    cc -O2 -o bench bench.c ../expr*.c -lm
+*/
+
+/* Needed for clock_gettime */
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "../expreval.h"
+
+/* Use the monotonic clock where there is one */
+#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) && defined(CLOCK_MONOTONIC)
+#define BENCH_MONOTONIC
+#endif
+
+/* Most repetitions of each measurement */
+#define MAXREPS 100
+
+/* Number of variables of the "variables" expression */
+#define MANYVARS 100
+
+/* Size of each generated expression */
+#define GENSIZE 8192
+
+/* An expression to time */
+typedef struct _benchItem
+{
+  const char *name;
+  char *expr;
+} benchItem;
+
+/* Results of an expression */
+typedef struct _benchResult
+{
+  double parse[MAXREPS]; /* Nanoseconds of each parse */
+  double tree[MAXREPS]; /* Nanoseconds of each exprEval */
+  double compiled[MAXREPS]; /* Nanoseconds of each exprEvalCompiled */
+  double allocs; /* Allocations of each parse */
+  double bytes; /* Bytes of each parse */
+  int length; /* Length of the expression */
+} benchResult;
+
+/* Seconds from some fixed time */
+static double now(void)
+{
+#ifdef BENCH_MONOTONIC
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Expressions built at startup */
+static char nested[GENSIZE];
+static char multi[GENSIZE];
+static char manyvars[GENSIZE];
+
+static benchItem items[] =
+  {
+    {"arithmetic", "x * 2.5 + y / 3 - (x - y) * (x + 1.5) + z * z - 4 * x * y + 0.5;"},
+    {"functions", "sin(x) + cos(y) * sqrt(abs(z)) + exp(-x) + ln(1 + y * y) + atan2(y, x) + pow(x, 2) + min(x, y, z);"},
+    {"nested", nested},
+    {"statements", multi},
+    {"variables", manyvars},
+    {"loop", "t = 0; for(i = 0, below(i, 100), i = i + 1, t = t + i * x);"}
+  };
+
+#define ITEMCOUNT (int)(sizeof(items) / sizeof(items[0]))
+
+/* Build the generated expressions */
+static void build(void)
+{
+  int pos, len;
+
+  /* Deep nesting of parentheses and calls */
+  len = 0;
+  for(pos = 0; pos < 48; pos++)
+    len += sprintf(nested + len, (pos % 2) ? "abs(" : "(1.01 * ");
+
+  len += sprintf(nested + len, "x");
+
+  for(pos = 0; pos < 48; pos++)
+    len += sprintf(nested + len, (pos % 2) ? " + 1)" : ")");
+
+  strcpy(nested + len, ";");
+
+  /* Many short statements */
+  len = 0;
+  for(pos = 0; pos < 100; pos++)
+    len += sprintf(multi + len, "t%d = t%d * 0.5 + x - %d; ", pos % 10, (pos + 3) % 10, pos % 7);
+
+  /* Many variables */
+  len = 0;
+  for(pos = 0; pos < MANYVARS; pos++)
+    len += sprintf(manyvars + len, "%sv%d * %d", pos ? " + " : "", pos, pos % 5 + 1);
+
+  strcpy(manyvars + len, ";");
+}
+
+/* Sort doubles for the median */
+static int compare(const void *a, const void *b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+/* Smallest and median of a list of times */
+static double best(double *times, int count)
+{
+  qsort(times, count, sizeof(double), compare);
+  return times[0];
+}
+
+static double median(double *times, int count)
+{
+  qsort(times, count, sizeof(double), compare);
+  return (count % 2) ? times[count / 2] : (times[count / 2 - 1] + times[count / 2]) / 2;
+}
+
+/* Parse an expression count times, returns nanoseconds for each */
+static double time_parse(exprObj *e, char *expr, long count, exprMemStats *stats)
+{
+  exprMemStats before;
+  double start, secs;
+  long pos;
+
+  exprGetMemStats(&before);
+  start = now();
+
+  for(pos = 0; pos < count; pos++)
+    {
+      exprParse(e, expr);
+      exprClear(e);
+    }
+
+  secs = now() - start;
+
+  if(stats)
+    {
+      exprGetMemStats(stats);
+      stats->allocs -= before.allocs;
+      stats->bytes -= before.bytes;
+    }
+
+  return secs * 1e9 / count;
+}
+
+/* Evaluate an expression count times, returns nanoseconds for each */
+static double time_eval(exprObj *e, int compiled, long count)
+{
+  EXPRTYPE val;
+  double start;
+  long pos;
+
+  start = now();
+
+  if(compiled)
+    {
+      for(pos = 0; pos < count; pos++)
+        exprEvalCompiled(e, &val);
+    }
+  else
+    {
+      for(pos = 0; pos < count; pos++)
+        exprEval(e, &val);
+    }
+
+  return (now() - start) * 1e9 / count;
+}
+
+/* Find how many calls of a measurement take about secs seconds.
+   Running this is the warmup. */
+static long calibrate(exprObj *e, char *expr, int which, double secs)
+{
+  double ns;
+  long count;
+
+  for(count = 1; ; count *= 2)
+    {
+      ns = (which == 0) ? time_parse(e, expr, count, NULL) : time_eval(e, which == 2, count);
+
+      if(ns * count >= secs * 1e9 * 0.25 || count >= 0x40000000L)
+        break;
+    }
+
+  count = (long)(secs * 1e9 / (ns > 0 ? ns : 1));
+  return (count > 0) ? count : 1;
+}
+
+/* Time one expression */
+static int run(exprObj *e, benchItem *item, benchResult *res, int reps, double secs)
+{
+  exprMemStats stats;
+  long count;
+  int rep, err;
+
+  /* Parse */
+  count = calibrate(e, item->expr, 0, secs);
+
+  for(rep = 0; rep < reps; rep++)
+    {
+      res->parse[rep] = time_parse(e, item->expr, count, &stats);
+
+      if(rep == 0)
+        {
+          res->allocs = (double)stats.allocs / count;
+          res->bytes = (double)stats.bytes / count;
+        }
+    }
+
+  err = exprParse(e, item->expr);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  /* Tree evaluation */
+  count = calibrate(e, item->expr, 1, secs);
+
+  for(rep = 0; rep < reps; rep++)
+    res->tree[rep] = time_eval(e, 0, count);
+
+  /* Compiled evaluation */
+  err = exprCompile(e);
+  if(err != EXPR_ERROR_NOERROR)
+    return err;
+
+  count = calibrate(e, item->expr, 2, secs);
+
+  for(rep = 0; rep < reps; rep++)
+    res->compiled[rep] = time_eval(e, 1, count);
+
+  res->length = (int)strlen(item->expr);
+
+  exprClear(e);
+  return EXPR_ERROR_NOERROR;
+}
+
+int main(int argc, char **argv)
+{
+  static benchResult results[ITEMCOUNT];
+  exprFuncList *f = NULL;
+  exprValList *v = NULL;
+  exprObj *e = NULL;
+  benchResult *res;
+  char name[16];
+  double secs;
+  int json, reps, pos, err;
+
+  json = 0;
+  reps = 5;
+  secs = 0.05;
+
+  for(pos = 1; pos < argc; pos++)
+    {
+      if(strcmp(argv[pos], "-json") == 0)
+        json = 1;
+      else if(strcmp(argv[pos], "-reps") == 0 && pos + 1 < argc)
+        reps = atoi(argv[++pos]);
+      else if(strcmp(argv[pos], "-time") == 0 && pos + 1 < argc)
+        secs = atof(argv[++pos]);
+      else
+        {
+          fprintf(stderr, "Usage: %s [-json] [-reps count] [-time seconds]\n", argv[0]);
+          return 1;
+        }
+    }
+
+  if(reps < 1)
+    reps = 1;
+
+  if(reps > MAXREPS)
+    reps = MAXREPS;
+
+  if(secs <= 0)
+    secs = 0.05;
+
+  build();
+
+  /* Set up the lists and expression object */
+  err = exprFuncListCreate(&f);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprFuncListInit(f);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListCreate(&v);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListAdd(v, "x", 0.75);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListAdd(v, "y", 1.5);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListAdd(v, "z", -2.25);
+
+  for(pos = 0; pos < MANYVARS && err == EXPR_ERROR_NOERROR; pos++)
+    {
+      sprintf(name, "v%d", pos);
+      err = exprValListAdd(v, name, pos * 0.5);
+    }
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreate(&e, f, v, NULL, NULL, NULL);
+
+  if(err != EXPR_ERROR_NOERROR)
+    {
+      fprintf(stderr, "Setup Error: %d\n", err);
+      return 1;
+    }
+
+  for(pos = 0; pos < ITEMCOUNT; pos++)
+    {
+      err = run(e, &items[pos], &results[pos], reps, secs);
+
+      if(err != EXPR_ERROR_NOERROR)
+        {
+          fprintf(stderr, "Error %d in %s\n", err, items[pos].name);
+          return 1;
+        }
+    }
+
+  /* Report */
+  if(json)
+    {
+      printf("{\n  \"clock\": \"%s\",\n  \"reps\": %d,\n  \"results\": [\n",
+#ifdef BENCH_MONOTONIC
+        "monotonic",
+#else
+        "clock",
+#endif
+        reps);
+
+      for(pos = 0; pos < ITEMCOUNT; pos++)
+        {
+          res = &results[pos];
+
+          printf("    {\"name\": \"%s\", \"length\": %d, ", items[pos].name, res->length);
+          printf("\"parse_ns\": %.1f, \"parse_ns_median\": %.1f, ", best(res->parse, reps), median(res->parse, reps));
+          printf("\"allocs_per_parse\": %.1f, \"bytes_per_parse\": %.1f, ", res->allocs, res->bytes);
+          printf("\"eval_ns\": %.2f, \"eval_ns_median\": %.2f, ", best(res->tree, reps), median(res->tree, reps));
+          printf("\"compiled_ns\": %.2f, \"compiled_ns_median\": %.2f}%s\n",
+            best(res->compiled, reps), median(res->compiled, reps), (pos + 1 < ITEMCOUNT) ? "," : "");
+        }
+
+      printf("  ]\n}\n");
+    }
+  else
+    {
+      printf("%-12s %8s %12s %8s %10s %12s %12s\n", "expression", "length", "parse usec",
+        "allocs", "bytes", "eval nsec", "compiled");
+
+      for(pos = 0; pos < ITEMCOUNT; pos++)
+        {
+          res = &results[pos];
+
+          printf("%-12s %8d %12.2f %8.1f %10.1f %12.2f %12.2f\n", items[pos].name, res->length,
+            best(res->parse, reps) / 1000, res->allocs, res->bytes,
+            best(res->tree, reps), best(res->compiled, reps));
+        }
+    }
+
+  exprFree(e);
+  exprValListFree(v);
+  exprFuncListFree(f);
+
+  return 0;
+}
@@ -0,0 +1,1550 @@
+/*
+  File: check.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Compare the ways of evaluating an expression
+
+  Each expression of a fixed set is evaluated over the same rows of
+  values with the node tree (exprEval) and with each other way the
+  library has of evaluating it:
+
+    exprEvalCompiled - the compiled program
+    exprEvalBatch - blocks of rows at a time
+    exprOptimize - the node tree after optimizing
+    exprContextEval - an evaluation context
+    exprJitCompile - machine code, where there is any
+    exprNativeEval - the expression written as C, compiled and loaded
+    exprCacheGet - a cached expression through an evaluation context
+    exprEvalRange - each index of a range, with and without a pool
+
+  The results, errors and final values of the variables must be the
+  same as the node tree, bit for bit, including the sign of zeros.
+  NaN only has to be NaN, since the sign of a NaN made from two NaNs
+  depends on the order of the operands, but abs and negation of NaN
+  must give the sign the node tree does.
+
+  Other checks:
+
+    exprKernel* - each item against the node tree
+    exprSourceCreate - expressions nested hundreds deep, and 'for'
+    exprCache* - hits, misses, evictions and errors
+    exprGroupEval - against evaluating each expression in order
+    exprGroupEvalParallel - the same with a thread pool
+    exprSetCancel - each way stops a loop and runs again once allowed
+    exprGetMemStats - everything allocated is freed
+    exprSetProfile - the counts of the report, where it is built in
+    exprGetStats - parses, evaluations, errors and live nodes
+    exprCreateEx and the others - allocators, including ones failing
+
+  Prints each difference and a count, and exits with 1 if there
+  were any.
+  Native code is kept in the directory named by TMPDIR, or /tmp.
+
+  Build with something like:
+    cc -O2 -o check check.c ../expr*.c -lm -ldl -lpthread
+*/
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include "../expreval.h"
+
+/* Rows of values for x, y and z */
+#define ROWS 8
+
+/* Items given to the kernels, not a multiple of any vector size */
+#define ITEMS 37
+
+/* Depth of the nested expressions */
+#define DEPTH 400
+
+/* Indexes given to exprEvalRange */
+#define RANGEBEGIN -4
+#define RANGEEND 12
+
+/* Ways to evaluate */
+enum
+  {
+  CHECK_TREE,
+  CHECK_VM,
+  CHECK_BATCH,
+  CHECK_OPT,
+  CHECK_CONTEXT,
+  CHECK_JIT,
+  CHECK_CACHE,
+  CHECK_COUNT
+  };
+
+static const char *checknames[CHECK_COUNT] =
+  {
+    "tree",
+    "vm",
+    "batch",
+    "optimize",
+    "context",
+    "jit",
+    "cache"
+  };
+
+/* Variables of each expression, the first three are set from the rows */
+static char *varnames[] =
+  {
+    "x", "y", "z", "t", "u", "i"
+  };
+
+#define VARCOUNT (int)(sizeof(varnames) / sizeof(varnames[0]))
+
+/* Expressions to compare */
+static char *exprs[] =
+  {
+    "x * 2.5 + y / 3 - (x - y) * (x + 1.5) + z * z;",
+    "-(x * 0) + y * 0;",
+    "-x; abs(-0 * y);",
+    "abs(z) + abs(-x);",
+    "t = x * y; u = t + z; t * u - x;",
+    "avg(x, y, z) + min(x, y) * max(y, z);",
+    "avg(-0 * x);",
+    "sqrt(abs(x)) + pow(y, 2) + exp(-abs(z)) + ln(1 + x * x);",
+    "sin(x) * cos(y) + atan2(y, x) + tanh(z);",
+    "if(above(x, y), x - y, y - x) + below(x, 0) * 10;",
+    "select(x, y, z) + select(y - 1, x, 0, z);",
+    "t = 0; for(i = 0, below(i, 5), i = i + 1, t = t + i * x); t;",
+    "x / y;",
+    "mod(x, y) + ipart(z) + fpart(x);",
+    "floor(x * 3.7) + ceil(y - 0.2) + clip(z, -1, 1) + clamp(x, -1, 1);",
+    "ln(x);",
+    "sqrt(y) * x;",
+    "u = u + x; u * y;",
+    "2 * M_PI / 360 * x + 0 * y + 1 * z + y ^ 2;",
+    "t = x * x + y * y; sqrt(x * x + y * y) + t;",
+    "poly(x, 1, -2, 3) + and(x, y) + or(z, 0) + not(y);",
+    "min(z, x) + max(x, z);",
+    "many(x, y, z);"
+  };
+
+#define EXPRCOUNT (int)(sizeof(exprs) / sizeof(exprs[0]))
+
+/* Expressions whose NaN results have a known sign */
+static char *signexprs[] =
+  {
+    "abs(z);",
+    "-z;",
+    "abs(-x) * 2;",
+    "t = abs(z); -t;"
+  };
+
+#define SIGNCOUNT (int)(sizeof(signexprs) / sizeof(signexprs[0]))
+
+/* Pieces of the nested expressions, the text before the middle
+   repeated DEPTH times, the middle, then the text after */
+static char *nestpieces[][3] =
+  {
+    {"if(above(x, y), ", "z", ", -z)"},
+    {"(", "x", " + y)"},
+    {"select(y, ", "x", ", z)"},
+    {"abs(-", "x", ")"},
+    {"if(x, ", "for(i = 0, below(i, 3), i = i + 1, t = t + z)", ", y)"}
+  };
+
+#define NESTCOUNT (int)(sizeof(nestpieces) / sizeof(nestpieces[0]))
+
+/* Results of evaluating an expression over the rows */
+typedef struct _checkResult
+{
+  EXPRTYPE val[ROWS];
+  int err[ROWS];
+  EXPRTYPE vars[VARCOUNT]; /* Values after the last row */
+  int setup; /* Error before the first row */
+} checkResult;
+
+/* Values of the rows */
+static EXPRTYPE rows[3][ROWS];
+
+static exprFuncList *flist;
+static exprValList *clist;
+static exprCache *cache;
+static exprPool *pool;
+static char *nativedir;
+static int nonative; /* The system can not load native code */
+static int failures, checks;
+static int nansigns; /* Compare the signs of NaN */
+
+
+/* Determine if a value has its sign bit set, which is the byte
+   where 1 and -1 differ */
+static int negative(EXPRTYPE val)
+{
+  EXPRTYPE one = 1.0, minus = -1.0;
+  unsigned char *p, *q, *v;
+  int pos;
+
+  p = (unsigned char*)&one;
+  q = (unsigned char*)&minus;
+  v = (unsigned char*)&val;
+
+  for(pos = 0; pos < (int)sizeof(EXPRTYPE); pos++)
+    {
+      if(p[pos] != q[pos])
+        return (v[pos] & (p[pos] ^ q[pos])) != 0;
+    }
+
+  return 0;
+}
+
+/* Two values are the same if their bits are, or both are NaN */
+static int same(EXPRTYPE a, EXPRTYPE b)
+{
+  if(a != a || b != b)
+    return a != a && b != b && (!nansigns || negative(a) == negative(b));
+
+  return memcmp(&a, &b, sizeof(EXPRTYPE)) == 0;
+}
+
+/* Report a difference, long expressions are cut short */
+static void fail(char *expr, const char *what, int row, EXPRTYPE got, int goterr, EXPRTYPE want, int wanterr)
+{
+  failures++;
+  printf("FAIL %.60s: %s row %d: got %g (error %d), expected %g (error %d)\n",
+    expr, what, row, got, goterr, want, wanterr);
+}
+
+/* Report a failed check that is not about a value */
+static void failcheck(char *expr, const char *what, int err)
+{
+  failures++;
+  printf("FAIL %.60s: %s (error %d)\n", expr, what, err);
+}
+
+/* Create a variable list with each variable set to 0 */
+static int makevars(exprValList **vlist)
+{
+  int pos, err;
+
+  err = exprValListCreate(vlist);
+
+  for(pos = 0; pos < VARCOUNT && err == EXPR_ERROR_NOERROR; pos++)
+    err = exprValListAdd(*vlist, varnames[pos], 0.0);
+
+  return err;
+}
+
+/* Evaluate an expression over the rows one way */
+static void evaluate(char *expr, int how, checkResult *ref, checkResult *res)
+{
+  exprValList *vlist = NULL;
+  exprObj *obj = NULL;
+  exprContext *ctx = NULL;
+  exprBinding bind[3];
+  EXPRTYPE *addr[VARCOUNT];
+  int row, start, end, pos, err;
+
+  memset(res, 0, sizeof(checkResult));
+
+  for(row = 0; row < ROWS; row++)
+    res->err[row] = EXPR_ERROR_UNKNOWN;
+
+  err = makevars(&vlist);
+  if(err == EXPR_ERROR_NOERROR && how == CHECK_CACHE)
+    {
+      /* The list is new, so the text is parsed again */
+      err = exprCacheGet(cache, &obj, flist, vlist, clist, expr);
+      if(err == EXPR_ERROR_NOERROR)
+        err = exprContextCreate(&ctx, obj);
+    }
+  else if(err == EXPR_ERROR_NOERROR)
+    {
+      err = exprCreate(&obj, flist, vlist, clist, NULL, NULL);
+      if(err == EXPR_ERROR_NOERROR)
+        err = exprParse(obj, expr);
+    }
+
+  if(err == EXPR_ERROR_NOERROR)
+    {
+      switch(how)
+        {
+          case CHECK_VM:
+            err = exprCompile(obj);
+            break;
+
+          case CHECK_OPT:
+            err = exprOptimize(obj, EXPR_OPT_FOLD | EXPR_OPT_CONSTANTS | EXPR_OPT_SIMPLIFY |
+              EXPR_OPT_STRICT | EXPR_OPT_CSE);
+            break;
+
+          case CHECK_CONTEXT:
+            err = exprContextCreate(&ctx, obj);
+            break;
+
+          case CHECK_JIT:
+            /* Where there is no machine code the program is used */
+            err = exprJitCompile(obj);
+            if(err == EXPR_ERROR_NONATIVE)
+              err = EXPR_ERROR_NOERROR;
+            break;
+        }
+    }
+
+  /* Find the variables, those a context does not use are left out */
+  for(pos = 0; pos < VARCOUNT && err == EXPR_ERROR_NOERROR; pos++)
+    {
+      if(ctx)
+        {
+          if(exprContextGetAddress(ctx, varnames[pos], &addr[pos]) != EXPR_ERROR_NOERROR)
+            addr[pos] = NULL;
+        }
+      else
+        err = exprValListGetAddress(vlist, varnames[pos], &addr[pos]);
+    }
+
+  res->setup = err;
+
+  if(err == EXPR_ERROR_NOERROR && how == CHECK_BATCH)
+    {
+      /* Each call ends at a row where the tree failed, so the rows
+         after it are evaluated like the tree does */
+      for(start = 0; start < ROWS; start = end + 1)
+        {
+          for(end = start; end < ROWS - 1 && ref->err[end] == EXPR_ERROR_NOERROR; end++)
+            ;
+
+          for(pos = 0; pos < 3; pos++)
+            {
+              bind[pos].addr = addr[pos];
+              bind[pos].data = rows[pos] + start;
+              bind[pos].stride = 1;
+            }
+
+          err = exprEvalBatch(obj, end - start + 1, bind, 3, res->val + start);
+
+          for(row = start; row < end; row++)
+            res->err[row] = EXPR_ERROR_NOERROR;
+
+          res->err[end] = err;
+        }
+    }
+  else if(err == EXPR_ERROR_NOERROR)
+    {
+      for(row = 0; row < ROWS; row++)
+        {
+          for(pos = 0; pos < 3; pos++)
+            {
+              if(addr[pos])
+                *addr[pos] = rows[pos][row];
+            }
+
+          if(ctx)
+            res->err[row] = exprContextEval(ctx, &res->val[row]);
+          else if(how == CHECK_VM || how == CHECK_JIT)
+            res->err[row] = exprEvalCompiled(obj, &res->val[row]);
+          else
+            res->err[row] = exprEval(obj, &res->val[row]);
+        }
+    }
+
+  if(err == EXPR_ERROR_NOERROR)
+    {
+      for(pos = 0; pos < VARCOUNT; pos++)
+        res->vars[pos] = addr[pos] ? *addr[pos] : ref->vars[pos];
+    }
+
+  if(ctx)
+    exprContextFree(ctx);
+
+  if(obj && how == CHECK_CACHE)
+    exprCacheRelease(cache, obj);
+  else if(obj)
+    exprFree(obj);
+
+  if(vlist)
+    exprValListFree(vlist);
+}
+
+/* Compare the results of one way with the tree */
+static void compare(char *expr, const char *what, checkResult *ref, checkResult *res)
+{
+  int row, pos;
+
+  checks++;
+
+  if(res->setup != EXPR_ERROR_NOERROR)
+    {
+      fail(expr, what, -1, 0.0, res->setup, 0.0, EXPR_ERROR_NOERROR);
+      return;
+    }
+
+  for(row = 0; row < ROWS; row++)
+    {
+      if(res->err[row] != ref->err[row] ||
+        (ref->err[row] == EXPR_ERROR_NOERROR && !same(res->val[row], ref->val[row])))
+        {
+          fail(expr, what, row, res->val[row], res->err[row], ref->val[row], ref->err[row]);
+          return;
+        }
+    }
+
+  for(pos = 0; pos < VARCOUNT; pos++)
+    {
+      if(!same(res->vars[pos], ref->vars[pos]))
+        {
+          printf("FAIL %.60s: %s leaves %s = %g, expected %g\n", expr, what, varnames[pos],
+            res->vars[pos], ref->vars[pos]);
+          failures++;
+          return;
+        }
+    }
+}
+
+/* Compare the expression written as C, compiled and loaded, with
+   the tree.  Expressions using 'for' must be refused. */
+static void checknative(char *expr, checkResult *ref)
+{
+  static checkResult res;
+  exprValList *vlist = NULL;
+  exprObj *obj = NULL;
+  exprNative *native = NULL;
+  EXPRTYPE *addr[VARCOUNT];
+  char *source = NULL;
+  int loops, row, pos, err;
+
+  loops = strstr(expr, "for(") != NULL;
+
+  memset(&res, 0, sizeof(res));
+
+  err = makevars(&vlist);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreate(&obj, flist, vlist, clist, NULL, NULL);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprParse(obj, expr);
+
+  for(pos = 0; pos < VARCOUNT && err == EXPR_ERROR_NOERROR; pos++)
+    err = exprValListGetAddress(vlist, varnames[pos], &addr[pos]);
+
+  if(err == EXPR_ERROR_NOERROR)
+    {
+      checks++;
+
+      err = exprSourceCreate(obj, "check", &source);
+      if(loops)
+        {
+          if(err != EXPR_ERROR_NONATIVE)
+            failcheck(expr, "source of a loop not refused", err);
+
+          err = EXPR_ERROR_NOERROR;
+        }
+      else if(err != EXPR_ERROR_NOERROR)
+        failcheck(expr, "source", err);
+      else if(strcmp(source + strlen(source) - 2, "}\n") != 0)
+        failcheck(expr, "source not ended", err);
+
+      if(source)
+        exprSourceFree(source);
+    }
+
+  if(err == EXPR_ERROR_NOERROR && !nonative)
+    {
+      err = exprNativeCreate(&native, obj, nativedir);
+      if(loops)
+        {
+          checks++;
+          if(err != EXPR_ERROR_NONATIVE)
+            failcheck(expr, "native code of a loop not refused", err);
+
+          if(native)
+            exprNativeFree(native);
+
+          native = NULL;
+        }
+      else if(err == EXPR_ERROR_NONATIVE)
+        {
+          /* Source is written but can not be compiled or loaded */
+          nonative = 1;
+        }
+      else if(err != EXPR_ERROR_NOERROR)
+        failcheck(expr, "native", err);
+      else
+        {
+          /* The expression is not needed by the native code */
+          exprFree(obj);
+          obj = NULL;
+        }
+    }
+
+  if(native)
+    {
+      for(row = 0; row < ROWS; row++)
+        {
+          for(pos = 0; pos < 3; pos++)
+            *addr[pos] = rows[pos][row];
+
+          res.err[row] = exprNativeEval(native, &res.val[row]);
+        }
+
+      for(pos = 0; pos < VARCOUNT; pos++)
+        res.vars[pos] = *addr[pos];
+
+      compare(expr, "native", ref, &res);
+
+      exprNativeFree(native);
+    }
+
+  if(obj)
+    exprFree(obj);
+
+  if(vlist)
+    exprValListFree(vlist);
+}
+
+/* Compare exprEvalRange with evaluating each index with the tree */
+static void checkrange(char *expr, exprPool *rangepool)
+{
+  exprValList *vlist = NULL;
+  exprObj *obj = NULL, *tree = NULL;
+  EXPRTYPE out[RANGEEND - RANGEBEGIN];
+  EXPRTYPE want[RANGEEND - RANGEBEGIN];
+  EXPRTYPE *x, *y, *z;
+  const char *what;
+  int wanterr, err, pos, var;
+  long index;
+
+  checks++;
+  what = rangepool ? "range with pool" : "range";
+
+  /* The expression given to exprEvalRange and the reference use
+     the same list, which exprEvalRange does not change */
+  err = makevars(&vlist);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreate(&obj, flist, vlist, clist, NULL, NULL);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprParse(obj, expr);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreate(&tree, flist, vlist, clist, NULL, NULL);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprParse(tree, expr);
+
+  if(err == EXPR_ERROR_NOERROR)
+    {
+      exprValListGetAddress(vlist, "x", &x);
+      exprValListGetAddress(vlist, "y", &y);
+      exprValListGetAddress(vlist, "z", &z);
+
+      *y = rows[1][0];
+      *z = rows[2][0];
+
+      err = exprEvalRange(obj, x, RANGEBEGIN, RANGEEND, out, rangepool);
+
+      /* Each index starts from the same values */
+      wanterr = EXPR_ERROR_NOERROR;
+      for(index = RANGEBEGIN; index < RANGEEND; index++)
+        {
+          for(var = 0; var < VARCOUNT; var++)
+            exprValListSet(vlist, varnames[var], 0.0);
+
+          *x = (EXPRTYPE)index;
+          *y = rows[1][0];
+          *z = rows[2][0];
+
+          pos = exprEval(tree, &want[index - RANGEBEGIN]);
+          if(pos != EXPR_ERROR_NOERROR && wanterr == EXPR_ERROR_NOERROR)
+            wanterr = pos;
+        }
+
+      if(err != wanterr)
+        fail(expr, what, -1, 0.0, err, 0.0, wanterr);
+      else if(err == EXPR_ERROR_NOERROR)
+        {
+          for(pos = 0; pos < RANGEEND - RANGEBEGIN; pos++)
+            {
+              if(!same(out[pos], want[pos]))
+                {
+                  fail(expr, what, pos, out[pos], err, want[pos], wanterr);
+                  break;
+                }
+            }
+        }
+    }
+  else
+    fail(expr, what, -1, 0.0, err, 0.0, EXPR_ERROR_NOERROR);
+
+  if(tree)
+    exprFree(tree);
+
+  if(obj)
+    exprFree(obj);
+
+  if(vlist)
+    exprValListFree(vlist);
+}
+
+/* Compare each way of evaluating an expression with the tree */
+static void checkexpr(char *expr)
+{
+  static checkResult ref, res;
+  int how;
+
+  evaluate(expr, CHECK_TREE, &ref, &ref);
+  if(ref.setup != EXPR_ERROR_NOERROR)
+    {
+      fail(expr, checknames[CHECK_TREE], -1, 0.0, ref.setup, 0.0, EXPR_ERROR_NOERROR);
+      return;
+    }
+
+  for(how = CHECK_TREE + 1; how < CHECK_COUNT; how++)
+    {
+      evaluate(expr, how, &ref, &res);
+      compare(expr, checknames[how], &ref, &res);
+    }
+
+  checknative(expr, &ref);
+
+  checkrange(expr, NULL);
+  checkrange(expr, pool);
+}
+
+/* Arguments of the kernels */
+static EXPRTYPE kernelargs[3][ITEMS];
+
+/* Compare the results of a kernel with the tree evaluating expr,
+   with x, y and z set to each item of the arguments.  The tree finds
+   errors from errno, which C libraries do not all set for infinite
+   and denormal arguments, so the mask is not compared for those. */
+static void kernelcompare(char *expr, int ret, EXPRTYPE *out, unsigned char *mask)
+{
+  exprValList *vlist = NULL;
+  exprObj *obj = NULL;
+  EXPRTYPE *addr[3];
+  EXPRTYPE val, arg;
+  int item, pos, err, anyerr, edge;
+
+  checks++;
+
+  err = makevars(&vlist);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreate(&obj, flist, vlist, clist, NULL, NULL);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprParse(obj, expr);
+
+  for(pos = 0; pos < 3 && err == EXPR_ERROR_NOERROR; pos++)
+    err = exprValListGetAddress(vlist, varnames[pos], &addr[pos]);
+
+  anyerr = 0;
+  for(item = 0; item < ITEMS && err == EXPR_ERROR_NOERROR; item++)
+    {
+      edge = 0;
+      for(pos = 0; pos < 3; pos++)
+        {
+          arg = kernelargs[pos][item];
+          *addr[pos] = arg;
+
+          if(arg == arg && arg != 0.0 && (arg - arg != 0.0 || (arg < DBL_MIN && -arg < DBL_MIN)))
+            edge = 1;
+        }
+
+      err = exprEval(obj, &val);
+
+      if(err != EXPR_ERROR_NOERROR && err != EXPR_ERROR_OUTOFRANGE)
+        break;
+
+      if(err != EXPR_ERROR_NOERROR || (mask != NULL && mask[item]))
+        anyerr = 1;
+
+      if(mask != NULL && !edge && mask[item] != (err != EXPR_ERROR_NOERROR))
+        {
+          fail(expr, "kernel mask", item, (EXPRTYPE)mask[item], ret, val, err);
+          err = EXPR_ERROR_NOERROR;
+          break;
+        }
+
+      if(err == EXPR_ERROR_NOERROR && (mask == NULL || !mask[item]) && !same(out[item], val))
+        {
+          fail(expr, "kernel", item, out[item], ret, val, err);
+          break;
+        }
+
+      err = EXPR_ERROR_NOERROR;
+    }
+
+  if(err != EXPR_ERROR_NOERROR)
+    failcheck(expr, "kernel reference", err);
+  else if(item == ITEMS && ret != (anyerr ? EXPR_ERROR_OUTOFRANGE : EXPR_ERROR_NOERROR))
+    fail(expr, "kernel result", -1, 0.0, ret, 0.0, anyerr ? EXPR_ERROR_OUTOFRANGE : EXPR_ERROR_NOERROR);
+
+  if(obj)
+    exprFree(obj);
+
+  if(vlist)
+    exprValListFree(vlist);
+}
+
+/* Compare each kernel with the built in function it stands for */
+static void checkkernels(void)
+{
+  static EXPRTYPE values[] =
+    {
+      0.0, 0.5, -0.5, 1.0, -1.0, 2.5, -3.75, 10.0, -10.0, 100.0, -100.0,
+      700.0, 710.0, -750.0, 1e-310, -1e-310, 1e300, -1e300, 3.14159, 1e8,
+      -1e8, 0.1, 0.25, 7.0, -7.0, 42.5, 1e-5, 2.0, 3.0, 4.0, 5.0, 6.0
+    };
+  EXPRTYPE out[ITEMS], coefs[2 * ITEMS];
+  EXPRTYPE zero, *x, *y, *z;
+  unsigned char mask[ITEMS];
+  int item, count;
+
+  /* NaN, infinity and -0 are made at run time */
+  zero = 0.0;
+  count = (int)(sizeof(values) / sizeof(values[0]));
+
+  for(item = 0; item < ITEMS; item++)
+    kernelargs[0][item] = item < count ? values[item] : (EXPRTYPE)item;
+
+  kernelargs[0][count] = -zero;
+  kernelargs[0][count + 1] = 1.0 / zero;
+  kernelargs[0][count + 2] = -1.0 / zero;
+  kernelargs[0][count + 3] = zero / zero;
+  kernelargs[0][count + 4] = -(zero / zero);
+
+  for(item = 0; item < ITEMS; item++)
+    {
+      kernelargs[1][item] = kernelargs[0][(item * 7 + 3) % ITEMS];
+      kernelargs[2][item] = kernelargs[0][(item * 11 + 5) % ITEMS];
+      coefs[item] = kernelargs[1][item];
+      coefs[ITEMS + item] = kernelargs[2][item];
+    }
+
+  x = kernelargs[0];
+  y = kernelargs[1];
+  z = kernelargs[2];
+
+  kernelcompare("sin(x);", exprKernelSin(out, x, ITEMS, mask), out, mask);
+  kernelcompare("cos(x);", exprKernelCos(out, x, ITEMS, mask), out, mask);
+  kernelcompare("exp(x);", exprKernelExp(out, x, ITEMS, mask), out, mask);
+  kernelcompare("ln(x);", exprKernelLn(out, x, ITEMS, mask), out, mask);
+  kernelcompare("sqrt(x);", exprKernelSqrt(out, x, ITEMS, mask), out, mask);
+  kernelcompare("pow(x, y);", exprKernelPow(out, x, y, ITEMS, mask), out, mask);
+  kernelcompare("clamp(x, y, z);", exprKernelClamp(out, x, y, z, ITEMS, mask), out, mask);
+  kernelcompare("poly(x, y, z);", exprKernelPoly(out, x, coefs, 2, ITEMS, ITEMS, mask), out, mask);
+  kernelcompare("floor(x);", exprKernelFloor(out, x, ITEMS), out, NULL);
+  kernelcompare("ceil(x);", exprKernelCeil(out, x, ITEMS), out, NULL);
+  kernelcompare("min(x, y);", exprKernelMin(out, x, y, ITEMS), out, NULL);
+  kernelcompare("max(x, y);", exprKernelMax(out, x, y, ITEMS), out, NULL);
+  kernelcompare("clip(x, y, z);", exprKernelClip(out, x, y, z, ITEMS), out, NULL);
+
+  /* The kernel writing over its argument */
+  memcpy(out, x, sizeof(out));
+  nansigns = 1;
+  kernelcompare("abs(x);", exprKernelAbs(out, out, ITEMS), out, NULL);
+  nansigns = 0;
+}
+
+/* Check expressions nested DEPTH deep, whose C source is indented
+   further than a line of it is long */
+static void checknested(void)
+{
+  char *expr, *end;
+  size_t size;
+  int kind, depth;
+
+  for(kind = 0; kind < NESTCOUNT; kind++)
+    {
+      size = DEPTH * (strlen(nestpieces[kind][0]) + strlen(nestpieces[kind][2])) +
+        strlen(nestpieces[kind][1]) + 2;
+
+      expr = malloc(size);
+      if(expr == NULL)
+        {
+          failcheck(nestpieces[kind][0], "out of memory", EXPR_ERROR_MEMORY);
+          return;
+        }
+
+      end = expr;
+      for(depth = 0; depth < DEPTH; depth++)
+        {
+          strcpy(end, nestpieces[kind][0]);
+          end += strlen(end);
+        }
+
+      strcpy(end, nestpieces[kind][1]);
+      end += strlen(end);
+
+      for(depth = 0; depth < DEPTH; depth++)
+        {
+          strcpy(end, nestpieces[kind][2]);
+          end += strlen(end);
+        }
+
+      /* The middle may have its own statements */
+      if(end[-1] != ';')
+        strcpy(end, ";");
+
+      checkexpr(expr);
+
+      free(expr);
+    }
+}
+
+/* Check the counters of a cache and the errors of its functions */
+static void checkcache(void)
+{
+  exprCache *small = NULL;
+  exprValList *vlist = NULL, *other = NULL;
+  exprObj *a = NULL, *b = NULL, *c = NULL, *bad = NULL;
+  exprCacheStats stats;
+  int err;
+
+  checks++;
+
+  err = exprCacheCreate(&small, 1);
+  if(err == EXPR_ERROR_NOERROR)
+    err = makevars(&vlist);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = makevars(&other);
+
+  /* Blanks and comments do not matter, the lists do */
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCacheGet(small, &a, flist, vlist, clist, "t = x * 2 + y;");
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCacheGet(small, &b, flist, vlist, clist, "t=x*2 # twice\n + y;");
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCacheGet(small, &c, flist, other, clist, "t = x * 2 + y;");
+
+  if(err != EXPR_ERROR_NOERROR)
+    failcheck("cache", "getting expressions", err);
+  else if(a != b || a == c)
+    failcheck("cache", "texts differing in blanks not shared", err);
+  else
+    {
+      /* Parse errors are returned and not kept */
+      err = exprCacheGet(small, &bad, flist, vlist, clist, "t = x * ;");
+      if(err == EXPR_ERROR_NOERROR || bad != NULL)
+        failcheck("cache", "bad text gave an expression", err);
+
+      exprCacheGetStats(small, &stats);
+      if(stats.hits != 1 || stats.misses != 3 || stats.entries != 2 || stats.evictions != 0)
+        failcheck("cache", "counters after getting", stats.entries);
+
+      /* Expressions in use are kept over the budget, then freed */
+      exprCacheRelease(small, a);
+      exprCacheGetStats(small, &stats);
+      if(stats.entries != 2)
+        failcheck("cache", "expression in use freed", stats.entries);
+
+      exprCacheRelease(small, b);
+      exprCacheRelease(small, c);
+      exprCacheGetStats(small, &stats);
+      if(stats.entries != 0 || stats.evictions != 2 || stats.bytes != 0)
+        failcheck("cache", "expressions not in use kept", stats.entries);
+
+      /* Releasing again, while still cached, is an error */
+      err = exprCacheGet(cache, &a, flist, vlist, clist, "t = x * 2 + y;");
+      if(err == EXPR_ERROR_NOERROR)
+        exprCacheRelease(cache, a);
+
+      if(err != EXPR_ERROR_NOERROR || exprCacheRelease(cache, a) != EXPR_ERROR_NOTFOUND)
+        failcheck("cache", "released twice", err);
+
+      err = exprCacheClear(small);
+      if(err != EXPR_ERROR_NOERROR)
+        failcheck("cache", "clearing", err);
+    }
+
+  if(small)
+    exprCacheFree(small);
+
+  if(other)
+    exprValListFree(other);
+
+  if(vlist)
+    exprValListFree(vlist);
+}
+
+/* Expressions of the group, several assign x */
+static char *groupexprs[] =
+  {
+    "x = a;",
+    "x = b;",
+    "y = x * 10;",
+    "z = y + a;",
+    "w = b * 2;",
+    "x = if(above(b, 5), b, x);",
+    "v = z - w;"
+  };
+
+#define GROUPCOUNT (int)(sizeof(groupexprs) / sizeof(groupexprs[0]))
+
+static char *groupvars[] =
+  {
+    "a", "b", "x", "y", "z", "w", "v"
+  };
+
+#define GROUPVARS (int)(sizeof(groupvars) / sizeof(groupvars[0]))
+
+/* Values of a and b at each evaluation.  Changing only a must still
+   leave x set by the later expressions. */
+static EXPRTYPE groupvals[][2] =
+  {
+    {1, 2}, {5, 2}, {5, 3}, {7, 3}, {7, 3}, {7, 6}, {8, 6}, {8, 4}, {9, 4}
+  };
+
+#define GROUPTICKS (int)(sizeof(groupvals) / sizeof(groupvals[0]))
+
+/* Compare a group with evaluating each of its expressions in order */
+static void checkgroup(exprPool *grouppool)
+{
+  exprValList *vlist[2] = {NULL, NULL};
+  exprObj *objs[2][GROUPCOUNT];
+  exprGroup *group = NULL;
+  EXPRTYPE got, want[GROUPCOUNT];
+  EXPRTYPE gotvar, wantvar;
+  int wanterr[GROUPCOUNT];
+  int tick, pos, list, err, goterr;
+  const char *what;
+
+  what = grouppool ? "group with pool" : "group";
+  memset(objs, 0, sizeof(objs));
+
+  /* List 0 is evaluated in order, list 1 by the group */
+  err = exprGroupCreate(&group);
+
+  for(list = 0; list < 2 && err == EXPR_ERROR_NOERROR; list++)
+    {
+      err = exprValListCreate(&vlist[list]);
+
+      for(pos = 0; pos < GROUPVARS && err == EXPR_ERROR_NOERROR; pos++)
+        err = exprValListAdd(vlist[list], groupvars[pos], 0.0);
+
+      for(pos = 0; pos < GROUPCOUNT && err == EXPR_ERROR_NOERROR; pos++)
+        {
+          err = exprCreate(&objs[list][pos], flist, vlist[list], clist, NULL, NULL);
+          if(err == EXPR_ERROR_NOERROR)
+            err = exprParse(objs[list][pos], groupexprs[pos]);
+
+          if(err == EXPR_ERROR_NOERROR && list == 1)
+            err = exprGroupAdd(group, objs[list][pos]);
+        }
+    }
+
+  for(tick = 0; tick < GROUPTICKS && err == EXPR_ERROR_NOERROR; tick++)
+    {
+      checks++;
+
+      for(list = 0; list < 2; list++)
+        {
+          exprValListSet(vlist[list], "a", groupvals[tick][0]);
+          exprValListSet(vlist[list], "b", groupvals[tick][1]);
+        }
+
+      for(pos = 0; pos < GROUPCOUNT; pos++)
+        wanterr[pos] = exprEval(objs[0][pos], &want[pos]);
+
+      if(grouppool)
+        err = exprGroupEvalParallel(group, grouppool, NULL);
+      else
+        err = exprGroupEval(group, NULL);
+
+      if(err != EXPR_ERROR_NOERROR)
+        break;
+
+      for(pos = 0; pos < GROUPCOUNT; pos++)
+        {
+          goterr = exprGroupGetResult(group, pos, &got);
+          if(goterr != wanterr[pos] || !same(got, want[pos]))
+            {
+              fail(groupexprs[pos], what, tick, got, goterr, want[pos], wanterr[pos]);
+              break;
+            }
+        }
+
+      for(pos = 0; pos < GROUPVARS; pos++)
+        {
+          exprValListGet(vlist[0], groupvars[pos], &wantvar);
+          exprValListGet(vlist[1], groupvars[pos], &gotvar);
+
+          if(!same(gotvar, wantvar))
+            {
+              printf("FAIL %s: evaluation %d leaves %s = %g, expected %g\n", what, tick,
+                groupvars[pos], gotvar, wantvar);
+              failures++;
+              break;
+            }
+        }
+    }
+
+  if(err != EXPR_ERROR_NOERROR)
+    fail("group", what, -1, 0.0, err, 0.0, EXPR_ERROR_NOERROR);
+
+  if(group)
+    exprGroupFree(group);
+
+  for(list = 0; list < 2; list++)
+    {
+      for(pos = 0; pos < GROUPCOUNT; pos++)
+        {
+          if(objs[list][pos])
+            exprFree(objs[list][pos]);
+        }
+
+      if(vlist[list])
+        exprValListFree(vlist[list]);
+    }
+}
+
+/* Check that a cancelled expression stops each way it is evaluated,
+   and evaluates again once allowed */
+static void checkcancel(void)
+{
+  static char *expr = "t = 0; for(i = 0, below(i, 100), i = i + 1, t = t + x); t;";
+  static char *names[] = {"cancel tree", "cancel vm", "cancel jit", "cancel context", "cancel range"};
+  exprValList *vlist = NULL;
+  exprObj *objs[3] = {NULL, NULL, NULL};
+  exprContext *ctx = NULL;
+  EXPRTYPE *x, *ctxx, val, wantval, out[4];
+  int how, pass, err, want;
+
+  err = makevars(&vlist);
+
+  for(how = 0; how < 3 && err == EXPR_ERROR_NOERROR; how++)
+    {
+      err = exprCreate(&objs[how], flist, vlist, clist, NULL, NULL);
+      if(err == EXPR_ERROR_NOERROR)
+        err = exprParse(objs[how], expr);
+    }
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCompile(objs[1]);
+
+  if(err == EXPR_ERROR_NOERROR)
+    {
+      err = exprJitCompile(objs[2]);
+      if(err == EXPR_ERROR_NONATIVE)
+        err = EXPR_ERROR_NOERROR;
+    }
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprContextCreate(&ctx, objs[0]);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListGetAddress(vlist, "x", &x);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprContextGetAddress(ctx, "x", &ctxx);
+
+  if(err != EXPR_ERROR_NOERROR)
+    failcheck(expr, "setting up cancel", err);
+
+  for(pass = 0; pass < 2 && err == EXPR_ERROR_NOERROR; pass++)
+    {
+      want = pass ? EXPR_ERROR_NOERROR : EXPR_ERROR_BREAK;
+
+      for(how = 0; how < 3; how++)
+        exprSetCancel(objs[how], !pass);
+
+      if(exprGetCancel(objs[0]) != !pass)
+        failcheck(expr, "exprGetCancel", exprGetCancel(objs[0]));
+
+      *x = 1.0;
+      *ctxx = 1.0;
+
+      for(how = 0; how < 5; how++)
+        {
+          checks++;
+          val = 0.0;
+
+          switch(how)
+            {
+              case 0:
+                err = exprEval(objs[0], &val);
+                break;
+
+              case 1:
+              case 2:
+                err = exprEvalCompiled(objs[how], &val);
+                break;
+
+              case 3:
+                err = exprContextEval(ctx, &val);
+                break;
+
+              case 4:
+                err = exprEvalRange(objs[0], x, 0, 4, out, pool);
+                val = out[3];
+                break;
+            }
+
+          wantval = how == 4 ? 300.0 : 100.0;
+          if(err != want || (pass && val != wantval))
+            fail(expr, names[how], pass, val, err, wantval, want);
+        }
+
+      err = EXPR_ERROR_NOERROR;
+    }
+
+  if(ctx)
+    exprContextFree(ctx);
+
+  for(how = 0; how < 3; how++)
+    {
+      if(objs[how])
+        exprFree(objs[how]);
+    }
+
+  if(vlist)
+    exprValListFree(vlist);
+}
+
+/* Parse, evaluate and free an expression with lists of its own */
+static int roundtrip(char *expr)
+{
+  exprValList *vlist = NULL;
+  exprObj *obj = NULL;
+  EXPRTYPE val;
+  int err;
+
+  err = makevars(&vlist);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreate(&obj, flist, vlist, clist, NULL, NULL);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprParse(obj, expr);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCompile(obj);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprEval(obj, &val);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprEvalCompiled(obj, &val);
+
+  if(obj)
+    exprFree(obj);
+
+  if(vlist)
+    exprValListFree(vlist);
+
+  return err;
+}
+
+/* Check that the memory of an expression is all given back */
+static void checkmemstats(void)
+{
+  exprMemStats before, after;
+  int err;
+
+  checks++;
+
+  /* Once first, anything made only once is then already made */
+  roundtrip(exprs[0]);
+
+  exprGetMemStats(&before);
+  err = roundtrip(exprs[0]);
+  exprGetMemStats(&after);
+
+  if(err != EXPR_ERROR_NOERROR)
+    failcheck(exprs[0], "memory round trip", err);
+  else if(after.allocs == before.allocs || after.bytes <= before.bytes)
+    failcheck(exprs[0], "allocations not counted", (int)(after.allocs - before.allocs));
+  else if(after.allocs - before.allocs != after.frees - before.frees)
+    failcheck(exprs[0], "allocations not freed",
+      (int)((after.allocs - before.allocs) - (after.frees - before.frees)));
+}
+
+/* Check the counts of the profiler, where it is built in */
+static void checkprofile(void)
+{
+  static char *expr = "t = 0; for(i = 0, below(i, 5), i = i + 1, t = t + sin(x)); t;";
+  exprValList *vlist = NULL;
+  exprObj *obj = NULL;
+  EXPRTYPE val, plain;
+  char *report = NULL, *line;
+  unsigned long visits;
+  int pass, count, err;
+
+  checks++;
+
+  err = makevars(&vlist);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListSet(vlist, "x", 0.75);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreate(&obj, flist, vlist, clist, NULL, NULL);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprParse(obj, expr);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprEval(obj, &plain);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprSetProfile(obj, 1);
+
+  if(err == EXPR_ERROR_NOPROFILE)
+    {
+      /* Not built in, nothing else may be profiled either */
+      err = exprProfileReset(obj);
+      if(err != EXPR_ERROR_NOPROFILE)
+        failcheck(expr, "reset without the profiler", err);
+
+      err = EXPR_ERROR_NOERROR;
+    }
+  else if(err == EXPR_ERROR_NOERROR)
+    {
+      /* Three evaluations, then none after the reset */
+      for(pass = 0; pass < 2 && err == EXPR_ERROR_NOERROR; pass++)
+        {
+          for(count = 0; pass == 0 && count < 3 && err == EXPR_ERROR_NOERROR; count++)
+            {
+              err = exprEval(obj, &val);
+              if(err == EXPR_ERROR_NOERROR && !same(val, plain))
+                fail(expr, "profiled", count, val, err, plain, err);
+            }
+
+          if(err == EXPR_ERROR_NOERROR)
+            err = exprProfileReport(obj, expr, &report);
+
+          if(err != EXPR_ERROR_NOERROR)
+            break;
+
+          /* The line of sin(x) starts with its number of visits */
+          line = strstr(report, "sin(x)");
+          while(line && line > report && line[-1] != '\n')
+            line--;
+
+          visits = 0;
+          if(strncmp(report, pass ? "Profile of 0 evaluations" : "Profile of 3 evaluations", 24) != 0)
+            failcheck(expr, "report heading", pass);
+          else if(pass == 0 && (line == NULL || sscanf(line, "%lu", &visits) != 1 || visits != 15))
+            failcheck(expr, "visits of sin(x)", (int)visits);
+
+          exprProfileReportFree(report);
+
+          if(pass == 0)
+            err = exprProfileReset(obj);
+        }
+
+      if(err == EXPR_ERROR_NOERROR)
+        err = exprSetProfile(obj, 0);
+
+      if(err == EXPR_ERROR_NOERROR && exprProfileReset(obj) != EXPR_ERROR_NOPROFILE)
+        failcheck(expr, "reset after stopping", err);
+    }
+
+  if(err != EXPR_ERROR_NOERROR)
+    failcheck(expr, "profile", err);
+
+  if(obj)
+    exprFree(obj);
+
+  if(vlist)
+    exprValListFree(vlist);
+}
+
+/* Slot of an error in the counters */
+static int statcode(int err)
+{
+  return (err > 0 && err < EXPR_ERROR_USER) ? err : EXPR_ERROR_USER;
+}
+
+/* Check the library counters over some parses and evaluations */
+static void checkstats(void)
+{
+  static exprStats before, after;
+  exprValList *vlist = NULL;
+  exprObj *obj = NULL;
+  EXPRTYPE val;
+  int parseerr, evalerr, row, fails, pos, err;
+
+  checks++;
+
+  exprGetStats(&before);
+
+  /* A parse that fails, then one that succeeds */
+  err = makevars(&vlist);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreate(&obj, flist, vlist, clist, NULL, NULL);
+
+  parseerr = EXPR_ERROR_NOERROR;
+  if(err == EXPR_ERROR_NOERROR)
+    {
+      parseerr = exprParse(obj, "t = x * ;");
+      exprClear(obj);
+      err = exprParse(obj, "x / y;");
+    }
+
+  /* Some rows divide by 0 */
+  fails = 0;
+  evalerr = EXPR_ERROR_NOERROR;
+  for(row = 0; row < ROWS && err == EXPR_ERROR_NOERROR; row++)
+    {
+      exprValListSet(vlist, "x", rows[0][row]);
+      exprValListSet(vlist, "y", rows[1][row]);
+
+      pos = exprEval(obj, &val);
+      if(pos != EXPR_ERROR_NOERROR)
+        {
+          evalerr = pos;
+          fails++;
+        }
+    }
+
+  exprGetStats(&after);
+
+  if(err != EXPR_ERROR_NOERROR || parseerr == EXPR_ERROR_NOERROR)
+    failcheck("stats", "setting up", err);
+  else if(after.parses - before.parses != 2 ||
+    after.parseerrors[statcode(parseerr)] - before.parseerrors[statcode(parseerr)] != 1)
+    failcheck("stats", "parses", (int)(after.parses - before.parses));
+  else if(after.evals - before.evals != ROWS ||
+    (fails && after.evalerrors[statcode(evalerr)] - before.evalerrors[statcode(evalerr)] != (unsigned long)fails))
+    failcheck("stats", "evaluations", (int)(after.evals - before.evals));
+  else if(after.nodes == before.nodes || after.livenodes <= before.livenodes)
+    failcheck("stats", "nodes", (int)(after.livenodes - before.livenodes));
+
+  if(obj)
+    exprFree(obj);
+
+  exprGetStats(&after);
+  if(after.livenodes != before.livenodes)
+    failcheck("stats", "nodes alive after freeing", (int)(after.livenodes - before.livenodes));
+
+  if(vlist)
+    exprValListFree(vlist);
+}
+
+/* Allocator counting its blocks, failing from a given call on */
+typedef struct _checkAlloc
+{
+  long live; /* Blocks not freed */
+  long calls; /* Allocations and resizes */
+  long failat; /* Call that fails and those after it, 0 for none */
+} checkAlloc;
+
+static void *allocfunc(void *context, unsigned long size)
+{
+  checkAlloc *c = context;
+  void *data;
+
+  c->calls++;
+  if(c->failat && c->calls >= c->failat)
+    return NULL;
+
+  data = malloc(size ? size : 1);
+  if(data)
+    c->live++;
+
+  return data;
+}
+
+static void *reallocfunc(void *context, void *data, unsigned long size)
+{
+  checkAlloc *c = context;
+  void *tmp;
+
+  c->calls++;
+  if(c->failat && c->calls >= c->failat)
+    return NULL;
+
+  tmp = realloc(data, size ? size : 1);
+  if(tmp && data == NULL)
+    c->live++;
+
+  return tmp;
+}
+
+static void freefunc(void *context, void *data)
+{
+  checkAlloc *c = context;
+
+  if(data)
+    {
+      c->live--;
+      free(data);
+    }
+}
+
+/* Parse and evaluate with everything taken from an allocator */
+static int allocwork(exprAllocator *alloc, EXPRTYPE *val)
+{
+  exprFuncList *fl = NULL;
+  exprValList *vl = NULL;
+  exprArena *arena = NULL;
+  exprObj *obj = NULL;
+  int err;
+
+  err = exprFuncListCreateEx(&fl, alloc);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprFuncListInit(fl);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListCreateEx(&vl, alloc);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListAdd(vl, "x", 1.5);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprArenaCreateEx(&arena, 64, alloc);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreateEx(&obj, fl, vl, NULL, NULL, NULL, alloc);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprSetArena(obj, arena);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprParse(obj, "t = x * 2; u = sqrt(t) + if(above(t, 1), t, -t); u * t;");
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCompile(obj);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprEvalCompiled(obj, val);
+
+  if(obj)
+    exprFree(obj);
+
+  if(arena)
+    exprArenaFree(arena);
+
+  if(vl)
+    exprValListFree(vl);
+
+  if(fl)
+    exprFuncListFree(fl);
+
+  return err;
+}
+
+/* Check that objects take their memory from their allocator, give
+   it all back, and fail cleanly when it runs out */
+static void checkalloc(void)
+{
+  checkAlloc counts;
+  exprAllocator alloc;
+  EXPRTYPE val, want;
+  long calls, failat;
+  int err;
+
+  memset(&counts, 0, sizeof(counts));
+  alloc.allocfunc = allocfunc;
+  alloc.reallocfunc = reallocfunc;
+  alloc.freefunc = freefunc;
+  alloc.context = &counts;
+
+  checks++;
+
+  err = allocwork(&alloc, &want);
+  calls = counts.calls;
+
+  if(err != EXPR_ERROR_NOERROR)
+    {
+      failcheck("allocator", "evaluating", err);
+      return;
+    }
+
+  if(calls == 0 || counts.live != 0)
+    failcheck("allocator", "blocks not taken or not given back", (int)counts.live);
+
+  /* Each allocation failing in turn */
+  for(failat = 1; failat <= calls; failat++)
+    {
+      checks++;
+
+      memset(&counts, 0, sizeof(counts));
+      counts.failat = failat;
+      val = 0.0;
+
+      err = allocwork(&alloc, &val);
+
+      if(err != EXPR_ERROR_NOERROR && err != EXPR_ERROR_MEMORY)
+        fail("allocator", "failing allocation", (int)failat, val, err, want, EXPR_ERROR_MEMORY);
+      else if(err == EXPR_ERROR_NOERROR && !same(val, want))
+        fail("allocator", "failing allocation", (int)failat, val, err, want, EXPR_ERROR_NOERROR);
+      else if(counts.live != 0)
+        failcheck("allocator", "blocks kept after a failed allocation", (int)failat);
+    }
+}
+
+int main(void)
+{
+  EXPRTYPE zero, nan;
+  int pos, err;
+
+  /* NaN is made at run time, some compilers reject 0.0 / 0.0 */
+  zero = 0.0;
+  nan = zero / zero;
+
+  rows[0][0] = 1.5; rows[1][0] = 2.0; rows[2][0] = -1.0;
+  rows[0][1] = -2.0; rows[1][1] = 0.5; rows[2][1] = 0.0;
+  rows[0][2] = 0.0; rows[1][2] = -1.0; rows[2][2] = 2.5;
+  rows[0][3] = 3.0; rows[1][3] = 0.0; rows[2][3] = -zero;
+  rows[0][4] = -zero; rows[1][4] = 4.0; rows[2][4] = 1e300;
+  rows[0][5] = 7.25; rows[1][5] = -3.5; rows[2][5] = nan;
+  rows[0][6] = 0.5; rows[1][6] = 0.25; rows[2][6] = -nan;
+  rows[0][7] = nan; rows[1][7] = 1.0; rows[2][7] = 0.75;
+
+  nativedir = getenv("TMPDIR");
+  if(nativedir == NULL || *nativedir == '\0')
+    nativedir = "/tmp";
+
+  err = exprFuncListCreate(&flist);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprFuncListInit(flist);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListCreate(&clist);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprValListInit(clist);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCacheCreate(&cache, 64 * 1024);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprPoolCreate(&pool, 3);
+
+  if(err != EXPR_ERROR_NOERROR)
+    {
+      printf("Error %d setting up\n", err);
+      return 1;
+    }
+
+  for(pos = 0; pos < EXPRCOUNT; pos++)
+    checkexpr(exprs[pos]);
+
+  nansigns = 1;
+  for(pos = 0; pos < SIGNCOUNT; pos++)
+    checkexpr(signexprs[pos]);
+
+  nansigns = 0;
+  checkkernels();
+  checknested();
+  checkcache();
+  checkgroup(NULL);
+  checkgroup(pool);
+  checkcancel();
+  checkmemstats();
+  checkprofile();
+  checkstats();
+  checkalloc();
+
+  if(nonative)
+    printf("Native code is not available, only its source was checked\n");
+
+  exprPoolFree(pool);
+  exprCacheFree(cache);
+  exprValListFree(clist);
+  exprFuncListFree(flist);
+
+  printf("%d checks, %d failed\n", checks, failures);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,329 @@
+/*
+  File: parsebench.c
+  Auth: agent
+  Date: Saturday, October 17, 2026
+  Desc: Time exprParse on generated expressions of growing size
+
+  Expressions are generated from a number of terms, a depth of
+  parentheses around the first term, a number of different
+  variable names and the percent of terms that call a function.
+  Each series changes one of these while keeping the others fixed.
+
+  The time for each token should stay about the same down a series
+  if parsing is linear.  At the end of the size and depth series
+  the time is fitted to a power of the tokens, so an exponent near
+  1 is linear and near 2 is quadratic.  Lookups of names that get
+  slower as there are more of them show in the names series.  The
+  memory is what the first parse of each expression allocates on a
+  new expression object, which is more than the most it uses at
+  once since resized blocks are counted at their new size.
+
+  Usage: parsebench [-quick]
+
+  -quick stops the growing series at a sixteenth of their largest size.
+
+  Build with something like:
+    cc -O2 -o parsebench parsebench.c ../expr*.c -lm
+*/
+
+/* Needed for clock_gettime */
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "../expreval.h"
+
+/* Use the monotonic clock where there is one */
+#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) && defined(CLOCK_MONOTONIC)
+#define BENCH_MONOTONIC
+#endif
+
+/* Parse for at least this long for each expression */
+#define MINTIME 0.1
+
+/* Most rows of a series */
+#define MAXROWS 32
+
+/* Shape of a generated expression */
+typedef struct _genShape
+{
+  long terms; /* Operands of the binary operators */
+  long depth; /* Parentheses around the first term */
+  long names; /* Different variable names */
+  long calls; /* Percent of terms calling a function */
+} genShape;
+
+/* Parts of the shape a series changes */
+#define GEN_TERMS 0
+#define GEN_DEPTH 1
+#define GEN_NAMES 2
+#define GEN_CALLS 3
+
+/* A series of expressions */
+typedef struct _genSeries
+{
+  const char *name;
+  genShape shape; /* Shape of the first row */
+  int part; /* GEN_* part of the shape the series changes */
+  long last; /* Value of the part in the last row */
+  long mult, add; /* Each row the part is multiplied then added to */
+  int fit; /* Fit the time to the tokens if nonzero */
+} genSeries;
+
+/* Seconds from some fixed time */
+static double now(void)
+{
+#ifdef BENCH_MONOTONIC
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Generate an expression, returns the buffer or NULL and the
+   number of tokens in *tokens */
+static char *generate(genShape *shape, long *tokens)
+{
+  static const char *ops[] = {" + ", " - ", " * ", " / ", "^"};
+  static const char *funcs[] = {"sin(v%ld)", "min(v%ld, 2.5)", "if(v%ld, 1, -1)", "abs(v%ld - 3)"};
+  static const int functokens[] = {4, 6, 9, 6};
+  char *buf;
+  long term, len, count;
+  int kind;
+
+  buf = malloc(shape->terms * 32 + shape->depth * 2 + 16);
+  if(buf == NULL)
+    return NULL;
+
+  len = 0;
+  count = 1; /* The ; */
+
+  for(term = 0; term < shape->depth; term++)
+    buf[len++] = '(';
+
+  count += 2 * shape->depth;
+
+  for(term = 0; term < shape->terms; term++)
+    {
+      if(term > 0)
+        {
+          len += sprintf(buf + len, "%s", ops[term % 5]);
+          count++;
+        }
+
+      if((term * 37) % 100 < shape->calls)
+        {
+          kind = (int)(term % 4);
+          len += sprintf(buf + len, funcs[kind], term % shape->names);
+          count += functokens[kind];
+        }
+      else if(term % 4 == 3)
+        {
+          len += sprintf(buf + len, "%ld.25", term % 100);
+          count++;
+        }
+      else
+        {
+          len += sprintf(buf + len, "v%ld", term % shape->names);
+          count++;
+        }
+
+      if(term == 0)
+        {
+          for(kind = 0; kind < shape->depth; kind++)
+            buf[len++] = ')';
+        }
+    }
+
+  strcpy(buf + len, ";");
+
+  *tokens = count;
+  return buf;
+}
+
+/* Parse an expression on a new object, returns nonzero on error */
+static int measure(exprFuncList *f, genShape *shape, long *tokens, double *usec, int *parses, unsigned long *bytes)
+{
+  exprMemStats before, after;
+  exprValList *v = NULL;
+  exprObj *e = NULL;
+  double start, secs;
+  char *buf;
+  int err;
+
+  buf = generate(shape, tokens);
+  if(buf == NULL)
+    return EXPR_ERROR_MEMORY;
+
+  err = exprValListCreate(&v);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprCreate(&e, f, v, NULL, NULL, NULL);
+
+  /* Memory of the first parse, which also adds the variables */
+  exprGetMemStats(&before);
+
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprParse(e, buf);
+
+  exprGetMemStats(&after);
+  *bytes = after.bytes - before.bytes;
+
+  /* Parse it until enough time has passed */
+  *parses = 0;
+  start = now();
+
+  do
+    {
+      if(err == EXPR_ERROR_NOERROR)
+        err = exprClear(e);
+
+      if(err == EXPR_ERROR_NOERROR)
+        err = exprParse(e, buf);
+
+      (*parses)++;
+      secs = now() - start;
+    }
+  while(secs < MINTIME && err == EXPR_ERROR_NOERROR);
+
+  *usec = secs * 1e6 / *parses;
+
+  exprFree(e);
+  exprValListFree(v);
+  free(buf);
+
+  return err;
+}
+
+/* Find the part of a shape a series changes */
+static long *part(genShape *shape, int which)
+{
+  switch(which)
+    {
+      case GEN_DEPTH:
+        return &(shape->depth);
+
+      case GEN_NAMES:
+        return &(shape->names);
+
+      case GEN_CALLS:
+        return &(shape->calls);
+
+      default:
+        return &(shape->terms);
+    }
+}
+
+/* Run a series and print its rows */
+static int series(exprFuncList *f, genSeries *ser, int quick)
+{
+  genShape shape;
+  double xs[MAXROWS], ys[MAXROWS];
+  double usec, sx, sy, sxx, sxy;
+  unsigned long bytes;
+  long tokens, *field;
+  int rows, parses, pos, err;
+
+  shape = ser->shape;
+  field = part(&shape, ser->part);
+
+  printf("\n%s\n", ser->name);
+  printf("%8s %6s %6s %6s %8s %7s %12s %11s %11s\n", "terms", "depth", "names", "calls", "tokens",
+    "parses", "usec/parse", "nsec/token", "bytes/token");
+
+  for(rows = 0; rows < MAXROWS && *field <= ser->last; rows++)
+    {
+      err = measure(f, &shape, &tokens, &usec, &parses, &bytes);
+      if(err != EXPR_ERROR_NOERROR)
+        {
+          printf("Parse Error: %d\n", err);
+          return err;
+        }
+
+      printf("%8ld %6ld %6ld %5ld%% %8ld %7d %12.2f %11.2f %11.2f\n", shape.terms, shape.depth,
+        shape.names, shape.calls, tokens, parses, usec, usec * 1e3 / tokens, (double)bytes / tokens);
+
+      xs[rows] = log((double)tokens);
+      ys[rows] = log(usec);
+
+      *field = *field * ser->mult + ser->add;
+
+      if(quick && ser->mult > 1 && *field > ser->last / 16)
+        {
+          rows++;
+          break;
+        }
+    }
+
+  /* Least squares fit of log(time) to log(tokens), leaving out the
+     smallest rows where the overhead of a parse is most of it */
+  if(ser->fit && rows >= 3)
+    {
+      sx = sy = sxx = sxy = 0;
+
+      for(pos = rows / 3; pos < rows; pos++)
+        {
+          sx += xs[pos];
+          sy += ys[pos];
+          sxx += xs[pos] * xs[pos];
+          sxy += xs[pos] * ys[pos];
+        }
+
+      pos = rows - rows / 3;
+      printf("time grows as tokens^%.2f\n", (pos * sxy - sx * sy) / (pos * sxx - sx * sx));
+    }
+
+  return EXPR_ERROR_NOERROR;
+}
+
+int main(int argc, char **argv)
+{
+  static genSeries list[] =
+    {
+      /* Size, from 1 token to about 1 million */
+      {"size", {1, 0, 16, 10}, GEN_TERMS, 524288, 2, 0, 1},
+      /* Nesting depth of parentheses */
+      {"depth", {1000, 1, 16, 10}, GEN_DEPTH, 65536, 4, 0, 1},
+      /* Different names, with the same number of terms */
+      {"names", {65536, 0, 1, 0}, GEN_NAMES, 65536, 4, 0, 0},
+      /* Function call density */
+      {"calls", {20000, 0, 16, 0}, GEN_CALLS, 100, 1, 25, 0}
+    };
+  exprFuncList *f = NULL;
+  int quick, pos, err;
+
+  quick = (argc > 1 && strcmp(argv[1], "-quick") == 0);
+
+  err = exprFuncListCreate(&f);
+  if(err == EXPR_ERROR_NOERROR)
+    err = exprFuncListInit(f);
+
+  if(err != EXPR_ERROR_NOERROR)
+    {
+      printf("Setup Error: %d\n", err);
+      return 1;
+    }
+
+  for(pos = 0; pos < (int)(sizeof(list) / sizeof(list[0])); pos++)
+    {
+      if(series(f, &list[pos], quick) != EXPR_ERROR_NOERROR)
+        return 1;
+    }
+
+  exprFuncListFree(f);
+
+  return 0;
+}